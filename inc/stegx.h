@@ -26,6 +26,8 @@
 #ifndef STEGX_H
 #define STEGX_H
 
+#include <stdint.h>
+
 #include "stegx_common.h"
 #include "stegx_errors.h"
 
@@ -62,6 +64,24 @@ info_s *stegx_init(stegx_choices_s * choices);
  */
 void stegx_clear(info_s * infos);
 
+/**
+ * @brief Réutilise une structure pour un nouveau traitement.
+ * @details Équivalent de \r{stegx_clear} suivi de \r{stegx_init}, mais la
+ * structure et sa mémoire temporaire (nom du fichier caché, mot de passe,
+ * tampons des algorithmes) sont conservées : un traitement qui n'a pas plus
+ * de besoins que le précédent ne fait aucune allocation sur le tas.
+ * @req Avoir appelé \r{stegx_init} sur le paramètre "infos".
+ * @param infos Structure du traitement précédent.
+ * @param choices Choix de l'utilisateur pour le nouveau traitement, ou NULL
+ * pour seulement terminer le traitement précédent (fichiers fermés, mémoire
+ * temporaire rendue) en gardant la structure pour plus tard.
+ * @return 0 si la réinitialisation s'est bien déroulée, sinon 1 et met à jour
+ * \r{stegx_errno}. Dans tous les cas, "infos" doit être libérée par
+ * \r{stegx_clear}, qui ferme aussi les fichiers fournis par l'appelant.
+ * @author StegX Team
+ */
+int stegx_reset(info_s * infos, stegx_choices_s * choices);
+
 /**
  * @brief Vérifie la compatibilité des fichiers.
  * @sideeffect Remplit le champ \r{info_s.host.type} de la structure \r{info_s}.
@@ -123,6 +143,50 @@ int stegx_choose_algo(info_s * infos, algo_e algo_choosen);
  */
 int stegx_detect_algo(info_s * infos);
 
+/** 
+ * @brief Renvoie le nom du fichier caché.
+ * @req \r{stegx_detect_algo} doit avoir réussi (extraction) ou
+ * \r{stegx_init} doit avoir été appelée (insertion).
+ * @param infos Structure représentant les informations concernant la dissimulation.
+ * @return Nom du fichier caché, valide jusqu'à \r{stegx_clear}.
+ * @author StegX Team
+ */
+const char *stegx_hidden_name(const info_s * infos);
+
+/** 
+ * @brief Renvoie l'algorithme détecté lors de l'extraction.
+ * @req \r{stegx_detect_algo} doit avoir réussi.
+ * @param infos Structure représentant les informations concernant l'extraction.
+ * @return Algorithme utilisé lors de la dissimulation.
+ * @author StegX Team
+ */
+algo_e stegx_detected_algo(const info_s * infos);
+
+/** 
+ * @brief Sonde rapidement un fichier pour savoir s'il peut contenir des
+ * données cachées.
+ * @details Seuls le premier et le dernier bloc de 4 Kio du fichier sont lus,
+ * le milieu du fichier jamais. Le format est reconnu sur le premier bloc, en
+ * une passe sur une table de signatures. Le fichier est suspect s'il se
+ * termine par un pied de signature StegX (version 2) ou, sinon, s'il ne se
+ * termine pas là où son format l'indique (les algorithmes écrivent tous la
+ * signature StegX après la fin de l'hôte). Quand la signature est dans le
+ * dernier bloc (tous les algorithmes sauf EOF et JUNK_CHUNK avec plus de
+ * quelques Kio de données), elle y est lue et l'algorithme est connu ; sinon
+ * les données suivent la signature et l'algorithme est supposé être EOF (ou
+ * JUNK_CHUNK pour AVI). Un fichier suspect doit ensuite passer par
+ * \r{stegx_detect_algo} pour confirmer la présence de données.
+ * @error \r{ERR_HOST} si le fichier ne peut pas être lu.
+ * @param path Chemin du fichier à sonder.
+ * @param res Résultat détaillé du sondage (peut être NULL).
+ * @return 1 si le fichier peut contenir des données cachées (y compris quand
+ * le sondage ne permet pas de conclure), 0 s'il n'en contient pas (format non
+ * pris en charge ou fichier terminé normalement), -1 en cas d'erreur et met à
+ * jour \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_probe(const char *path, stegx_probe_s * res);
+
 /** 
  * @brief Va faire l'insertion selon l'algorithme, ainsi que les 
  * fichiers en entrée choisis par l'utilisateur. 
@@ -134,6 +198,85 @@ int stegx_detect_algo(info_s * infos);
  */
 int stegx_insert(info_s * infos);
 
+/** 
+ * @brief Insère un fichier à cacher différent dans plusieurs copies d'un même
+ * fichier hôte.
+ * @details Le fichier hôte n'est ouvert, vérifié et analysé qu'une seule fois.
+ * Lorsque l'algorithme le permet (EOF, Junk Chunk, Metadata sur PNG et LSB
+ * séquentiel sur BMP et WAVE), l'hôte est lu une seule fois par fenêtre de
+ * taille fixe et chaque fenêtre est écrite, éventuellement modifiée, dans
+ * tous les fichiers résultats. Sinon, l'insertion est faite destinataire par
+ * destinataire en réutilisant l'analyse de l'hôte. Les fichiers des
+ * destinataires ne sont ouverts que pendant leur insertion, par lots bornés
+ * par la limite de descripteurs du processus (\c RLIMIT_NOFILE) : l'hôte est
+ * alors relu une fois par lot.
+ * @sideeffect Remplit le champ \r{stegx_dest_s.err} de chaque destinataire.
+ * @error \r{ERR_HOST} si une erreur survient pendant l'ouverture du fichier hôte.
+ * @error \r{ERR_CHECK_COMPAT} si le fichier hôte n'est pas compatible.
+ * @error \r{ERR_SUGG_ALGOS} si l'analyse du fichier hôte a échouée.
+ * @error \r{ERR_INSERT} si l'insertion a échouée pour au moins un destinataire.
+ * @param host_path Chemin du fichier hôte.
+ * @param algo Algorithme à utiliser pour tous les destinataires.
+ * @param dests Tableau des destinataires.
+ * @param nb Nombre de destinataires.
+ * @return 0 si toutes les insertions se sont bien passées, sinon 1 et met à
+ * jour \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_insert_multi(const char *host_path, algo_e algo, stegx_dest_s * dests, unsigned int nb);
+
+/** 
+ * @brief Ouvre (ou crée) le cache partagé des fichiers hôtes.
+ * @details Les processus qui ouvrent un cache du même nom partagent le contenu
+ * des hôtes et le résultat de leur analyse : un hôte n'est lu et analysé
+ * qu'une fois, puis projeté en lecture seule dans chaque processus qui
+ * l'utilise avec l'option \r{STEGX_FLAG_CACHE}. Quand le budget est dépassé,
+ * les hôtes utilisés le moins récemment sont retirés du cache.
+ * @sideeffect Crée le segment de mémoire partagée "/<name>" s'il n'existe pas.
+ * @error \r{ERR_CACHE} si le cache ne peut pas être ouvert.
+ * @param name Nom du cache (sans '/').
+ * @param budget Mémoire maximale occupée par les hôtes (octets). Si le cache
+ * existe déjà, 0 conserve son budget actuel.
+ * @return 0 si le cache est ouvert, sinon 1 et met à jour \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_cache_open(const char *name, uint64_t budget);
+
+/** 
+ * @brief Ferme le cache partagé des fichiers hôtes.
+ * @req Les structures utilisant un hôte du cache peuvent encore être
+ * utilisées : leur projection reste valide jusqu'à \r{stegx_clear}.
+ * @param destroy Si non nul, retire tous les hôtes et supprime le cache pour
+ * tous les processus.
+ * @author StegX Team
+ */
+void stegx_cache_close(int destroy);
+
+/** 
+ * @brief Ouvre et analyse un fichier hôte pour plusieurs traitements.
+ * @details Le fichier est projeté en lecture seule puis vérifié et analysé une
+ * seule fois. Les traitements dont le champ \r{stegx_choices.host} pointe sur
+ * cet hôte le lisent depuis la projection, chacun par son propre flux, et
+ * peuvent s'exécuter dans des threads différents.
+ * @error \r{ERR_HOST} si le fichier ne peut pas être ouvert.
+ * @error \r{ERR_CHECK_COMPAT} si le fichier n'est pas compatible.
+ * @error \r{ERR_SUGG_ALGOS} ou \r{ERR_DETECT_ALGOS} si l'analyse a échoué.
+ * @param path Chemin du fichier hôte.
+ * @param mode Mode des traitements qui utiliseront l'hôte.
+ * @return Hôte ouvert, sinon NULL et met à jour \r{stegx_errno}.
+ * @author StegX Team
+ */
+stegx_host_s *stegx_host_open(const char *path, mode_e mode);
+
+/** 
+ * @brief Ferme un hôte ouvert par \r{stegx_host_open}.
+ * @req Tous les traitements utilisant l'hôte doivent avoir appelé
+ * \r{stegx_clear}.
+ * @param host Hôte à fermer (NULL accepté).
+ * @author StegX Team
+ */
+void stegx_host_close(stegx_host_s * host);
+
 /** 
  * @brief Va faire l'extraction selon l'algorithme détecté, ainsi que les 
  * fichiers en entrée choisis par l'utilisateur. 
@@ -146,4 +289,245 @@ int stegx_insert(info_s * infos);
  */
 int stegx_extract(info_s * infos, char *res_path);
 
+/** 
+ * @brief Prépare la recherche du mot de passe d'un fichier hôte parmi des
+ * candidats.
+ * @details L'hôte est projeté et analysé, et sa signature lue, une seule fois
+ * pour tous les candidats. Les fonctions \r{stegx_trial_name},
+ * \r{stegx_trial_key} et \r{stegx_trial_extract} peuvent ensuite être
+ * appelées depuis plusieurs threads en même temps.
+ * @error \r{ERR_HOST} si le fichier hôte ne peut pas être lu.
+ * @error \r{ERR_CHECK_COMPAT} si le format de l'hôte n'est pas pris en charge.
+ * @error \r{ERR_DETECT_ALGOS} si l'hôte ne contient pas de signature.
+ * @error \r{ERR_NO_PASSWD} si les données n'ont pas été cachées avec un mot
+ * de passe (\r{stegx_extract} suffit).
+ * @param host_path Chemin du fichier hôte.
+ * @return Recherche à libérer avec \r{stegx_trial_close}, sinon NULL et met à
+ * jour \r{stegx_errno}.
+ * @author StegX Team
+ */
+stegx_trial_s *stegx_trial_open(const char *host_path);
+
+/** 
+ * @brief Teste un mot de passe candidat sur le nom du fichier caché.
+ * @details Ne déXOR que le nom du fichier caché de la signature : un candidat
+ * est rejeté si le nom obtenu ne peut pas être un nom de fichier (caractère de
+ * contrôle ou '/').
+ * @param t Recherche ouverte par \r{stegx_trial_open}.
+ * @param passwd Mot de passe candidat.
+ * @param name Tampon d'au moins 256 octets recevant le nom déXORé.
+ * @return 1 si le candidat est plausible, 0 s'il est rejeté.
+ * @author StegX Team
+ */
+int stegx_trial_name(const stegx_trial_s * t, const char *passwd, char *name);
+
+/** 
+ * @brief Donne la clé d'un mot de passe.
+ * @details Les données cachées ne dépendent du mot de passe que par cette clé
+ * (la seed de la protection des données) : deux candidats de même clé donnent
+ * exactement les mêmes données, seule une extraction est nécessaire.
+ * @param passwd Mot de passe non vide.
+ * @return Clé du mot de passe.
+ * @author StegX Team
+ */
+unsigned int stegx_trial_key(const char *passwd);
+
+/** 
+ * @brief Renvoie la taille des données cachées (écrite en clair dans la
+ * signature).
+ * @param t Recherche ouverte par \r{stegx_trial_open}.
+ * @return Taille des données cachées en octets.
+ * @author StegX Team
+ */
+uint32_t stegx_trial_length(const stegx_trial_s * t);
+
+/** 
+ * @brief Extrait les données cachées avec un mot de passe candidat.
+ * @param t Recherche ouverte par \r{stegx_trial_open}.
+ * @param passwd Mot de passe candidat.
+ * @param res Fichier ouvert en écriture recevant les données (fermé dans tous
+ * les cas).
+ * @return 0 si l'extraction s'est bien passée, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_trial_extract(const stegx_trial_s * t, const char *passwd, FILE * res);
+
+/** 
+ * @brief Termine une recherche de mot de passe.
+ * @param t Recherche à libérer (NULL accepté).
+ * @author StegX Team
+ */
+void stegx_trial_close(stegx_trial_s * t);
+
+/** 
+ * @brief Écrit un registre des empreintes.
+ * @details Le registre associe chaque jeton (données cachées pour un
+ * utilisateur) à son identité. Il est écrit dans un fichier temporaire
+ * renommé à la fin : un registre ouvert n'est jamais modifié.
+ * @error \r{ERR_REGISTRY} si un jeton est invalide ou en double, ou si le
+ * fichier ne peut pas être écrit.
+ * @param path Chemin du registre.
+ * @param tokens Jetons et identités.
+ * @param nb Nombre de jetons.
+ * @return 0 si le registre a été écrit, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_registry_build(const char *path, const stegx_token_s * tokens, size_t nb);
+
+/** 
+ * @brief Ouvre un registre des empreintes.
+ * @details Le registre est projeté en mémoire et vérifié une fois ; il peut
+ * ensuite être interrogé depuis plusieurs threads en même temps, directement
+ * (\r{stegx_registry_lookup}) ou par les extractions
+ * (\r{stegx_choices_s.registry}).
+ * @error \r{ERR_REGISTRY} si le registre ne peut pas être lu ou est invalide.
+ * @param path Chemin du registre.
+ * @return Registre à fermer avec \r{stegx_registry_close}, sinon NULL et met
+ * à jour \r{stegx_errno}.
+ * @author StegX Team
+ */
+stegx_registry_s *stegx_registry_open(const char *path);
+
+/** 
+ * @brief Recherche un jeton dans le registre des empreintes.
+ * @param r Registre ouvert.
+ * @param token Jeton à chercher.
+ * @param len Taille du jeton.
+ * @param id Identité trouvée (chaînes valides jusqu'à
+ * \r{stegx_registry_close}).
+ * @return 0 si le jeton a été trouvé, 1 sinon.
+ * @author StegX Team
+ */
+int stegx_registry_lookup(const stegx_registry_s * r, const void *token, size_t len,
+                          stegx_identity_s * id);
+
+/** 
+ * @brief Ferme un registre des empreintes.
+ * @param r Registre à fermer (NULL accepté).
+ * @author StegX Team
+ */
+void stegx_registry_close(stegx_registry_s * r);
+
+/** 
+ * @brief Renvoie l'identité associée aux données extraites.
+ * @req \r{stegx_extract} doit avoir réussi avec un registre des empreintes
+ * (\r{stegx_choices_s.registry}).
+ * @param infos Structure représentant les informations concernant l'extraction.
+ * @param id Identité trouvée (chaînes valides jusqu'à
+ * \r{stegx_registry_close}).
+ * @return 0 si les données extraites sont un jeton du registre, 1 sinon.
+ * @author StegX Team
+ */
+int stegx_identity(const info_s * infos, stegx_identity_s * id);
+
+/** 
+ * @brief Compare un fichier suspect avec son original.
+ * @details Les deux fichiers sont projetés en mémoire et alignés : les zones
+ * modifiées sur place, insérées ou supprimées sont relevées. La signature
+ * StegX est lue si elle est présente ; si elle a été retirée, l'algorithme et
+ * la taille des données sont déduits des différences.
+ * @error \r{ERR_DIFF} si les deux fichiers ne sont pas du même format.
+ * @param orig_path Chemin de l'original (fichier hôte avant l'insertion).
+ * @param suspect_path Chemin du fichier suspect.
+ * @return Comparaison à fermer avec \r{stegx_diff_close}, sinon NULL et met à
+ * jour \r{stegx_errno}.
+ * @author StegX Team
+ */
+stegx_diff_s *stegx_diff(const char *orig_path, const char *suspect_path);
+
+/** 
+ * @brief Renvoie le résultat d'une comparaison.
+ * @param d Comparaison faite par \r{stegx_diff}.
+ * @return Résultat (valide jusqu'à \r{stegx_diff_close}).
+ * @author StegX Team
+ */
+const stegx_diff_info_s *stegx_diff_info(const stegx_diff_s * d);
+
+/** 
+ * @brief Extrait les données cachées du fichier suspect.
+ * @details Sans signature, elle est reconstituée à partir des différences
+ * avant l'extraction, et le mot de passe est requis.
+ * @error \r{ERR_DETECT_ALGOS} si aucun algorithme n'a été reconnu,
+ * \r{ERR_NEED_PASSWD} si le mot de passe est requis.
+ * @param d Comparaison faite par \r{stegx_diff}.
+ * @param passwd Mot de passe (NULL si la signature contient celui choisi par
+ * StegX).
+ * @param res Fichier ouvert en écriture recevant les données (fermé dans tous
+ * les cas).
+ * @return 0 si l'extraction s'est bien passée, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_diff_extract(stegx_diff_s * d, const char *passwd, FILE * res);
+
+/** 
+ * @brief Identifie l'utilisateur du fichier suspect dans le registre des
+ * empreintes.
+ * @details Sans mot de passe, toutes les clés des mots de passe ASCII d'au
+ * plus 64 caractères sont essayées (une extraction par clé) : les données qui
+ * forment un jeton du registre donnent l'utilisateur.
+ * @error \r{ERR_REGISTRY} si aucun jeton du registre n'a été trouvé.
+ * @param d Comparaison faite par \r{stegx_diff}.
+ * @param passwd Mot de passe (NULL si inconnu).
+ * @param r Registre des empreintes.
+ * @param id Identité trouvée (chaînes valides jusqu'à
+ * \r{stegx_registry_close}).
+ * @param key Si non NULL, reçoit la clé du mot de passe (\r{stegx_trial_key}).
+ * @return 0 si l'utilisateur a été identifié, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_diff_identify(stegx_diff_s * d, const char *passwd, const stegx_registry_s * r,
+                        stegx_identity_s * id, unsigned int *key);
+
+/** 
+ * @brief Ferme une comparaison.
+ * @param d Comparaison à fermer (NULL accepté).
+ * @author StegX Team
+ */
+void stegx_diff_close(stegx_diff_s * d);
+
+/** 
+ * @brief Cache des données dans un flux FLV au fil de son arrivée.
+ * @details Variante de l'algorithme EOC pour les flux en direct, dont le
+ * nombre de tags vidéo n'est pas connu d'avance : chaque tag vidéo reçoit
+ * "per_tag" octets d'une trame contenant les données, répétée jusqu'à la fin
+ * du flux. Chaque tag est écrit dès qu'il est lu, seul son header est gardé
+ * en mémoire. Aucune signature n'est écrite : les données se retrouvent avec
+ * \r{stegx_stream_extract}, à partir de n'importe quel tag du flux.
+ * @error \r{ERR_LENGTH_HIDDEN} si les données sont vides ou dépassent 16 Mio.
+ * @error \r{ERR_HOST} si le flux lu n'est pas un FLV.
+ * @error \r{ERR_INSERT} sur une erreur de lecture ou d'écriture.
+ * @param in Flux FLV lu (un tube ou un fichier).
+ * @param out Flux FLV écrit (non fermé).
+ * @param data Données à cacher.
+ * @param len Taille des données.
+ * @param passwd Mot de passe (NULL pour ne pas protéger les données).
+ * @param per_tag Nombre d'octets de la trame par tag vidéo (de 1 à 255).
+ * @return 0 si tout le flux a été traité, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_stream_insert(FILE * in, FILE * out, const void *data, uint32_t len, const char *passwd,
+                        unsigned int per_tag);
+
+/** 
+ * @brief Extrait les données cachées dans un flux FLV par
+ * \r{stegx_stream_insert}.
+ * @details Le flux est lu au fil de son arrivée et la lecture s'arrête dès
+ * qu'une trame complète et valide a été trouvée.
+ * @error \r{ERR_HOST} si le flux lu n'est pas un FLV.
+ * @error \r{ERR_EXTRACT} si aucune trame valide n'a été trouvée (ou si les
+ * données ne peuvent pas être écrites).
+ * @param in Flux FLV lu.
+ * @param passwd Mot de passe de l'insertion (NULL si aucun).
+ * @param res Fichier ouvert en écriture recevant les données (non fermé).
+ * @return 0 si les données ont été extraites, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int stegx_stream_extract(FILE * in, const char *passwd, FILE * res);
+
 #endif                          /* ifndef STEGX_H */
@@ -27,6 +27,10 @@
 #ifndef STEGX_COMMON_H
 #define STEGX_COMMON_H
 
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
 /*
  * Types
  * =============================================================================
@@ -69,9 +73,80 @@ enum method {
 /** Type de la méthode de protection des données. */
 typedef enum method method_e;
 
+/** Options de la bibliothèque (à combiner avec un OU binaire). */
+enum flag {
+    STEGX_FLAG_INDEX = 1 << 0,  /*!< Utilise et crée l'index d'analyse de l'hôte ("<hôte>.stegxidx"). */
+    STEGX_FLAG_INDEX_HASH = 1 << 1,     /*!< Valide aussi l'index par une empreinte du contenu de l'hôte. */
+    STEGX_FLAG_CACHE = 1 << 2,  /*!< Lit l'hôte depuis le cache partagé (voir \r{stegx_cache_open}). */
+    STEGX_FLAG_PARALLEL = 1 << 3,       /*!< Répartit le traitement entre les coeurs quand c'est possible (analyse d'un MP3, insertion LSB sur MP3 et EOC sur FLV, fichiers ordinaires). */
+    STEGX_FLAG_CHECK_CRC = 1 << 4       /*!< Vérifie le CRC des chunks PNG pendant l'analyse de l'hôte : un hôte corrompu est refusé. */
+};
+
+/** Type d'une option de la bibliothèque. */
+typedef enum flag flag_e;
+
+/** Étapes d'un traitement signalées au suivi de progression. */
+enum stage {
+    STEGX_STAGE_ANALYSE,        /*!< Analyse du fichier hôte (\r{stegx_suggest_algo} et \r{stegx_detect_algo}). */
+    STEGX_STAGE_INSERT,         /*!< Insertion des données (\r{stegx_insert}). */
+    STEGX_STAGE_EXTRACT         /*!< Extraction des données (\r{stegx_extract}). */
+};
+
+/** Type d'une étape d'un traitement. */
+typedef enum stage stage_e;
+
+/** Nature d'une zone de différence entre un fichier suspect et son original
+ * (voir \r{stegx_diff}). */
+enum diff_kind {
+    STEGX_DIFF_MODIFIED,        /*!< Octets de l'original modifiés sur place. */
+    STEGX_DIFF_INSERTED,        /*!< Octets ajoutés dans le fichier suspect. */
+    STEGX_DIFF_REMOVED          /*!< Octets de l'original absents du fichier suspect. */
+};
+
+/** Type de la nature d'une zone de différence. */
+typedef enum diff_kind diff_kind_e;
+
+/** Intervalle approximatif entre deux appels du suivi de progression (octets
+ * traités). */
+#define STEGX_PROGRESS_BLOCK (1 << 16)
+
+/**
+ * @brief Fonction de suivi de progression d'un traitement.
+ * @details Appelée au début de chaque étape, environ tous les
+ * \r{STEGX_PROGRESS_BLOCK} octets traités, puis à la fin de l'étape (la valeur
+ * de retour est alors ignorée). Elle est appelée dans le thread du traitement.
+ * @param data Argument choisi par l'appelant (\r{stegx_choices_s.progress_data}).
+ * @param stage Étape en cours.
+ * @param done Nombre d'octets déjà traités.
+ * @param total Nombre d'octets à traiter (estimation : fichier hôte, plus
+ * fichier à cacher lors de l'insertion).
+ * @return 0 pour continuer, autre chose pour annuler le traitement.
+ */
+typedef int (*stegx_progress_f) (void *data, stage_e stage, uint64_t done, uint64_t total);
+
 /** Type de la structure privée stockant les informations de la bibliothèque. */
 typedef struct info info_s;
 
+/** Type d'un fichier hôte ouvert et analysé une fois pour plusieurs
+ * traitements (voir \r{stegx_host_open}). */
+typedef struct stegx_host stegx_host_s;
+
+/** Type d'une recherche du mot de passe d'un fichier hôte parmi des candidats
+ * (voir \r{stegx_trial_open}). */
+typedef struct stegx_trial stegx_trial_s;
+
+/** Type d'un registre des empreintes projeté en mémoire (voir
+ * \r{stegx_registry_open}). */
+typedef struct stegx_registry stegx_registry_s;
+
+/** Taille maximale d'un jeton du registre des empreintes (octets) : seules les
+ * données cachées de cette taille au plus y sont recherchées. */
+#define STEGX_TOKEN_MAX 256
+
+/** Type d'une comparaison d'un fichier suspect avec son original (voir
+ * \r{stegx_diff}). */
+typedef struct stegx_diff stegx_diff_s;
+
 /*
  * Variables
  * =============================================================================
@@ -80,9 +155,10 @@ typedef struct info info_s;
 /**
  * Variable globale pointant sur un tableau de booléen de taille \r{STEGX_NB_ALGO}.
  * Si stegx_propos_algo[i] est égal à 1, alors on peut utiliser l'algorithme
- * correspondant à algo_e égal à i. Sinon, on ne peut pas.
+ * correspondant à algo_e égal à i. Sinon, on ne peut pas. Chaque thread a sa
+ * propre variable.
  */
-extern algo_e *stegx_propos_algos;
+extern _Thread_local algo_e *stegx_propos_algos;
 
 /*
  * Structures
@@ -95,6 +171,7 @@ extern algo_e *stegx_propos_algos;
 struct stegx_info_insert {
     char *hidden_path;          /*!< Chaîne de caractères representant le nom du fichier a cacher (requis). */
     algo_e algo;                /*!< Algorithme qui sera utilisé pour la dissimulation (requis uniquement si CLI). */
+    FILE *hidden_file;          /*!< Fichier à cacher déjà ouvert en lecture, "hidden_path" ne sert alors qu'au nom (optionnel, fermé par \r{stegx_clear}). */
 };
 
 /** Type des informations concernant uniquement l'insertion. */
@@ -113,9 +190,107 @@ struct stegx_choices {
     char *passwd;               /*!< Mot de passe choisi par l'utilisateur (optionnel). */
     mode_e mode;                /*!< Mode d'utilisation (requis). */
     stegx_info_insert_s *insert_info;   /*!< Structure stockant les informations de l'insertion (requis si insertion). */
+    unsigned int flags;         /*!< Options de la bibliothèque, combinaison de \r{flag_e} (optionnel). */
+    stegx_host_s *host;         /*!< Hôte déjà ouvert et analysé, remplace l'ouverture de "host_path" (optionnel). */
+    FILE *res_file;             /*!< Fichier résultat déjà ouvert en écriture, remplace "res_path" (optionnel, fermé par \r{stegx_clear}). En extraction, les données extraites y sont écrites à la place du fichier "res_path/<nom du fichier caché>". */
+    stegx_progress_f progress;  /*!< Suivi de progression et annulation du traitement (optionnel). */
+    void *progress_data;        /*!< Argument passé à "progress" (optionnel). */
+    struct timespec deadline;   /*!< Échéance absolue (horloge CLOCK_MONOTONIC) au-delà de laquelle le traitement est annulé (optionnel, ignorée si nulle). */
+    const stegx_registry_s *registry;   /*!< Registre des empreintes où chercher les données extraites, voir \r{stegx_identity} (optionnel). */
 };
 
 /** Type des informations du choix de l'utilisateur. */
 typedef struct stegx_choices stegx_choices_s;
 
+/**
+ * @brief Destinataire d'une insertion multiple.
+ * @details Cette structure est à remplir par les interfaces pour chaque copie
+ * du fichier hôte à produire avec \r{stegx_insert_multi}.
+ * @req Les pointeurs ne doivent pas êtres null pour les champs requis et
+ * doivent pointer sur des zones mémoires allouées.
+ */
+struct stegx_dest {
+    char *hidden_path;          /*!< Chemin du fichier à cacher pour ce destinataire (requis). */
+    char *res_path;             /*!< Chemin du fichier résultat pour ce destinataire (requis). */
+    char *passwd;               /*!< Mot de passe choisi pour ce destinataire (optionnel). */
+    int err;                    /*!< Code d'erreur de l'insertion pour ce destinataire (rempli par la bibliothèque). */
+};
+
+/** Type d'un destinataire d'une insertion multiple. */
+typedef struct stegx_dest stegx_dest_s;
+
+/**
+ * @brief Identité associée à un jeton du registre des empreintes.
+ */
+struct stegx_identity {
+    const char *user;           /*!< Identifiant de l'utilisateur. */
+    const char *host;           /*!< Identifiant de l'hôte distribué. */
+    int64_t issued;             /*!< Date de délivrance du jeton (secondes depuis le 1er janvier 1970). */
+};
+
+/** Type d'une identité du registre des empreintes. */
+typedef struct stegx_identity stegx_identity_s;
+
+/**
+ * @brief Jeton à écrire dans un registre des empreintes.
+ */
+struct stegx_token {
+    const void *token;          /*!< Jeton (données cachées pour l'utilisateur). */
+    uint32_t len;               /*!< Taille du jeton (au plus \r{STEGX_TOKEN_MAX}). */
+    stegx_identity_s id;        /*!< Identité associée au jeton. */
+};
+
+/** Type d'un jeton à écrire dans un registre des empreintes. */
+typedef struct stegx_token stegx_token_s;
+
+/**
+ * @brief Zone de différence entre un fichier suspect et son original.
+ */
+struct stegx_diff_region {
+    diff_kind_e kind;           /*!< Nature de la zone. */
+    uint64_t offset;            /*!< Début de la zone dans le fichier suspect. */
+    uint64_t orig_offset;       /*!< Début de la zone dans l'original. */
+    uint64_t length;            /*!< Taille de la zone (dans l'original pour \r{STEGX_DIFF_REMOVED}, dans le fichier suspect sinon). */
+};
+
+/** Type d'une zone de différence. */
+typedef struct stegx_diff_region stegx_diff_region_s;
+
+/**
+ * @brief Résultat de la comparaison d'un fichier suspect avec son original.
+ */
+struct stegx_diff_info {
+    uint64_t orig_size;         /*!< Taille de l'original. */
+    uint64_t suspect_size;      /*!< Taille du fichier suspect. */
+    uint64_t nb_modified;       /*!< Nombre d'octets modifiés sur place. */
+    uint64_t nb_lsb;            /*!< Nombre d'octets modifiés sur leurs 2 bits de poids faible seulement. */
+    uint64_t nb_inserted;       /*!< Nombre d'octets ajoutés. */
+    uint64_t nb_removed;        /*!< Nombre d'octets de l'original absents. */
+    const stegx_diff_region_s *regions; /*!< Zones de différence, dans l'ordre du fichier suspect. */
+    size_t nb_regions;          /*!< Nombre de zones de différence. */
+    algo_e algo;                /*!< Algorithme reconnu (\r{STEGX_NB_ALGO} si aucun). */
+    int signature;              /*!< 1 si la signature StegX est présente dans le fichier suspect, 0 si elle a été retirée. */
+    method_e method;            /*!< Méthode de protection (lue dans la signature, \r{STEGX_WITH_PASSWD} supposée sinon). */
+    uint32_t hidden_length;     /*!< Taille des données cachées : lue dans la signature, sinon déduite des différences (borne supérieure pour LSB). */
+};
+
+/** Type du résultat d'une comparaison. */
+typedef struct stegx_diff_info stegx_diff_info_s;
+
+/**
+ * @brief Résultat du sondage d'un fichier (\r{stegx_probe}).
+ */
+struct stegx_probe {
+    const char *format;         /*!< Format reconnu dans le premier bloc ("bmp", "png", "wav", "mp3", "avi", "flv"), NULL si aucun. */
+    int suspect;                /*!< 1 si le fichier peut contenir des données cachées (y compris quand le sondage ne permet pas de conclure). */
+    int confirmed;              /*!< 1 si la signature a été lue dans le dernier bloc ("algo", "method" et "hidden_length" en viennent). */
+    algo_e algo;                /*!< Algorithme de la signature, ou supposé d'après sa place si elle n'a pas été lue (\r{STEGX_NB_ALGO} si inconnu). */
+    method_e method;            /*!< Méthode de protection (si la signature a été lue). */
+    uint32_t hidden_length;     /*!< Taille des données cachées (si la signature a été lue). */
+    uint64_t sig_offset;        /*!< Adresse de la signature (0 si inconnue). */
+};
+
+/** Type du résultat d'un sondage. */
+typedef struct stegx_probe stegx_probe_s;
+
 #endif                          /* ifndef STEGX_COMMON_H */
@@ -49,15 +49,21 @@ enum err_code {
     ERR_LENGTH_HIDDEN,          /*!< Erreur taille du fichier à cacher trop élevée */
     ERR_NEED_PASSWD,            /*!< Erreur l'application a besoin d'un mot de passe pour extraire les données. */
     ERR_HIDDEN_FILE_EMPTY,      /*!< Erreur fichier caché/à cacher est vide. */
+    ERR_CACHE,                  /*!< Erreur pendant l'ouverture du cache partagé des hôtes. */
+    ERR_CANCELED,               /*!< Traitement annulé par le suivi de progression. */
+    ERR_DEADLINE,               /*!< Traitement annulé car son échéance est dépassée. */
+    ERR_NO_PASSWD,              /*!< Erreur les données cachées ne sont pas protégées par un mot de passe. */
+    ERR_REGISTRY,               /*!< Erreur registre des empreintes invalide ou inaccessible. */
+    ERR_DIFF,                   /*!< Erreur fichier suspect et original de formats différents. */
     ERR_OTHER                   /*!< Erreur quelconque. */
 };
 
 /**
  * Variable mise à la disposition des fonctions de la bibliothèque pour y
- * inscrire leur code d'erreur.
+ * inscrire leur code d'erreur. Chaque thread a sa propre variable.
  * @author Pierre Ayoub
  */
-extern enum err_code stegx_errno;
+extern _Thread_local enum err_code stegx_errno;
 
 /**
  * Affiche le message d'erreur sur la sortie d'erreur en fonction du code
@@ -67,4 +73,12 @@ extern enum err_code stegx_errno;
  */
 void err_print(const enum err_code err);
 
+/**
+ * Renvoie le message d'erreur correspondant au code d'erreur spécifié.
+ * @param err Code d'erreur.
+ * @return Chaîne constante décrivant l'erreur.
+ * @author StegX Team
+ */
+const char *stegx_strerror(enum err_code err);
+
 #endif                          /* ERRORS_H */
@@ -24,7 +24,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "common.h"
 #include "stegx_common.h"
@@ -33,6 +36,225 @@
 #include "../protection.h"
 #include "../endian.h"
 #include "../rand.h"
+#include "../parallel.h"
+
+/** Taille des blocs lus puis écrits d'un coup par l'insertion parallèle. */
+#define EOC_BLOCK_SIZE (64 * 1024)
+/** Nombre minimal de tags vidéo traités par un thread de l'insertion parallèle. */
+#define EOC_PAR_MIN_TAGS 1024
+/** Octet écrit avant les données cachées d'un tag (évite les distorsions). */
+#define EOC_PAD_BYTE 28
+
+/**
+ * @brief Disposition du résultat de l'insertion EOC.
+ */
+struct eoc_layout {
+    const flv_tag_s **video;    /*!< Tags vidéo de l'hôte, dans l'ordre du fichier. */
+    uint32_t nb_video_tag;      /*!< Nombre de tags vidéo. */
+    uint32_t data_per_vtag, reste;      /*!< Taille d'un bloc de données et octets en plus dans le dernier. */
+    uint32_t last;              /*!< Tag vidéo contenant le dernier bloc. */
+};
+
+/**
+ * @brief Prépare la disposition du résultat de l'insertion EOC.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @param l Disposition à remplir.
+ * @param last Tag vidéo contenant le dernier bloc de données.
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+static int eoc_layout_init(info_s * infos, struct eoc_layout *l, uint32_t last)
+{
+    const flv_tag_s *tags = flv_tags(infos);
+    uint32_t nb_video_tag = infos->host.file_info.flv.nb_video_tag;
+    *l = (struct eoc_layout) {.video = arena_alloc(&infos->arena, nb_video_tag * sizeof(*l->video)),
+        .nb_video_tag = nb_video_tag,.data_per_vtag = infos->hidden_length / nb_video_tag,
+        .reste = infos->hidden_length % nb_video_tag,.last = last
+    };
+    if (!tags)
+        return 1;
+    if (!l->video)
+        return perror("insert_eoc: Can't allocate memory for the layout"), 1;
+    for (uint32_t i = 0, k = 0; i < infos->host.flv_nb_tag; i++)
+        if (tags[i].type == VIDEO_TAG)
+            l->video[k++] = &tags[i];
+    return 0;
+}
+
+/**
+ * @brief Donne l'adresse d'un octet de l'hôte FLV dans le résultat.
+ * @details Chaque tag vidéo qui précède l'octet a grandi de son bloc de
+ * données plus un octet.
+ * @param offset Adresse de l'octet dans l'hôte.
+ * @param arg Disposition du résultat (\r{struct eoc_layout}).
+ * @return Adresse de l'octet dans le résultat.
+ * @author StegX Team
+ */
+static uint64_t eoc_relocate(uint64_t offset, void *arg)
+{
+    const struct eoc_layout *l = arg;
+    uint32_t lo = 0, hi = l->nb_video_tag;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (l->video[mid]->offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return offset + (uint64_t) lo * (l->data_per_vtag + 1) + (l->last < lo ? l->reste : 0);
+}
+
+/**
+ * @brief Partie de l'hôte FLV traitée par un thread de l'insertion parallèle.
+ */
+struct eoc_part {
+    const struct eoc_layout *l; /*!< Disposition du résultat. */
+    const uint8_t *data;        /*!< Données à cacher, en clair. */
+    const uint8_t *key;         /*!< Clé appliquée aux données de chaque tag. */
+    int in, out;                /*!< Descripteurs de l'hôte et du résultat. */
+    uint32_t k0, k1;            /*!< Tags vidéo de la partie, [k0, k1[. */
+    long int begin, end;        /*!< Partie de l'hôte, [begin, end[. */
+    long int shift;             /*!< Décalage de la partie dans le résultat (octets cachés avant elle). */
+    uint8_t *buf;               /*!< Tampon de \r{EOC_BLOCK_SIZE} octets. */
+    struct parallel *par;       /*!< Suivi partagé par les parties. */
+    int err;                    /*!< 1 sur une erreur ou une annulation. */
+};
+
+/**
+ * @brief Insère les données d'une partie de l'hôte FLV (thread de
+ * l'insertion parallèle).
+ * @details Chaque tag vidéo k grandit du bloc de données k plus un octet :
+ * sa taille et son "previous tag size" sont mis à jour, le bloc chiffré est
+ * écrit à la fin de ses données. Le reste est recopié tel quel.
+ * @param arg Partie à traiter (\r{struct eoc_part}).
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *eoc_part_insert(void *arg)
+{
+    struct eoc_part *pt = arg;
+    long int pos = pt->begin, shift = pt->shift;
+    int r;
+    for (uint32_t k = pt->k0; k < pt->k1; k++) {
+        const flv_tag_s *tag = pt->l->video[k];
+        uint32_t limit = k == pt->l->last ? pt->l->data_per_vtag + pt->l->reste : pt->l->data_per_vtag;
+        uint32_t data_size = tag->data_size + limit + 1, prev_tag_size = stegx_htobe32(tag->prev_tag_size + limit + 1);
+        long int data_end = tag->offset + FLV_TAG_HEADER_SIZE + tag->data_size;
+        uint8_t size[3] = { data_size >> 16, data_size >> 8, data_size };
+
+        /* Tags précédents et tag vidéo, avec sa nouvelle taille. */
+        if ((r = parallel_copy(pt->par, pt->in, pt->out, pt->buf, EOC_BLOCK_SIZE, pos, data_end, shift))
+            || pwrite(pt->out, size, sizeof(size), tag->offset + 1 + shift) != sizeof(size))
+            return pt->err = 1, r > 0 ? NULL : (perror("insert_eoc: Can't copy FLV tags"), NULL);
+        /* Octet ajouté puis données cachées, par blocs. */
+        const uint8_t pad = EOC_PAD_BYTE, *d = pt->data + (uint64_t) k * pt->l->data_per_vtag;
+        if (pwrite(pt->out, &pad, sizeof(pad), data_end + shift++) != sizeof(pad))
+            return perror("insert_eoc: Can't write hidden data"), pt->err = 1, NULL;
+        for (uint32_t i = 0, n; i < limit; i += n, shift += n) {
+            n = limit - i < EOC_BLOCK_SIZE ? limit - i : EOC_BLOCK_SIZE;
+            for (uint32_t j = 0; j < n; j++)
+                pt->buf[j] = d[i + j] ^ pt->key[i + j];
+            if (pwrite(pt->out, pt->buf, n, data_end + shift) != (ssize_t) n)
+                return perror("insert_eoc: Can't write hidden data"), pt->err = 1, NULL;
+            if (parallel_step(pt->par, n))
+                return pt->err = 1, NULL;
+        }
+        if (pwrite(pt->out, &prev_tag_size, sizeof(prev_tag_size), data_end + shift) != sizeof(prev_tag_size))
+            return perror("insert_eoc: Can't write previous tag size"), pt->err = 1, NULL;
+        pos = data_end + sizeof(prev_tag_size);
+    }
+    /* Tags suivants jusqu'à la partie suivante (fin du fichier pour la dernière). */
+    if ((r = parallel_copy(pt->par, pt->in, pt->out, pt->buf, EOC_BLOCK_SIZE, pos, pt->end, shift)))
+        return pt->err = 1, r > 0 ? NULL : (perror("insert_eoc: Can't copy FLV tags"), NULL);
+    return NULL;
+}
+
+/**
+ * @brief Insertion EOC répartie entre plusieurs threads.
+ * @details À partir de 256 tags vidéo, les blocs de données ne sont pas
+ * mélangés : le bloc k est dans le tag vidéo k. La place de chaque tag dans
+ * le résultat est donc connue d'avance grâce à l'index des tags. Le résultat
+ * est alloué à sa taille puis chaque thread y écrit sa partie par "pwrite".
+ * La clé étant la même pour chaque tag, elle n'est calculée qu'une fois.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @return 0 si l'insertion est faite, 1 sur une erreur, -1 si elle n'est pas
+ * possible (un seul coeur, hôte trop court ou fichiers sans descripteur) et
+ * doit être faite en série.
+ * @author StegX Team
+ */
+static int eoc_insert_parallel(info_s * infos)
+{
+    flv_s *hs = &(infos->host.file_info.flv);
+    long int nb = sysconf(_SC_NPROCESSORS_ONLN);
+    int in = fileno(infos->host.host), out = fileno(infos->res);
+    struct stat st_in, st;
+    if (hs->nb_video_tag / EOC_PAR_MIN_TAGS < nb)
+        nb = hs->nb_video_tag / EOC_PAR_MIN_TAGS;
+    if (nb < 2 || in == -1 || out == -1 || fstat(in, &st_in) || !S_ISREG(st_in.st_mode)
+        || fstat(out, &st) || !S_ISREG(st.st_mode))
+        return -1;
+    struct eoc_layout l;
+    if (eoc_layout_init(infos, &l, hs->nb_video_tag - 1))
+        return 1;
+
+    struct eoc_part *pt = arena_alloc(&infos->arena, nb * sizeof(*pt));
+    uint8_t *data = arena_alloc(&infos->arena, infos->hidden_length);
+    uint8_t *key = arena_alloc(&infos->arena, l.data_per_vtag + l.reste);
+    uint8_t *buf = arena_alloc(&infos->arena, nb * EOC_BLOCK_SIZE);
+    if (!pt || !data || !key || !buf)
+        return perror("insert_eoc: Can't allocate memory for the threads"), 1;
+    if (fseek(infos->hidden, 0, SEEK_SET) || fread(data, 1, infos->hidden_length, infos->hidden) != infos->hidden_length)
+        return perror("insert_eoc: Can't read the hidden file"), 1;
+    stegx_srand(create_seed(infos->passwd));
+    for (uint32_t i = 0; i < l.data_per_vtag + l.reste; i++)
+        key[i] = stegx_rand() % UINT8_MAX;
+    /* data_size ne peut pas faire plus de 3 octets */
+    for (uint32_t k = 0; k < l.nb_video_tag; k++)
+        if (l.video[k]->data_size + l.data_per_vtag + (k == l.last ? l.reste : 0) + 1 > 0xFFFFFF)
+            return perror("Can't write data, hidden file to big."), 1;
+    long int size = eoc_relocate(st_in.st_size, &l);
+    if (fflush(infos->res) || ftruncate(out, size))
+        return perror("insert_eoc: Can't allocate the res file"), 1;
+
+    /* Découpage en parties de même nombre de tags vidéo, chacune à sa place
+     * dans le résultat. */
+    struct parallel par;
+    for (long int t = 0; t < nb; t++) {
+        uint32_t k0 = (uint64_t) l.nb_video_tag * t / nb, k1 = (uint64_t) l.nb_video_tag * (t + 1) / nb;
+        long int begin = t ? l.video[k0]->offset : 0;
+        pt[t] = (struct eoc_part) {.l = &l,.data = data,.key = key,.in = in,.out = out,.k0 = k0,.k1 = k1,
+            .begin = begin,.end = t < nb - 1 ? l.video[k1]->offset : st_in.st_size,
+            .shift = eoc_relocate(begin, &l) - begin,.buf = buf + t * EOC_BLOCK_SIZE,.par = &par
+        };
+    }
+    if (parallel_run(eoc_part_insert, pt, nb, sizeof(*pt), &par, &infos->progress, 0))
+        return 1;
+    int err = 0;
+    for (long int t = 0; t < nb; t++)
+        err |= pt[t].err;
+    if (err || progress_at(&infos->progress, st_in.st_size + infos->hidden_length))
+        return 1;
+    /* Mise à jour des adresses de "onMetaData", une fois les tags recopiés. */
+    for (uint32_t i = 0; i < infos->host.flv_nb_tag; i++) {
+        const flv_tag_s *tag = &infos->host.flv_tag[i];
+        long int adr = tag->offset + FLV_TAG_HEADER_SIZE;
+        if (tag->type != METATAG && tag->type != SCRIPT_DATA_TAG)
+            continue;
+        uint8_t *meta = arena_alloc(&infos->arena, tag->data_size);
+        if (!meta || pread(in, meta, tag->data_size, adr) != (ssize_t) tag->data_size)
+            return perror("insert_eoc: Can't read script data"), 1;
+        if (flv_meta_relocate(meta, tag->data_size, eoc_relocate, &l))
+            continue;
+        if (pwrite(out, meta, tag->data_size, eoc_relocate(adr, &l)) != (ssize_t) tag->data_size)
+            return perror("insert_eoc: Can't write script data"), 1;
+    }
+    /* La signature est écrite par le flux, après la dernière partie. */
+    if (fseek(infos->res, size, SEEK_SET))
+        return perror("insert_eoc: Can't jump to the end of the res file"), 1;
+    return 0;
+}
 
 int insert_eoc(info_s * infos)
 {
@@ -57,24 +279,40 @@ int insert_eoc(info_s * infos)
         return perror("Can't do insertion EOC"), 1;
     }
 
+    /* Insertion parallèle si elle est demandée et possible. */
+    int par = infos->flags & STEGX_FLAG_PARALLEL ? eoc_insert_parallel(infos) : -1;
+    if (par != -1)
+        return par || write_signature(infos);
+
     /* Initialise les tableaux pour le cas avec l'algorithme de protection des données et le cas sans */
     if (infos->host.file_info.flv.nb_video_tag < 256) {
-        data = malloc(infos->host.file_info.flv.nb_video_tag * sizeof(uint8_t));
+        data = arena_alloc(&infos->arena, infos->host.file_info.flv.nb_video_tag * sizeof(uint8_t));
         if (!data)
             return perror("Can't allocate memory Insertion"), 1;
         for (uint32_t i = 0; i < infos->host.file_info.flv.nb_video_tag; i++) {
             data[i] = i;
         }
         protect_data(data, infos->host.file_info.flv.nb_video_tag, infos->passwd,
-                     STEGX_MODE_INSERT);
+                     STEGX_MODE_INSERT, &infos->arena, &infos->progress);
         datab = 0;
     } else {
-        data2 = malloc(infos->host.file_info.flv.nb_video_tag * sizeof(uint32_t));
+        data2 = arena_alloc(&infos->arena, infos->host.file_info.flv.nb_video_tag * sizeof(uint32_t));
+        if (!data2)
+            return perror("Can't allocate memory Insertion"), 1;
         for (uint32_t i = 0; i < infos->host.file_info.flv.nb_video_tag; i++) {
             data2[i] = i;
         }
         datab = 1;
     }
+    /* Disposition du résultat, pour mettre à jour les adresses de
+     * "onMetaData" : le dernier bloc est dans le tag vidéo "last". */
+    struct eoc_layout l;
+    uint32_t last = infos->host.file_info.flv.nb_video_tag - 1;
+    for (uint32_t i = 0; !datab && i < infos->host.file_info.flv.nb_video_tag; i++)
+        if (data[i] == infos->host.file_info.flv.nb_video_tag - 1)
+            last = i;
+    if (eoc_layout_init(infos, &l, last))
+        return 1;
 
     //recopie header
     for (int j = 0; j < 13; j++) {
@@ -93,10 +331,25 @@ int insert_eoc(info_s * infos)
             fwrite(&data_size, sizeof(uint32_t), 1, infos->res);
             //passage en 24 bits      
             data_size = stegx_be32toh(data_size) >> 8;
-            //recopie data + 6 octets
-            for (uint32_t j = 0; j < data_size + 6; j++) {
-                fread(&byte_cpy, sizeof(uint8_t), 1, infos->host.host);
-                fwrite(&byte_cpy, sizeof(uint8_t), 1, infos->res);
+            if (tag_type == METATAG || tag_type == SCRIPT_DATA_TAG) {
+                /* Tag de script : recopie data + 6 octets, avec les adresses
+                 * de "onMetaData" mises à jour. */
+                uint8_t *meta = arena_alloc(&infos->arena, data_size + 6);
+                if (!meta || fread(meta, sizeof(uint8_t), data_size + 6, infos->host.host) != data_size + 6)
+                    return perror("Can't read script data"), 1;
+                flv_meta_relocate(meta + 6, data_size, eoc_relocate, &l);
+                if (fwrite(meta, sizeof(uint8_t), data_size + 6, infos->res) != data_size + 6)
+                    return perror("Can't write script data"), 1;
+                if (progress_step(&infos->progress, data_size + 6))
+                    return 1;
+            } else {
+                //recopie data + 6 octets
+                for (uint32_t j = 0; j < data_size + 6; j++) {
+                    if (progress_step(&infos->progress, 1))
+                        return 1;
+                    fread(&byte_cpy, sizeof(uint8_t), 1, infos->host.host);
+                    fwrite(&byte_cpy, sizeof(uint8_t), 1, infos->res);
+                }
             }
             //recopie prev tag size
             fread(&prev_tag_size, sizeof(uint32_t), 1, infos->host.host);
@@ -144,6 +397,8 @@ int insert_eoc(info_s * infos)
 
             //copie des data d'origine + 6 octets
             for (uint32_t j = 0; j < data_size_host + 6; j++) {
+                if (progress_step(&infos->progress, 1))
+                    return 1;
                 fread(&byte_cpy, sizeof(uint8_t), 1, infos->host.host);
                 fwrite(&byte_cpy, sizeof(uint8_t), 1, infos->res);
             }
@@ -162,6 +417,8 @@ int insert_eoc(info_s * infos)
 			fwrite(&byte_cpy,sizeof(uint8_t),1,infos->res);
 
 			for(uint32_t i=0;i<limit;i++){
+				if (progress_step(&infos->progress, 1))
+					return 1;
 				fread(&byte_cpy,sizeof(uint8_t),1,infos->hidden);
 				byte_cpy ^= stegx_rand() % UINT8_MAX;
 				fwrite(&byte_cpy,sizeof(uint8_t),1,infos->res);
@@ -187,13 +444,12 @@ int insert_eoc(info_s * infos)
     } while (cpt_video_tag < infos->host.file_info.flv.nb_video_tag);
 
     /* Ecrit la fin du fichier et la signature */
-    while (fread(&byte_cpy, sizeof(uint8_t), 1, infos->host.host) == 1)
+    while (!progress_step(&infos->progress, 1)
+           && fread(&byte_cpy, sizeof(uint8_t), 1, infos->host.host) == 1)
         fwrite(&byte_cpy, sizeof(uint8_t), 1, infos->res);
+    if (progress_canceled(&infos->progress))
+        return 1;
     write_signature(infos);
-    if (datab)
-        free(data2);
-    else
-        free(data);
     return 0;
 
 }
@@ -205,111 +461,57 @@ int extract_eoc(info_s * infos)
     assert(infos->algo == STEGX_ALGO_EOC);
 
     uint8_t byte_cpy;
-    uint32_t data_size;
-    uint8_t tag_type;
-    uint32_t cpt_video_tag = -1;
-    uint32_t nb_block = 0;
-    uint32_t data_jump;
+    uint32_t nb_video_tag = infos->host.file_info.flv.nb_video_tag;
+    uint32_t data_per_vtag = infos->hidden_length / nb_video_tag;
+    uint32_t reste = infos->hidden_length % nb_video_tag;
     uint32_t write_data;
-    uint32_t data_per_vtag = infos->hidden_length / infos->host.file_info.flv.nb_video_tag;
-    uint32_t reste = infos->hidden_length % infos->host.file_info.flv.nb_video_tag;
-    uint8_t *data;
-    uint32_t *data2;
-    int datab;
-    uint32_t cursor = 0;
+    const flv_tag_s *tags = flv_tags(infos);
+    /* Tags vidéo, dans l'ordre du fichier. */
+    const flv_tag_s **video = arena_alloc(&infos->arena, nb_video_tag * sizeof(*video));
+    /* Numéro du tag vidéo contenant chaque bloc de données. */
+    uint32_t *cursor = arena_alloc(&infos->arena, nb_video_tag * sizeof(*cursor));
 
-    if (fseek(infos->host.host, 0, SEEK_SET) == -1) {
-        return perror("Can't do extraction EOC"), 1;
-	}
-    /* Initialisation de protect data */
-    if (infos->host.file_info.flv.nb_video_tag < 256) {
-        data = malloc(infos->host.file_info.flv.nb_video_tag * sizeof(uint8_t));
-		if (!data)
-			return perror("Can't allocate memory Insertion"), 1;
-		
-		for(uint32_t i=0;i<infos->host.file_info.flv.nb_video_tag;i++){
-			data[i]=i;
-   		}
- 	protect_data(data,infos->host.file_info.flv.nb_video_tag,infos->passwd, STEGX_MODE_INSERT);
- 	datab=0;
- 	} 
- 	else {
- 			data2 = malloc(infos->host.file_info.flv.nb_video_tag * sizeof(uint32_t));
- 			for(uint32_t i=0;i<infos->host.file_info.flv.nb_video_tag;i++){
-				data2[i]=i;
-			}
-			datab=1;
- 		}
- 	//saute de header
- 	fseek(infos->host.host, 13, SEEK_SET);
-	do {
-		
-		
-		if(datab){
-			while(data2[cursor] != nb_block)
-				cursor++;
-						
-			/* Recherche du tag vidéo numéro cursor */
-			while(cursor != cpt_video_tag){
-				
-				fread(&tag_type, sizeof(uint8_t), 1, infos->host.host);
-				if(tag_type == 9){
-					cpt_video_tag++;
-				}
-				fread(&data_size, sizeof(uint32_t), 1, infos->host.host);
-				//passage en 24 bits      
-				data_size = stegx_be32toh(data_size) >> 8;
-				/* Si c'est pas le tag recherché, on jump 
-				 * les 6 octets après data_size + les data + le previous tag size (4 octets) */ 
-				if(cursor != cpt_video_tag)
-					fseek(infos->host.host, data_size + 10, SEEK_CUR);
-			}
-		}
-		else {
-				//on revient à la fin du header
-				fseek(infos->host.host, 13, SEEK_SET);
-				cursor = 0;
-				while(data[cursor] != nb_block)
-				cursor++;
-			cpt_video_tag = -1;
-			/* Recherche du tag vidéo numéro cursor */
-			while(cursor != cpt_video_tag){
-				fread(&tag_type, sizeof(uint8_t), 1, infos->host.host);
-				if(tag_type == 9)
-					cpt_video_tag++;
-				fread(&data_size, sizeof(uint32_t), 1, infos->host.host);
-				//passage en 24 bits      
-				data_size = stegx_be32toh(data_size) >> 8;
-				/* Si c'est pas le tag recherché, on jump 
-				 * les 6 octets après data_size + les data + le previous tag size (4 octets) */ 
-				if(cursor != cpt_video_tag)
-					fseek(infos->host.host, data_size + 10, SEEK_CUR);
-			}
-		}
-		/* Calcul le nombre d'octets à sauter pour arriver avant les données à récupérer */
-		if (nb_block == infos->host.file_info.flv.nb_video_tag - 1){
-			data_jump = data_size - reste - data_per_vtag + 6; //cas particulier dernier tag
-			write_data = reste + data_per_vtag;
-		}
-		else {
-			data_jump = data_size - data_per_vtag + 6;
-			write_data = data_per_vtag;
-		}
-		
-		fseek(infos->host.host, data_jump, SEEK_CUR);
-		stegx_srand(create_seed(infos->passwd));
-		/* Recopie des données dans le fichhier resultat */
-		for(uint32_t i = 0; i < write_data; i++){
-			fread(&byte_cpy, sizeof(uint8_t), 1, infos->host.host);
-			byte_cpy ^= stegx_rand() % UINT8_MAX;
-			fwrite(&byte_cpy,sizeof(uint8_t),1,infos->res);
-		}
-		
-		nb_block++;
-		fseek(infos->host.host,4,SEEK_CUR);
-	}while(nb_block < infos->host.file_info.flv.nb_video_tag);
-	if (datab)
-		free(data2);
-	else free(data);
-	return 0;
+    if (!tags)
+        return 1;
+    if (!video || !cursor)
+        return perror("Can't allocate memory Extraction"), 1;
+    for (uint32_t i = 0, k = 0; i < infos->host.flv_nb_tag; i++)
+        if (tags[i].type == VIDEO_TAG)
+            video[k++] = &tags[i];
+
+    /* Initialisation de protect data : le bloc data[i] est dans le tag
+     * vidéo i (sans mélange à partir de 256 tags vidéo). */
+    if (nb_video_tag < 256) {
+        uint8_t *data = arena_alloc(&infos->arena, nb_video_tag * sizeof(uint8_t));
+        if (!data)
+            return perror("Can't allocate memory Extraction"), 1;
+        for (uint32_t i = 0; i < nb_video_tag; i++)
+            data[i] = i;
+        protect_data(data, nb_video_tag, infos->passwd, STEGX_MODE_INSERT, &infos->arena, &infos->progress);
+        for (uint32_t i = 0; i < nb_video_tag; i++)
+            cursor[data[i]] = i;
+    } else {
+        for (uint32_t i = 0; i < nb_video_tag; i++)
+            cursor[i] = i;
+    }
+
+    for (uint32_t nb_block = 0; nb_block < nb_video_tag; nb_block++) {
+        const flv_tag_s *tag = video[cursor[nb_block]];
+        write_data = (nb_block == nb_video_tag - 1) ? reste + data_per_vtag : data_per_vtag;   //cas particulier dernier tag
+        if (write_data > tag->data_size)
+            return fprintf(stderr, "EOC: Video tag too small for the hidden data\n"), 1;
+        /* Les données cachées sont à la fin des données du tag. */
+        if (fseek(infos->host.host, tag->offset + FLV_TAG_HEADER_SIZE + tag->data_size - write_data, SEEK_SET))
+            return perror("Can't do extraction EOC"), 1;
+        stegx_srand(create_seed(infos->passwd));
+        /* Recopie des données dans le fichier resultat */
+        for (uint32_t i = 0; i < write_data; i++) {
+            if (progress_step(&infos->progress, 1))
+                return 1;
+            fread(&byte_cpy, sizeof(uint8_t), 1, infos->host.host);
+            byte_cpy ^= stegx_rand() % UINT8_MAX;
+            fwrite(&byte_cpy, sizeof(uint8_t), 1, infos->res);
+        }
+    }
+    return 0;
 }
@@ -38,6 +38,17 @@
  */
 int insert_junk_chunk(info_s * infos);
 
+/** 
+ * @brief Écrit le chunk JUNK, la signature puis les données cachées à la
+ * suite du fichier résultat.
+ * @details Partie de l'algorithme Junk Chunk qui suit la recopie du fichier hôte.
+ * @req La copie de l'hôte doit déjà avoir été écrite dans \r{info_s.res}.
+ * @param infos Structure représentant les informations concernant la dissimulation.
+ * @return 0 si les données ont bien été écrites ; sinon 1 en cas d'erreur.
+ * @author StegX Team
+ */
+int junk_chunk_write_hidden(info_s * infos);
+
 /** 
  * @brief Va extraire les donnees cachees en utilisant l'algorithme Junk Chunk. 
  * @param infos Structure représentant les informations concernant l'extraction.
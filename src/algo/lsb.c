@@ -25,7 +25,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "common.h"
 #include "stegx_common.h"
@@ -33,18 +36,273 @@
 #include "protection.h"
 #include "insert.h"
 #include "rand.h"
+#include "parallel.h"
 
 /** MP3 : masque à appliquer au header où cacher un bit. */
 static const uint32_t mp3_mask[MP3_HDR_NB_BITS_MODIF] = {0xFFFFFFFB, 0xFFFFFFF7, 0xFFFFFEFF};
 /** MP3 : offset à appliquer au bit à caché / déjà caché en fonction du masque. */
 static const uint32_t mp3_shift[MP3_HDR_NB_BITS_MODIF] = {2, 3, 8};
+/** MP3 : taille des blocs de frames entières lus puis écrits d'un coup. */
+#define MP3_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @brief Obtient l'index des frames de l'hôte MP3.
+ * @details L'index est celui construit par l'analyse. S'il n'a pas été gardé
+ * (analyse reprise du cache ou de l'index d'analyse), il est construit une
+ * fois pour le traitement.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @return Distance de chaque frame à la suivante, ou NULL sur une erreur.
+ * @author StegX Team
+ */
+static const uint32_t *mp3_fr_index(info_s * infos)
+{
+    host_info_s *hi = &infos->host;
+    if (hi->mp3_fr_size)
+        return hi->mp3_fr_size;
+    long int nb = 0, end;
+    uint32_t next;
+    int threads = infos->flags & STEGX_FLAG_PARALLEL ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    if (!(hi->mp3_fr_size = mp3_mpeg_fr_index(hi->host, hi->file_info.mp3.fr_frst_adr, &nb, &end, &next, threads, NULL)))
+        return NULL;
+    if (nb != hi->file_info.mp3.fr_nb)
+        return fprintf(stderr, "LSB MP3: Frame index doesn't match the host analysis\n"), NULL;
+    return hi->mp3_fr_size;
+}
+
+/**
+ * @brief Délimite le prochain bloc de l'hôte MP3 lu puis écrit d'un coup.
+ * @details Le bloc fait au plus \r{MP3_BLOCK_SIZE} octets et s'arrête avant
+ * un header qui le dépasserait : chaque header est modifié en entier dans le
+ * tampon, quelle que soit la distance entre les frames.
+ * @param fr Index des frames.
+ * @param k Première frame dont le header n'est pas encore traité.
+ * @param k1 Fin des frames à traiter.
+ * @param adr Adresse du header de la frame k.
+ * @param pos Début du bloc.
+ * @param end Fin de la zone à recopier.
+ * @return Taille du bloc.
+ * @author StegX Team
+ */
+static size_t mp3_block(const uint32_t * fr, long int k, long int k1, long int adr, long int pos, long int end)
+{
+    long int lim = end - pos < MP3_BLOCK_SIZE ? end : pos + MP3_BLOCK_SIZE;
+    for (; k < k1 && adr + (long int)sizeof(uint32_t) <= lim; adr += fr[k++]);
+    return (k < k1 && adr < lim ? adr : lim) - pos;
+}
+
+/** MP3 : nombre minimal de frames traitées par un thread de l'insertion parallèle. */
+#define MP3_PAR_MIN_FRAMES 4096
+
+/**
+ * @brief Partie de l'hôte MP3 traitée par un thread de l'insertion parallèle.
+ */
+struct mp3_part {
+    const uint32_t *fr;         /*!< Index des frames. */
+    const uint8_t *data;        /*!< Données à cacher, en clair. */
+    uint32_t data_len;          /*!< Taille des données à cacher. */
+    const char *passwd;         /*!< Mot de passe (graine de la clé). */
+    int in, out;                /*!< Descripteurs de l'hôte et du résultat. */
+    long int k0, k1;            /*!< Frames de la partie, [k0, k1[. */
+    long int begin, adr, end;   /*!< Début de la partie, adresse de la frame k0 et fin de la partie. */
+    uint8_t *buf;               /*!< Tampon de \r{MP3_BLOCK_SIZE} octets. */
+    struct parallel *par;       /*!< Suivi partagé par les parties. */
+    int err;                    /*!< 1 sur une erreur ou une annulation. */
+};
+
+/**
+ * @brief Insère les bits d'une partie de l'hôte MP3 (thread de l'insertion
+ * parallèle).
+ * @details Les bits de la frame k sont les bits 3k à 3k + 2 des données : la
+ * clé est avancée jusqu'au premier octet de la partie, puis la partie est
+ * lue par blocs et écrite à la même adresse.
+ * @param arg Partie à traiter (\r{struct mp3_part}).
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *mp3_part_insert(void *arg)
+{
+    struct mp3_part *pt = arg;
+    uint64_t nb_bits = (uint64_t) pt->data_len * 8, bit = (uint64_t) pt->k0 * MP3_HDR_NB_BITS_MODIF;
+    uint32_t cur = bit / 8;     // Octet en clair dont "b" est la version chiffrée.
+    uint8_t b = 0;
+    stegx_srand_libc(create_seed(pt->passwd));
+    stegx_rand_libc_skip(cur);
+    if (bit < nb_bits)
+        b = pt->data[cur] ^ stegx_rand_libc() % UINT8_MAX;
+
+    /* Préfixe ID3v2 (première partie seulement). */
+    if (parallel_copy(pt->par, pt->in, pt->out, pt->buf, MP3_BLOCK_SIZE, pt->begin, pt->adr, 0))
+        return pt->err = 1, parallel_stopped(pt->par) ? NULL
+            : (perror("insert_lsb MP3: Can't copy the header of the MP3 file"), NULL);
+    long int k = pt->k0, adr = pt->adr, pos = adr;
+    while (k < pt->k1 && bit < nb_bits) {
+        size_t len = mp3_block(pt->fr, k, pt->k1, adr, pos, pt->end);
+        if (pread(pt->in, pt->buf, len, pos) != (ssize_t) len)
+            return perror("insert_lsb MP3: Can't read MPEG frames"), pt->err = 1, NULL;
+        for (uint8_t * o; k < pt->k1 && bit < nb_bits && adr + 4 <= pos + (long int)len; adr += pt->fr[k++]) {
+            uint32_t hdr;
+            memcpy(&hdr, o = pt->buf + (adr - pos), sizeof(hdr));
+            hdr = stegx_be32toh(hdr);
+            for (uint32_t hdr_cnt = 0; hdr_cnt < MP3_HDR_NB_BITS_MODIF && bit < nb_bits; hdr_cnt++, bit++) {
+                if (bit / 8 != cur)
+                    b = pt->data[cur = bit / 8] ^ stegx_rand_libc() % UINT8_MAX;
+                hdr = (hdr & mp3_mask[hdr_cnt]) | (((b >> bit % 8) & 1) << mp3_shift[hdr_cnt]);
+            }
+            hdr = stegx_htobe32(hdr);
+            memcpy(o, &hdr, sizeof(hdr));
+        }
+        if (pwrite(pt->out, pt->buf, len, pos) != (ssize_t) len)
+            return perror("insert_lsb MP3: Can't write current MPEG frames"), pt->err = 1, NULL;
+        if (parallel_step(pt->par, len))
+            return pt->err = 1, NULL;
+        pos += len;
+    }
+    /* Frames sans bits cachés et fin du fichier (dernière partie). */
+    if (parallel_copy(pt->par, pt->in, pt->out, pt->buf, MP3_BLOCK_SIZE, pos, pt->end, 0))
+        return pt->err = 1, parallel_stopped(pt->par) ? NULL
+            : (perror("insert_lsb MP3: Can't copy the end of the MP3 file"), NULL);
+    return NULL;
+}
+
+/**
+ * @brief Insertion en LSB sur le format MP3 répartie entre plusieurs threads.
+ * @details Les tailles des frames ne changent pas : le résultat a la même
+ * disposition que l'hôte jusqu'à la signature. Il est alloué à sa taille
+ * puis chaque thread y écrit sa partie par "pwrite".
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @param fr Index des frames.
+ * @return 0 si l'insertion est faite, 1 sur une erreur, -1 si elle n'est pas
+ * possible (un seul coeur, hôte trop court ou fichiers sans descripteur) et
+ * doit être faite en série.
+ * @author StegX Team
+ */
+static int mp3_insert_parallel(info_s * infos, const uint32_t * fr)
+{
+    mp3_s *hs = &(infos->host.file_info.mp3);
+    long int nb = sysconf(_SC_NPROCESSORS_ONLN);
+    int in = fileno(infos->host.host), out = fileno(infos->res);
+    struct stat st;
+    if (hs->fr_nb / MP3_PAR_MIN_FRAMES < nb)
+        nb = hs->fr_nb / MP3_PAR_MIN_FRAMES;
+    if (nb < 2 || in == -1 || out == -1 || fstat(out, &st) || !S_ISREG(st.st_mode))
+        return -1;
+
+    /* Données à cacher en mémoire et résultat alloué à la taille de l'hôte. */
+    struct mp3_part *pt = arena_alloc(&infos->arena, nb * sizeof(*pt));
+    uint8_t *data = arena_alloc(&infos->arena, infos->hidden_length);
+    uint8_t *buf = arena_alloc(&infos->arena, nb * MP3_BLOCK_SIZE);
+    if (!pt || !data || !buf)
+        return perror("insert_lsb MP3: Can't allocate memory for the threads"), 1;
+    if (fseek(infos->hidden, 0, SEEK_SET) || fread(data, 1, infos->hidden_length, infos->hidden) != infos->hidden_length)
+        return perror("insert_lsb MP3: Can't read the hidden file"), 1;
+    if (fflush(infos->res) || ftruncate(out, hs->eof))
+        return perror("insert_lsb MP3: Can't allocate the res file"), 1;
+
+    /* Découpage en parties de même nombre de frames. */
+    struct parallel par;
+    long int k = 0, adr = hs->fr_frst_adr;
+    for (long int t = 0; t < nb; t++) {
+        pt[t] = (struct mp3_part) {.fr = fr,.data = data,.data_len = infos->hidden_length,
+            .passwd = infos->passwd,.in = in,.out = out,.k0 = k,.k1 = hs->fr_nb * (t + 1) / nb,
+            .begin = t ? adr : 0,.adr = adr,.buf = buf + t * MP3_BLOCK_SIZE,.par = &par
+        };
+        for (; k < pt[t].k1; k++)
+            adr += fr[k];
+        pt[t].end = t < nb - 1 ? adr : hs->eof;
+    }
+    if (parallel_run(mp3_part_insert, pt, nb, sizeof(*pt), &par, &infos->progress, 0))
+        return 1;
+    int err = 0;
+    for (long int t = 0; t < nb; t++)
+        err |= pt[t].err;
+    if (err)
+        return 1;
+    if (progress_at(&infos->progress, hs->eof))
+        return 1;
+    /* La signature est écrite par le flux, après la dernière partie. */
+    if (fseek(infos->res, hs->eof, SEEK_SET))
+        return perror("insert_lsb MP3: Can't jump to the end of the res file"), 1;
+    return 0;
+}
+
+/**
+ * @brief Recopie une partie de l'hôte MP3 dans le fichier résultat.
+ * @param h Fichier hôte.
+ * @param r Fichier résultat.
+ * @param buf Tampon de \r{MP3_BLOCK_SIZE} octets.
+ * @param s Nombre d'octets à recopier.
+ * @param p Progression à mettre à jour (peut être NULL).
+ * @return 0 si tout s'est bien passé, sinon -1.
+ * @author StegX Team
+ */
+static int mp3_copy(FILE * h, FILE * r, uint8_t * buf, long int s, struct progress *p)
+{
+    for (size_t n; s > 0; s -= n) {
+        n = s < MP3_BLOCK_SIZE ? (size_t)s : MP3_BLOCK_SIZE;
+        if (fread(buf, sizeof(*buf), n, h) != n || fwrite(buf, sizeof(*buf), n, r) != n
+            || (p && progress_step(p, n)))
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief LSB séquentiel sur les lignes d'une image PNG.
+ * @details Même disposition que le LSB séquentiel du BMP et du WAVE : chaque
+ * octet caché, XORé avec la suite pseudo aléatoire, occupe les 2 bits de
+ * poids faible de 4 échantillons consécutifs.
+ */
+struct lsb_png {
+    FILE *file;                 /*!< Fichier à cacher (insertion) ou résultat (extraction). */
+    mode_e mode;                /*!< Insertion ou extraction. */
+    uint32_t left;              /*!< Octets restant à lire (insertion) ou à écrire (extraction). */
+    uint8_t b;                  /*!< Octet caché en cours. */
+    uint8_t pair;               /*!< Couple de bits de l'octet en cours (0 à 3). */
+};
+
+/**
+ * @brief Cache ou extrait des données dans une ligne de l'image PNG
+ * (\r{png_row_f}).
+ * @param row Échantillons de la ligne.
+ * @param len Taille de la ligne.
+ * @param arg LSB en cours (\r{struct lsb_png}).
+ * @return 0 pour continuer, -1 si l'extraction est terminée, 1 sur une
+ * erreur.
+ * @author StegX Team
+ */
+static int lsb_png_row(uint8_t * row, uint32_t len, void *arg)
+{
+    struct lsb_png *l = arg;
+    for (uint32_t i = 0; i < len && (l->left || l->pair); i++, l->pair = (l->pair + 1) & 3) {
+        int shift = 6 - 2 * l->pair;
+        if (l->mode == STEGX_MODE_INSERT) {
+            if (!l->pair) {
+                if (fread(&l->b, sizeof(l->b), 1, l->file) != 1)
+                    return perror("Can't read data hidden"), 1;
+                l->b ^= stegx_rand() % UINT8_MAX, l->left--;
+            }
+            row[i] = (row[i] & 0xFC) | ((l->b >> shift) & 0x03);
+        } else {
+            l->b |= (row[i] & 0x03) << shift;
+            if (l->pair == 3) {
+                l->b ^= stegx_rand() % UINT8_MAX;
+                if (fwrite(&l->b, sizeof(l->b), 1, l->file) != 1)
+                    return perror("Can't write data hidden extracted"), 1;
+                l->b = 0, l->left--;
+            }
+        }
+    }
+    return l->mode == STEGX_MODE_EXTRACT && !l->left ? -1 : 0;
+}
 
 int protect_data_lsb(uint8_t * pixels, uint32_t pixels_length, uint8_t * data, uint32_t data_length,
-                     char *passwd, mode_e mode)
+                     char *passwd, mode_e mode, struct arena *a, struct progress *p)
 {
 
     // Tableau pour savoir si cette case a deja ete inseree dans result
-    uint8_t *done = malloc(pixels_length * sizeof(uint8_t));
+    uint8_t *done = arena_alloc(a, pixels_length * sizeof(uint8_t));
     if (!done)
         return perror("Can't allocate memory protection data"), 1;
     uint32_t i;
@@ -77,6 +335,8 @@ int protect_data_lsb(uint8_t * pixels, uint32_t pixels_length, uint8_t * data, u
     int j;
     // pour chaque element a cacher
     for (i = 0; i < data_length; i++) {
+        if (progress_step(p, 1))
+            return 1;
         mask_hidden = 0xC0;     // 11000000 en binaire
         // pour chaque couple de bits dans l'octet (soit 4)
         for (j = 0; j < 4; j++) {
@@ -143,7 +403,6 @@ int protect_data_lsb(uint8_t * pixels, uint32_t pixels_length, uint8_t * data, u
         }
     }
 
-    free(done);
     return 0;
 }
 
@@ -158,7 +417,8 @@ int insert_lsb(info_s * infos)
         return perror("Can't make jump hidden file"), 1;
 
     // pour le format BMP et WAVE
-    assert(infos->host.type == BMP_UNCOMPRESSED || infos->host.type == WAV_PCM || infos->host.type == MP3);
+    assert(infos->host.type == BMP_UNCOMPRESSED || infos->host.type == WAV_PCM || infos->host.type == MP3
+           || infos->host.type == PNG);
     if (infos->host.type == BMP_UNCOMPRESSED || infos->host.type == WAV_PCM) {
         uint32_t nb_cpy = 0;        //nb doctets recopies
         uint8_t byte_read_hidden, byte_read_host;
@@ -167,6 +427,8 @@ int insert_lsb(info_s * infos)
 
         // Recopie du header dans le fichier resultat -> taille du header de l'hote
         while (nb_cpy < (infos->host.file_info.bmp.header_size)) {
+            if (progress_step(&infos->progress, 1))
+                return 1;
             if (fread(&byte_read_host, sizeof(uint8_t), 1, infos->host.host) == 0)
                 return perror("Can't read header host"), 1;
             if (fwrite(&byte_read_host, sizeof(uint8_t), 1, infos->res) != 1)
@@ -188,6 +450,9 @@ int insert_lsb(info_s * infos)
             stegx_srand(create_seed(infos->passwd));
             // Cacher en LSB les donnees du fichier a cacher
             while (nb_cpy < (infos->hidden_length)) {
+                /* 4 octets de l'hôte et 1 octet caché par tour. */
+                if (progress_step(&infos->progress, 5))
+                    return 1;
                 // Lecture de l'octet du fichier a cacher
                 if (fread(&byte_read_hidden, sizeof(uint8_t), 1, infos->hidden) == 0)
                     return perror("Can't read data hidden"), 2;
@@ -222,6 +487,8 @@ int insert_lsb(info_s * infos)
             nb_cpy = 0;
             // Recopie du reste des donnees de l'hote -> taille de data de l'hote - taille des octets utilisés pour cacher
             while (rest_host_cpy != 0) {
+                if (progress_step(&infos->progress, 1))
+                    return 1;
                 if (fread(&byte_read_host, sizeof(uint8_t), 1, infos->host.host) == 0)
                     return perror("Can't read data host"), 1;
                 if (fwrite(&byte_read_host, sizeof(uint8_t), 1, infos->res) == 0)
@@ -235,17 +502,19 @@ int insert_lsb(info_s * infos)
         else {
             // Lecture des pixels dans lesquels on va cacher le fichier a cacher
             uint32_t data_length;
-            uint8_t *pixels = malloc((infos->host.file_info.bmp.data_size) * sizeof(uint8_t));
+            uint8_t *pixels = arena_alloc(&infos->arena, (infos->host.file_info.bmp.data_size) * sizeof(uint8_t));
             if (!pixels)
                 return perror("Can't allocate memory Insertion"), 1;
             for (data_length = 0; data_length < infos->host.file_info.bmp.data_size; data_length++) {
+                if (progress_step(&infos->progress, 1))
+                    return 1;
                 if (fread(&byte_read_host, sizeof(uint8_t), 1, infos->host.host) == 0)
                     return perror("Can't read header host"), 1;
                 pixels[data_length] = byte_read_host;
             }
 
             // Lecture des donnees a cacher qui seront stockées dans data
-            uint8_t *data = malloc((infos->hidden_length) * sizeof(uint8_t));
+            uint8_t *data = arena_alloc(&infos->arena, (infos->hidden_length) * sizeof(uint8_t));
             if (!data)
                 return perror("Can't allocate memory Insertion"), 1;
             for (data_length = 0; data_length < infos->hidden_length; data_length++) {
@@ -255,16 +524,16 @@ int insert_lsb(info_s * infos)
             }
             /* methode de protection des donnees avec insertion sur les bits de 
              * poids faible de pixels aleatoires */
-            protect_data_lsb(pixels, infos->host.file_info.bmp.data_size, data,
-                             infos->hidden_length, infos->passwd, infos->mode);
+            if (protect_data_lsb(pixels, infos->host.file_info.bmp.data_size, data,
+                                 infos->hidden_length, infos->passwd, infos->mode, &infos->arena,
+                                 &infos->progress))
+                return 1;
 
             for (data_length = 0; data_length < infos->host.file_info.bmp.data_size; data_length++) {
                 if (fwrite(&pixels[data_length], sizeof(uint8_t), 1, infos->res) != 1)
                     return perror("Sig: Can't write data host modified"), 1;
             }
 
-            free(data);
-            free(pixels);
         }
 
         // Ecriture de la signature
@@ -275,51 +544,79 @@ int insert_lsb(info_s * infos)
         return 0;
     }
 
+    /* Insertion en LSB séquentiel sur les pixels décompressés d'un PNG. */
+    if (infos->host.type == PNG) {
+        struct lsb_png l = {.file = infos->hidden,.mode = infos->mode,.left = infos->hidden_length };
+        stegx_srand(create_seed(infos->passwd));
+        if (png_rows(infos, lsb_png_row, &l))
+            return 1;
+        if (l.left)
+            return fprintf(stderr, "insert_lsb PNG: Not enough pixels\n"), 1;
+        if (write_signature(infos))
+            return stegx_errno = ERR_INSERT, 1;
+        return 0;
+    }
+
     /* Insertion en LSB sur le format MP3. */
     if (infos->host.type == MP3) {
         /* Initialisation. */
         FILE * h = infos->host.host, * r = infos->res; // Fichier hôte et fichier résultant.
         mp3_s * hs = &(infos->host.file_info.mp3);     // Structure du fichier hôte.
-        srand(create_seed(infos->passwd));
+        const uint32_t * fr = mp3_fr_index(infos);     // Index des frames.
+        uint8_t * buf = arena_alloc(&infos->arena, MP3_BLOCK_SIZE), b = 0; // Tampon, octet temporaire lu.
+        if (!fr)
+            return 1;
+        if (!buf)
+            return perror("insert_lsb MP3: Can't allocate memory for the copy buffer"), 1;
+        /* Insertion parallèle si elle est demandée et possible. */
+        int par = infos->flags & STEGX_FLAG_PARALLEL ? mp3_insert_parallel(infos, fr) : -1;
+        if (par == 0 && write_signature(infos))
+            return stegx_errno = ERR_INSERT, 1;
+        if (par != -1)
+            return par;
+        stegx_srand_libc(create_seed(infos->passwd));
 
         /* Recopie du header ID3v2 du fichier hôte s'il y en à un. */
-        uint8_t buf[BUFSIZ], b = 0; // Buffer, octet temporaire lu.
-        for (int s = hs->fr_frst_adr; s && fread(buf, sizeof(*buf), s < BUFSIZ ? s : BUFSIZ, h);)
-            s -= fwrite(buf, sizeof(*buf), s < BUFSIZ ? s : BUFSIZ, r);
-        if (ferror(h) || ferror(r))
-            return perror("insert_lsb MP3: Can't copy the header of the MP3 file"), 1;
-
-        assert(ftell(h) == hs->fr_frst_adr);
-        /* Lecture successive des headers de chaque frame. "b_cnt" et "hdr_cnt" sont
-         * respectivement les compteurs des bits à traiter et traités de l'octet
-         * et du header venant d'être lu.*/
-        uint32_t hdr = 0; // Header lu.
-        for (uint32_t hdr_cnt = 0, b_cnt = 0; fread(&hdr, sizeof(hdr), 1, h) && mp3_mpeg_hdr_test(hdr = stegx_be32toh(hdr)); hdr_cnt = 0) {
-            /* S'il ne reste plus de données déjà lues à cacher, on relis. Si on peux relire, on remet le compteur "b_cnt" égal à 8 bits à cacher.
-             * Tant qu'il reste des bits à caché dans l'octet lu et qu'on à pas saturé le header du MP3, on cache. On relis si besoin le fichier
-             * à cacher pour saturer le header du MP3 jusqu'à ce qu'on ai tout lu. */
-            for (; (b_cnt = !b_cnt ? fread(&b, sizeof(b), 1, infos->hidden) * 8 : b_cnt) && hdr_cnt < MP3_HDR_NB_BITS_MODIF;
-                    b >>= 1, b_cnt--, hdr_cnt++) {
-                /* Si on vient de lire un octet du fichier à cacher. */
-                if (b_cnt == 8)
-                    b ^= rand() % UINT8_MAX;
-                hdr = (hdr & mp3_mask[hdr_cnt]) | ((b & 1) << mp3_shift[hdr_cnt]);
+        if (fseek(h, 0, SEEK_SET) || mp3_copy(h, r, buf, hs->fr_frst_adr, &infos->progress))
+            return progress_canceled(&infos->progress) ? 1
+                : (perror("insert_lsb MP3: Can't copy the header of the MP3 file"), 1);
+
+        /* Lecture par blocs, dont on ne modifie que les headers. "b_cnt" et
+         * "hdr_cnt" sont respectivement les compteurs des bits à traiter et
+         * traités de l'octet et du header en cours. On s'arrête dès que le
+         * fichier à cacher est entièrement lu ("end"). */
+        long int i = 0, adr = hs->fr_frst_adr, pos = adr; // Frame, adresse de son header et début du bloc.
+        for (uint32_t b_cnt = 0, hdr_cnt, hdr, end = 0; i < hs->fr_nb && !end;) {
+            size_t len = mp3_block(fr, i, hs->fr_nb, adr, pos, hs->eof);
+            if (fread(buf, sizeof(*buf), len, h) != len)
+                return perror("insert_lsb MP3: Can't read MPEG frames"), 1;
+            for (uint8_t * o; i < hs->fr_nb && !end && adr + (long int)sizeof(hdr) <= pos + (long int)len; adr += fr[i++]) {
+                memcpy(&hdr, o = buf + (adr - pos), sizeof(hdr));
+                hdr = stegx_be32toh(hdr);
+                /* Tant qu'on à pas saturé le header du MP3, on cache. S'il ne
+                 * reste plus de bits à cacher dans l'octet lu, on relis. */
+                for (hdr_cnt = 0; hdr_cnt < MP3_HDR_NB_BITS_MODIF; b >>= 1, b_cnt--, hdr_cnt++) {
+                    if (!b_cnt && !(end = !fread(&b, sizeof(b), 1, infos->hidden)))
+                        b ^= stegx_rand_libc() % UINT8_MAX, b_cnt = 8;
+                    if (end)
+                        break;
+                    hdr = (hdr & mp3_mask[hdr_cnt]) | ((b & 1) << mp3_shift[hdr_cnt]);
+                }
+                hdr = stegx_htobe32(hdr);
+                memcpy(o, &hdr, sizeof(hdr));
             }
-            /* On écrit le header éventuellement modifié puis les données de la frame. */
-            if (!fwrite((hdr = stegx_htobe32(hdr), &hdr), sizeof(hdr), 1, r) || mp3_mpeg_fr_write(stegx_be32toh(hdr), h, r))
-                return perror("insert_lsb MP3: Can't write current MPEG header and frame"), 1;
+            if (fwrite(buf, sizeof(*buf), len, r) != len)
+                return perror("insert_lsb MP3: Can't write current MPEG frames"), 1;
+            if (progress_at(&infos->progress, pos += len))
+                return 1;
         }
-        if (ferror(h))
-            return perror("insert_lsb MP3: Can't read frame header"), 1;
+        if (ferror(infos->hidden))
+            return perror("insert_lsb MP3: Can't read the hidden file"), 1;
 
-        /* Curseur sur un tag ID3v1 => écris le tag. */
-        if (mp3_id3v1_hdr_test(hdr)) {
-            if (!fwrite((hdr = stegx_htobe32(hdr), &hdr), sizeof(hdr), 1, r) || mp3_id3v1_tag_write(h, r))
-                return perror("insert_lsb MP3: Can't write ID3v1 tag at the end of file"), 1;
-        } 
-
-        assert(ftell(h) == hs->eof);
-        assert(feof(infos->hidden));
+        /* Recopie des frames restantes et de l'éventuel tag ID3v1. */
+        if (mp3_copy(h, r, buf, hs->eof - pos, &infos->progress))
+            return progress_canceled(&infos->progress) ? 1
+                : (perror("insert_lsb MP3: Can't copy the end of the MP3 file"), 1);
         /* Écriture de la signature et fin du LSB. */
         if (write_signature(infos))
             return stegx_errno = ERR_INSERT, 1;
@@ -359,7 +656,8 @@ int extract_lsb(info_s * infos)
             mask_host = 0x03;   // 00000011 en binaire
             // Extraire en LSB les donnees du fichier a cacher -> taille du fichier a cacher
             while (nb_cpy < (infos->hidden_length)) {
-
+                if (progress_step(&infos->progress, 4))
+                    return 1;
                 byte_created = 0;
                 for (i = 0; i < 4; i++) {
                     // Lecture de l'octet du fichier hote
@@ -385,68 +683,79 @@ int extract_lsb(info_s * infos)
 
         else {
             uint32_t data_length;
-            uint8_t *pixels = malloc((infos->host.file_info.bmp.data_size) * sizeof(uint8_t));
+            uint8_t *pixels = arena_alloc(&infos->arena, (infos->host.file_info.bmp.data_size) * sizeof(uint8_t));
             if (!pixels)
                 return perror("Can't allocate memory Insertion"), 1;
             for (data_length = 0; data_length < infos->host.file_info.bmp.data_size; data_length++) {
+                if (progress_step(&infos->progress, 1))
+                    return 1;
                 if (fread(&byte_read_host, sizeof(uint8_t), 1, infos->host.host) == 0)
                     return perror("Can't read header host"), 1;
                 pixels[data_length] = byte_read_host;
             }
-            uint8_t *data = malloc((infos->hidden_length) * sizeof(uint8_t));
+            uint8_t *data = arena_alloc(&infos->arena, (infos->hidden_length) * sizeof(uint8_t));
             if (!data)
                 return perror("Can't allocate memory Insertion"), 1;
 
-            protect_data_lsb(pixels, infos->host.file_info.bmp.data_size, data,
-                             infos->hidden_length, infos->passwd, infos->mode);
+            if (protect_data_lsb(pixels, infos->host.file_info.bmp.data_size, data,
+                                 infos->hidden_length, infos->passwd, infos->mode, &infos->arena,
+                                 &infos->progress))
+                return 1;
 
             for (data_length = 0; data_length < infos->hidden_length; data_length++) {
                 if (fwrite(&data[data_length], sizeof(uint8_t), 1, infos->res) != 1)
                     return perror("Sig: Can't write data host modified"), 1;
             }
 
-            free(pixels);
-            free(data);
             return 0;
         }
     }
 
+    /* Extraction en LSB séquentiel sur les pixels décompressés d'un PNG. */
+    if (infos->host.type == PNG) {
+        struct lsb_png l = {.file = infos->res,.mode = infos->mode,.left = infos->hidden_length };
+        stegx_srand(create_seed(infos->passwd));
+        if (png_rows(infos, lsb_png_row, &l))
+            return 1;
+        return l.left ? fprintf(stderr, "extract_lsb PNG: Not enough pixels\n"), 1 : 0;
+    }
+
     /* Extraction en LSB sur le format MP3. */
     if (infos->host.type == MP3) {
         /* Initialisation. */
         FILE * h = infos->host.host, * r = infos->res; // Fichier hôte et fichier résultant.
         mp3_s * hs = &(infos->host.file_info.mp3);     // Structure du fichier hôte.
-        srand(create_seed(infos->passwd));
-
-        /* Saut du header ID3v2 du fichier hôte s'il y en à un. */
-        if (fseek(h, hs->fr_frst_adr, SEEK_SET))
-            return perror("extract_lsb: Can't jump over ID3v2 tag"), -1;
-
-        assert(ftell(h) == hs->fr_frst_adr);
-        /* Lecture successive des headers de chaque frame tant qu'on à pas fini
-         * d'écrire la taille du fichier qui était caché dans le fichier
-         * résultat. "s" correspond à la taille actuellement écrite dans le
-         * fichier resultat. "hdr" est le header lu. "b_cnt" et "hdr_cnt" sont
-         * respectivement les compteurs des bits à traiter et traités de l'octet
-         * et du header venant d'être lu.*/
+        const uint32_t * fr = mp3_fr_index(infos);     // Index des frames.
+        if (!fr)
+            return 1;
+        stegx_srand_libc(create_seed(infos->passwd));
+
+        /* Lecture des seuls headers des frames utiles, grâce à l'index, tant
+         * qu'on à pas fini d'écrire la taille du fichier qui était caché dans
+         * le fichier résultat. "s" correspond à la taille actuellement écrite
+         * dans le fichier resultat. "b_cnt" est le nombre de bits de l'octet
+         * en cours de reconstitution. */
         uint8_t b = 0; // Octet reconstitué à écrire dans le résultat.
-        for (uint32_t s = 0, hdr = 0, hdr_cnt = 0, b_cnt = 8; fread(&hdr, sizeof(hdr), 1, h) && s < infos->hidden_length; hdr_cnt = 0) {
+        long int adr = hs->fr_frst_adr; // Adresse de la frame en cours.
+        for (uint32_t s = 0, i = 0, hdr, b_cnt = 0; s < infos->hidden_length; adr += fr[i++]) {
+            if (i == hs->fr_nb)
+                return fprintf(stderr, "extract_lsb MP3: Not enough MPEG frames\n"), 1;
+            if (fseek(h, adr, SEEK_SET) || fread(&hdr, sizeof(hdr), 1, h) != 1)
+                return perror("extract_lsb MP3: Can't read frame header"), 1;
             hdr = stegx_be32toh(hdr);
-            /* Tant que l'on à pas lu les bits caché du header en cours. */
-            for (; hdr_cnt < MP3_HDR_NB_BITS_MODIF; b_cnt--, hdr_cnt++) {
+            for (uint32_t hdr_cnt = 0; hdr_cnt < MP3_HDR_NB_BITS_MODIF && s < infos->hidden_length; hdr_cnt++) {
+                b |= ((hdr & ~mp3_mask[hdr_cnt]) >> mp3_shift[hdr_cnt]) << b_cnt;
                 /* Si notre octet est complètement reconstitué. */
-                for (; !b_cnt ; b = 0, s++) {
-                    b ^= rand() % UINT8_MAX;
-                    b_cnt = fwrite(&b, sizeof(b), 1, r) * 8;
+                if (++b_cnt == 8) {
+                    b ^= stegx_rand_libc() % UINT8_MAX;
+                    if (fwrite(&b, sizeof(b), 1, r) != 1)
+                        return perror("extract_lsb MP3: Can't write the res file"), 1;
+                    b = 0, b_cnt = 0, s++;
                 }
-                b |= ((hdr & ~mp3_mask[hdr_cnt]) >> mp3_shift[hdr_cnt]) << (8 - b_cnt);
             }
-            /* On saute la frame quand on à récupéré tout les bits du header. */
-            if (mp3_mpeg_fr_seek(hdr, h))
-                return perror("insert_lsb MP3: Can't skip current MP3 MPEG frame"), 1;
+            if (progress_at(&infos->progress, adr))
+                return 1;
         }
-        if (ferror(h) || ferror(r))
-            return perror("insert_lsb MP3: Can't read the host file or write the res file"), 1;
         return 0;
     }
 
@@ -46,11 +46,14 @@
  * pseudo aleatoire nécessaire au mélange des octets de tab. 
  * @param mode Mode qui peut être \req{STEGX_STEGX_MODE_INSERT} ou 
  * \req{STEGX_MODE_EXTRACT}. 
- * @return 0 si le melange des donnees s'est bien passé ; 1 sinon. 
+ * @param a Allocateur du traitement (tableau temporaire).
+ * @param p Suivi de progression du traitement (un octet par octet caché).
+ * @return 0 si le melange des donnees s'est bien passé ; 1 sinon (ou si le
+ * traitement est annulé). 
  * @author Clement Caumes
  */
 int protect_data_lsb(uint8_t * pixels, uint32_t pixels_length, uint8_t * data, uint32_t data_length,
-                     char *passwd, mode_e mode);
+                     char *passwd, mode_e mode, struct arena *a, struct progress *p);
 
 /** 
  * @brief Va inserer les donnees cachees en utilisant l'algorithme LSB. 
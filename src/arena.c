@@ -0,0 +1,102 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file arena.c
+ * @brief Allocateur par traitement.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "arena.h"
+
+/** Alignement des zones allouées. */
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+/**
+ * @brief Ajoute un bloc en tête de l'allocateur.
+ * @param a Allocateur.
+ * @param size Taille utile minimale du bloc.
+ * @return Bloc ajouté, NULL en cas d'erreur.
+ * @author StegX Team
+ */
+static struct arena_block *arena_grow(struct arena *a, size_t size)
+{
+    size = size < ARENA_BLOCK_SIZE ? ARENA_BLOCK_SIZE : size;
+    if (size > SIZE_MAX - sizeof(struct arena_block))
+        return NULL;
+    struct arena_block *b = malloc(sizeof(*b) + size);
+    if (!b)
+        return NULL;
+    *b = (struct arena_block) {.next = a->blocks,.size = size };
+    return a->blocks = b;
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+    assert(a);
+    if (size > SIZE_MAX - ARENA_ALIGN)
+        return NULL;
+    size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    struct arena_block *b = a->blocks;
+    if ((!b || b->size - b->used < size) && !(b = arena_grow(a, size)))
+        return NULL;
+    void *p = (char *)b->data + b->used;
+    b->used += size;
+    return p;
+}
+
+void *arena_calloc(struct arena *a, size_t nb, size_t size)
+{
+    if (size && nb > SIZE_MAX / size)
+        return NULL;
+    void *p = arena_alloc(a, nb * size);
+    return p ? memset(p, 0, nb * size) : NULL;
+}
+
+char *arena_strdup(struct arena *a, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *d = arena_alloc(a, len);
+    return d ? memcpy(d, s, len) : NULL;
+}
+
+void arena_reset(struct arena *a)
+{
+    assert(a);
+    if (a->blocks && a->blocks->next) {
+        /* Plusieurs blocs : un seul bloc de la taille totale pour la suite. */
+        size_t total = 0;
+        for (struct arena_block * b = a->blocks; b; b = b->next)
+            total += b->size;
+        arena_free(a);
+        arena_grow(a, total);
+    } else if (a->blocks)
+        a->blocks->used = 0;
+}
+
+void arena_free(struct arena *a)
+{
+    assert(a);
+    for (struct arena_block * b = a->blocks, *next; b; b = next)
+        next = b->next, free(b);
+    a->blocks = NULL;
+}
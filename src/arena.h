@@ -0,0 +1,100 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file arena.h
+ * @brief Allocateur par traitement.
+ * @details Module qui fournit la mémoire temporaire d'un traitement (nom du
+ * fichier caché, mot de passe, tampons des algorithmes et de la protection des
+ * données). Les allocations avancent simplement dans un bloc et ne sont jamais
+ * libérées une par une : tout est rendu d'un coup à la fin du traitement. Les
+ * blocs sont conservés par \r{arena_reset} pour le traitement suivant, qui ne
+ * fait alors plus aucune allocation sur le tas.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/** Taille minimale d'un bloc de l'allocateur (octets). */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @brief Bloc de mémoire de l'allocateur.
+ */
+struct arena_block {
+    struct arena_block *next;   /*!< Bloc alloué précédemment. */
+    size_t size;                /*!< Taille utile du bloc (octets). */
+    size_t used;                /*!< Nombre d'octets utilisés. */
+    max_align_t data[];         /*!< Mémoire du bloc. */
+};
+
+/**
+ * @brief Allocateur d'un traitement.
+ */
+struct arena {
+    struct arena_block *blocks; /*!< Bloc courant, suivi des blocs pleins. */
+};
+
+/**
+ * @brief Alloue de la mémoire non initialisée.
+ * @param a Allocateur.
+ * @param size Taille (octets).
+ * @return Zone allouée (alignée pour tout type), NULL en cas d'erreur.
+ * @author StegX Team
+ */
+void *arena_alloc(struct arena *a, size_t size);
+
+/**
+ * @brief Alloue de la mémoire initialisée à zéro.
+ * @param a Allocateur.
+ * @param nb Nombre d'éléments.
+ * @param size Taille d'un élément (octets).
+ * @return Zone allouée, NULL en cas d'erreur.
+ * @author StegX Team
+ */
+void *arena_calloc(struct arena *a, size_t nb, size_t size);
+
+/**
+ * @brief Copie une chaîne de caractères.
+ * @param a Allocateur.
+ * @param s Chaîne à copier.
+ * @return Copie de la chaîne, NULL en cas d'erreur.
+ * @author StegX Team
+ */
+char *arena_strdup(struct arena *a, const char *s);
+
+/**
+ * @brief Rend toute la mémoire allouée en gardant les blocs.
+ * @details Si le traitement a eu besoin de plusieurs blocs, ils sont remplacés
+ * par un seul bloc de leur taille totale : le traitement suivant, s'il a les
+ * mêmes besoins, n'alloue plus rien.
+ * @param a Allocateur.
+ * @author StegX Team
+ */
+void arena_reset(struct arena *a);
+
+/**
+ * @brief Libère les blocs de l'allocateur.
+ * @param a Allocateur.
+ * @author StegX Team
+ */
+void arena_free(struct arena *a);
+
+#endif
@@ -30,17 +30,11 @@
 #include "stegx_common.h"
 #include "stegx_errors.h"
 #include "common.h"
+#include "check_compa.h"
 
 /** Nombre de fonctions de test d'un type de fichier. */
 #define STEGX_TEST_FILE_NB 6
 
-/**
- * @brief Retourne le type du fichier. 
- * @param *file fichier à tester.
- * @return type_e représentant les différents types pris en charge par 
- * l'application. 
- * @author Clément Caumes et Yassin Doudouh
- */
 type_e check_file_format(FILE * file)
 {
     assert(file);
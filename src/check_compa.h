@@ -0,0 +1,42 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file check_compa.h
+ * @brief Module de vérification de la compatibilité.
+ * @details Vérification de la compatibilité des fichiers en entrée, détection
+ * du type du fichier hôte.
+ */
+
+#ifndef CHECK_COMPA_H
+#define CHECK_COMPA_H
+
+#include <stdio.h>
+
+#include "common.h"
+
+/**
+ * @brief Retourne le type du fichier. 
+ * @param *file fichier à tester.
+ * @return type_e représentant les différents types pris en charge par 
+ * l'application. 
+ * @author Clément Caumes et Yassin Doudouh
+ */
+type_e check_file_format(FILE * file);
+
+#endif                          /* ifndef CHECK_COMPA_H */
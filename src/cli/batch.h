@@ -0,0 +1,94 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file batch.h
+ * @brief Travaux du programme "stegx-batch".
+ * @details Définitions partagées entre l'exécution sur le pool de threads
+ * (stegx_batch.c) et l'exécution en pipeline (pipeline.c).
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+#include "stegx.h"
+
+/** Valeur de l'algorithme "auto" (premier algorithme proposé). */
+#define ALGO_AUTO STEGX_NB_ALGO
+
+/**
+ * @brief Travail décrit par une ligne du manifeste.
+ */
+struct job {
+    unsigned int line;          /*!< Numéro de ligne dans le manifeste. */
+    mode_e mode;                /*!< Insertion ou extraction. */
+    char *host;                 /*!< Chemin du fichier hôte. */
+    char *hidden;               /*!< Chemin du fichier à cacher (insertion). */
+    char *res;                  /*!< Fichier (insertion) ou dossier (extraction) résultat. */
+    algo_e algo;                /*!< Algorithme (insertion), \r{ALGO_AUTO} pour le premier proposé. */
+    char *passwd;               /*!< Mot de passe (NULL si aucun). */
+    unsigned int flags;         /*!< Options de la bibliothèque. */
+    enum err_code err;          /*!< Code d'erreur du travail. */
+    struct timespec start;      /*!< Début du travail. */
+    void *priv;                 /*!< Données du mode d'exécution (pipeline). */
+};
+
+/**
+ * @brief Exécute les étapes de la bibliothèque pour un travail.
+ * @param j Travail à exécuter.
+ * @param ctx Structure de la bibliothèque réutilisée d'un travail à l'autre par
+ * \r{stegx_reset} (NULL pour une structure propre au travail). Si "*ctx" est
+ * NULL, elle est créée ; elle doit être libérée par \r{stegx_clear}.
+ * @param host Hôte partagé (NULL pour ouvrir "j->host").
+ * @param hidden Fichier à cacher déjà ouvert (NULL pour ouvrir "j->hidden").
+ * @param res Fichier résultat déjà ouvert pour l'insertion (NULL pour ouvrir
+ * "j->res").
+ * @details Les fichiers "hidden" et "res" sont fermés dans tous les cas.
+ * @sideeffect Remplit "j->err".
+ * @return Code d'erreur du travail.
+ * @author StegX Team
+ */
+enum err_code job_exec(struct job *j, info_s ** ctx, stegx_host_s * host, FILE * hidden,
+                       FILE * res);
+
+/**
+ * @brief Écrit le résultat d'un travail terminé sur la sortie standard.
+ * @param j Travail terminé (sa durée est comptée depuis "j->start").
+ * @author StegX Team
+ */
+void job_report(struct job *j);
+
+/**
+ * @brief Exécute les travaux en pipeline.
+ * @details Un étage de lecture ouvre et analyse chaque hôte une fois pour tous
+ * ses travaux, lit les fichiers à cacher et demande au système de précharger
+ * l'hôte suivant. Les threads de l'étage de calcul font l'insertion dans un
+ * fichier temporaire à côté du résultat. Un étage d'écriture renomme les
+ * résultats. Les étages sont reliés par des files bornées.
+ * @param jobs Travaux à exécuter.
+ * @param nb Nombre de travaux.
+ * @param nb_threads Nombre de threads de calcul (0 pour le nombre de coeurs).
+ * @return 0 si le pipeline a pu être lancé, 1 sinon.
+ * @author StegX Team
+ */
+int pipeline_run(struct job *jobs, size_t nb, unsigned int nb_threads);
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file pipeline.c
+ * @brief Exécution des travaux de "stegx-batch" en pipeline.
+ * @details Trois étages reliés par des files bornées :
+ * - lecture (un thread) : les travaux sont triés par hôte ; chaque hôte est
+ *   ouvert et analysé une seule fois (\r{stegx_host_open}) pour tous ses
+ *   travaux, les fichiers à cacher sont lus en mémoire et le système est
+ *   prévenu que l'hôte suivant va être lu (posix_fadvise) ;
+ * - calcul (N threads) : insertion dans un fichier temporaire placé à côté du
+ *   fichier résultat, ou extraction complète (la bibliothèque écrit elle-même
+ *   le fichier extrait) ;
+ * - écriture (thread appelant) : renommage des fichiers temporaires en
+ *   fichiers résultats, compte rendu des travaux et fermeture de chaque hôte
+ *   après son dernier travail.
+ * Seuls les fichiers à cacher sont gardés en mémoire : un résultat n'y est
+ * jamais construit entièrement.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "stegx.h"
+#include "queue.h"
+#include "batch.h"
+
+/** Nombre de travaux en attente par thread de calcul dans chaque file. */
+#define PIPELINE_DEPTH 2
+
+/**
+ * @brief Hôte partagé par un groupe de travaux.
+ */
+struct pipe_group {
+    stegx_host_s *host;         /*!< Hôte ouvert et analysé. */
+    atomic_size_t ref;          /*!< Nombre de travaux du groupe non terminés. */
+};
+
+/**
+ * @brief État d'un travail dans le pipeline (\r{job.priv}).
+ */
+struct pipe_job {
+    struct pipe_group *group;   /*!< Groupe du travail (NULL si l'hôte n'a pas pu être ouvert). */
+    char *hidden_buf;           /*!< Fichier à cacher lu en mémoire. */
+    size_t hidden_len;          /*!< Taille du fichier à cacher. */
+    char *res_tmp;              /*!< Fichier résultat temporaire (NULL si non créé). */
+};
+
+/**
+ * @brief Pipeline.
+ */
+struct pipeline {
+    struct job *jobs;           /*!< Travaux. */
+    size_t nb;                  /*!< Nombre de travaux. */
+    unsigned int nb_threads;    /*!< Nombre de threads de calcul. */
+    atomic_uint running;        /*!< Nombre de threads de calcul non terminés. */
+    queue_s *cpu;               /*!< File vers l'étage de calcul. */
+    queue_s *out;               /*!< File vers l'étage d'écriture. */
+};
+
+/**
+ * @brief Ordre des travaux : par hôte, puis par mode, puis par ligne.
+ * @author StegX Team
+ */
+static int job_cmp(const void *a, const void *b)
+{
+    const struct job *x = *(struct job * const *)a, *y = *(struct job * const *)b;
+    int c = strcmp(x->host, y->host);
+    if (!c)
+        c = (int)x->mode - (int)y->mode;
+    return c ? c : (x->line > y->line) - (x->line < y->line);
+}
+
+/**
+ * @brief Demande au système de lire un fichier à l'avance.
+ * @param path Chemin du fichier.
+ * @author StegX Team
+ */
+static void readahead_file(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+/**
+ * @brief Lit un fichier entier en mémoire.
+ * @param path Chemin du fichier.
+ * @param len Taille lue.
+ * @return Contenu du fichier, NULL en cas d'erreur.
+ * @author StegX Team
+ */
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return perror(path), NULL;
+    char *buf = NULL;
+    long size = fseek(f, 0, SEEK_END) ? -1 : ftell(f);
+    if (size > 0 && !fseek(f, 0, SEEK_SET) && (buf = malloc(size))
+        && fread(buf, 1, size, f) != (size_t)size)
+        free(buf), buf = NULL;
+    fclose(f);
+    *len = buf ? size : 0;
+    return buf;
+}
+
+/**
+ * @brief Crée le fichier temporaire qui reçoit le résultat d'une insertion.
+ * @details Le fichier est créé dans le même dossier que le résultat pour que
+ * l'étage d'écriture n'ait qu'à le renommer. C'est un vrai fichier : les
+ * chemins parallèles de la bibliothèque peuvent y écrire par son descripteur.
+ * @param j Travail.
+ * @return Fichier temporaire ouvert en écriture, NULL en cas d'erreur.
+ * @author StegX Team
+ */
+static FILE *res_tmp_open(struct job *j)
+{
+    struct pipe_job *pj = j->priv;
+    size_t len = strlen(j->res) + 32;
+    if (!(pj->res_tmp = malloc(len)))
+        return NULL;
+    snprintf(pj->res_tmp, len, "%s.%ld.%u", j->res, (long)getpid(), j->line);
+    int fd = open(pj->res_tmp, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    FILE *f = fd == -1 ? NULL : fdopen(fd, "w+b");
+    if (!f && fd != -1)
+        close(fd), unlink(pj->res_tmp);
+    if (!f)
+        pj->res_tmp = (free(pj->res_tmp), NULL);
+    return f;
+}
+
+/**
+ * @brief Étage de lecture.
+ * @param arg Pipeline.
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *stage_read(void *arg)
+{
+    struct pipeline *pl = arg;
+    struct job **order = malloc(pl->nb * sizeof(*order));
+    for (size_t i = 0; order && i < pl->nb; i++)
+        order[i] = &pl->jobs[i];
+    if (order)
+        qsort(order, pl->nb, sizeof(*order), job_cmp);
+
+    for (size_t i = 0, end; order && i < pl->nb; i = end) {
+        /* Groupe : travaux consécutifs sur le même hôte et dans le même mode. */
+        for (end = i + 1; end < pl->nb && !strcmp(order[end]->host, order[i]->host)
+             && order[end]->mode == order[i]->mode; end++);
+        if (end < pl->nb && strcmp(order[end]->host, order[i]->host))
+            readahead_file(order[end]->host);
+
+        struct pipe_group *g = malloc(sizeof(*g));
+        stegx_errno = ERR_NONE;
+        if (g && !(g->host = stegx_host_open(order[i]->host, order[i]->mode)))
+            free(g), g = NULL;
+        if (g)
+            atomic_init(&g->ref, end - i);
+        enum err_code err = g ? ERR_NONE : stegx_errno != ERR_NONE ? stegx_errno : ERR_OTHER;
+
+        for (size_t k = i; k < end; k++) {
+            struct job *j = order[k];
+            struct pipe_job *pj = j->priv;
+            clock_gettime(CLOCK_MONOTONIC, &j->start);
+            pj->group = g;
+            if (!g)
+                j->err = err;
+            else if (j->mode == STEGX_MODE_INSERT
+                     && !(pj->hidden_buf = read_file(j->hidden, &pj->hidden_len)))
+                j->err = ERR_HIDDEN;
+            /* Les travaux en erreur vont directement à l'écriture. */
+            queue_push(j->err ? pl->out : pl->cpu, j);
+        }
+    }
+    if (!order)
+        for (size_t i = 0; i < pl->nb; i++)
+            pl->jobs[i].err = ERR_OTHER, queue_push(pl->out, &pl->jobs[i]);
+    free(order);
+    for (unsigned int i = 0; i < pl->nb_threads; i++)
+        queue_push(pl->cpu, NULL);
+    return NULL;
+}
+
+/**
+ * @brief Étage de calcul.
+ * @param arg Pipeline.
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *stage_cpu(void *arg)
+{
+    struct pipeline *pl = arg;
+    /* Structure de la bibliothèque réutilisée par tous les travaux du thread. */
+    info_s *ctx = NULL;
+    for (struct job *j; (j = queue_pop(pl->cpu));) {
+        struct pipe_job *pj = j->priv;
+        if (j->mode == STEGX_MODE_EXTRACT) {
+            job_exec(j, &ctx, pj->group->host, NULL, NULL);
+        } else {
+            /* Fichier à cacher en mémoire, résultat écrit directement sur le
+             * disque dans un fichier temporaire. */
+            FILE *hidden = fmemopen(pj->hidden_buf, pj->hidden_len, "rb");
+            FILE *res = hidden ? res_tmp_open(j) : NULL;
+            if (!hidden)
+                perror("Can't open in-memory hidden file"), j->err = ERR_OTHER;
+            else if (!res)
+                fclose(hidden), perror(j->res), j->err = ERR_RES_INSERT;
+            else
+                job_exec(j, &ctx, pj->group->host, hidden, res);
+        }
+        queue_push(pl->out, j);
+    }
+    if (ctx)
+        stegx_clear(ctx);
+    /* Le dernier thread de calcul termine l'étage d'écriture. */
+    if (atomic_fetch_sub(&pl->running, 1) == 1)
+        queue_push(pl->out, NULL);
+    return NULL;
+}
+
+/**
+ * @brief Étage d'écriture.
+ * @param pl Pipeline.
+ * @author StegX Team
+ */
+static void stage_write(struct pipeline *pl)
+{
+    for (struct job *j; (j = queue_pop(pl->out));) {
+        struct pipe_job *pj = j->priv;
+        /* Le résultat n'apparaît sous son nom qu'une fois l'insertion réussie. */
+        if (pj->res_tmp && !j->err && rename(pj->res_tmp, j->res))
+            perror(j->res), j->err = ERR_RES_INSERT;
+        if (pj->res_tmp && j->err)
+            unlink(pj->res_tmp);
+        free(pj->hidden_buf), free(pj->res_tmp);
+        pj->hidden_buf = pj->res_tmp = NULL;
+        job_report(j);
+        if (pj->group && atomic_fetch_sub(&pj->group->ref, 1) == 1)
+            stegx_host_close(pj->group->host), free(pj->group);
+    }
+}
+
+int pipeline_run(struct job *jobs, size_t nb, unsigned int nb_threads)
+{
+    if (!nb_threads) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nb_threads = n > 0 ? n : 1;
+    }
+    struct pipeline pl = {.jobs = jobs,.nb = nb,.nb_threads = nb_threads };
+    struct pipe_job *pjobs = calloc(nb ? nb : 1, sizeof(*pjobs));
+    pthread_t *threads = calloc(nb_threads + 1, sizeof(*threads));
+    pl.cpu = queue_create(PIPELINE_DEPTH * nb_threads);
+    pl.out = queue_create(PIPELINE_DEPTH * nb_threads);
+    if (!pjobs || !threads || !pl.cpu || !pl.out) {
+        perror("Pipeline: Can't allocate memory");
+        return free(pjobs), free(threads), queue_destroy(pl.cpu), queue_destroy(pl.out), 1;
+    }
+    for (size_t i = 0; i < nb; i++)
+        jobs[i].priv = &pjobs[i];
+    atomic_init(&pl.running, nb_threads);
+
+    /* Les threads de calcul sont démarrés avant la lecture : si l'un d'eux ne
+     * peut pas l'être, le pipeline n'a encore rien fait. */
+    unsigned int started = 0;
+    while (started < nb_threads && !pthread_create(&threads[started], NULL, stage_cpu, &pl))
+        started++;
+    int err = started < nb_threads
+        || pthread_create(&threads[nb_threads], NULL, stage_read, &pl);
+    if (err) {
+        perror("Pipeline: Can't create thread");
+        for (unsigned int i = 0; i < started; i++)
+            queue_push(pl.cpu, NULL);
+        for (unsigned int i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+    } else {
+        stage_write(&pl);
+        for (unsigned int i = 0; i <= nb_threads; i++)
+            pthread_join(threads[i], NULL);
+    }
+    for (size_t i = 0; i < nb; i++)
+        jobs[i].priv = NULL;
+    queue_destroy(pl.cpu), queue_destroy(pl.out);
+    free(pjobs), free(threads);
+    return err;
+}
@@ -0,0 +1,257 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file pool.c
+ * @brief Pool de threads avec vol de tâches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/** Capacité initiale de la file de chaque thread. */
+#define POOL_DEQUE_INIT 64
+
+/**
+ * @brief Tâche du pool.
+ */
+struct pool_task {
+    pool_fn fn;                 /*!< Fonction à exécuter. */
+    void *arg;                  /*!< Argument de la fonction. */
+};
+
+/**
+ * @brief File de tâches d'un thread (tableau circulaire).
+ * @details Le propriétaire ajoute et prend en fin de file, les voleurs
+ * prennent en début de file.
+ */
+struct pool_deque {
+    pthread_mutex_t lock;       /*!< Verrou de la file. */
+    struct pool_task *tasks;    /*!< Tableau circulaire des tâches. */
+    size_t head;                /*!< Indice de la plus ancienne tâche. */
+    size_t len;                 /*!< Nombre de tâches dans la file. */
+    size_t cap;                 /*!< Capacité du tableau. */
+};
+
+/** Argument de démarrage d'un thread du pool. */
+struct pool_worker {
+    pool_s *p;                  /*!< Pool du thread. */
+    unsigned int id;            /*!< Indice du thread (et de sa file). */
+};
+
+/**
+ * @brief Pool de threads.
+ */
+struct pool {
+    unsigned int nb;            /*!< Nombre de threads. */
+    pthread_t *threads;         /*!< Threads du pool. */
+    struct pool_worker *workers;        /*!< Argument de démarrage de chaque thread. */
+    struct pool_deque *deques;  /*!< File de chaque thread. */
+    struct pool_deque inject;   /*!< File commune des tâches venant de l'extérieur (FIFO). */
+    pthread_mutex_t lock;       /*!< Verrou des compteurs et des conditions. */
+    pthread_cond_t work;        /*!< Signalée quand une tâche est ajoutée. */
+    pthread_cond_t done;        /*!< Signalée quand toutes les tâches sont finies. */
+    size_t queued;              /*!< Nombre de tâches en attente dans les files. */
+    size_t pending;             /*!< Nombre de tâches en attente ou en cours. */
+    int stop;                   /*!< Demande d'arrêt des threads. */
+};
+
+/** Pool et indice du thread courant (NULL hors du pool). */
+static _Thread_local struct pool_worker self;
+
+/**
+ * @brief Ajoute une tâche en fin de file.
+ * @param d File de tâches.
+ * @param t Tâche à ajouter.
+ * @return 0 si la tâche a été ajoutée, 1 en cas d'erreur d'allocation.
+ * @author StegX Team
+ */
+static int deque_push(struct pool_deque *d, struct pool_task t)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->len == d->cap) {
+        size_t cap = d->cap ? d->cap * 2 : POOL_DEQUE_INIT;
+        struct pool_task *tasks = malloc(cap * sizeof(*tasks));
+        if (!tasks)
+            return pthread_mutex_unlock(&d->lock), perror("Pool: Can't grow task queue"), 1;
+        for (size_t i = 0; i < d->len; i++)
+            tasks[i] = d->tasks[(d->head + i) % d->cap];
+        free(d->tasks);
+        d->tasks = tasks, d->head = 0, d->cap = cap;
+    }
+    d->tasks[(d->head + d->len++) % d->cap] = t;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+/**
+ * @brief Prend une tâche dans une file.
+ * @param d File de tâches.
+ * @param t Tâche prise.
+ * @param steal Si non nul, prend la plus ancienne tâche (vol), sinon la plus
+ * récente.
+ * @return 1 si une tâche a été prise, 0 si la file est vide.
+ * @author StegX Team
+ */
+static int deque_pop(struct pool_deque *d, struct pool_task *t, int steal)
+{
+    pthread_mutex_lock(&d->lock);
+    int ok = d->len > 0;
+    if (ok && steal) {
+        *t = d->tasks[d->head];
+        d->head = (d->head + 1) % d->cap, d->len--;
+    } else if (ok)
+        *t = d->tasks[(d->head + --d->len) % d->cap];
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+/**
+ * @brief Boucle d'un thread du pool.
+ * @param arg Structure \r{pool_worker} du thread.
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *pool_run(void *arg)
+{
+    self = *(struct pool_worker *)arg;
+    pool_s *p = self.p;
+    struct pool_task t;
+    for (;;) {
+        /* Sa propre file d'abord, puis les tâches venant de l'extérieur dans
+         * leur ordre d'arrivée, puis vol dans la file des autres. */
+        int found = deque_pop(&p->deques[self.id], &t, 0) || deque_pop(&p->inject, &t, 1);
+        for (unsigned int i = 1; !found && i < p->nb; i++)
+            found = deque_pop(&p->deques[(self.id + i) % p->nb], &t, 1);
+
+        pthread_mutex_lock(&p->lock);
+        if (!found) {
+            /* Rien à voler : attente d'une nouvelle tâche ou de l'arrêt. */
+            if (p->stop && !p->queued)
+                break;
+            if (!p->queued)
+                pthread_cond_wait(&p->work, &p->lock);
+            pthread_mutex_unlock(&p->lock);
+            continue;
+        }
+        p->queued--;
+        pthread_mutex_unlock(&p->lock);
+
+        t.fn(t.arg);
+
+        pthread_mutex_lock(&p->lock);
+        if (!--p->pending)
+            pthread_cond_broadcast(&p->done);
+        pthread_mutex_unlock(&p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+pool_s *pool_create(unsigned int nb)
+{
+    if (!nb) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nb = n > 0 ? n : 1;
+    }
+    pool_s *p = calloc(1, sizeof(*p));
+    if (!p || !(p->threads = calloc(nb, sizeof(*p->threads)))
+        || !(p->workers = calloc(nb, sizeof(*p->workers)))
+        || !(p->deques = calloc(nb, sizeof(*p->deques)))) {
+        if (p)
+            free(p->threads), free(p->workers);
+        return perror("Pool: Can't allocate memory"), free(p), NULL;
+    }
+    p->nb = nb;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->done, NULL);
+    for (unsigned int i = 0; i < nb; i++)
+        pthread_mutex_init(&p->deques[i].lock, NULL);
+    pthread_mutex_init(&p->inject.lock, NULL);
+
+    unsigned int started = 0;
+    for (; started < nb; started++) {
+        p->workers[started] = (struct pool_worker) {.p = p,.id = started };
+        if (pthread_create(&p->threads[started], NULL, pool_run, &p->workers[started]))
+            break;
+    }
+    if (started < nb) {
+        perror("Pool: Can't create thread");
+        p->nb = started;
+        return pool_destroy(p), NULL;
+    }
+    return p;
+}
+
+unsigned int pool_size(const pool_s * p)
+{
+    return p->nb;
+}
+
+int pool_submit(pool_s * p, pool_fn fn, void *arg)
+{
+    assert(p && fn);
+    /* Depuis une tâche : sa propre file (elle sera exécutée en priorité),
+     * sinon la file commune. L'ajout et le compteur "queued" sont faits sous
+     * le verrou : un thread qui prend la tâche aussitôt attend le verrou pour
+     * décompter, et un thread réveillé trouve toujours la tâche dans sa file. */
+    struct pool_deque *d = self.p == p ? &p->deques[self.id] : &p->inject;
+    pthread_mutex_lock(&p->lock);
+    int err = deque_push(d, (struct pool_task) {.fn = fn,.arg = arg });
+    if (!err)
+        p->queued++, p->pending++, pthread_cond_signal(&p->work);
+    pthread_mutex_unlock(&p->lock);
+    return err;
+}
+
+void pool_wait(pool_s * p)
+{
+    pthread_mutex_lock(&p->lock);
+    while (p->pending)
+        pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_destroy(pool_s * p)
+{
+    if (!p)
+        return;
+    pool_wait(p);
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+    for (unsigned int i = 0; i < p->nb; i++)
+        pthread_join(p->threads[i], NULL);
+    for (unsigned int i = 0; i < p->nb; i++) {
+        pthread_mutex_destroy(&p->deques[i].lock);
+        free(p->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&p->inject.lock);
+    free(p->inject.tasks);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work);
+    pthread_cond_destroy(&p->done);
+    free(p->deques), free(p->workers), free(p->threads), free(p);
+}
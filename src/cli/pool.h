@@ -0,0 +1,79 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file pool.h
+ * @brief Pool de threads avec vol de tâches.
+ * @details Chaque thread possède sa propre file de tâches : il prend la
+ * dernière tâche ajoutée à sa file et, quand elle est vide, vole la plus
+ * ancienne tâche de la file d'un autre thread. Les tâches soumises depuis
+ * l'extérieur du pool vont dans une file commune et sont prises dans leur
+ * ordre d'arrivée ; celles soumises par une tâche vont dans la file du thread
+ * qui l'exécute et sont prises en premier (la dernière ajoutée d'abord).
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+/** Type d'une fonction exécutée par le pool. */
+typedef void (*pool_fn) (void *arg);
+
+/** Type du pool de threads (structure opaque). */
+typedef struct pool pool_s;
+
+/**
+ * @brief Crée un pool de threads.
+ * @param nb Nombre de threads (0 pour le nombre de coeurs disponibles).
+ * @return Pool créé, NULL en cas d'erreur.
+ * @author StegX Team
+ */
+pool_s *pool_create(unsigned int nb);
+
+/**
+ * @brief Renvoie le nombre de threads du pool.
+ * @param p Pool de threads.
+ * @return Nombre de threads.
+ * @author StegX Team
+ */
+unsigned int pool_size(const pool_s * p);
+
+/**
+ * @brief Soumet une tâche au pool.
+ * @param p Pool de threads.
+ * @param fn Fonction à exécuter.
+ * @param arg Argument de la fonction.
+ * @return 0 si la tâche a été ajoutée, 1 sinon.
+ * @author StegX Team
+ */
+int pool_submit(pool_s * p, pool_fn fn, void *arg);
+
+/**
+ * @brief Attend la fin de toutes les tâches soumises.
+ * @param p Pool de threads.
+ * @author StegX Team
+ */
+void pool_wait(pool_s * p);
+
+/**
+ * @brief Attend la fin des tâches puis détruit le pool.
+ * @param p Pool de threads.
+ * @author StegX Team
+ */
+void pool_destroy(pool_s * p);
+
+#endif
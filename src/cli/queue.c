@@ -0,0 +1,129 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file queue.c
+ * @brief File bornée sans verrou entre les étages d'un pipeline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <semaphore.h>
+
+#include "queue.h"
+
+/**
+ * @brief Case de la file.
+ * @details La case d'indice i peut être remplie pour la position "pos" quand
+ * "seq == pos", et vidée quand "seq == pos + 1".
+ */
+struct queue_cell {
+    atomic_size_t seq;          /*!< Numéro de séquence de la case. */
+    void *data;                 /*!< Élément contenu. */
+};
+
+/**
+ * @brief File bornée.
+ */
+struct queue {
+    size_t mask;                /*!< Capacité - 1 (capacité puissance de 2). */
+    struct queue_cell *cells;   /*!< Cases de la file. */
+    _Alignas(64) atomic_size_t tail;    /*!< Prochaine position à remplir. */
+    _Alignas(64) atomic_size_t head;    /*!< Prochaine position à vider. */
+    sem_t items;                /*!< Nombre de cases pleines. */
+    sem_t slots;                /*!< Nombre de cases libres. */
+};
+
+queue_s *queue_create(size_t cap)
+{
+    size_t n = 2;
+    while (n < cap)
+        n <<= 1;
+    queue_s *q = aligned_alloc(64, (sizeof(*q) + 63) / 64 * 64);
+    if (!q || !(q->cells = malloc(n * sizeof(*q->cells))))
+        return perror("Queue: Can't allocate memory"), free(q), NULL;
+    q->mask = n - 1;
+    for (size_t i = 0; i < n; i++)
+        atomic_init(&q->cells[i].seq, i);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->head, 0);
+    sem_init(&q->items, 0, 0);
+    sem_init(&q->slots, 0, n);
+    return q;
+}
+
+void queue_push(queue_s * q, void *data)
+{
+    while (sem_wait(&q->slots));
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    struct queue_cell *c;
+    for (;;) {
+        c = &q->cells[pos & q->mask];
+        intptr_t dif = (intptr_t)atomic_load_explicit(&c->seq, memory_order_acquire) - (intptr_t)pos;
+        if (!dif && atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                          memory_order_relaxed,
+                                                          memory_order_relaxed))
+            break;
+        /* Case encore occupée par un consommateur en retard : on réessaie. */
+        if (dif < 0)
+            sched_yield(), pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        else if (dif > 0)
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    }
+    c->data = data;
+    atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+    sem_post(&q->items);
+}
+
+void *queue_pop(queue_s * q)
+{
+    while (sem_wait(&q->items));
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    struct queue_cell *c;
+    for (;;) {
+        c = &q->cells[pos & q->mask];
+        intptr_t dif =
+            (intptr_t)atomic_load_explicit(&c->seq, memory_order_acquire) - (intptr_t)(pos + 1);
+        if (!dif && atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                          memory_order_relaxed,
+                                                          memory_order_relaxed))
+            break;
+        /* Case pas encore publiée par un producteur en retard : on réessaie. */
+        if (dif < 0)
+            sched_yield(), pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        else if (dif > 0)
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    }
+    void *data = c->data;
+    atomic_store_explicit(&c->seq, pos + q->mask + 1, memory_order_release);
+    sem_post(&q->slots);
+    return data;
+}
+
+void queue_destroy(queue_s * q)
+{
+    if (!q)
+        return;
+    sem_destroy(&q->items);
+    sem_destroy(&q->slots);
+    free(q->cells);
+    free(q);
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file queue.h
+ * @brief File bornée sans verrou entre les étages d'un pipeline.
+ * @details File circulaire multi-producteurs multi-consommateurs de D. Vyukov :
+ * chaque case porte un numéro de séquence qui indique si elle peut être
+ * remplie ou vidée, les indices de début et de fin sont avancés par
+ * compare-and-swap. Deux sémaphores comptent les cases pleines et vides pour
+ * endormir les producteurs quand la file est pleine et les consommateurs
+ * quand elle est vide.
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+
+/** Type de la file (structure opaque). */
+typedef struct queue queue_s;
+
+/**
+ * @brief Crée une file.
+ * @param cap Capacité minimale (arrondie à la puissance de 2 supérieure).
+ * @return File créée, NULL en cas d'erreur.
+ * @author StegX Team
+ */
+queue_s *queue_create(size_t cap);
+
+/**
+ * @brief Ajoute un élément en fin de file, en attendant une case libre.
+ * @param q File.
+ * @param data Élément à ajouter.
+ * @author StegX Team
+ */
+void queue_push(queue_s * q, void *data);
+
+/**
+ * @brief Retire l'élément en début de file, en attendant qu'il y en ait un.
+ * @param q File.
+ * @return Élément retiré.
+ * @author StegX Team
+ */
+void *queue_pop(queue_s * q);
+
+/**
+ * @brief Détruit une file.
+ * @param q File (doit être vide et sans utilisateur).
+ * @author StegX Team
+ */
+void queue_destroy(queue_s * q);
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stegx_batch.c
+ * @brief Programme "stegx-batch" : insertions et extractions en lot.
+ * @details Lit un manifeste contenant un travail par ligne et exécute les
+ * travaux sur un pool de threads avec vol de tâches (un thread par coeur par
+ * défaut). Chaque travail est une suite classique \r{stegx_init},
+ * \r{stegx_check_compatibility}, ..., \r{stegx_clear} exécutée dans un thread.
+ * Avec l'option -p, les travaux sont exécutés en pipeline (voir
+ * \r{pipeline_run}).
+ * 
+ * Format du manifeste (champs séparés par des tabulations, les lignes vides et
+ * commençant par '#' sont ignorées) :
+ * 
+ *     insert  <hôte>  <fichier à cacher>  <fichier résultat>  <algo>  [mot de passe]
+ *     extract <hôte>  <dossier résultat>  [mot de passe]
+ * 
+ * L'algorithme est "lsb", "eof", "metadata", "eoc", "junk_chunk" ou "auto" (le
+ * premier algorithme proposé). Pour chaque travail terminé, une ligne est
+ * écrite sur la sortie standard :
+ * 
+ *     <ligne>  <mode>  <hôte>  <ok|error>  <code>  <message>  <durée en ms>
+ * 
+ * Sur SIGINT ou SIGTERM, les travaux en cours sont annulés à leur prochaine
+ * vérification et les suivants échouent aussitôt avec \r{ERR_CANCELED} : leurs
+ * fichiers résultats sont supprimés.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "stegx.h"
+#include "pool.h"
+#include "batch.h"
+
+/** Noms des algorithmes dans le manifeste (dans l'ordre de \r{algo_e}). */
+static const char *algo_names[STEGX_NB_ALGO] = { "lsb", "eof", "metadata", "eoc", "junk_chunk" };
+
+/** Verrou de la sortie standard (une ligne par travail). */
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Durée maximale d'un travail en millisecondes (0 si aucune). */
+static unsigned long timeout_ms;
+
+/** Mis à 1 par SIGINT et SIGTERM : les travaux sont annulés. */
+static atomic_int stop;
+
+/**
+ * @brief Suivi de progression des travaux : annule tout après un signal.
+ * @return 1 si le programme doit s'arrêter, 0 sinon.
+ * @author StegX Team
+ */
+static int job_progress(void *data, stage_e stage, uint64_t done, uint64_t total)
+{
+    (void)data, (void)stage, (void)done, (void)total;
+    return stop;
+}
+
+enum err_code job_exec(struct job *j, info_s ** ctx, stegx_host_s * host, FILE * hidden,
+                       FILE * res)
+{
+    stegx_info_insert_s insert_info = {.hidden_path = j->hidden,.algo = j->algo,
+        .hidden_file = hidden
+    };
+    stegx_choices_s choices = {.host_path = j->host,.res_path = j->res,.passwd = j->passwd,
+        .mode = j->mode,.insert_info = j->mode == STEGX_MODE_INSERT ? &insert_info : NULL,
+        .flags = j->flags,.host = host,.res_file = res,.progress = job_progress
+    };
+    /* Échéance comptée depuis le début du travail. */
+    if (timeout_ms) {
+        choices.deadline.tv_sec = j->start.tv_sec + timeout_ms / 1000;
+        choices.deadline.tv_nsec = j->start.tv_nsec + (timeout_ms % 1000) * 1000000;
+        if (choices.deadline.tv_nsec >= 1000000000)
+            choices.deadline.tv_sec++, choices.deadline.tv_nsec -= 1000000000;
+    }
+    stegx_errno = ERR_NONE;
+    info_s *infos = ctx && *ctx ? *ctx : stegx_init(&choices);
+    int err = !infos;
+    if (ctx && *ctx && stegx_reset(infos, &choices)) {
+        /* Les fichiers déjà confiés à la structure sont fermés avec elle. */
+        stegx_clear(infos);
+        infos = *ctx = NULL, err = 1;
+    } else if (err) {
+        /* Les fichiers n'ont pas été confiés à une structure libérable. */
+        if (hidden)
+            fclose(hidden);
+        if (res)
+            fclose(res);
+    } else if (j->mode == STEGX_MODE_INSERT) {
+        err = stegx_check_compatibility(infos) || stegx_suggest_algo(infos);
+        /* "auto" : premier algorithme proposé pour cet hôte. */
+        algo_e algo = j->algo;
+        for (algo_e i = 0; !err && algo == ALGO_AUTO && i < STEGX_NB_ALGO; i++)
+            algo = stegx_propos_algos[i] ? i : algo;
+        if (!err && algo == ALGO_AUTO)
+            stegx_errno = ERR_CHOICE_ALGO, err = 1;
+        err = err || stegx_choose_algo(infos, algo) || stegx_insert(infos);
+    } else
+        err = stegx_check_compatibility(infos) || stegx_detect_algo(infos)
+            || stegx_extract(infos, j->res);
+    if (infos && ctx)
+        stegx_reset(*ctx = infos, NULL);
+    else if (infos)
+        stegx_clear(infos);
+    return j->err = err ? (stegx_errno != ERR_NONE ? stegx_errno : ERR_OTHER) : ERR_NONE;
+}
+
+void job_report(struct job *j)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    double ms = (t.tv_sec - j->start.tv_sec) * 1e3 + (t.tv_nsec - j->start.tv_nsec) / 1e6;
+    pthread_mutex_lock(&out_lock);
+    printf("%u\t%s\t%s\t%s\t%d\t%s\t%.3f\n", j->line,
+           j->mode == STEGX_MODE_INSERT ? "insert" : "extract", j->host,
+           j->err ? "error" : "ok", j->err, stegx_strerror(j->err), ms);
+    fflush(stdout);
+    pthread_mutex_unlock(&out_lock);
+}
+
+/**
+ * @brief Exécute un travail du manifeste sur le pool de threads.
+ * @param arg Travail (\r{job}) à exécuter.
+ * @author StegX Team
+ */
+static void job_run(void *arg)
+{
+    struct job *j = arg;
+    clock_gettime(CLOCK_MONOTONIC, &j->start);
+    job_exec(j, NULL, NULL, NULL, NULL);
+    job_report(j);
+}
+
+/**
+ * @brief Découpe une ligne du manifeste en champs séparés par des tabulations.
+ * @param line Ligne à découper (modifiée).
+ * @param fields Tableau des champs.
+ * @param max Nombre maximum de champs.
+ * @return Nombre de champs lus.
+ * @author StegX Team
+ */
+static int split_fields(char *line, char **fields, int max)
+{
+    int n = 0;
+    line[strcspn(line, "\r\n")] = '\0';
+    for (char *save = NULL, *f = strtok_r(line, "\t", &save); f && n < max;
+         f = strtok_r(NULL, "\t", &save))
+        fields[n++] = f;
+    return n;
+}
+
+/**
+ * @brief Lit un travail depuis une ligne du manifeste.
+ * @param j Travail à remplir.
+ * @param line Ligne du manifeste (modifiée).
+ * @return 0 si la ligne est un travail valide, 1 si elle est ignorée (vide ou
+ * commentaire), -1 si elle est invalide.
+ * @author StegX Team
+ */
+static int job_parse(struct job *j, char *line)
+{
+    char *f[6];
+    if (line[0] == '#' || !line[strspn(line, " \t\r\n")])
+        return 1;
+    int n = split_fields(line, f, 6);
+    if (n >= 5 && !strcmp(f[0], "insert")) {
+        j->mode = STEGX_MODE_INSERT;
+        j->algo = ALGO_AUTO + 1;
+        for (algo_e i = 0; i < STEGX_NB_ALGO; i++)
+            j->algo = !strcmp(f[4], algo_names[i]) ? i : j->algo;
+        j->algo = !strcmp(f[4], "auto") ? ALGO_AUTO : j->algo;
+        if (j->algo > ALGO_AUTO)
+            return -1;
+        j->hidden = strdup(f[2]), j->res = strdup(f[3]);
+        j->passwd = n > 5 ? strdup(f[5]) : NULL;
+    } else if (n >= 3 && !strcmp(f[0], "extract")) {
+        j->mode = STEGX_MODE_EXTRACT;
+        j->res = strdup(f[2]);
+        j->passwd = n > 3 ? strdup(f[3]) : NULL;
+    } else
+        return -1;
+    j->host = strdup(f[1]);
+    return 0;
+}
+
+/**
+ * @brief Gestionnaire de SIGINT et SIGTERM.
+ * @author StegX Team
+ */
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+/**
+ * @brief Affiche l'aide du programme.
+ * @param prog Nom du programme.
+ * @author StegX Team
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage : %s [-j threads] [-p] [-i] [-c cache[:budget]] [-t ms] manifeste\n"
+            "  -j threads  nombre de threads (défaut : nombre de coeurs)\n"
+            "  -p          exécution en pipeline (lecture, calcul et écriture séparés,\n"
+            "              travaux regroupés par hôte)\n"
+            "  -i          utilise l'index d'analyse des hôtes (<hôte>.stegxidx)\n"
+            "  -c cache    lit les hôtes depuis le cache partagé \"cache\" (budget en octets,\n"
+            "              défaut : 1 Gio)\n"
+            "  -t ms       durée maximale d'un travail, annulé au-delà (défaut : aucune)\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int nb_threads = 0, flags = 0;
+    int pipeline = 0;
+    char *cache = NULL;
+    for (int opt; (opt = getopt(argc, argv, "j:pic:t:h")) != -1;) {
+        if (opt == 'j')
+            nb_threads = strtoul(optarg, NULL, 10);
+        else if (opt == 'p')
+            pipeline = 1;
+        else if (opt == 'i')
+            flags |= STEGX_FLAG_INDEX;
+        else if (opt == 'c')
+            cache = optarg, flags |= STEGX_FLAG_CACHE;
+        else if (opt == 't')
+            timeout_ms = strtoul(optarg, NULL, 10);
+        else
+            return usage(argv[0]), opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (optind != argc - 1)
+        return usage(argv[0]), EXIT_FAILURE;
+
+    /* Ouverture du cache partagé : "nom" ou "nom:budget". */
+    if (cache) {
+        char *budget = strchr(cache, ':');
+        if (budget)
+            *budget++ = '\0';
+        if (stegx_cache_open(cache, budget ? strtoull(budget, NULL, 10) : 1ULL << 30))
+            return err_print(stegx_errno), EXIT_FAILURE;
+    }
+
+    /* Lecture du manifeste. */
+    FILE *m = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+    if (!m)
+        return perror(argv[optind]), EXIT_FAILURE;
+    struct job *jobs = NULL;
+    size_t nb = 0, max = 0;
+    char *line = NULL;
+    size_t len = 0;
+    for (unsigned int l = 1; getline(&line, &len, m) != -1; l++) {
+        if (nb == max) {
+            max = max ? max * 2 : 64;
+            struct job *tmp = realloc(jobs, max * sizeof(*jobs));
+            if (!tmp)
+                return perror("Can't allocate memory for jobs"), EXIT_FAILURE;
+            jobs = tmp;
+        }
+        memset(&jobs[nb], 0, sizeof(*jobs));
+        int r = job_parse(&jobs[nb], line);
+        if (r < 0)
+            fprintf(stderr, "%s:%u: ligne invalide ignorée\n", argv[optind], l);
+        if (r)
+            continue;
+        jobs[nb].line = l, jobs[nb].flags = flags;
+        nb++;
+    }
+    free(line);
+    if (m != stdin)
+        fclose(m);
+
+    /* Exécution en pipeline ou sur le pool. */
+    struct sigaction sa = {.sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (pipeline && pipeline_run(jobs, nb, nb_threads))
+        return EXIT_FAILURE;
+    if (!pipeline) {
+        pool_s *pool = pool_create(nb_threads);
+        if (!pool)
+            return EXIT_FAILURE;
+        for (size_t i = 0; i < nb; i++)
+            if (pool_submit(pool, job_run, &jobs[i]))
+                jobs[i].err = ERR_OTHER;
+        pool_destroy(pool);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    /* Bilan. */
+    size_t nb_err = 0;
+    for (size_t i = 0; i < nb; i++) {
+        nb_err += jobs[i].err != ERR_NONE;
+        free(jobs[i].host), free(jobs[i].hidden), free(jobs[i].res), free(jobs[i].passwd);
+    }
+    free(jobs);
+    fprintf(stderr, "%zu travaux, %zu erreurs, %.3f ms\n", nb, nb_err,
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    if (cache)
+        stegx_cache_close(0);
+    return nb_err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
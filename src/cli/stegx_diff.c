@@ -0,0 +1,137 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stegx_diff.c
+ * @brief Programme "stegx-diff" : comparaison d'une copie diffusée avec son
+ * original.
+ * @details Écrit le résultat de la comparaison (\r{stegx_diff}) sur la sortie
+ * standard, une information par ligne, puis les zones de différence :
+ *
+ *     <nature>  <offset suspect>  <offset original>  <taille>
+ *
+ * Les données cachées sont écrites dans le fichier donné avec -o, et
+ * l'utilisateur est cherché dans le registre des empreintes donné avec -r,
+ * avec le mot de passe s'il est connu ou en essayant toutes les clés sinon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stegx.h"
+
+/** Nombre de zones écrites par défaut. */
+#define DIFF_REGIONS 16
+
+/** Noms des algorithmes (dans l'ordre de \r{algo_e}). */
+static const char *algo_names[STEGX_NB_ALGO + 1] = { "lsb", "eof", "metadata", "eoc", "junk_chunk", "-" };
+
+/** Noms des natures de zone (dans l'ordre de \r{diff_kind_e}). */
+static const char *kind_names[] = { "modified", "inserted", "removed" };
+
+/**
+ * @brief Écrit le résultat d'une comparaison.
+ * @param info Résultat de la comparaison.
+ * @param max Nombre maximal de zones écrites.
+ * @author StegX Team
+ */
+static void report(const stegx_diff_info_s * info, size_t max)
+{
+    printf("original\t%" PRIu64 "\n" "suspect\t%" PRIu64 "\n", info->orig_size, info->suspect_size);
+    printf("modified\t%" PRIu64 "\n" "lsb\t%" PRIu64 "\n", info->nb_modified, info->nb_lsb);
+    printf("inserted\t%" PRIu64 "\n" "removed\t%" PRIu64 "\n", info->nb_inserted, info->nb_removed);
+    printf("algo\t%s\n" "signature\t%s\n" "length\t%" PRIu32 "\n", algo_names[info->algo],
+           info->signature ? "present" : "stripped", info->hidden_length);
+    printf("regions\t%zu\n", info->nb_regions);
+    for (size_t k = 0; k < info->nb_regions && k < max; k++)
+        printf("%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n", kind_names[info->regions[k].kind],
+               info->regions[k].offset, info->regions[k].orig_offset, info->regions[k].length);
+    if (info->nb_regions > max)
+        printf("...\n");
+}
+
+/**
+ * @brief Affiche l'aide du programme.
+ * @param prog Nom du programme.
+ * @author StegX Team
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage : %s [-k mot de passe] [-o sortie] [-r registre] [-a] original suspect\n"
+            "  -k mot de passe   mot de passe de l'insertion\n"
+            "  -o sortie         fichier recevant les données cachées\n"
+            "  -r registre       registre des empreintes où chercher l'utilisateur\n"
+            "  -a                écrit toutes les zones de différence\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *passwd = NULL, *out = NULL, *registry_path = NULL;
+    size_t max = DIFF_REGIONS;
+    for (int opt; (opt = getopt(argc, argv, "k:o:r:ah")) != -1;) {
+        if (opt == 'k')
+            passwd = optarg;
+        else if (opt == 'o')
+            out = optarg;
+        else if (opt == 'r')
+            registry_path = optarg;
+        else if (opt == 'a')
+            max = SIZE_MAX;
+        else
+            return usage(argv[0]), opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (optind != argc - 2)
+        return usage(argv[0]), EXIT_FAILURE;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    stegx_diff_s *d = stegx_diff(argv[optind], argv[optind + 1]);
+    if (!d)
+        return err_print(stegx_errno), EXIT_FAILURE;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    report(stegx_diff_info(d), max);
+    fprintf(stderr, "comparaison : %.3f ms\n",
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+    int err = 0;
+    if (out) {
+        FILE *res = fopen(out, "wb");
+        if (!res)
+            perror(out), err = 1;
+        else if (stegx_diff_extract(d, passwd, res))
+            err_print(stegx_errno), err = 1;
+    }
+    if (registry_path) {
+        stegx_registry_s *r = stegx_registry_open(registry_path);
+        stegx_identity_s id;
+        unsigned int key = 0;
+        if (!r)
+            err_print(stegx_errno), err = 1;
+        else if (stegx_diff_identify(d, passwd, r, &id, &key))
+            err_print(stegx_errno), err = 1;
+        else
+            printf("user\t%s\t%" PRId64 "\t%s\t%u\n", id.user, id.issued, id.host, key);
+        stegx_registry_close(r);
+    }
+    stegx_diff_close(d);
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stegx_registry.c
+ * @brief Programme "stegx-registry" : construction et interrogation d'un
+ * registre des empreintes.
+ * @details Le registre associe les jetons cachés pour chaque utilisateur à
+ * leur identité (\r{stegx_registry_build}). Il est construit à partir d'un
+ * fichier contenant un jeton par ligne (champs séparés par des tabulations,
+ * les lignes vides et commençant par '#' sont ignorées) :
+ *
+ *     <jeton>  <utilisateur>  <date de délivrance (secondes)>  <hôte>
+ *
+ * L'interrogation écrit une ligne par jeton, au même format, avec "-" à la
+ * place de l'identité d'un jeton inconnu.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "stegx.h"
+
+/**
+ * @brief Construit un registre.
+ * @param path Chemin du registre.
+ * @param src Chemin du fichier des jetons ("-" pour l'entrée standard).
+ * @return 0 si le registre a été écrit, 1 sinon.
+ * @author StegX Team
+ */
+static int build(const char *path, const char *src)
+{
+    FILE *f = strcmp(src, "-") ? fopen(src, "r") : stdin;
+    if (!f)
+        return perror(src), 1;
+    stegx_token_s *tokens = NULL;
+    size_t nb = 0, max = 0, len = 0;
+    char *line = NULL;
+    int err = 0;
+    for (unsigned int l = 1; !err && getline(&line, &len, f) != -1; l++) {
+        char *fields[4], *save = NULL;
+        int n = 0;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || !line[0])
+            continue;
+        for (char *c = strtok_r(line, "\t", &save); c && n < 4; c = strtok_r(NULL, "\t", &save))
+            fields[n++] = c;
+        if (n != 4) {
+            fprintf(stderr, "%s:%u: ligne invalide ignorée\n", src, l);
+            continue;
+        }
+        if (nb == max) {
+            max = max ? max * 2 : 1024;
+            stegx_token_s *tmp = realloc(tokens, max * sizeof(*tokens));
+            if (!tmp) {
+                perror("Can't allocate memory for tokens");
+                err = 1;
+                break;
+            }
+            tokens = tmp;
+        }
+        /* Les champs pointent dans une copie de la ligne, libérée à la fin. */
+        char *copy = malloc(strlen(fields[0]) + strlen(fields[1]) + strlen(fields[3]) + 3);
+        if (!copy) {
+            perror("Can't allocate memory for tokens");
+            err = 1;
+            break;
+        }
+        char *user = stpcpy(copy, fields[0]) + 1, *host = stpcpy(user, fields[1]) + 1;
+        strcpy(host, fields[3]);
+        tokens[nb++] = (stegx_token_s) {.token = copy,.len = strlen(copy),
+            .id = {.user = user,.host = host,.issued = strtoll(fields[2], NULL, 10)}
+        };
+    }
+    free(line);
+    if (f != stdin)
+        fclose(f);
+    if (!err && stegx_registry_build(path, tokens, nb))
+        err_print(stegx_errno), err = 1;
+    for (size_t i = 0; i < nb; i++)
+        free((void *)tokens[i].token);
+    free(tokens);
+    if (!err)
+        fprintf(stderr, "%zu jetons\n", nb);
+    return err;
+}
+
+/**
+ * @brief Écrit l'identité d'un jeton.
+ * @param r Registre ouvert.
+ * @param token Jeton à chercher.
+ * @return 0 si le jeton a été trouvé, 1 sinon.
+ * @author StegX Team
+ */
+static int lookup(const stegx_registry_s * r, const char *token)
+{
+    stegx_identity_s id;
+    if (stegx_registry_lookup(r, token, strlen(token), &id))
+        return printf("%s\t-\n", token), 1;
+    printf("%s\t%s\t%" PRId64 "\t%s\n", token, id.user, id.issued, id.host);
+    return 0;
+}
+
+/**
+ * @brief Affiche l'aide du programme.
+ * @param prog Nom du programme.
+ * @author StegX Team
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage : %s build registre jetons\n"
+            "        %s lookup registre [jeton...]\n"
+            "  build   construit le registre à partir du fichier des jetons (\"-\" pour\n"
+            "          l'entrée standard)\n"
+            "  lookup  cherche les jetons donnés, ou lus sur l'entrée standard (un par\n"
+            "          ligne)\n", prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 4 && !strcmp(argv[1], "build"))
+        return build(argv[2], argv[3]) ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (argc < 3 || strcmp(argv[1], "lookup"))
+        return usage(argv[0]), EXIT_FAILURE;
+
+    stegx_registry_s *r = stegx_registry_open(argv[2]);
+    if (!r)
+        return err_print(stegx_errno), EXIT_FAILURE;
+    int missing = 0;
+    for (int i = 3; i < argc; i++)
+        missing |= lookup(r, argv[i]);
+    if (argc == 3) {
+        char *line = NULL;
+        size_t len = 0;
+        while (getline(&line, &len, stdin) != -1) {
+            line[strcspn(line, "\r\n")] = '\0';
+            missing |= lookup(r, line);
+        }
+        free(line);
+    }
+    stegx_registry_close(r);
+    return missing ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,392 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stegx_scan.c
+ * @brief Programme "stegx-scan" : recherche de données cachées dans une
+ * arborescence.
+ * @details Parcourt les dossiers donnés sur un pool de threads : chaque
+ * dossier est une tâche qui soumet ses sous-dossiers et ses fichiers. Chaque
+ * fichier est d'abord sondé (\r{stegx_probe}, deux blocs lus) et seuls les
+ * fichiers suspects passent par la suite \r{stegx_init},
+ * \r{stegx_check_compatibility}, \r{stegx_detect_algo}, \r{stegx_extract},
+ * les données extraites restant en mémoire. Le travail étant surtout fait
+ * d'attentes du disque, le pool a par défaut 4 threads par coeur.
+ *
+ * Le rapport est un tableau JSON écrit sur la sortie standard, avec un objet
+ * par fichier contenant des données cachées :
+ *
+ *     {"path": "...", "algo": "eof", "name": "...", "length": 42, "payload": "<base64>"}
+ *
+ * "payload" vaut null si les données dépassent la taille maximale choisie. Avec
+ * un registre des empreintes (-r), les données sont cherchées dans le registre
+ * pendant l'extraction et l'objet contient aussi "user", "issued" et
+ * "host_id" quand elles y sont trouvées. Un
+ * fichier dont l'extraction échoue après la détection d'une signature (mot de
+ * passe absent ou incorrect par exemple) donne un objet avec "error" (code de
+ * \r{err_code}) et "message", et "algo" si le sondage l'a trouvé. Le bilan
+ * est écrit sur la sortie d'erreur.
+ *
+ * Avec -p, les fichiers sont seulement sondés (aucune extraction) et le
+ * rapport contient un objet par fichier suspect :
+ *
+ *     {"path": "...", "format": "png", "algo": "eof", "confirmed": false, "length": null}
+ *
+ * "algo" vaut null s'il est inconnu, "confirmed" indique que la signature a
+ * été lue et "length" n'est donné que dans ce cas.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "stegx.h"
+#include "pool.h"
+
+/** Taille maximale par défaut des données écrites dans le rapport. */
+#define SCAN_PAYLOAD_MAX (64 * 1024)
+
+/** Noms des algorithmes dans le rapport (dans l'ordre de \r{algo_e}). */
+static const char *algo_names[STEGX_NB_ALGO] = { "lsb", "eof", "metadata", "eoc", "junk_chunk" };
+
+/** Pool de threads du parcours. */
+static pool_s *pool;
+
+/** Mot de passe essayé sur les fichiers (NULL si aucun). */
+static const char *passwd;
+
+/** Taille maximale des données écrites dans le rapport. */
+static size_t payload_max = SCAN_PAYLOAD_MAX;
+
+/** Registre des empreintes (NULL si aucun). */
+static stegx_registry_s *registry;
+
+/** Extrait tous les fichiers, sans les sonder. */
+static int no_probe;
+
+/** Sonde seulement les fichiers, sans les extraire. */
+static int probe_only;
+
+/** Verrou de la sortie standard (un objet JSON par fichier). */
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Nombre d'objets déjà écrits dans le rapport. */
+static size_t nb_out;
+
+/** Compteurs du bilan : fichiers, fichiers suspects, fichiers avec données. */
+static atomic_size_t nb_files, nb_suspects, nb_found;
+
+/** Mis à 1 par SIGINT et SIGTERM : le parcours s'arrête. */
+static atomic_int stop;
+
+/**
+ * @brief Suivi de progression des extractions : annule tout après un signal.
+ * @return 1 si le programme doit s'arrêter, 0 sinon.
+ * @author StegX Team
+ */
+static int scan_progress(void *data, stage_e stage, uint64_t done, uint64_t total)
+{
+    (void)data, (void)stage, (void)done, (void)total;
+    return stop;
+}
+
+/**
+ * @brief Écrit une chaîne JSON (guillemets et échappements compris).
+ * @param out Flux de sortie.
+ * @param s Chaîne à écrire.
+ * @author StegX Team
+ */
+static void json_str(FILE * out, const char *s)
+{
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)s; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            fprintf(out, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(out, "\\u%04x", *c);
+        else
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * @brief Écrit des données en base64 entre guillemets.
+ * @param out Flux de sortie.
+ * @param d Données à écrire.
+ * @param n Taille des données.
+ * @author StegX Team
+ */
+static void json_base64(FILE * out, const unsigned char *d, size_t n)
+{
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    fputc('"', out);
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = d[i] << 16 | (i + 1 < n ? d[i + 1] << 8 : 0) | (i + 2 < n ? d[i + 2] : 0);
+        fputc(b64[v >> 18 & 0x3F], out), fputc(b64[v >> 12 & 0x3F], out);
+        fputc(i + 1 < n ? b64[v >> 6 & 0x3F] : '=', out);
+        fputc(i + 2 < n ? b64[v & 0x3F] : '=', out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * @brief Commence un objet du rapport (verrou de la sortie pris).
+ * @param path Chemin du fichier.
+ * @author StegX Team
+ */
+static void report_begin(const char *path)
+{
+    pthread_mutex_lock(&out_lock);
+    fputs(nb_out++ ? ",\n  {\"path\": " : "  {\"path\": ", stdout);
+    json_str(stdout, path);
+}
+
+/**
+ * @brief Termine un objet du rapport (verrou de la sortie rendu).
+ * @author StegX Team
+ */
+static void report_end(void)
+{
+    fputc('}', stdout);
+    pthread_mutex_unlock(&out_lock);
+}
+
+/**
+ * @brief Ajoute le résultat du sondage d'un fichier suspect au rapport.
+ * @param path Chemin du fichier.
+ * @param pr Résultat du sondage.
+ * @author StegX Team
+ */
+static void scan_report_probe(const char *path, const stegx_probe_s * pr)
+{
+    report_begin(path);
+    fputs(", \"format\": ", stdout);
+    pr->format ? json_str(stdout, pr->format) : (void)fputs("null", stdout);
+    fputs(", \"algo\": ", stdout);
+    pr->algo < STEGX_NB_ALGO ? printf("\"%s\"", algo_names[pr->algo]) : fputs("null", stdout);
+    printf(", \"confirmed\": %s, \"length\": ", pr->confirmed ? "true" : "false");
+    pr->confirmed ? printf("%" PRIu32, pr->hidden_length) : fputs("null", stdout);
+    report_end();
+}
+
+/**
+ * @brief Extrait les données cachées d'un fichier suspect et les ajoute au
+ * rapport.
+ * @param path Chemin du fichier.
+ * @param pr Résultat du sondage (algorithme signalé en cas d'échec).
+ * @author StegX Team
+ */
+static void scan_extract(const char *path, const stegx_probe_s * pr)
+{
+    char *data = NULL;
+    size_t len = 0;
+    FILE *res = open_memstream(&data, &len);
+    if (!res)
+        return perror("Can't open memory stream for extracted data");
+    stegx_choices_s choices = {.host_path = (char *)path,.res_path = "",.passwd = (char *)passwd,
+        .mode = STEGX_MODE_EXTRACT,.res_file = res,.progress = scan_progress,.registry = registry
+    };
+    stegx_errno = ERR_NONE;
+    info_s *infos = stegx_init(&choices);
+    if (!infos) {
+        fclose(res), free(data);
+        return;
+    }
+    /* Sans signature, le fichier était un faux positif du sondage : rien à
+     * signaler. Avec une signature, tout échec est signalé. */
+    int err = stegx_check_compatibility(infos) || stegx_detect_algo(infos);
+    int found = !err || stegx_errno == ERR_NEED_PASSWD;
+    err = err || stegx_extract(infos, "");
+    enum err_code code = stegx_errno;
+    algo_e algo = err ? STEGX_NB_ALGO : stegx_detected_algo(infos);
+    char *name = err ? NULL : strdup(stegx_hidden_name(infos));
+    stegx_identity_s id;
+    int identified = !err && !stegx_identity(infos, &id);
+    stegx_clear(infos);
+    if (found) {
+        nb_found++;
+        report_begin(path);
+        if (err) {
+            printf(", \"error\": %d, \"message\": ", code), json_str(stdout, stegx_strerror(code));
+            if (pr->algo < STEGX_NB_ALGO)
+                printf(", \"algo\": \"%s\"", algo_names[pr->algo]);
+        } else {
+            printf(", \"algo\": \"%s\", \"name\": ", algo_names[algo]);
+            json_str(stdout, name ? name : "");
+            printf(", \"length\": %zu, \"payload\": ", len);
+            if (len <= payload_max)
+                json_base64(stdout, (unsigned char *)data, len);
+            else
+                fputs("null", stdout);
+            if (identified) {
+                fputs(", \"user\": ", stdout), json_str(stdout, id.user);
+                printf(", \"issued\": %" PRId64 ", \"host_id\": ", id.issued);
+                json_str(stdout, id.host);
+            }
+        }
+        report_end();
+    }
+    free(name), free(data);
+}
+
+/**
+ * @brief Sonde un fichier et l'extrait s'il est suspect.
+ * @param arg Chemin du fichier (libéré).
+ * @author StegX Team
+ */
+static void file_run(void *arg)
+{
+    char *path = arg;
+    if (!stop) {
+        nb_files++;
+        stegx_probe_s pr = {.algo = STEGX_NB_ALGO };
+        int r = no_probe ? 1 : stegx_probe(path, &pr);
+        if (r < 0)
+            fprintf(stderr, "%s: %s\n", path, stegx_strerror(stegx_errno));
+        else if (r) {
+            nb_suspects++;
+            probe_only ? scan_report_probe(path, &pr) : scan_extract(path, &pr);
+        }
+    }
+    free(path);
+}
+
+/**
+ * @brief Parcourt un dossier : soumet ses sous-dossiers et ses fichiers au
+ * pool.
+ * @param arg Chemin du dossier (libéré).
+ * @author StegX Team
+ */
+static void dir_run(void *arg)
+{
+    char *dir = arg;
+    DIR *d = stop ? NULL : opendir(dir);
+    if (!d && !stop)
+        perror(dir);
+    for (struct dirent * e; d && !stop && (e = readdir(d));) {
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+            continue;
+        char *path = NULL;
+        if (asprintf(&path, "%s/%s", dir, e->d_name) == -1) {
+            perror("Can't allocate memory for path");
+            break;
+        }
+        /* Les liens symboliques ne sont pas suivis. */
+        unsigned char type = e->d_type;
+        struct stat st;
+        if (type == DT_UNKNOWN && !lstat(path, &st))
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        if ((type != DT_DIR && type != DT_REG)
+            || pool_submit(pool, type == DT_DIR ? dir_run : file_run, path))
+            free(path);
+    }
+    if (d)
+        closedir(d);
+    free(dir);
+}
+
+/**
+ * @brief Gestionnaire de SIGINT et SIGTERM.
+ * @author StegX Team
+ */
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+/**
+ * @brief Affiche l'aide du programme.
+ * @param prog Nom du programme.
+ * @author StegX Team
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage : %s [-j threads] [-k mot de passe] [-m octets] [-r registre] [-a | -p] chemin...\n"
+            "  -j threads        nombre de threads (défaut : 4 par coeur)\n"
+            "  -k mot de passe   mot de passe essayé pour l'extraction\n"
+            "  -r registre       registre des empreintes où chercher les données extraites\n"
+            "  -m octets         taille maximale des données écrites dans le rapport\n"
+            "                    (défaut : %d)\n"
+            "  -a                extrait tous les fichiers, sans les sonder\n"
+            "  -p                sonde seulement les fichiers, sans les extraire\n", prog,
+            SCAN_PAYLOAD_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+    long nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int nb_threads = 4 * (nb_cores > 0 ? nb_cores : 1);
+    const char *registry_path = NULL;
+    for (int opt; (opt = getopt(argc, argv, "j:k:m:r:aph")) != -1;) {
+        if (opt == 'j')
+            nb_threads = strtoul(optarg, NULL, 10);
+        else if (opt == 'k')
+            passwd = optarg;
+        else if (opt == 'm')
+            payload_max = strtoull(optarg, NULL, 10);
+        else if (opt == 'r')
+            registry_path = optarg;
+        else if (opt == 'a')
+            no_probe = 1;
+        else if (opt == 'p')
+            probe_only = 1;
+        else
+            return usage(argv[0]), opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (optind == argc || (no_probe && probe_only))
+        return usage(argv[0]), EXIT_FAILURE;
+    if (registry_path && !(registry = stegx_registry_open(registry_path)))
+        return err_print(stegx_errno), EXIT_FAILURE;
+
+    struct sigaction sa = {.sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    if (!(pool = pool_create(nb_threads)))
+        return EXIT_FAILURE;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    puts("[");
+    for (int i = optind; i < argc; i++) {
+        struct stat st;
+        char *path = strdup(argv[i]);
+        if (!path || stat(path, &st))
+            perror(argv[i]), free(path);
+        else if (pool_submit(pool, S_ISDIR(st.st_mode) ? dir_run : file_run, path))
+            free(path);
+    }
+    pool_destroy(pool);
+    puts(nb_out ? "\n]" : "]");
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    fprintf(stderr, "%zu fichiers, %zu suspects, %zu avec données, %.3f ms\n",
+            (size_t)nb_files, (size_t)nb_suspects, (size_t)nb_found,
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    stegx_registry_close(registry);
+    return stop ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stegx_stream.c
+ * @brief Programme "stegx-stream" : insertion et extraction sur un flux FLV
+ * en direct.
+ * @details Le flux est lu sur l'entrée standard (ou dans le fichier donné) et
+ * le résultat écrit sur la sortie standard (ou dans le fichier donné), tag par
+ * tag (\r{stegx_stream_insert}). Par exemple, pour marquer un flux RTMP :
+ *
+ *     ffmpeg -i rtmp://... -c copy -f flv - | stegx-stream insert jeton | ...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stegx.h"
+
+/** Nombre d'octets de la trame par tag vidéo par défaut. */
+#define STREAM_PER_TAG 16
+
+/**
+ * @brief Affiche l'aide du programme.
+ * @param prog Nom du programme.
+ * @author StegX Team
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage : %s insert [-k mot de passe] [-n octets] données [entrée [sortie]]\n"
+            "        %s extract [-k mot de passe] [entrée [sortie]]\n"
+            "  insert   cache le contenu du fichier \"données\" dans le flux FLV\n"
+            "  extract  écrit les données cachées dans le flux FLV\n"
+            "  -k mot de passe   mot de passe protégeant les données\n"
+            "  -n octets         octets cachés par tag vidéo (1 à 255, %d par défaut)\n"
+            "L'entrée et la sortie sont par défaut l'entrée et la sortie standard (\"-\").\n",
+            prog, prog, STREAM_PER_TAG);
+}
+
+/**
+ * @brief Ouvre un fichier, "-" désignant l'entrée ou la sortie standard.
+ * @param path Chemin du fichier (NULL pour "-").
+ * @param mode Mode d'ouverture.
+ * @return Fichier ouvert, sinon NULL.
+ * @author StegX Team
+ */
+static FILE *open_file(const char *path, const char *mode)
+{
+    if (!path || !strcmp(path, "-"))
+        return mode[0] == 'r' ? stdin : stdout;
+    FILE *f = fopen(path, mode);
+    if (!f)
+        perror(path);
+    return f;
+}
+
+/**
+ * @brief Lit tout un fichier en mémoire.
+ * @param path Chemin du fichier.
+ * @param len Taille lue.
+ * @return Contenu du fichier (à libérer), sinon NULL.
+ * @author StegX Team
+ */
+static void *read_file(const char *path, uint32_t * len)
+{
+    FILE *f = fopen(path, "rb");
+    long size;
+    void *data = NULL;
+    if (!f || fseek(f, 0, SEEK_END) || (size = ftell(f)) <= 0 || size > UINT32_MAX
+        || fseek(f, 0, SEEK_SET) || !(data = malloc(size)) || fread(data, 1, size, f) != (size_t)size) {
+        perror(path), free(data), data = NULL;
+    } else
+        *len = size;
+    if (f)
+        fclose(f);
+    return data;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *passwd = NULL;
+    unsigned int per_tag = STREAM_PER_TAG;
+    int insert = argc > 1 && !strcmp(argv[1], "insert");
+    if (argc < 2 || (!insert && strcmp(argv[1], "extract")))
+        return usage(argv[0]), EXIT_FAILURE;
+    optind = 2;
+    for (int opt; (opt = getopt(argc, argv, insert ? "k:n:h" : "k:h")) != -1;) {
+        if (opt == 'k')
+            passwd = optarg;
+        else if (opt == 'n' && (per_tag = atoi(optarg)) >= 1 && per_tag <= 255)
+            continue;
+        else
+            return usage(argv[0]), opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc - optind < insert || argc - optind > insert + 2)
+        return usage(argv[0]), EXIT_FAILURE;
+
+    uint32_t len = 0;
+    void *data = insert ? read_file(argv[optind++], &len) : NULL;
+    FILE *in = open_file(optind < argc ? argv[optind] : NULL, "rb");
+    FILE *out = open_file(optind + 1 < argc ? argv[optind + 1] : NULL, "wb");
+    int err = (insert && !data) || !in || !out;
+    if (!err && (insert ? stegx_stream_insert(in, out, data, len, passwd, per_tag)
+                 : stegx_stream_extract(in, passwd, out)))
+        err_print(stegx_errno), err = 1;
+    free(data);
+    if (in && in != stdin)
+        fclose(in);
+    if (out && out != stdout && fclose(out))
+        perror("Can't close the output"), err = 1;
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,294 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stegx_trial.c
+ * @brief Programme "stegx-trial" : recherche du mot de passe d'un fichier
+ * hôte dans une liste de candidats.
+ * @details Quand chaque client reçoit son propre mot de passe, retrouver le
+ * client d'une copie diffusée revient à essayer tous les mots de passe.
+ * L'hôte est analysé et sa signature lue une seule fois
+ * (\r{stegx_trial_open}), puis les candidats sont testés en deux passes sur
+ * un pool de threads :
+ *
+ * 1. le nom du fichier caché est déXORé avec chaque candidat
+ *    (\r{stegx_trial_name}), ce qui rejette la plupart d'entre eux pour
+ *    quelques octets de calcul (et presque tous si le nom attendu est donné
+ *    avec -n) ;
+ * 2. si un début de données attendu est donné avec -s, les candidats restants
+ *    sont regroupés par clé (\r{stegx_trial_key}) et les données ne sont
+ *    extraites qu'une fois par clé. Les candidats d'une même clé donnant les
+ *    mêmes données, seul le nom peut les départager.
+ *
+ * Une ligne est écrite sur la sortie standard par candidat retenu :
+ *
+ *     <mot de passe>  <nom du fichier caché>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "stegx.h"
+#include "pool.h"
+
+/** Nombre de candidats testés par une tâche de la première passe. */
+#define TRIAL_CHUNK 16384
+
+/** Recherche en cours. */
+static stegx_trial_s *trial;
+
+/** Mots de passe candidats. */
+static char **cands;
+
+/** Candidats retenus par la première passe. */
+static unsigned char *keep;
+
+/** Nom du fichier caché attendu (NULL si inconnu). */
+static const char *expected_name;
+
+/** Début attendu des données cachées (NULL si inconnu). */
+static const char *expected_data;
+
+/** Verrou de la sortie standard. */
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Nombre de candidats retenus à la fin. */
+static size_t nb_found;
+
+/**
+ * @brief Suite de candidats traitée par une tâche.
+ */
+struct range {
+    size_t begin;               /*!< Premier candidat (indice). */
+    size_t end;                 /*!< Fin de la suite (exclue). */
+    size_t *idx;                /*!< Indices des candidats (NULL pour la suite begin..end). */
+};
+
+/**
+ * @brief Candidat retenu par la première passe, avec sa clé.
+ */
+struct survivor {
+    unsigned int key;           /*!< Clé du mot de passe. */
+    size_t i;                   /*!< Indice du candidat. */
+};
+
+/**
+ * @brief Écrit les candidats retenus d'une suite.
+ * @param r Suite de candidats.
+ * @author StegX Team
+ */
+static void report(const struct range *r)
+{
+    char name[256];
+    pthread_mutex_lock(&out_lock);
+    for (size_t k = r->begin; k < r->end; k++) {
+        size_t i = r->idx ? r->idx[k] : k;
+        stegx_trial_name(trial, cands[i], name);
+        printf("%s\t%s\n", cands[i], name);
+        nb_found++;
+    }
+    pthread_mutex_unlock(&out_lock);
+}
+
+/**
+ * @brief Première passe : teste le nom du fichier caché.
+ * @param arg Suite de candidats (\r{range}, libérée).
+ * @author StegX Team
+ */
+static void name_run(void *arg)
+{
+    struct range *r = arg;
+    char name[256];
+    for (size_t i = r->begin; i < r->end; i++)
+        keep[i] = stegx_trial_name(trial, cands[i], name)
+            && (!expected_name || !strcmp(name, expected_name));
+    free(r);
+}
+
+/**
+ * @brief Seconde passe : extrait les données pour une clé et retient ses
+ * candidats si elles commencent comme attendu.
+ * @param arg Candidats de même clé (\r{range}, libérée).
+ * @author StegX Team
+ */
+static void data_run(void *arg)
+{
+    struct range *r = arg;
+    char *data = NULL;
+    size_t len = 0, n = strlen(expected_data);
+    FILE *res = open_memstream(&data, &len);
+    if (!res)
+        perror("Can't open memory stream for extracted data");
+    else if (!stegx_trial_extract(trial, cands[r->idx[r->begin]], res) && len >= n
+             && !memcmp(data, expected_data, n))
+        report(r);
+    free(data), free(r);
+}
+
+/**
+ * @brief Compare deux candidats par clé.
+ * @author StegX Team
+ */
+static int survivor_cmp(const void *a, const void *b)
+{
+    const struct survivor *x = a, *y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+/**
+ * @brief Lit la liste des candidats (un par ligne).
+ * @param path Chemin de la liste ("-" pour l'entrée standard).
+ * @param nb Nombre de candidats lus.
+ * @param block Bloc contenant tous les candidats, à libérer avec le tableau.
+ * @return Tableau des candidats (pointant dans "block"), NULL en cas d'erreur.
+ * @author StegX Team
+ */
+static char **read_list(const char *path, size_t *nb, char **block)
+{
+    FILE *f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!f)
+        return perror(path), NULL;
+    /* Lecture en un seul bloc, découpé ensuite sur place. */
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    for (size_t n = 1; n;) {
+        if (len + BUFSIZ + 1 > cap) {
+            char *tmp = realloc(buf, cap = cap ? cap * 2 : 1 << 20);
+            if (!tmp)
+                return perror("Can't allocate memory for candidates"), free(buf), NULL;
+            buf = tmp;
+        }
+        len += n = fread(buf + len, 1, cap - len - 1, f);
+    }
+    if (f != stdin)
+        fclose(f);
+    buf = buf ? buf : calloc(1, 1);
+    buf[len] = '\0';
+
+    size_t max = 1;
+    for (char *c = buf; (c = strchr(c, '\n')); c++)
+        max++;
+    char **l = malloc(max * sizeof(*l));
+    if (!l)
+        return perror("Can't allocate memory for candidates"), free(buf), NULL;
+    *nb = 0, *block = buf;
+    for (char *save = NULL, *c = strtok_r(buf, "\n", &save); c; c = strtok_r(NULL, "\n", &save)) {
+        c[strcspn(c, "\r")] = '\0';
+        if (*c)
+            l[(*nb)++] = c;
+    }
+    return l;
+}
+
+/**
+ * @brief Affiche l'aide du programme.
+ * @param prog Nom du programme.
+ * @author StegX Team
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage : %s [-j threads] [-n nom] [-s début] hôte candidats\n"
+            "  -j threads  nombre de threads (défaut : nombre de coeurs)\n"
+            "  -n nom      nom du fichier caché attendu\n"
+            "  -s début    début attendu des données cachées\n"
+            "  candidats   fichier des mots de passe, un par ligne (\"-\" pour l'entrée\n"
+            "              standard)\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int nb_threads = 0;
+    for (int opt; (opt = getopt(argc, argv, "j:n:s:h")) != -1;) {
+        if (opt == 'j')
+            nb_threads = strtoul(optarg, NULL, 10);
+        else if (opt == 'n')
+            expected_name = optarg;
+        else if (opt == 's')
+            expected_data = optarg;
+        else
+            return usage(argv[0]), opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (optind != argc - 2)
+        return usage(argv[0]), EXIT_FAILURE;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (!(trial = stegx_trial_open(argv[optind])))
+        return err_print(stegx_errno), EXIT_FAILURE;
+    size_t nb = 0;
+    char *block = NULL;
+    if (!(cands = read_list(argv[optind + 1], &nb, &block)) || !(keep = calloc(nb + 1, 1)))
+        return stegx_trial_close(trial), EXIT_FAILURE;
+    pool_s *pool = pool_create(nb_threads);
+    if (!pool)
+        return EXIT_FAILURE;
+
+    /* Première passe : nom du fichier caché. */
+    for (size_t i = 0; i < nb; i += TRIAL_CHUNK) {
+        struct range *r = malloc(sizeof(*r));
+        if (r)
+            *r = (struct range) {.begin = i,.end = i + TRIAL_CHUNK < nb ? i + TRIAL_CHUNK : nb };
+        if (!r || pool_submit(pool, name_run, r))
+            return perror("Can't submit candidates"), EXIT_FAILURE;
+    }
+    pool_wait(pool);
+    size_t nb_names = 0;
+    for (size_t i = 0; i < nb; i++)
+        nb_names += keep[i];
+
+    /* Seconde passe : une extraction par clé, ou aucune si les données ne
+     * peuvent pas être vérifiées. */
+    struct survivor *s = malloc((nb_names + 1) * sizeof(*s));
+    size_t *idx = malloc((nb_names + 1) * sizeof(*idx));
+    if (!s || !idx)
+        return perror("Can't allocate memory for candidates"), EXIT_FAILURE;
+    for (size_t i = 0, k = 0; i < nb; i++)
+        if (keep[i])
+            s[k++] = (struct survivor) {.key = stegx_trial_key(cands[i]),.i = i };
+    qsort(s, nb_names, sizeof(*s), survivor_cmp);
+    for (size_t k = 0; k < nb_names; k++)
+        idx[k] = s[k].i;
+    size_t nb_keys = 0;
+    for (size_t k = 0, e; k < nb_names; k = e) {
+        for (e = k + 1; e < nb_names && s[e].key == s[k].key; e++);
+        struct range r = {.begin = k,.end = e,.idx = idx };
+        nb_keys++;
+        if (!expected_data)
+            report(&r);
+        else {
+            struct range *p = malloc(sizeof(*p));
+            if (p)
+                *p = r;
+            if (!p || pool_submit(pool, data_run, p))
+                return perror("Can't submit candidates"), EXIT_FAILURE;
+        }
+    }
+    pool_destroy(pool);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    fprintf(stderr, "%zu candidats, %zu noms plausibles, %zu clés, %zu retenus, %.3f ms\n",
+            nb, nb_names, nb_keys, nb_found,
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    free(s), free(idx), free(keep), free(block), free(cands);
+    stegx_trial_close(trial);
+    return nb_found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,631 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stegxd.c
+ * @brief Démon "stegxd" : insertions et extractions sur un socket Unix.
+ * @details Le démon garde en mémoire les hôtes déjà ouverts et analysés
+ * (\r{stegx_host_open}) : une requête sur un hôte connu ne coûte que
+ * l'insertion ou l'extraction elle-même. Un hôte est ouvert de nouveau si le
+ * fichier a changé (périphérique, inode, taille ou date de modification) et
+ * les hôtes utilisés le moins récemment sont fermés au-delà de la limite.
+ * Chaque connexion a son propre thread, qui attend ses requêtes : un client
+ * inactif ou lent n'empêche pas les autres d'être servis. Le nombre de
+ * requêtes exécutées en même temps par la bibliothèque est limité par un
+ * sémaphore. Les données à cacher et les résultats ne passent jamais par le
+ * disque (memfd). Une requête est
+ * annulée (\r{ERR_CANCELED}) si le client ferme la connexion ou si le démon
+ * s'arrête, et (\r{ERR_DEADLINE}) si elle dépasse la durée maximale choisie.
+ * Le protocole est décrit dans stegxd.h.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "stegx.h"
+#include "stegxd.h"
+
+/** Nombre d'hôtes gardés ouverts par défaut. */
+#define STEGXD_HOSTS 64
+
+/** Longueur maximale d'une chaîne d'une requête. */
+#define STEGXD_STR_MAX 4096
+
+/** Longueur maximale du nom du fichier caché (voir LENGTH_HIDDEN_NAME_MAX). */
+#define STEGXD_NAME_MAX 255
+
+/**
+ * @brief Hôte gardé ouvert par le démon.
+ */
+struct warm_host {
+    char *path;                 /*!< Chemin du fichier hôte (NULL si l'entrée est libre). */
+    mode_e mode;                /*!< Mode pour lequel l'hôte a été analysé. */
+    dev_t dev;                  /*!< Périphérique du fichier à l'ouverture. */
+    ino_t ino;                  /*!< Inode du fichier à l'ouverture. */
+    off_t size;                 /*!< Taille du fichier à l'ouverture. */
+    struct timespec mtime;      /*!< Date de modification à l'ouverture. */
+    stegx_host_s *host;         /*!< Hôte ouvert et analysé. */
+    unsigned int ref;           /*!< Nombre de requêtes en cours sur l'hôte. */
+    int stale;                  /*!< Fichier modifié : fermé après la dernière requête. */
+    unsigned long last_use;     /*!< Date de dernière utilisation (horloge logique). */
+};
+
+/**
+ * @brief Connexion d'un client.
+ */
+struct conn {
+    int fd;                     /*!< Socket de la connexion. */
+    struct conn *prev;          /*!< Connexion précédente dans la liste. */
+    struct conn *next;          /*!< Connexion suivante dans la liste. */
+};
+
+/** Hôtes gardés ouverts. */
+static struct warm_host *hosts;
+/** Nombre d'entrées de \r{hosts}. */
+static unsigned int nb_hosts = STEGXD_HOSTS;
+/** Horloge logique de \r{warm_host.last_use}. */
+static unsigned long host_clock;
+/** Verrou de \r{hosts}. */
+static pthread_mutex_t hosts_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Connexions en cours (fermées à l'arrêt du démon). */
+static struct conn *conns;
+/** Verrou de \r{conns}. */
+static pthread_mutex_t conns_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Signalée quand \r{conns} devient vide. */
+static pthread_cond_t conns_empty = PTHREAD_COND_INITIALIZER;
+
+/** Places libres pour exécuter une requête avec la bibliothèque. */
+static sem_t slots;
+
+/** Durée maximale d'une requête en millisecondes (0 si aucune). */
+static unsigned long timeout_ms;
+
+/** Demande d'arrêt reçue (SIGINT ou SIGTERM), lue par tous les threads. */
+static atomic_int stop;
+
+/**
+ * @brief Ferme un hôte gardé ouvert et libère son entrée.
+ * @param w Entrée à libérer (sans requête en cours).
+ * @author StegX Team
+ */
+static void warm_free(struct warm_host *w)
+{
+    stegx_host_close(w->host);
+    free(w->path);
+    memset(w, 0, sizeof(*w));
+}
+
+/**
+ * @brief Renvoie l'hôte ouvert et analysé correspondant à un fichier.
+ * @param path Chemin du fichier hôte.
+ * @param mode Mode de la requête.
+ * @param w Entrée de l'hôte (NULL si l'hôte n'a pas pu être gardé ouvert :
+ * il doit alors être fermé après la requête).
+ * @return Hôte, NULL en cas d'erreur (\r{stegx_errno} mis à jour).
+ * @author StegX Team
+ */
+static stegx_host_s *warm_get(const char *path, mode_e mode, struct warm_host **w)
+{
+    struct stat st;
+    *w = NULL;
+    if (stat(path, &st))
+        return stegx_errno = ERR_HOST, NULL;
+
+    pthread_mutex_lock(&hosts_lock);
+    for (unsigned int i = 0; i < nb_hosts; i++) {
+        struct warm_host *h = &hosts[i];
+        if (!h->path || h->stale || h->mode != mode || strcmp(h->path, path))
+            continue;
+        if (h->dev == st.st_dev && h->ino == st.st_ino && h->size == st.st_size
+            && h->mtime.tv_sec == st.st_mtim.tv_sec && h->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            h->ref++, h->last_use = ++host_clock;
+            pthread_mutex_unlock(&hosts_lock);
+            return *w = h, h->host;
+        }
+        /* Fichier modifié : l'ancienne analyse n'est plus valable. */
+        if (h->ref)
+            h->stale = 1;
+        else
+            warm_free(h);
+    }
+    pthread_mutex_unlock(&hosts_lock);
+
+    /* Ouverture et analyse hors du verrou. */
+    stegx_host_s *host = stegx_host_open(path, mode);
+    char *dup = host ? strdup(path) : NULL;
+    if (!dup)
+        return host;
+
+    /* Entrée libre, sinon l'hôte sans requête utilisé le moins récemment. */
+    pthread_mutex_lock(&hosts_lock);
+    struct warm_host *victim = NULL;
+    for (unsigned int i = 0; i < nb_hosts && (!victim || victim->path); i++)
+        if (!hosts[i].path || (!hosts[i].ref && (!victim || hosts[i].last_use < victim->last_use)))
+            victim = &hosts[i];
+    if (victim) {
+        if (victim->path)
+            warm_free(victim);
+        *victim = (struct warm_host) {.path = dup,.mode = mode,.dev = st.st_dev,.ino =
+                st.st_ino,.size = st.st_size,.mtime = st.st_mtim,.host = host,.ref = 1,
+            .last_use = ++host_clock
+        };
+        *w = victim;
+    } else
+        free(dup);
+    pthread_mutex_unlock(&hosts_lock);
+    return host;
+}
+
+/**
+ * @brief Rend un hôte obtenu par \r{warm_get}.
+ * @param host Hôte.
+ * @param w Entrée de l'hôte (NULL si l'hôte n'est pas gardé ouvert).
+ * @author StegX Team
+ */
+static void warm_put(stegx_host_s * host, struct warm_host *w)
+{
+    if (!w)
+        return stegx_host_close(host);
+    pthread_mutex_lock(&hosts_lock);
+    if (!--w->ref && w->stale)
+        warm_free(w);
+    pthread_mutex_unlock(&hosts_lock);
+}
+
+/**
+ * @brief Reçoit exactement "len" octets, avec un éventuel descripteur joint.
+ * @param fd Socket.
+ * @param buf Tampon de réception.
+ * @param len Nombre d'octets à recevoir.
+ * @param pass_fd Descripteur reçu (-1 si aucun), NULL pour les refuser.
+ * @return 0 si tout a été reçu, 1 sinon (fin de connexion ou erreur).
+ * @author StegX Team
+ */
+static int recv_full(int fd, void *buf, size_t len, int *pass_fd)
+{
+    for (size_t done = 0; done < len;) {
+        union {
+            struct cmsghdr hdr;
+            char buf[CMSG_SPACE(sizeof(int))];
+        } ctl;
+        struct iovec iov = {.iov_base = (char *)buf + done,.iov_len = len - done };
+        struct msghdr msg = {.msg_iov = &iov,.msg_iovlen = 1,.msg_control = &ctl,
+            .msg_controllen = sizeof(ctl)
+        };
+        ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+        done += n;
+        for (struct cmsghdr * c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+                continue;
+            int got;
+            memcpy(&got, CMSG_DATA(c), sizeof(got));
+            if (pass_fd && *pass_fd == -1)
+                *pass_fd = got;
+            else
+                close(got);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Envoie exactement "len" octets.
+ * @return 0 si tout a été envoyé, 1 sinon.
+ * @author StegX Team
+ */
+static int send_full(int fd, const void *buf, size_t len)
+{
+    for (size_t done = 0; done < len;) {
+        ssize_t n = send(fd, (const char *)buf + done, len - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+        done += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Envoie la réponse à une requête.
+ * @param fd Socket.
+ * @param rep En-tête de la réponse.
+ * @param name Nom du fichier caché (NULL si aucun).
+ * @param res Descripteur du résultat (-1 si aucun).
+ * @return 0 si la réponse a été envoyée, 1 sinon.
+ * @author StegX Team
+ */
+static int send_reply(int fd, struct stegxd_reply *rep, const char *name, int res)
+{
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } ctl;
+    struct iovec iov = {.iov_base = rep,.iov_len = sizeof(*rep) };
+    struct msghdr msg = {.msg_iov = &iov,.msg_iovlen = 1 };
+    if (rep->flags & STEGXD_REPLY_FD) {
+        msg.msg_control = &ctl, msg.msg_controllen = sizeof(ctl);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET, c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(c), &res, sizeof(res));
+    }
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(*rep)
+        || send_full(fd, name, rep->name_len))
+        return 1;
+    if (rep->flags & STEGXD_REPLY_FD)
+        return 0;
+    /* Résultat copié du memfd vers le socket par le noyau. */
+    for (off_t off = 0; off < (off_t) rep->len;) {
+        ssize_t n = sendfile(fd, res, &off, rep->len - off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Suivi de progression d'une requête : annule la requête si le client
+ * est parti ou si le démon s'arrête.
+ * @param data Socket de la connexion (int *).
+ * @return 1 si la requête doit être annulée, 0 sinon.
+ * @author StegX Team
+ */
+static int run_progress(void *data, stage_e stage, uint64_t done, uint64_t total)
+{
+    (void)stage, (void)done, (void)total;
+    /* POLLHUP n'est levé que si le client a fermé les deux sens : un client qui
+     * a seulement fini d'écrire attend encore sa réponse. */
+    struct pollfd p = {.fd = *(int *)data };
+    return stop || (poll(&p, 1, 0) == 1 && (p.revents & (POLLHUP | POLLERR)));
+}
+
+/**
+ * @brief Exécute une requête avec la bibliothèque.
+ * @param req En-tête de la requête.
+ * @param host_path Chemin de l'hôte.
+ * @param passwd Mot de passe (NULL si aucun).
+ * @param name Nom du fichier caché (insertion).
+ * @param hidden Fichier à cacher (insertion, fermé dans tous les cas).
+ * @param res Fichier résultat (fermé dans tous les cas).
+ * @param hidden_name Nom du fichier caché lu dans l'hôte (extraction, chaîne
+ * vide sinon).
+ * @param ctx Structure de la bibliothèque de la connexion, réutilisée d'une
+ * requête à l'autre (créée si NULL).
+ * @param fd Socket de la connexion, surveillé pendant la requête.
+ * @return Code d'erreur de la requête.
+ * @author StegX Team
+ */
+static enum err_code run(const struct stegxd_request *req, char *host_path, char *passwd,
+                         char *name, FILE * hidden, FILE * res, char *hidden_name,
+                         info_s ** ctx, int *fd)
+{
+    mode_e mode = req->op == STEGXD_OP_INSERT ? STEGX_MODE_INSERT : STEGX_MODE_EXTRACT;
+    struct warm_host *w;
+    stegx_errno = ERR_NONE;
+    stegx_host_s *host = warm_get(host_path, mode, &w);
+    stegx_info_insert_s insert_info = {.hidden_path = name,.algo = req->algo,
+        .hidden_file = hidden
+    };
+    stegx_choices_s choices = {.host_path = host_path,.res_path = "",.passwd = passwd,
+        .mode = mode,.insert_info = mode == STEGX_MODE_INSERT ? &insert_info : NULL,
+        .host = host,.res_file = res,.progress = run_progress,.progress_data = fd
+    };
+    if (timeout_ms) {
+        clock_gettime(CLOCK_MONOTONIC, &choices.deadline);
+        choices.deadline.tv_sec += timeout_ms / 1000;
+        choices.deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+        if (choices.deadline.tv_nsec >= 1000000000)
+            choices.deadline.tv_sec++, choices.deadline.tv_nsec -= 1000000000;
+    }
+    info_s *infos = !host ? NULL : *ctx ? *ctx : stegx_init(&choices);
+    int err = !infos;
+    if (host && *ctx && stegx_reset(infos, &choices)) {
+        /* Les fichiers déjà confiés à la structure sont fermés avec elle. */
+        stegx_clear(infos);
+        infos = *ctx = NULL, err = 1;
+    } else if (err) {
+        if (hidden)
+            fclose(hidden);
+        fclose(res);
+    } else if (mode == STEGX_MODE_INSERT) {
+        err = stegx_check_compatibility(infos) || stegx_suggest_algo(infos);
+        /* STEGX_NB_ALGO : premier algorithme proposé pour cet hôte. */
+        algo_e algo = req->algo;
+        for (algo_e i = 0; !err && algo == STEGX_NB_ALGO && i < STEGX_NB_ALGO; i++)
+            algo = stegx_propos_algos[i] ? i : algo;
+        if (!err && algo == STEGX_NB_ALGO)
+            stegx_errno = ERR_CHOICE_ALGO, err = 1;
+        err = err || stegx_choose_algo(infos, algo) || stegx_insert(infos);
+    } else {
+        err = stegx_check_compatibility(infos) || stegx_detect_algo(infos)
+            || snprintf(hidden_name, STEGXD_NAME_MAX + 1, "%s", stegx_hidden_name(infos)) < 0
+            || stegx_extract(infos, "");
+    }
+    /* Fichiers fermés tout de suite : le résultat est complet dans le memfd. */
+    if (infos)
+        stegx_reset(*ctx = infos, NULL);
+    if (host)
+        warm_put(host, w);
+    return err ? (stegx_errno != ERR_NONE ? stegx_errno : ERR_OTHER) : ERR_NONE;
+}
+
+/**
+ * @brief Reçoit une requête complète.
+ * @param fd Socket de la connexion.
+ * @param req En-tête de la requête.
+ * @param str Chemin de l'hôte, mot de passe et nom du fichier caché (à libérer).
+ * @param buf Données à cacher reçues sur le socket (à libérer).
+ * @param hidden_fd Descripteur du fichier à cacher joint (-1 si aucun, à fermer).
+ * @return 0 si la requête est valide, 1 sinon (la connexion doit être fermée).
+ * @author StegX Team
+ */
+static int recv_request(int fd, struct stegxd_request *req, char *str[3], char **buf,
+                        int *hidden_fd)
+{
+    if (recv_full(fd, req, sizeof(*req), hidden_fd) || req->magic != STEGXD_MAGIC
+        || req->op > STEGXD_OP_EXTRACT || req->algo > STEGX_NB_ALGO || !req->host_len
+        || req->host_len > STEGXD_STR_MAX || req->passwd_len > STEGXD_STR_MAX
+        || req->name_len > STEGXD_STR_MAX
+        || ((req->flags & STEGXD_HIDDEN_FD) && *hidden_fd == -1))
+        return 1;
+    uint16_t lens[3] = { req->host_len, req->passwd_len, req->name_len };
+    for (int i = 0; i < 3; i++)
+        if (!(str[i] = calloc(lens[i] + 1, 1)) || recv_full(fd, str[i], lens[i], NULL))
+            return 1;
+    /* Les données à cacher ne dépassent pas la taille codée dans la signature. */
+    if (req->op != STEGXD_OP_INSERT || (req->flags & STEGXD_HIDDEN_FD) || !req->hidden_len)
+        return 0;
+    return req->hidden_len > STEGXD_HIDDEN_MAX || !(*buf = malloc(req->hidden_len))
+        || recv_full(fd, *buf, req->hidden_len, NULL);
+}
+
+/**
+ * @brief Lit et traite une requête d'une connexion.
+ * @param fd Socket de la connexion.
+ * @param ctx Structure de la bibliothèque de la connexion.
+ * @return 0 si la requête a été traitée, 1 si la connexion doit être fermée.
+ * @author StegX Team
+ */
+static int serve_request(int fd, info_s ** ctx)
+{
+    struct stegxd_request req;
+    int hidden_fd = -1, mfd = -1, ret = 1;
+    char *str[3] = { NULL }, *buf = NULL, hidden_name[STEGXD_NAME_MAX + 1] = "";
+    if (!recv_request(fd, &req, str, &buf, &hidden_fd)) {
+        /* Fichier à cacher et résultat en mémoire. */
+        struct stegxd_reply rep = {.magic = STEGXD_MAGIC,.flags = req.flags & STEGXD_REPLY_FD };
+        FILE *hidden = NULL, *res = NULL;
+        if (req.op == STEGXD_OP_INSERT && hidden_fd != -1)
+            hidden = fdopen(hidden_fd, "rb"), hidden_fd = hidden ? -1 : hidden_fd;
+        else if (req.op == STEGXD_OP_INSERT && buf)
+            hidden = fmemopen(buf, req.hidden_len, "rb");
+        if ((mfd = memfd_create("stegx-result", MFD_CLOEXEC)) != -1) {
+            int dup_fd = dup(mfd);
+            if (dup_fd != -1 && !(res = fdopen(dup_fd, "wb")))
+                close(dup_fd);
+        }
+        if (req.op == STEGXD_OP_INSERT && !hidden)
+            rep.err = ERR_HIDDEN;
+        else if (!res)
+            rep.err = ERR_OTHER;
+        if (rep.err) {
+            if (hidden)
+                fclose(hidden);
+            if (res)
+                fclose(res);
+        } else {
+            /* Requête reçue en entier : seule son exécution prend une place. */
+            while (sem_wait(&slots) && errno == EINTR);
+            rep.err = run(&req, str[0], req.passwd_len ? str[1] : NULL,
+                          req.name_len ? str[2] : "hidden", hidden, res, hidden_name, ctx, &fd);
+            sem_post(&slots);
+        }
+
+        /* Réponse : taille du memfd, remis au début pour le client. */
+        off_t size = rep.err ? 0 : lseek(mfd, 0, SEEK_END);
+        if (size < 0 || (!rep.err && lseek(mfd, 0, SEEK_SET)))
+            rep.err = ERR_OTHER, size = 0;
+        rep.len = size;
+        rep.name_len = rep.err ? 0 : strlen(hidden_name);
+        rep.flags = rep.err ? 0 : rep.flags;
+        ret = send_reply(fd, &rep, hidden_name, mfd);
+    }
+    if (hidden_fd != -1)
+        close(hidden_fd);
+    if (mfd != -1)
+        close(mfd);
+    for (int i = 0; i < 3; i++)
+        free(str[i]);
+    free(buf);
+    return ret;
+}
+
+/**
+ * @brief Sert une connexion jusqu'à sa fermeture (thread de la connexion).
+ * @param arg Connexion (\r{conn}).
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *serve(void *arg)
+{
+    struct conn *c = arg;
+    info_s *ctx = NULL;
+    while (!stop && !serve_request(c->fd, &ctx));
+    if (ctx)
+        stegx_clear(ctx);
+    pthread_mutex_lock(&conns_lock);
+    if (c->prev)
+        c->prev->next = c->next;
+    else
+        conns = c->next;
+    if (c->next)
+        c->next->prev = c->prev;
+    if (!conns)
+        pthread_cond_signal(&conns_empty);
+    pthread_mutex_unlock(&conns_lock);
+    close(c->fd);
+    free(c);
+    return NULL;
+}
+
+/**
+ * @brief Gestionnaire de SIGINT et SIGTERM.
+ * @author StegX Team
+ */
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+/**
+ * @brief Affiche l'aide du programme.
+ * @param prog Nom du programme.
+ * @author StegX Team
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage : %s [-s socket] [-j threads] [-n hôtes] [-t ms]\n"
+            "  -s socket   chemin du socket Unix (défaut : " STEGXD_SOCKET ")\n"
+            "  -j threads  nombre de requêtes exécutées en parallèle (défaut : nombre\n"
+            "              de coeurs)\n"
+            "  -n hôtes    nombre d'hôtes gardés ouverts et analysés (défaut : %d)\n"
+            "  -t ms       durée maximale d'une requête, annulée au-delà (défaut : aucune)\n",
+            prog, STEGXD_HOSTS);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = STEGXD_SOCKET;
+    unsigned int nb_threads = 0;
+    for (int opt; (opt = getopt(argc, argv, "s:j:n:t:h")) != -1;) {
+        if (opt == 's')
+            path = optarg;
+        else if (opt == 'j')
+            nb_threads = strtoul(optarg, NULL, 10);
+        else if (opt == 'n')
+            nb_hosts = strtoul(optarg, NULL, 10);
+        else if (opt == 't')
+            timeout_ms = strtoul(optarg, NULL, 10);
+        else
+            return usage(argv[0]), opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (optind != argc || !nb_hosts)
+        return usage(argv[0]), EXIT_FAILURE;
+
+    /* Socket d'écoute. */
+    struct sockaddr_un addr = {.sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return fprintf(stderr, "%s: chemin trop long\n", path), EXIT_FAILURE;
+    strcpy(addr.sun_path, path);
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (lfd == -1 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) || listen(lfd, SOMAXCONN))
+        return perror(path), EXIT_FAILURE;
+
+    /* Arrêt propre sur SIGINT et SIGTERM : accept() est interrompu. Les
+     * signaux sont bloqués dans les threads des connexions pour être reçus
+     * par le thread principal. */
+    struct sigaction sa = {.sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    if (!nb_threads) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nb_threads = n > 0 ? n : 1;
+    }
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (sem_init(&slots, 0, nb_threads) || !(hosts = calloc(nb_hosts, sizeof(*hosts))))
+        return unlink(path), EXIT_FAILURE;
+    while (!stop) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EINTR && errno != ECONNABORTED)
+                perror("accept"), stop = 1;
+            continue;
+        }
+        struct conn *c = malloc(sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        pthread_mutex_lock(&conns_lock);
+        *c = (struct conn) {.fd = fd,.next = conns };
+        if (conns)
+            conns->prev = c;
+        conns = c;
+        pthread_mutex_unlock(&conns_lock);
+        pthread_t t;
+        pthread_sigmask(SIG_BLOCK, &set, NULL);
+        int err = pthread_create(&t, &attr, serve, c);
+        pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+        if (err) {
+            /* Sans thread, la connexion est fermée tout de suite. */
+            errno = err, perror("Can't create connection thread");
+            shutdown(fd, SHUT_RDWR), serve(c);
+        }
+    }
+
+    /* Réveil des connexions en attente d'une requête, puis fin de leurs
+     * threads. */
+    close(lfd);
+    unlink(path);
+    pthread_mutex_lock(&conns_lock);
+    for (struct conn * c = conns; c; c = c->next)
+        shutdown(c->fd, SHUT_RD);
+    while (conns)
+        pthread_cond_wait(&conns_empty, &conns_lock);
+    pthread_mutex_unlock(&conns_lock);
+    pthread_attr_destroy(&attr);
+    sem_destroy(&slots);
+    for (unsigned int i = 0; i < nb_hosts; i++)
+        if (hosts[i].path)
+            warm_free(&hosts[i]);
+    free(hosts);
+    return EXIT_SUCCESS;
+}
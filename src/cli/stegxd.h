@@ -0,0 +1,95 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stegxd.h
+ * @brief Protocole du démon "stegxd".
+ * @details Le client se connecte au socket Unix du démon (SOCK_STREAM) et
+ * envoie autant de requêtes qu'il le souhaite sur la même connexion. Chaque
+ * requête est :
+ * 
+ *     struct stegxd_request | chemin de l'hôte | mot de passe | nom du fichier
+ *     caché | données à cacher (insertion, sauf si STEGXD_HIDDEN_FD)
+ * 
+ * Si STEGXD_HIDDEN_FD est présent, le descripteur du fichier à cacher est
+ * joint à l'en-tête (SCM_RIGHTS) et "hidden_len" est ignoré. Sinon,
+ * "hidden_len" ne dépasse pas STEGXD_HIDDEN_MAX : un fichier plus gros doit
+ * être joint en descripteur. La réponse est :
+ * 
+ *     struct stegxd_reply | nom du fichier caché (extraction) | résultat
+ * 
+ * Le résultat (fichier hôte modifié ou données extraites) fait "len" octets.
+ * Si la requête contenait STEGXD_REPLY_FD, il n'est pas envoyé sur le socket :
+ * un descripteur (memfd, positionné au début) est joint à l'en-tête de la
+ * réponse. Les entiers sont dans l'ordre des octets de la machine.
+ */
+
+#ifndef STEGXD_H
+#define STEGXD_H
+
+#include <stdint.h>
+
+/** Nombre magique des requêtes et réponses ("SXD1"). */
+#define STEGXD_MAGIC 0x31445853
+
+/** Chemin par défaut du socket du démon. */
+#define STEGXD_SOCKET "/tmp/stegxd.sock"
+
+/** Taille maximale des données à cacher envoyées sur le socket (64 Mio). */
+#define STEGXD_HIDDEN_MAX (64UL << 20)
+
+/** Fichier à cacher joint en descripteur à l'en-tête de la requête. */
+#define STEGXD_HIDDEN_FD (1 << 0)
+
+/** Résultat renvoyé en descripteur plutôt que sur le socket. */
+#define STEGXD_REPLY_FD (1 << 1)
+
+/** Opérations du démon. */
+enum stegxd_op {
+    STEGXD_OP_INSERT,           /*!< Insertion. */
+    STEGXD_OP_EXTRACT           /*!< Extraction. */
+};
+
+/**
+ * @brief En-tête d'une requête.
+ */
+struct stegxd_request {
+    uint32_t magic;             /*!< \r{STEGXD_MAGIC}. */
+    uint8_t op;                 /*!< Opération (\r{stegxd_op}). */
+    uint8_t algo;               /*!< Algorithme (\r{algo_e}), STEGX_NB_ALGO pour le premier proposé. */
+    uint16_t flags;             /*!< Combinaison de STEGXD_HIDDEN_FD et STEGXD_REPLY_FD. */
+    uint16_t host_len;          /*!< Longueur du chemin de l'hôte. */
+    uint16_t passwd_len;        /*!< Longueur du mot de passe (0 si aucun). */
+    uint16_t name_len;          /*!< Longueur du nom du fichier caché (insertion). */
+    uint16_t reserved;          /*!< Réservé (0). */
+    uint64_t hidden_len;        /*!< Taille des données à cacher (insertion). */
+};
+
+/**
+ * @brief En-tête d'une réponse.
+ */
+struct stegxd_reply {
+    uint32_t magic;             /*!< \r{STEGXD_MAGIC}. */
+    int32_t err;                /*!< Code d'erreur (\r{err_code}), 0 si succès. */
+    uint16_t name_len;          /*!< Longueur du nom du fichier caché (extraction). */
+    uint16_t flags;             /*!< STEGXD_REPLY_FD si un descripteur est joint. */
+    uint32_t reserved;          /*!< Réservé (0). */
+    uint64_t len;               /*!< Taille du résultat. */
+};
+
+#endif
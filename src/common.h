@@ -30,6 +30,8 @@
 #include <stdint.h>
 
 #include "stegx_common.h"
+#include "arena.h"
+#include "progress.h"
 
 /*
  * Types
@@ -92,6 +94,13 @@ struct host_info {
         struct avi avi;
         struct flv flv;
     } file_info;                /*!< Structure du format du fichier hôte. */
+    struct host_index *index;   /*!< Index d'analyse de l'hôte (NULL si non utilisé, voir host_index.h). */
+    struct host_cache_map *cache;       /*!< Projection de l'hôte depuis le cache partagé (NULL si non utilisé, voir host_cache.h). */
+    uint32_t *mp3_fr_size;      /*!< Index des frames MP3 : distance de chaque frame à la suivante à partir de file_info.mp3.fr_frst_adr (NULL si non construit, voir \r{mp3_mpeg_fr_index}). */
+    flv_tag_s *flv_tag;         /*!< Index des tags FLV (NULL si non construit, voir \r{flv_tag_index}). */
+    uint32_t flv_nb_tag;        /*!< Nombre de tags dans l'index des tags FLV. */
+    int borrowed;               /*!< 1 si les index des frames MP3 et des tags FLV appartiennent à l'hôte partagé (non libérés avec le traitement). */
+    int analysed;               /*!< Analyse déjà faite par le cache ou par l'hôte partagé (\r{fill_host_info} n'a rien à faire). */
 };
 
 /** Type du fichier hôte. */
@@ -107,10 +116,19 @@ struct info {
     method_e method;            /*!< Méthode de protection de données utilisé. */
     host_info_s host;           /*!< Fichier hôte. */
     FILE *res;                  /*!< Fichier résultat qui va être créé pour l'insertion ou l'extraction (requis). */
+    char *res_path;             /*!< Chemin du fichier résultat s'il a été créé par la bibliothèque (supprimé si le traitement est annulé), NULL sinon. */
     FILE *hidden;               /*!< Fichier à cacher (requis lors de l'insertion). */
     char *hidden_name;          /*!< Nom du fichier à cacher / du fichier chaché (requis, calculé à partir de hidden_path). */
     uint32_t hidden_length;     /*!< Taille du fichier à cacher / du fichier caché (octets). */
     char *passwd;               /*!< Mot de passe choisi par l'utilisateur. */
+    char *host_path;            /*!< Chemin du fichier hôte (NULL si l'hôte est lu sur stdin). */
+    unsigned int flags;         /*!< Options choisies par l'utilisateur (voir \r{flag_e}). */
+    struct arena arena;         /*!< Mémoire temporaire du traitement (voir arena.h), conservée par \r{stegx_reset}. */
+    struct progress progress;   /*!< Suivi de progression et annulation du traitement (voir progress.h). */
+    const stegx_registry_s *registry;   /*!< Registre des empreintes (NULL si non utilisé). */
+    stegx_identity_s identity;  /*!< Identité trouvée dans le registre pour les données extraites ("user" NULL sinon). */
+    long sig_pos;               /*!< Adresse de la signature dans l'hôte (extraction) ou dans le résultat (insertion, -1 s'il n'est pas positionnable), 0 si inconnue. */
+    uint64_t sig_hash;          /*!< Empreinte de la signature écrite, reprise par son pied (insertion). */
 };
 
 /*
@@ -128,4 +146,23 @@ struct info {
 /** Longueur du mot de passe choisi par défaut. */
 #define LENGTH_DEFAULT_PASSWD  64       /* 64 caractères sans compter le '\0'. */
 
+/** Taille de la partie fixe de la signature : méthode, algorithme, taille des
+ * données cachées et taille du nom. */
+#define LENGTH_SIG_HEAD        7
+
+/** Taille maximale de la signature. */
+#define LENGTH_SIG_MAX         (LENGTH_SIG_HEAD + LENGTH_HIDDEN_NAME_MAX + LENGTH_DEFAULT_PASSWD)
+
+/* Pied de signature (version 2), toujours dans les derniers octets du fichier
+ * résultat : identifiant (4 octets), version (1), réservé (3), adresse de la
+ * signature (8) et empreinte FNV-1a 64 bits de la signature et des 16 premiers
+ * octets du pied (8). */
+
+/** Identifiant du pied de signature ("SGXF"). */
+#define SIG_FOOTER_MAGIC       0x46584753
+/** Version de la signature décrite par le pied. */
+#define SIG_VERSION            2
+/** Taille du pied de signature. */
+#define LENGTH_SIG_FOOTER      24
+
 #endif                          /* ifndef COMMON_PRIV_H */
@@ -0,0 +1,169 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file crc32.c
+ * @brief Module qui calcule le CRC-32 (ISO 3309, celui des chunks PNG) et
+ * l'empreinte FNV-1a 64 bits.
+ * @details Pour le CRC-32, deux méthodes, choisies à la compilation comme les autres
+ * optimisations SIMD de StegX :
+ * - repliement par multiplications sans retenue (PCLMULQDQ) de 64 octets à
+ *   la fois, d'après "Fast CRC Computation for Generic Polynomials Using
+ *   PCLMULQDQ Instruction" (Intel, 2009) ;
+ * - tables "slice-by-8" sinon, et pour les octets restants.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__PCLMUL__) && defined(__SSE4_1__)
+#include <wmmintrin.h>
+#include <smmintrin.h>
+#endif
+
+#include "crc32.h"
+
+/** Polynôme du CRC-32 (bits inversés). */
+#define CRC32_POLY 0xEDB88320
+
+/** Tables "slice-by-8" : crc32_table[k][n] est le CRC de l'octet n suivi de
+ * k octets nuls. */
+static uint32_t crc32_table[8][256];
+
+/** Initialisation unique des tables. */
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Remplit les tables "slice-by-8".
+ * @author StegX Team
+ */
+static void crc32_init(void)
+{
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? CRC32_POLY ^ (c >> 1) : c >> 1;
+        crc32_table[0][n] = c;
+    }
+    for (uint32_t n = 0; n < 256; n++)
+        for (int k = 1; k < 8; k++)
+            crc32_table[k][n] = crc32_table[0][crc32_table[k - 1][n] & 0xFF] ^ (crc32_table[k - 1][n] >> 8);
+}
+
+/**
+ * @brief Met à jour un CRC-32 (non complémenté) avec les tables.
+ * @param crc CRC en cours, complémenté.
+ * @param p Données.
+ * @param len Taille des données.
+ * @return CRC en cours, complémenté.
+ * @author StegX Team
+ */
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t * p, size_t len)
+{
+    const uint32_t(*t)[256] = (const uint32_t(*)[256])crc32_table;
+    for (uint32_t lo, hi; len >= 8; p += 8, len -= 8) {
+        memcpy(&lo, p, sizeof(lo));
+        memcpy(&hi, p + 4, sizeof(hi));
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    while (len--)
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__PCLMUL__) && defined(__SSE4_1__)
+/** Taille minimale des données repliées par multiplications. */
+#define CRC32_CLMUL_MIN 64
+
+/**
+ * @brief Met à jour un CRC-32 (non complémenté) par repliement.
+ * @details Quatre blocs de 16 octets sont repliés en parallèle sur les 64
+ * octets suivants, puis en un seul bloc, réduit à 32 bits par la méthode de
+ * Barrett. Les constantes sont x^(4*128+32) mod P, x^(4*128-32) mod P,
+ * x^(128+32) mod P, x^(128-32) mod P, x^64 mod P, puis P et floor(x^64 / P),
+ * en bits inversés.
+ * @param crc CRC en cours, complémenté.
+ * @param p Données.
+ * @param len Taille des données (au moins \r{CRC32_CLMUL_MIN} et multiple de
+ * 16).
+ * @return CRC en cours, complémenté.
+ * @author StegX Team
+ */
+static uint32_t crc32_clmul(uint32_t crc, const uint8_t * p, size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x1 = _mm_loadu_si128((const __m128i *)p), x2 = _mm_loadu_si128((const __m128i *)(p + 16));
+    __m128i x3 = _mm_loadu_si128((const __m128i *)(p + 32)), x4 = _mm_loadu_si128((const __m128i *)(p + 48));
+    __m128i t;
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    for (p += 64, len -= 64; len >= 64; p += 64, len -= 64) {
+#define CRC32_FOLD(x, k, next) \
+        (t = _mm_clmulepi64_si128(x, k, 0x00), x = _mm_clmulepi64_si128(x, k, 0x11), \
+         x = _mm_xor_si128(_mm_xor_si128(x, t), next))
+        CRC32_FOLD(x1, k1k2, _mm_loadu_si128((const __m128i *)p));
+        CRC32_FOLD(x2, k1k2, _mm_loadu_si128((const __m128i *)(p + 16)));
+        CRC32_FOLD(x3, k1k2, _mm_loadu_si128((const __m128i *)(p + 32)));
+        CRC32_FOLD(x4, k1k2, _mm_loadu_si128((const __m128i *)(p + 48)));
+    }
+    /* Repliement des quatre blocs en un, puis des blocs de 16 restants. */
+    CRC32_FOLD(x1, k3k4, x2);
+    CRC32_FOLD(x1, k3k4, x3);
+    CRC32_FOLD(x1, k3k4, x4);
+    for (; len >= 16; p += 16, len -= 16)
+        CRC32_FOLD(x1, k3k4, _mm_loadu_si128((const __m128i *)p));
+#undef CRC32_FOLD
+
+    /* Réduction de 128 à 64 bits, puis à 32 bits. */
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5, 0x00), x2);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), poly, 0x00);
+    return _mm_extract_epi32(_mm_xor_si128(x1, x2), 1);
+}
+#endif
+
+uint32_t stegx_crc32(uint32_t crc, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    pthread_once(&crc32_once, crc32_init);
+    crc = ~crc;
+#if defined(__PCLMUL__) && defined(__SSE4_1__)
+    if (len >= CRC32_CLMUL_MIN) {
+        size_t n = len & ~(size_t)15;
+        crc = crc32_clmul(crc, p, n);
+        p += n, len -= n;
+    }
+#endif
+    return ~crc32_slice8(crc, p, len);
+}
+
+uint64_t sig_hash(uint64_t h, const void *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ ((const uint8_t *)buf)[i]) * FNV64_PRIME;
+    return h;
+}
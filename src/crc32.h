@@ -0,0 +1,61 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file crc32.h
+ * @brief Module qui calcule le CRC-32 (ISO 3309, celui des chunks PNG) et
+ * l'empreinte FNV-1a 64 bits (signatures, index et registre).
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Valeur initiale de l'empreinte FNV-1a 64 bits. */
+#define FNV64_OFFSET 0xcbf29ce484222325ULL
+/** Nombre premier de l'empreinte FNV-1a 64 bits. */
+#define FNV64_PRIME  0x100000001b3ULL
+
+/**
+ * @brief Met à jour un CRC-32 avec de nouvelles données.
+ * @details Le calcul se fait 8 octets à la fois (tables "slice-by-8"), ou par
+ * multiplications sans retenue quand le processeur cible les permet
+ * (compilation avec PCLMUL et SSE4.1). Les CRC de données consécutives
+ * s'enchaînent : stegx_crc32(stegx_crc32(0, a, n), b, m) est le CRC de a
+ * suivi de b.
+ * @param crc CRC des données précédentes (0 au début).
+ * @param buf Données.
+ * @param len Taille des données.
+ * @return CRC des données précédentes suivies de buf.
+ * @author StegX Team
+ */
+uint32_t stegx_crc32(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * @brief Ajoute des données à une empreinte FNV-1a 64 bits.
+ * @param h Empreinte des données précédentes (FNV64_OFFSET au départ).
+ * @param buf Données.
+ * @param len Taille des données.
+ * @return Nouvelle empreinte.
+ * @author StegX Team
+ */
+uint64_t sig_hash(uint64_t h, const void *buf, size_t len);
+
+#endif
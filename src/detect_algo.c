@@ -32,48 +32,96 @@
 #include "stegx_errors.h"
 #include "common.h"
 #include "sugg_algo.h"
+#include "detect_algo.h"
+#include "crc32.h"
 
-/** 
- * @brief Lit la signature contenu dans le fichier hôte.
- * @sideeffect Renseigne la structure \r{infos_s} avec les informations
- * contenues dans la signature.
- * @error \r{ERR_NEED_PASSWD} si le récepteur n'as pas fourni de mot de passe
- * alors qu'il aurait dû.
- * @param infos Structure représentant les informations concernant l'extraction.
- * @return 0 si la signature a bien été lue, sinon 1 et assigne \r{stegx_errno}
- * à l'erreur survenue.
- * @author Pierre Ayoub et Damien Delaunay
- */
-static int read_signature(info_s * infos)
+void sig_name_xor(char *name, size_t len, const char *passwd)
 {
-    assert(infos && infos->mode == STEGX_MODE_EXTRACT);
+    for (size_t i = 0, j = 0; i < len; i++) {
+        name[i] = name[i] ^ passwd[j];
+        j = passwd[j + 1] ? j + 1 : 0;  /* Boucle sur le mot de passe. */
+    }
+}
 
-    /* Longueur du nom du fichier caché. */
-    uint8_t length_hidden_name;
+size_t sig_size(const uint8_t * sig, size_t avail)
+{
+    uint32_t len;
+    if (avail < LENGTH_SIG_HEAD || sig[0] > STEGX_WITH_PASSWD || sig[1] >= STEGX_NB_ALGO)
+        return 0;
+    memcpy(&len, sig + 2, sizeof(len));
+    size_t n = LENGTH_SIG_HEAD + sig[LENGTH_SIG_HEAD - 1]
+        + (sig[0] == STEGX_WITHOUT_PASSWD ? LENGTH_DEFAULT_PASSWD : 0);
+    return len && n <= avail ? n : 0;
+}
 
-    /* Saut à l'offset de la signature. Il faut prendre en compte les
-     * spécificités de chaque format. */
+int sig_footer_test(const uint8_t * footer)
+{
+    uint32_t magic;
+    memcpy(&magic, footer, sizeof(magic));
+    return magic == SIG_FOOTER_MAGIC && footer[4] == SIG_VERSION;
+}
+
+long sig_footer(info_s * infos)
+{
+    assert(infos && infos->host.host);
+    FILE *f = infos->host.host;
+    uint8_t footer[LENGTH_SIG_FOOTER], sig[LENGTH_SIG_MAX];
+    long size;
+    if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < LENGTH_SIG_FOOTER + LENGTH_SIG_HEAD
+        || fseek(f, size - LENGTH_SIG_FOOTER, SEEK_SET)
+        || fread(footer, sizeof(uint8_t), LENGTH_SIG_FOOTER, f) != LENGTH_SIG_FOOTER
+        || !sig_footer_test(footer))
+        return -1;
+    uint64_t pos, hash;
+    memcpy(&pos, footer + 8, sizeof(pos));
+    memcpy(&hash, footer + 16, sizeof(hash));
+    size -= LENGTH_SIG_FOOTER;
+    if (!pos || pos > (uint64_t) size - LENGTH_SIG_HEAD || fseek(f, pos, SEEK_SET)
+        || fread(sig, sizeof(uint8_t), LENGTH_SIG_HEAD, f) != LENGTH_SIG_HEAD)
+        return -1;
+    /* Relecture de toute la signature pour vérifier l'empreinte : un pied
+     * laissé par un fichier recopié ou modifié n'est pas utilisé. */
+    size_t n = sig[LENGTH_SIG_HEAD - 1] + (sig[0] == STEGX_WITHOUT_PASSWD ? LENGTH_DEFAULT_PASSWD : 0);
+    if (pos + LENGTH_SIG_HEAD + n > (uint64_t) size
+        || fread(sig + LENGTH_SIG_HEAD, sizeof(uint8_t), n, f) != n)
+        return -1;
+    hash ^= sig_hash(sig_hash(FNV64_OFFSET, sig, LENGTH_SIG_HEAD + n), footer, 16);
+    return hash ? -1 : (long)pos;
+}
 
+long sig_offset(info_s * infos)
+{
+    assert(infos && infos->host.host);
     /* BMP, PNG et WAVE (car ils ont tout les trois "header_size" et "data_size"
      * en "uint32_t" au début de leurs structures). */
-    if ((infos->host.type >= BMP_COMPRESSED) && (infos->host.type <= PNG)) {
-        if (fseek(infos->host.host, infos->host.file_info.wav.header_size +
-                  infos->host.file_info.wav.data_size, SEEK_SET))
-            return perror("BMP, PNG & WAVE: Can't move to StegX signature"), 1;
-    } else if (infos->host.type == MP3) {
-        if (fseek(infos->host.host, infos->host.file_info.mp3.eof, SEEK_SET))
-            return perror("MP3: Can't move to StegX signature"), 1;
-    } else if (infos->host.type == AVI_COMPRESSED || infos->host.type == AVI_UNCOMPRESSED) {
-        fseek(infos->host.host, 4, SEEK_SET);
+    if ((infos->host.type >= BMP_COMPRESSED) && (infos->host.type <= PNG))
+        return (long)infos->host.file_info.wav.header_size + infos->host.file_info.wav.data_size;
+    else if (infos->host.type == MP3)
+        return infos->host.file_info.mp3.eof;
+    else if (infos->host.type == AVI_COMPRESSED || infos->host.type == AVI_UNCOMPRESSED) {
         uint32_t file_size;
-        if (!(fread(&file_size, sizeof(uint32_t), 1, infos->host.host)))
-            return perror("AVI: can't read file_size"), 1;
-        if (fseek(infos->host.host, file_size + 8, SEEK_SET))
-            return perror("AVI: Can't move to StegX signature"), 1;
-    } else if (infos->host.type == FLV) {
-        if (fseek(infos->host.host, infos->host.file_info.flv.file_size, SEEK_SET))
-            return perror("FLV: Can't move to StegX signature"), 1;
-    }
+        if (fseek(infos->host.host, 4, SEEK_SET)
+            || !(fread(&file_size, sizeof(uint32_t), 1, infos->host.host)))
+            return perror("AVI: can't read file_size"), -1;
+        return (long)file_size + 8;
+    } else if (infos->host.type == FLV)
+        return infos->host.file_info.flv.file_size;
+    return -1;
+}
+
+int sig_read(info_s * infos, int decode, uint8_t * name_len)
+{
+    assert(infos && infos->mode == STEGX_MODE_EXTRACT);
+
+    /* Longueur du nom du fichier caché. */
+    uint8_t length_hidden_name;
+
+    /* Saut à l'offset de la signature : donné par le pied (version 2), sinon
+     * juste après la fin naturelle de l'hôte (version 1). */
+    if (!infos->sig_pos && (infos->sig_pos = sig_footer(infos)) == -1)
+        infos->sig_pos = sig_offset(infos);
+    if (infos->sig_pos == -1 || fseek(infos->host.host, infos->sig_pos, SEEK_SET))
+        return infos->sig_pos = 0, perror("Sig: Can't move to StegX signature"), 1;
 
     /* Lecture de l'algorithme utilisé et de la méthode de protection utilisée. */
     if (fread(&(infos->method), sizeof(uint8_t), 1, infos->host.host) != 1)
@@ -83,7 +131,7 @@ static int read_signature(info_s * infos)
 
     /* Si l'émetteur a fournis un mot de passe et que le récepteur n'en a pas
      * fourni, on lève une erreur. */
-    if ((infos->method == STEGX_WITH_PASSWD) && (infos->passwd == NULL))
+    if (decode && (infos->method == STEGX_WITH_PASSWD) && (infos->passwd == NULL))
         return stegx_errno = ERR_NEED_PASSWD, 1;
 
     /* Lecture de la taille du fichier caché. */
@@ -94,8 +142,7 @@ static int read_signature(info_s * infos)
     /* Lecture de la taille du nom du fichier caché + allocation. */
     if (fread(&length_hidden_name, sizeof(uint8_t), 1, infos->host.host) != 1)
         return perror("Sig: Can't read name length of hidden file"), 1;
-    free(infos->hidden_name);
-    if (!(infos->hidden_name = calloc((length_hidden_name + 1), sizeof(char))))
+    if (!(infos->hidden_name = arena_calloc(&infos->arena, length_hidden_name + 1, sizeof(char))))
         return perror("Sig: Can't calloc for name of hidden file"), 1;
 
     /* Lecture du nom du fichier caché XOR avec le mot de passe (choisi par
@@ -109,9 +156,8 @@ static int read_signature(info_s * infos)
      * ce dernier. */
     if (infos->method == STEGX_WITHOUT_PASSWD) {
         /* Si l'utilisateur tape un mot de passe alors qu'il n'en a pas besoin,
-         * il faut vider la memoire et réallouer par dessus. */
-        free(infos->passwd);
-        if (!(infos->passwd = calloc((LENGTH_DEFAULT_PASSWD + 1), sizeof(char))))
+         * il est remplacé (l'ancien est rendu avec la mémoire du traitement). */
+        if (!(infos->passwd = arena_calloc(&infos->arena, LENGTH_DEFAULT_PASSWD + 1, sizeof(char))))
             return perror("Sig: Can't calloc password"), 1;
         if (fread(infos->passwd, sizeof(char), LENGTH_DEFAULT_PASSWD, infos->host.host) !=
             LENGTH_DEFAULT_PASSWD)
@@ -119,10 +165,10 @@ static int read_signature(info_s * infos)
     }
 
     /* DéXOR du nom du fichier cacher. */
-    for (int i = 0, j = 0; i < length_hidden_name; i++) {
-        infos->hidden_name[i] = infos->hidden_name[i] ^ infos->passwd[j];
-        j = infos->passwd[j + 1] ? j + 1 : 0;   /* Boucle sur le mot de passe. */
-    }
+    if (name_len)
+        *name_len = length_hidden_name;
+    if (decode)
+        sig_name_xor(infos->hidden_name, length_hidden_name, infos->passwd);
     return 0;
 }
 
@@ -139,13 +185,38 @@ int sig_fseek(FILE * f, char *h, method_e m)
 
 int stegx_detect_algo(info_s * infos)
 {
-    /* Vérifie le mode d'utilisation, puis remplit la structure afin d'avoir la
-     * structure spécifique de "infos->host.file_info". */
-    if (infos->mode == STEGX_MODE_INSERT || fill_host_info(infos))
-        return stegx_errno = ERR_DETECT_ALGOS, 1;
+    /* Vérifie le mode d'utilisation, puis cherche la signature : son pied
+     * (version 2) donne son adresse, sinon (version 1) il faut remplir la
+     * structure spécifique de "infos->host.file_info", donc parcourir tout
+     * l'hôte, pour trouver sa fin naturelle. */
+    if (infos->mode == STEGX_MODE_INSERT
+        || ((infos->sig_pos = sig_footer(infos)) == -1
+            && (fill_host_info(infos) || (infos->sig_pos = sig_offset(infos)) == -1)))
+        return stegx_errno =
+            progress_fail(&infos->progress, &infos->res, infos->res_path, ERR_DETECT_ALGOS), 1;
     /* Lecture de la signature pour connaître l'algorithme, la méthode,
        la taille des données cachées et le nom du fichier caché. */
-    if (read_signature(infos))
+    if (sig_read(infos, 1, NULL))
         return stegx_errno == ERR_NEED_PASSWD ? 1 : (stegx_errno = ERR_DETECT_ALGOS), 1;
+    /* EOF et JUNK_CHUNK lisent les données juste après la signature, METADATA
+     * sur FLV dans le premier tag : seuls les autres algorithmes ont besoin de
+     * l'analyse de l'hôte. */
+    if (infos->algo != STEGX_ALGO_EOF && infos->algo != STEGX_ALGO_JUNK_CHUNK
+        && (infos->algo != STEGX_ALGO_METADATA || infos->host.type != FLV)
+        && fill_host_info(infos))
+        return stegx_errno =
+            progress_fail(&infos->progress, &infos->res, infos->res_path, ERR_DETECT_ALGOS), 1;
     return 0;
 }
+
+const char *stegx_hidden_name(const info_s * infos)
+{
+    assert(infos && infos->hidden_name);
+    return infos->hidden_name;
+}
+
+algo_e stegx_detected_algo(const info_s * infos)
+{
+    assert(infos && infos->mode == STEGX_MODE_EXTRACT);
+    return infos->algo;
+}
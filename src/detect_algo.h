@@ -25,6 +25,80 @@
 #ifndef DETECT_ALGO_H
 #define DETECT_ALGO_H
 
+#include <stdio.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * @brief Calcule la taille d'une signature en mémoire si elle est plausible.
+ * @param sig Début de la signature.
+ * @param avail Nombre d'octets lisibles à partir de "sig".
+ * @return Taille de la signature, 0 si la méthode, l'algorithme ou la taille
+ * des données sont invalides ou si la signature dépasse "avail".
+ * @author StegX Team
+ */
+size_t sig_size(const uint8_t * sig, size_t avail);
+
+/**
+ * @brief Teste l'identifiant et la version d'un pied de signature.
+ * @param footer Les \r{LENGTH_SIG_FOOTER} derniers octets d'un fichier.
+ * @return 1 si c'est un pied de signature StegX, 0 sinon.
+ * @author StegX Team
+ */
+int sig_footer_test(const uint8_t * footer);
+
+/**
+ * @brief Lit le pied de signature (version 2) à la fin du fichier hôte.
+ * @details Ne lit que la fin du fichier et la signature désignée par le pied,
+ * dont l'empreinte est vérifiée : l'hôte n'a pas besoin d'être analysé.
+ * @param infos Structure représentant les informations concernant
+ * l'extraction.
+ * @return Offset de la signature, -1 si le fichier n'a pas de pied valide
+ * (signature version 1 seule).
+ * @author StegX Team
+ */
+long sig_footer(info_s * infos);
+
+/** 
+ * @brief Calcule l'offset de la signature, juste après la fin naturelle du
+ * fichier hôte.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation (hôte analysé).
+ * @return Offset de la signature, -1 en cas d'erreur.
+ * @author StegX Team
+ */
+long sig_offset(info_s * infos);
+
+/** 
+ * @brief Lit la signature contenu dans le fichier hôte.
+ * @details La signature est cherchée à l'offset donné par "infos->sig_pos"
+ * s'il est connu, sinon avec \r{sig_footer} puis \r{sig_offset}.
+ * @sideeffect Renseigne la structure \r{infos_s} avec les informations
+ * contenues dans la signature.
+ * @error \r{ERR_NEED_PASSWD} si le récepteur n'as pas fourni de mot de passe
+ * alors qu'il aurait dû.
+ * @param infos Structure représentant les informations concernant l'extraction.
+ * @param decode 1 pour déXORer le nom du fichier caché avec le mot de passe,
+ * 0 pour le laisser tel qu'il est dans la signature (le mot de passe n'est
+ * alors pas requis).
+ * @param name_len Si non NULL, reçoit la longueur du nom du fichier caché (le
+ * nom non déXORé peut contenir des '\0').
+ * @return 0 si la signature a bien été lue, sinon 1 et assigne \r{stegx_errno}
+ * à l'erreur survenue.
+ * @author StegX Team
+ */
+int sig_read(info_s * infos, int decode, uint8_t * name_len);
+
+/**
+ * @brief DéXOR (ou XOR) le nom du fichier caché avec le mot de passe.
+ * @param name Nom à déXORer (modifié).
+ * @param len Longueur du nom.
+ * @param passwd Mot de passe (non vide), répété sur toute la longueur du nom.
+ * @author StegX Team
+ */
+void sig_name_xor(char *name, size_t len, const char *passwd);
+
 /**
  * @brief Saute la signature.
  * @param f Pointeur sur le fichier ou faire le saut.
@@ -0,0 +1,634 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file diff.c
+ * @brief Comparaison d'un fichier suspect avec son original.
+ * @details Seul le fournisseur a l'original : comparer une copie diffusée
+ * avec lui retrouve les données cachées même si la signature a été retirée.
+ *
+ * Les deux fichiers sont projetés et parcourus ensemble. Les zones égales
+ * sont sautées par blocs de 64 octets comparés en SSE2 (le parcours est
+ * limité par la bande passante mémoire). À chaque différence, on cherche
+ * d'abord un réalignement sur place (modification, par exemple des bits de
+ * poids faible ou un champ d'en-tête), sinon un décalage (octets insérés ou
+ * supprimés) en cherchant un bloc de l'original plus loin dans le fichier
+ * suspect, ou l'inverse.
+ *
+ * Sans signature, l'algorithme et la taille des données sont déduits des
+ * différences et de la fin naturelle des deux fichiers (\r{sig_offset}). Pour
+ * extraire les données, une signature est alors reconstituée dans une image
+ * du fichier suspect, qui passe ensuite par l'extraction habituelle. En LSB,
+ * seule une borne de la taille est connue : l'original reçoit la même
+ * signature et les octets extraits de la fin identiques dans les deux
+ * fichiers ne font pas partie des données.
+ *
+ * Sans mot de passe, les données ne dépendent que de la clé
+ * (\r{stegx_trial_key}) : toutes les clés des mots de passe ASCII d'au plus
+ * \r{LENGTH_DEFAULT_PASSWD} caractères, dont ceux choisis par StegX, peuvent
+ * être essayées contre un registre des empreintes.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+#include "stegx.h"
+#include "detect_algo.h"
+#include "sugg_algo.h"
+#include "protection.h"
+#include "host_shared.h"
+
+/** Nombre d'octets égaux qui réalignent les deux fichiers. */
+#define DIFF_ANCHOR 16
+
+/** Longueur maximale d'une modification sur place avant de chercher un
+ * décalage (octets). */
+#define DIFF_RUN 64
+
+/** Première fenêtre de recherche d'un décalage (octets), multipliée par 16
+ * tant que le bloc n'est pas trouvé. */
+#define DIFF_WINDOW 4096
+
+/** Plus grande clé essayée sans mot de passe (mots de passe ASCII d'au plus
+ * \r{LENGTH_DEFAULT_PASSWD} caractères). */
+#define DIFF_KEY_MAX (127 * LENGTH_DEFAULT_PASSWD)
+
+/**
+ * @brief Comparaison d'un fichier suspect avec son original.
+ */
+struct stegx_diff {
+    stegx_host_s *orig;         /*!< Original projeté et analysé. */
+    stegx_host_s *suspect;      /*!< Fichier suspect projeté et analysé. */
+    stegx_host_s *repaired;     /*!< Fichier suspect avec une signature reconstituée (sans signature seulement). */
+    stegx_host_s *background;   /*!< Original avec la même signature (LSB sans signature seulement). */
+    long orig_end;              /*!< Fin naturelle de l'original (offset de la signature). */
+    long suspect_end;           /*!< Fin naturelle du fichier suspect (offset de la signature). */
+    stegx_diff_region_s *regions;       /*!< Zones de différence. */
+    size_t max_regions;         /*!< Nombre de zones allouées. */
+    stegx_diff_info_s info;     /*!< Résultat de la comparaison. */
+};
+
+/**
+ * @brief Donne la longueur du préfixe commun de deux zones.
+ * @param a Première zone.
+ * @param b Seconde zone.
+ * @param n Taille des zones.
+ * @return Nombre d'octets égaux avant la première différence (n si aucune).
+ * @author StegX Team
+ */
+static size_t diff_equal(const uint8_t * a, const uint8_t * b, size_t n)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    /* 64 octets par tour : quatre XOR combinés, un seul test. */
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 64 <= n; i += 64) {
+        __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                                   _mm_loadu_si128((const __m128i *)(b + i)));
+        __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 16)),
+                                   _mm_loadu_si128((const __m128i *)(b + i + 16)));
+        __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 32)),
+                                   _mm_loadu_si128((const __m128i *)(b + i + 32)));
+        __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 48)),
+                                   _mm_loadu_si128((const __m128i *)(b + i + 48)));
+        __m128i x = _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF)
+            break;
+    }
+    for (; i + 16 <= n; i += 16) {
+        int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                                                  _mm_loadu_si128((const __m128i *)(b + i))));
+        if (eq != 0xFFFF)
+            return i + __builtin_ctz(~eq);
+    }
+#else
+    for (uint64_t x, y; i + sizeof(x) <= n; i += sizeof(x)) {
+        memcpy(&x, a + i, sizeof(x)), memcpy(&y, b + i, sizeof(y));
+        if (x != y)
+            break;
+    }
+#endif
+    while (i < n && a[i] == b[i])
+        i++;
+    return i;
+}
+
+/**
+ * @brief Cherche un réalignement sur place après une différence.
+ * @param a Zone de l'original commençant par la différence.
+ * @param b Zone du fichier suspect commençant par la différence.
+ * @param n Taille des zones.
+ * @return Longueur de la modification avant \r{DIFF_ANCHOR} octets égaux
+ * (n si la fin est atteinte avant), 0 si les fichiers ne se réalignent pas
+ * dans les \r{DIFF_RUN} premiers octets.
+ * @author StegX Team
+ */
+static size_t diff_resync(const uint8_t * a, const uint8_t * b, size_t n)
+{
+    for (size_t k = 0, streak = 0; k < n; k++) {
+        streak = a[k] == b[k] ? streak + 1 : 0;
+        if (streak == DIFF_ANCHOR)
+            return k + 1 - DIFF_ANCHOR;
+        if (k + 1 - streak > DIFF_RUN)
+            return 0;
+    }
+    return n;
+}
+
+/**
+ * @brief Cherche un décalage après une différence.
+ * @details Des blocs du fichier qui a le moins d'octets restants sont
+ * cherchés plus loin dans l'autre, dans des fenêtres de plus en plus grandes
+ * (un petit décalage est trouvé sans parcourir tout le reste du fichier).
+ * @param o Reste de l'original (commençant par la différence).
+ * @param no Taille du reste de l'original.
+ * @param s Reste du fichier suspect (commençant par la différence).
+ * @param ns Taille du reste du fichier suspect.
+ * @return Nombre d'octets insérés dans le fichier suspect (positif) ou
+ * supprimés de l'original (négatif), 0 si aucun décalage n'est trouvé.
+ * @author StegX Team
+ */
+static int64_t diff_shift(const uint8_t * o, size_t no, const uint8_t * s, size_t ns)
+{
+    int ins = ns > no;
+    const uint8_t *x = ins ? o : s, *y = ins ? s : o;
+    size_t nx = ins ? no : ns, r = ins ? ns - no : no - ns;
+    if (!r)
+        return 0;
+    for (size_t w = DIFF_WINDOW;; w *= 16) {
+        size_t lim = w < r ? w : r;
+        for (size_t a = 0; a <= DIFF_RUN && a + DIFF_ANCHOR <= nx; a += DIFF_ANCHOR) {
+            const uint8_t *p = memmem(y + a + 1, lim + DIFF_ANCHOR - 1, x + a, DIFF_ANCHOR);
+            if (p)
+                return ins ? p - (y + a) : -(p - (y + a));
+        }
+        if (lim == r)
+            return 0;
+    }
+}
+
+/**
+ * @brief Ajoute une zone de différence (fusionnée avec la précédente si elle
+ * la prolonge).
+ * @param d Comparaison en cours.
+ * @param kind Nature de la zone.
+ * @param j Début dans le fichier suspect.
+ * @param i Début dans l'original.
+ * @param len Taille de la zone.
+ * @return 0 si la zone est ajoutée, 1 sinon.
+ * @author StegX Team
+ */
+static int region_add(stegx_diff_s * d, diff_kind_e kind, uint64_t j, uint64_t i, uint64_t len)
+{
+    stegx_diff_region_s *last = d->info.nb_regions ? &d->regions[d->info.nb_regions - 1] : NULL;
+    /* Deux modifications proches (même décalage) forment une seule zone, de
+     * même que deux insertions ou deux suppressions qui se suivent. */
+    int merge = last && last->kind == kind;
+    if (merge && kind == STEGX_DIFF_MODIFIED)
+        merge = last->offset - last->orig_offset == j - i && j - (last->offset + last->length) < DIFF_RUN;
+    else if (merge && kind == STEGX_DIFF_INSERTED)
+        merge = i == last->orig_offset && j == last->offset + last->length;
+    else if (merge)
+        merge = j == last->offset && i == last->orig_offset + last->length;
+    if (merge) {
+        last->length = kind == STEGX_DIFF_MODIFIED ? j + len - last->offset : last->length + len;
+        return 0;
+    }
+    if (d->info.nb_regions == d->max_regions) {
+        size_t max = d->max_regions ? d->max_regions * 2 : 64;
+        stegx_diff_region_s *tmp = realloc(d->regions, max * sizeof(*tmp));
+        if (!tmp)
+            return perror("Can't allocate memory for diff regions"), 1;
+        d->regions = tmp, d->max_regions = max;
+    }
+    d->regions[d->info.nb_regions++] = (stegx_diff_region_s) {.kind = kind,.offset = j,
+        .orig_offset = i,.length = len
+    };
+    return 0;
+}
+
+/**
+ * @brief Compte les octets modifiés d'une zone modifiée sur place.
+ * @param d Comparaison en cours.
+ * @param a Zone de l'original.
+ * @param b Zone du fichier suspect.
+ * @param n Taille de la zone.
+ * @author StegX Team
+ */
+static void diff_count(stegx_diff_s * d, const uint8_t * a, const uint8_t * b, size_t n)
+{
+    for (size_t k = 0; k < n; k++) {
+        uint8_t x = a[k] ^ b[k];
+        d->info.nb_modified += x != 0;
+        d->info.nb_lsb += x && !(x & 0xFC);
+    }
+}
+
+/**
+ * @brief Aligne les deux fichiers et relève les zones de différence.
+ * @param d Comparaison en cours.
+ * @return 0 si la comparaison s'est bien passée, 1 sinon.
+ * @author StegX Team
+ */
+static int diff_align(stegx_diff_s * d)
+{
+    const uint8_t *o = d->orig->addr, *s = d->suspect->addr;
+    size_t no = d->orig->size, ns = d->suspect->size, i = 0, j = 0;
+    while (i < no && j < ns) {
+        size_t n = no - i < ns - j ? no - i : ns - j, m = diff_equal(o + i, s + j, n);
+        i += m, j += m, n -= m;
+        if (!n)
+            break;
+        /* Modification sur place. */
+        size_t e = diff_resync(o + i, s + j, n);
+        if (e) {
+            diff_count(d, o + i, s + j, e);
+            if (region_add(d, STEGX_DIFF_MODIFIED, j, i, e))
+                return 1;
+            i += e, j += e;
+            continue;
+        }
+        /* Octets insérés ou supprimés. */
+        int64_t k = diff_shift(o + i, no - i, s + j, ns - j);
+        if (k > 0 && region_add(d, STEGX_DIFF_INSERTED, j, i, k))
+            return 1;
+        if (k < 0 && region_add(d, STEGX_DIFF_REMOVED, j, i, -k))
+            return 1;
+        if (k) {
+            d->info.nb_inserted += k > 0 ? k : 0;
+            d->info.nb_removed += k < 0 ? -k : 0;
+            j += k > 0 ? k : 0, i += k < 0 ? -k : 0;
+            continue;
+        }
+        /* Ni l'un ni l'autre : modification dense (LSB séquentiel). */
+        diff_count(d, o + i, s + j, DIFF_RUN);
+        if (region_add(d, STEGX_DIFF_MODIFIED, j, i, DIFF_RUN))
+            return 1;
+        i += DIFF_RUN, j += DIFF_RUN;
+    }
+    if (i < no && region_add(d, STEGX_DIFF_REMOVED, j, i, no - i))
+        return 1;
+    if (j < ns && region_add(d, STEGX_DIFF_INSERTED, j, i, ns - j))
+        return 1;
+    d->info.nb_removed += no - i;
+    d->info.nb_inserted += ns - j;
+    return 0;
+}
+
+/**
+ * @brief Cherche la zone de différence contenant un octet du fichier suspect.
+ * @param d Comparaison faite.
+ * @param off Offset dans le fichier suspect.
+ * @return Zone trouvée (modifiée ou insérée), NULL si l'octet est inchangé.
+ * @author StegX Team
+ */
+static const stegx_diff_region_s *region_find(const stegx_diff_s * d, uint64_t off)
+{
+    for (size_t k = 0; k < d->info.nb_regions; k++) {
+        const stegx_diff_region_s *r = &d->regions[k];
+        if (r->kind != STEGX_DIFF_REMOVED && off >= r->offset && off < r->offset + r->length)
+            return r;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Teste si une signature peut se trouver à la fin naturelle du
+ * fichier suspect, sans la lire.
+ * @details Évite les messages d'erreur de \r{sig_read} sur un fichier dont la
+ * signature a été retirée.
+ * @param d Comparaison faite.
+ * @return 1 si la signature est plausible, 0 sinon.
+ * @author StegX Team
+ */
+static int sig_plausible(const stegx_diff_s * d)
+{
+    return (size_t)d->suspect_end < d->suspect->size
+        && sig_size((const uint8_t *)d->suspect->addr + d->suspect_end,
+                    d->suspect->size - d->suspect_end);
+}
+
+/**
+ * @brief Lit la signature du fichier suspect, ou déduit l'algorithme et la
+ * taille des données des différences si elle a été retirée.
+ * @param d Comparaison faite.
+ * @return 0 si l'analyse s'est bien passée, 1 sinon.
+ * @author StegX Team
+ */
+static int diff_classify(stegx_diff_s * d)
+{
+    info_s o = {.mode = STEGX_MODE_EXTRACT }, s = {.mode = STEGX_MODE_EXTRACT };
+    if (host_shared_attach(&o, d->orig) || host_shared_attach(&s, d->suspect))
+        return o.host.host ? fclose(o.host.host) : 0, 1;
+    int err = (d->orig_end = sig_offset(&o)) == -1 || (d->suspect_end = sig_offset(&s)) == -1;
+
+    /* Signature présente : elle est lue sans mot de passe et doit se trouver
+     * dans une zone de différence. */
+    stegx_diff_info_s *info = &d->info;
+    uint8_t name_len;
+    if (!err && info->nb_regions && sig_plausible(d) && !sig_read(&s, 0, &name_len)
+        && s.hidden_length && s.hidden_length <= info->suspect_size
+        && region_find(d, d->suspect_end)) {
+        info->signature = 1;
+        info->algo = s.algo, info->method = s.method, info->hidden_length = s.hidden_length;
+    }
+    /* Signature retirée : la place des différences donne l'algorithme. */
+    else if (!err && info->nb_regions) {
+        uint64_t grown = d->suspect_end > d->orig_end ? d->suspect_end - d->orig_end : 0;
+        uint64_t tail = info->suspect_size - d->suspect_end;
+        /* Un pied de signature laissé à la fin ne fait pas partie des données. */
+        if (tail >= LENGTH_SIG_FOOTER
+            && sig_footer_test((uint8_t *) d->suspect->addr + info->suspect_size - LENGTH_SIG_FOOTER))
+            tail -= LENGTH_SIG_FOOTER;
+        info->method = STEGX_WITH_PASSWD;
+        if ((s.host.type == BMP_COMPRESSED || s.host.type == BMP_UNCOMPRESSED) && grown)
+            info->algo = STEGX_ALGO_METADATA, info->hidden_length = grown;
+        else if (s.host.type == PNG && grown > 2 * 16)
+            /* Deux chunks tEXt : taille, type, "STEGX" et CRC. */
+            info->algo = STEGX_ALGO_METADATA, info->hidden_length = grown - 2 * 16;
+        else if (s.host.type == FLV && grown > FLV_METADATA_OVERHEAD
+                 && s.host.file_info.flv.nb_metadata_tag > o.host.file_info.flv.nb_metadata_tag)
+            /* Un tag de script ajouté après le header. */
+            info->algo = STEGX_ALGO_METADATA, info->hidden_length = grown - FLV_METADATA_OVERHEAD;
+        else if (s.host.type == FLV && grown > s.host.file_info.flv.nb_video_tag)
+            /* Un octet de séparation par tag vidéo. */
+            info->algo = STEGX_ALGO_EOC, info->hidden_length = grown - s.host.file_info.flv.nb_video_tag;
+        else if (tail && region_find(d, d->suspect_end))
+            info->algo = s.host.type == AVI_COMPRESSED || s.host.type == AVI_UNCOMPRESSED
+                ? STEGX_ALGO_JUNK_CHUNK : STEGX_ALGO_EOF, info->hidden_length = tail;
+        else if (info->nb_modified) {
+            /* LSB : la capacité borne la taille ; en LSB séquentiel, la
+             * dernière modification aussi (4 octets de l'hôte par octet). */
+            uint64_t len = host_capacity(&s, STEGX_ALGO_LSB), last = 0;
+            for (size_t k = 0; k < info->nb_regions; k++)
+                if (d->regions[k].kind == STEGX_DIFF_MODIFIED)
+                    last = d->regions[k].offset + d->regions[k].length;
+            if ((s.host.type == BMP_UNCOMPRESSED && s.host.file_info.bmp.data_size > LENGTH_FILE_MAX)
+                || s.host.type == WAV_PCM) {
+                uint64_t seq = last > s.host.file_info.bmp.header_size
+                    ? (last - s.host.file_info.bmp.header_size + 3) / 4 : 0;
+                len = seq < len ? seq : len;
+            }
+            /* L'extraction MP3 lit le header qui suit le dernier octet : une
+             * frame doit rester après les données. */
+            if (s.host.type == MP3 && len)
+                len--;
+            info->algo = STEGX_ALGO_LSB, info->hidden_length = len < UINT32_MAX ? len : UINT32_MAX;
+        }
+    }
+    fclose(o.host.host), fclose(s.host.host);
+    arena_free(&o.arena), arena_free(&s.arena);
+    return err;
+}
+
+stegx_diff_s *stegx_diff(const char *orig_path, const char *suspect_path)
+{
+    assert(orig_path && suspect_path);
+    stegx_diff_s *d = calloc(1, sizeof(*d));
+    if (!d)
+        return perror("Can't allocate memory for diff"), stegx_errno = ERR_OTHER, NULL;
+    if (!(d->orig = stegx_host_open(orig_path, STEGX_MODE_EXTRACT))
+        || !(d->suspect = stegx_host_open(suspect_path, STEGX_MODE_EXTRACT)))
+        return stegx_diff_close(d), NULL;
+    if (d->orig->type != d->suspect->type)
+        return stegx_diff_close(d), stegx_errno = ERR_DIFF, NULL;
+    /* Les deux fichiers sont lus d'un bout à l'autre. */
+    madvise(d->orig->addr, d->orig->size, MADV_SEQUENTIAL);
+    madvise(d->suspect->addr, d->suspect->size, MADV_SEQUENTIAL);
+    d->info = (stegx_diff_info_s) {.orig_size = d->orig->size,.suspect_size = d->suspect->size,
+        .algo = STEGX_NB_ALGO
+    };
+    if (diff_align(d) || diff_classify(d))
+        return stegx_diff_close(d), stegx_errno = ERR_OTHER, NULL;
+    d->info.regions = d->regions;
+    return d;
+}
+
+const stegx_diff_info_s *stegx_diff_info(const stegx_diff_s * d)
+{
+    assert(d);
+    return &d->info;
+}
+
+/**
+ * @brief Crée l'image d'un fichier avec une signature reconstituée.
+ * @param h Fichier d'origine.
+ * @param at Offset de la signature.
+ * @param algo Algorithme de la signature.
+ * @param len Taille des données de la signature.
+ * @return Fichier avec la signature (à fermer avec \r{stegx_host_close}),
+ * NULL en cas d'erreur.
+ * @author StegX Team
+ */
+static stegx_host_s *diff_sign(const stegx_host_s * h, long at, algo_e algo, uint32_t len)
+{
+    uint8_t sig[LENGTH_SIG_HEAD] = { STEGX_WITH_PASSWD, algo };
+    memcpy(sig + 2, &len, sizeof(len));
+    uint8_t *img = malloc(h->size + sizeof(sig));
+    if (!img)
+        return perror("Can't allocate memory for repaired file"), NULL;
+    memcpy(img, h->addr, at);
+    memcpy(img + at, sig, sizeof(sig));
+    memcpy(img + at + sizeof(sig), (uint8_t *) h->addr + at, h->size - at);
+    return host_shared_mem(img, h->size + sizeof(sig), STEGX_MODE_EXTRACT);
+}
+
+/**
+ * @brief Change la taille des données d'une signature reconstituée.
+ * @param h Fichier avec une signature reconstituée.
+ * @param at Offset de la signature.
+ * @param len Nouvelle taille.
+ * @author StegX Team
+ */
+static void diff_sign_length(stegx_host_s * h, long at, uint32_t len)
+{
+    if (h)
+        memcpy((uint8_t *) h->addr + at + 2, &len, sizeof(len));
+}
+
+/**
+ * @brief Prépare l'extraction : reconstitue la signature si elle a été
+ * retirée.
+ * @param d Comparaison faite.
+ * @param passwd Mot de passe (NULL si inconnu).
+ * @return 0 si l'extraction est possible, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+static int diff_prepare(stegx_diff_s * d, const char *passwd)
+{
+    if (d->info.algo == STEGX_NB_ALGO)
+        return stegx_errno = ERR_DETECT_ALGOS, 1;
+    if (d->info.signature || d->repaired)
+        return 0;
+    if (!passwd)
+        return stegx_errno = ERR_NEED_PASSWD, 1;
+    if (!(d->repaired = diff_sign(d->suspect, d->suspect_end, d->info.algo, d->info.hidden_length)))
+        return stegx_errno = ERR_EXTRACT, 1;
+    if (d->info.algo == STEGX_ALGO_LSB
+        && !(d->background = diff_sign(d->orig, d->orig_end, d->info.algo, d->info.hidden_length)))
+        return stegx_host_close(d->repaired), d->repaired = NULL, stegx_errno = ERR_EXTRACT, 1;
+    return 0;
+}
+
+/**
+ * @brief Extrait les données d'un fichier avec un mot de passe.
+ * @param h Fichier (avec sa signature).
+ * @param passwd Mot de passe (NULL accepté si la signature le contient).
+ * @param data Données extraites (à libérer).
+ * @param len Taille des données extraites.
+ * @return 0 si l'extraction s'est bien passée, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+static int diff_run(stegx_host_s * h, const char *passwd, char **data, size_t *len)
+{
+    *data = NULL, *len = 0;
+    FILE *res = open_memstream(data, len);
+    if (!res)
+        return perror("Can't open memory stream for extracted data"), stegx_errno = ERR_EXTRACT, 1;
+    stegx_choices_s choices = {.host_path = "",.res_path = "",.passwd = (char *)passwd,
+        .mode = STEGX_MODE_EXTRACT,.host = h,.res_file = res
+    };
+    info_s *infos = stegx_init(&choices);
+    if (!infos)
+        return fclose(res), free(*data), *data = NULL, 1;
+    int err = stegx_detect_algo(infos) || stegx_extract(infos, "");
+    stegx_clear(infos);
+    if (err)
+        free(*data), *data = NULL;
+    return err;
+}
+
+/**
+ * @brief Extrait les données cachées du fichier suspect.
+ * @param d Comparaison préparée (\r{diff_prepare}).
+ * @param passwd Mot de passe.
+ * @param data Données extraites (à libérer).
+ * @param len Taille des données extraites.
+ * @return 0 si l'extraction s'est bien passée, sinon 1 et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+static int diff_decode(stegx_diff_s * d, const char *passwd, char **data, size_t *len)
+{
+    if (diff_run(d->info.signature ? d->suspect : d->repaired, passwd, data, len))
+        return 1;
+    if (!d->background)
+        return 0;
+    /* LSB sans signature : la fin identique à celle extraite de l'original
+     * ne fait pas partie des données. */
+    char *bg;
+    size_t bg_len;
+    if (diff_run(d->background, passwd, &bg, &bg_len))
+        return free(*data), *data = NULL, 1;
+    size_t n = *len < bg_len ? *len : bg_len;
+    while (n && (*data)[n - 1] == bg[n - 1])
+        n--;
+    *len = n;
+    free(bg);
+    return 0;
+}
+
+int stegx_diff_extract(stegx_diff_s * d, const char *passwd, FILE * res)
+{
+    assert(d && res);
+    char *data;
+    size_t len;
+    if (diff_prepare(d, passwd) || diff_decode(d, passwd, &data, &len))
+        return fclose(res), 1;
+    int err = fwrite(data, sizeof(*data), len, res) != len;
+    free(data);
+    if (fclose(res) || err)
+        return perror("Can't write extracted data"), stegx_errno = ERR_EXTRACT, 1;
+    return 0;
+}
+
+/**
+ * @brief Écrit un mot de passe de clé donnée (\r{create_seed}).
+ * @param key Clé (non nulle).
+ * @param passwd Tampon d'au moins DIFF_KEY_MAX / 127 + 2 octets.
+ * @author StegX Team
+ */
+static void key_passwd(unsigned int key, char *passwd)
+{
+    size_t n = 0;
+    for (; key > 127; key -= 127)
+        passwd[n++] = 127;
+    passwd[n++] = key;
+    passwd[n] = '\0';
+}
+
+int stegx_diff_identify(stegx_diff_s * d, const char *passwd, const stegx_registry_s * r,
+                        stegx_identity_s * id, unsigned int *key)
+{
+    assert(d && r && id);
+    char buf[DIFF_KEY_MAX / 127 + 2];
+    /* Sans mot de passe, toutes les clés sont essayées ; la signature ne
+     * sert plus qu'à l'algorithme et à la taille. */
+    int any = !passwd && !(d->info.signature && d->info.method == STEGX_WITHOUT_PASSWD);
+    if (diff_prepare(d, any ? buf : passwd))
+        return 1;
+    /* Un jeton est court : en LSB sans signature, la borne de la taille est
+     * ramenée juste au-dessus de sa taille maximale. */
+    uint32_t len = d->info.hidden_length;
+    if (d->background && len > STEGX_TOKEN_MAX + 1) {
+        diff_sign_length(d->repaired, d->suspect_end, STEGX_TOKEN_MAX + 1);
+        diff_sign_length(d->background, d->orig_end, STEGX_TOKEN_MAX + 1);
+    } else if (len > STEGX_TOKEN_MAX)
+        return stegx_errno = ERR_REGISTRY, 1;
+
+    int found = 0;
+    for (unsigned int k = 1; !found && k <= (any ? DIFF_KEY_MAX : 1); k++) {
+        char *data;
+        size_t n;
+        if (any)
+            key_passwd(k, buf);
+        const char *p = any ? buf : passwd;
+        if (!diff_decode(d, p, &data, &n)) {
+            found = n && !stegx_registry_lookup(r, data, n, id);
+            if (found && key)
+                *key = p ? stegx_trial_key(p) : 0;
+            free(data);
+        }
+    }
+    diff_sign_length(d->repaired, d->suspect_end, len);
+    diff_sign_length(d->background, d->orig_end, len);
+    return found ? 0 : (stegx_errno = ERR_REGISTRY, 1);
+}
+
+void stegx_diff_close(stegx_diff_s * d)
+{
+    if (!d)
+        return;
+    stegx_host_close(d->orig);
+    stegx_host_close(d->suspect);
+    stegx_host_close(d->repaired);
+    stegx_host_close(d->background);
+    free(d->regions);
+    free(d);
+}
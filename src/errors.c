@@ -29,34 +29,48 @@
 #include "stegx_errors.h"
 
 /* Initialisation. */
-enum err_code stegx_errno = ERR_NONE;
+_Thread_local enum err_code stegx_errno = ERR_NONE;
 
-void err_print(enum err_code err)
+/** Description de chaque code d'erreur (dans l'ordre de l'énumération). */
+static const char *err_desc[] = {
+    /* ERR_NONE */ "aucune erreur",
+    /* ERR_HOST */ "ouverture en lecture du fichier hôte impossible",
+    /* ERR_HIDDEN */ "ouverture en lecture du fichier à chacher impossible",
+    /* ERR_PASSWD */ "mot de passe invalide",
+    /* ERR_RES_EXTRACT */ "le chemin résultat pour l'extraction doit être un dossier",
+    /* ERR_RES_INSERT */ "ouverture en écriture du fichier résultat impossible",
+    /* ERR_READ */ "erreur de lecture",
+    /* ERR_CHECK_COMPAT */
+    "erreur dans le module verification de la compatibilite des fichiers",
+    /* ERR_SUGG_ALGOS */ "erreur dans le sous-module proposition des algos de steganographie",
+    /* ERR_CHOICE_ALGO */
+    "erreur l'algorithme choisi par l'utilisateur n'est proposé par StegX",
+    /* ERR_INSERT */ "erreur dans le sous-module insertion",
+    /* ERR_EXTRACT */ "erreur dans le sous-module extraction",
+    /* ERR_DETECT_ALGOS */
+    "erreur dans le sous-module detection de l'algorithme de steganographie",
+    /* ERR_LENGTH_HIDDEN */ "erreur taille du fichier a cacher trop importante",
+    /* ERR_NEED_PASSWD */ "l'application a besoin d'un mot de passe pour extraire les données",
+    /* ERR_HIDDEN_FILE_EMPTY */ "le fichier caché/à cacher est vide",
+    /* ERR_CACHE */ "ouverture du cache partagé des fichiers hôtes impossible",
+    /* ERR_CANCELED */ "traitement annulé",
+    /* ERR_DEADLINE */ "échéance du traitement dépassée",
+    /* ERR_NO_PASSWD */ "les données cachées ne sont pas protégées par un mot de passe",
+    /* ERR_REGISTRY */ "registre des empreintes invalide ou inaccessible",
+    /* ERR_DIFF */ "le fichier suspect et l'original ne sont pas du même format",
+    /* ERR_OTHER */ "erreur inconnu"
+};
+
+const char *stegx_strerror(enum err_code err)
 {
-    static const char *err_desc[] = {
-        /* ERR_NONE */ "aucune erreur",
-        /* ERR_HOST */ "ouverture en lecture du fichier hôte impossible",
-        /* ERR_HIDDEN */ "ouverture en lecture du fichier à chacher impossible",
-        /* ERR_PASSWD */ "mot de passe invalide",
-        /* ERR_RES_EXTRACT */ "le chemin résultat pour l'extraction doit être un dossier",
-        /* ERR_RES_INSERT */ "ouverture en écriture du fichier résultat impossible",
-        /* ERR_READ */ "erreur de lecture",
-        /* ERR_CHECK_COMPAT */
-        "erreur dans le module verification de la compatibilite des fichiers",
-        /* ERR_SUGG_ALGOS */ "erreur dans le sous-module proposition des algos de steganographie",
-        /* ERR_CHOICE_ALGO */
-        "erreur l'algorithme choisi par l'utilisateur n'est proposé par StegX",
-        /* ERR_INSERT */ "erreur dans le sous-module insertion",
-        /* ERR_EXTRACT */ "erreur dans le sous-module extraction",
-        /* ERR_DETECT_ALGOS */
-        "erreur dans le sous-module detection de l'algorithme de steganographie",
-        /* ERR_LENGTH_HIDDEN */ "erreur taille du fichier a cacher trop importante",
-        /* ERR_NEED_PASSWD */ "l'application a besoin d'un mot de passe pour extraire les données",
-        /* ERR_HIDDEN_FILE_EMPTY */ "le fichier caché/à cacher est vide",
-        /* ERR_OTHER */ "erreur inconnu"
-    };
+    /* Vérification de la valeur de "err". */
+    err = (unsigned int)err <= ERR_OTHER ? err : ERR_OTHER;
+    return err_desc[err];
+}
 
+void err_print(enum err_code err)
+{
     /* Vérification de la valeur de "err". */
     err = (unsigned int)err <= ERR_OTHER ? err : ERR_OTHER;
-    fprintf(stderr, "Erreur %d : %s.\n", err, err_desc[err]);
+    fprintf(stderr, "Erreur %d : %s.\n", err, stegx_strerror(err));
 }
@@ -31,6 +31,7 @@
 #include "common.h"
 #include "stegx_common.h"
 #include "stegx_errors.h"
+#include "stegx.h"
 
 #include "algo/lsb.h"
 #include "algo/eof.h"
@@ -44,9 +45,12 @@ int stegx_extract(info_s * infos, char *res_path)
     if (infos->mode != STEGX_MODE_EXTRACT)
         return stegx_errno = ERR_EXTRACT, 1;
 
-    if (infos->res != stdout) {
+    if (!infos->res) {
         // Concatenation du chemin du fichier a créer et le nom du fichier caché
-        char *res_name = malloc((strlen(res_path) + strlen(infos->hidden_name) + 1) * sizeof(char));
+        char *res_name = arena_alloc(&infos->arena,
+                                     (strlen(res_path) + strlen(infos->hidden_name) + 1) * sizeof(char));
+        if (!res_name)
+            return perror("Can't allocate memory for the result path"), stegx_errno = ERR_EXTRACT, 1;
         strcpy(res_name, res_path);
         strcat(res_name, infos->hidden_name);
 
@@ -55,7 +59,7 @@ int stegx_extract(info_s * infos, char *res_path)
             stegx_errno = ERR_EXTRACT;
             return 1;
         }
-        free(res_name);
+        infos->res_path = res_name;
     }
 
     /* Les fonctions de ce tableau doivent être déclarés dans l'ordre de
@@ -63,6 +67,37 @@ int stegx_extract(info_s * infos, char *res_path)
     assert(infos->algo >= STEGX_ALGO_LSB && infos->algo < STEGX_NB_ALGO);
     static int (*extract_algo[STEGX_NB_ALGO]) (info_s *) = {
     extract_lsb, extract_eof, extract_metadata, extract_eoc, extract_junk_chunk};
+    /* Données assez courtes pour être un jeton du registre : elles sont
+     * extraites en mémoire, cherchées dans le registre puis écrites dans le
+     * fichier résultat. */
+    uint8_t token[STEGX_TOKEN_MAX];
+    FILE *res = infos->res;
+    infos->identity = (stegx_identity_s) {.user = NULL };
+    if (infos->registry && infos->hidden_length <= STEGX_TOKEN_MAX
+        && !(infos->res = fmemopen(token, sizeof(token), "wb")))
+        return infos->res = res, perror("Can't open memory stream for token"),
+            stegx_errno = ERR_EXTRACT, 1;
+
     /* Extraction en appellant la fonction selon le format. */
-    return (*extract_algo[infos->algo]) (infos) ? (stegx_errno = ERR_EXTRACT, 1) : 0;
+    int err = progress_begin(&infos->progress, STEGX_STAGE_EXTRACT, infos->host.host, 0)
+        || (*extract_algo[infos->algo]) (infos);
+    if (infos->res != res) {
+        long int len = ftell(infos->res);
+        fclose(infos->res);
+        infos->res = res;
+        err = err || len < 0 || fwrite(token, sizeof(*token), len, res) != (size_t)len;
+        if (!err && stegx_registry_lookup(infos->registry, token, len, &infos->identity))
+            infos->identity.user = NULL;
+    }
+    if (err)
+        return stegx_errno = progress_fail(&infos->progress, &infos->res, infos->res_path, ERR_EXTRACT), 1;
+    return progress_end(&infos->progress), 0;
+}
+
+int stegx_identity(const info_s * infos, stegx_identity_s * id)
+{
+    assert(infos && id);
+    if (!infos->identity.user)
+        return 1;
+    return *id = infos->identity, 0;
 }
@@ -130,7 +130,8 @@ int insert_metadata_bmp(info_s * infos)
     if (infos->hidden_length > LENGTH_FILE_MAX) {
         stegx_srand(create_seed(infos->passwd));
         uint8_t random;
-        while (fread(&byte_read_bmp, sizeof(uint8_t), 1, infos->hidden) != 0) {
+        while (!progress_step(&infos->progress, 1)
+               && fread(&byte_read_bmp, sizeof(uint8_t), 1, infos->hidden) != 0) {
             random = stegx_rand() % UINT8_MAX;
             byte_read_bmp = byte_read_bmp ^ random;     //XOR avec le nombre pseudo aleatoire generé
             if (fwrite(&byte_read_bmp, sizeof(uint8_t), 1, infos->res) == 0)
@@ -142,7 +143,7 @@ int insert_metadata_bmp(info_s * infos)
      * des octets. 
      * */
     else {
-        uint8_t *data = malloc(infos->hidden_length * sizeof(uint8_t));
+        uint8_t *data = arena_alloc(&infos->arena, infos->hidden_length * sizeof(uint8_t));
         if (!data)
             return perror("Can't allocate memory Insertion"), 1;
         uint32_t cursor = 0;
@@ -152,18 +153,24 @@ int insert_metadata_bmp(info_s * infos)
             cursor++;
         }
         // Melange des octets dans data
-        protect_data(data, infos->hidden_length, infos->passwd, infos->mode);
+        if (protect_data(data, infos->hidden_length, infos->passwd, infos->mode, &infos->arena,
+                         &infos->progress))
+            return 1;
         // Ecriture des donnees dans le fichier a cacher
         for (cursor = 0; cursor < infos->hidden_length; cursor++) {
             if (fwrite(&data[cursor], sizeof(uint8_t), 1, infos->res) == 0)
                 return perror("Can't write hidden data"), 1;
         }
-        free(data);
     }
 
+    if (progress_canceled(&infos->progress))
+        return 1;
+
     // Recopie de data du fichier BMP
     nb_cpy = 0;
     while (nb_cpy < infos->host.file_info.bmp.data_size) {
+        if (progress_step(&infos->progress, 1))
+            return 1;
         if (fread(&byte_read_bmp, sizeof(uint8_t), 1, infos->host.host) != 1)
             return perror("BMP file: Can't read data host"), 1;
         if (fwrite(&byte_read_bmp, sizeof(uint8_t), 1, infos->res) == 0)
@@ -196,24 +203,18 @@ int extract_metadata_bmp(info_s * infos)
     /* Si le fichier a cacher est trop gros, on fait XOR avec la 
      * suite pseudo aleatoire générée avec le mot de passe
      * */
-    uint8_t byte_read, byte_cpy;
+    uint8_t byte_read;
     if (infos->hidden_length > LENGTH_FILE_MAX) {
-        stegx_srand(create_seed(infos->passwd));
-        int i = 0;
-        uint8_t random;
-        while (fread(&byte_cpy, sizeof(uint8_t), 1, infos->host.host) != 0) {
-            random = stegx_rand() % UINT8_MAX;
-            byte_cpy = byte_cpy ^ random;       //XOR avec le nombre pseudo aleatoire generé
-            if (fwrite(&byte_cpy, sizeof(uint8_t), 1, infos->res) == 0)
-                return perror("Can't write hidden data"), 1;
-            i++;
-        }
+        /* Lecture bornée : les données de l'image suivent les données cachées. */
+        if (data_xor_write_file(infos->host.host, infos->res, infos->passwd,
+                                infos->hidden_length, &infos->progress))
+            return perror("Can't write hidden data"), 1;
     }
     /* Sinon on utilise la méthode de protection des données du mélange
      * des octets. 
      * */
     else {
-        uint8_t *data = malloc(infos->hidden_length * sizeof(uint8_t));
+        uint8_t *data = arena_alloc(&infos->arena, infos->hidden_length * sizeof(uint8_t));
         if (!data)
             return perror("Can't allocate memory Extraction"), 1;
 
@@ -226,14 +227,15 @@ int extract_metadata_bmp(info_s * infos)
             cursor++;
         }
         // Remise dans l'ordre des octets dans data
-        protect_data(data, infos->hidden_length, infos->passwd, infos->mode);
+        if (protect_data(data, infos->hidden_length, infos->passwd, infos->mode, &infos->arena,
+                         &infos->progress))
+            return 1;
 
         // Ecriture des donnees dans le fichier a cacher
         for (cursor = 0; cursor < infos->hidden_length; cursor++) {
             if (fwrite(&data[cursor], sizeof(uint8_t), 1, infos->res) == 0)
                 return perror("Can't write hidden data"), 1;
         }
-        free(data);
     }
 
     return 0;
@@ -23,18 +23,185 @@
  * aux fichiers au format FLV.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
+#include <unistd.h>
 
 #include "common.h"
 #include "stegx_common.h"
 #include "stegx_errors.h"
+#include "../insert.h"
+#include "../protection.h"
+#include "../endian.h"
 
 /** Signature d'un fichier FLV. */
 #define SIG_FLV 0x564C46
 
+/** Types AMF0 des valeurs d'un tag de script. */
+enum amf0_type {
+    AMF0_NUMBER = 0x00, AMF0_BOOLEAN = 0x01, AMF0_STRING = 0x02, AMF0_OBJECT = 0x03,
+    AMF0_NULL = 0x05, AMF0_UNDEFINED = 0x06, AMF0_REFERENCE = 0x07, AMF0_ECMA_ARRAY = 0x08,
+    AMF0_STRICT_ARRAY = 0x0A, AMF0_DATE = 0x0B, AMF0_LONG_STRING = 0x0C, AMF0_XML = 0x0F,
+    AMF0_TYPED_OBJECT = 0x10
+};
+
+/** Marque de fin d'un objet AMF0 (clé vide suivie du type 0x09). */
+#define AMF0_OBJECT_END 0x09
+
+/** Début du tag de script de l'algorithme METADATA, jusqu'aux données
+ * cachées (header du tag, nom et type AMF0, taille des données). */
+#define FLV_METADATA_HEAD (FLV_METADATA_OVERHEAD - 4)
+
+/** Taille maximale d'une copie de l'hôte faite par le noyau. */
+#define FLV_COPY_BLOCK (1 << 20)
+
+/** Profondeur maximale des objets AMF0 lus. */
+#define AMF0_MAX_DEPTH 16
+
+/** Champ dont les nombres sont des adresses à mettre à jour. */
+enum amf0_field { AMF0_FIELD_NONE, AMF0_FIELD_FILESIZE, AMF0_FIELD_KEYFRAMES, AMF0_FIELD_FILEPOSITIONS };
+
+/**
+ * @brief Lecture des données d'un tag de script.
+ */
+struct amf0 {
+    uint8_t *p, *end;           /*!< Position de lecture et fin des données. */
+    flv_relocate_f relocate;    /*!< Nouvelle adresse d'un octet (NULL pour seulement valider les données). */
+    void *arg;                  /*!< Paramètre de "relocate". */
+};
+
+/**
+ * @brief Lit un entier big endian de n octets.
+ * @param a Lecture en cours.
+ * @param n Nombre d'octets.
+ * @param v Entier lu.
+ * @return 0 si l'entier a été lu, 1 s'il dépasse des données.
+ * @author StegX Team
+ */
+static int amf0_uint(struct amf0 *a, int n, uint64_t * v)
+{
+    if (a->end - a->p < n)
+        return 1;
+    for (*v = 0; n--; a->p++)
+        *v = *v << 8 | *a->p;
+    return 0;
+}
+
+/**
+ * @brief Lit un nombre AMF0 et le remplace par sa nouvelle adresse si c'en
+ * est une.
+ * @param a Lecture en cours.
+ * @param relocate 1 si le nombre est une adresse.
+ * @return 0 si le nombre a été lu, 1 s'il dépasse des données.
+ * @author StegX Team
+ */
+static int amf0_number(struct amf0 *a, int relocate)
+{
+    uint64_t v;
+    double d;
+    if (amf0_uint(a, sizeof(v), &v))
+        return 1;
+    memcpy(&d, &v, sizeof(d));
+    if (!relocate || !a->relocate || !(d >= 0 && d < (double)UINT64_MAX))
+        return 0;
+    d = a->relocate(d, a->arg);
+    memcpy(&v, &d, sizeof(v));
+    for (int i = 1; i <= (int)sizeof(v); i++, v >>= 8)
+        a->p[-i] = v;
+    return 0;
+}
+
+static int amf0_value(struct amf0 *a, enum amf0_field field, int depth);
+
+/**
+ * @brief Lit les propriétés d'un objet AMF0, jusqu'à sa marque de fin.
+ * @param a Lecture en cours.
+ * @param field Champ de l'objet.
+ * @param depth Profondeur de l'objet.
+ * @return 0 si l'objet a été lu, 1 s'il n'est pas valide.
+ * @author StegX Team
+ */
+static int amf0_object(struct amf0 *a, enum amf0_field field, int depth)
+{
+    for (uint64_t len;;) {
+        if (amf0_uint(a, 2, &len) || a->end - a->p < (long int)len)
+            return 1;
+        const char *key = (const char *)a->p;
+        a->p += len;
+        if (!len && a->p < a->end && *a->p == AMF0_OBJECT_END)
+            return a->p++, 0;
+        /* "filesize" dans "onMetaData", "filepositions" dans "keyframes". */
+        enum amf0_field f = AMF0_FIELD_NONE;
+        if (field == AMF0_FIELD_NONE && !depth && len == 8 && !memcmp(key, "filesize", len))
+            f = AMF0_FIELD_FILESIZE;
+        else if (field == AMF0_FIELD_NONE && !depth && len == 9 && !memcmp(key, "keyframes", len))
+            f = AMF0_FIELD_KEYFRAMES;
+        else if (field == AMF0_FIELD_KEYFRAMES && len == 13 && !memcmp(key, "filepositions", len))
+            f = AMF0_FIELD_FILEPOSITIONS;
+        if (amf0_value(a, f, depth + 1))
+            return 1;
+    }
+}
+
+/**
+ * @brief Lit une valeur AMF0.
+ * @param a Lecture en cours.
+ * @param field Champ de la valeur.
+ * @param depth Profondeur de la valeur.
+ * @return 0 si la valeur a été lue, 1 si elle n'est pas valide.
+ * @author StegX Team
+ */
+static int amf0_value(struct amf0 *a, enum amf0_field field, int depth)
+{
+    uint64_t n;
+    if (a->p >= a->end || depth > AMF0_MAX_DEPTH)
+        return 1;
+    switch (*a->p++) {
+    case AMF0_NUMBER:
+        return amf0_number(a, field == AMF0_FIELD_FILESIZE || field == AMF0_FIELD_FILEPOSITIONS);
+    case AMF0_BOOLEAN:
+        return amf0_uint(a, 1, &n);
+    case AMF0_STRING:
+        return amf0_uint(a, 2, &n) || a->end - a->p < (long int)n || (a->p += n, 0);
+    case AMF0_LONG_STRING:
+    case AMF0_XML:
+        return amf0_uint(a, 4, &n) || a->end - a->p < (long int)n || (a->p += n, 0);
+    case AMF0_NULL:
+    case AMF0_UNDEFINED:
+        return 0;
+    case AMF0_REFERENCE:
+        return amf0_uint(a, 2, &n);
+    case AMF0_DATE:
+        return amf0_uint(a, 8, &n) || amf0_uint(a, 2, &n);
+    case AMF0_TYPED_OBJECT:
+        if (amf0_uint(a, 2, &n) || a->end - a->p < (long int)n)
+            return 1;
+        a->p += n;
+        return amf0_object(a, field, depth);
+    case AMF0_ECMA_ARRAY:
+        /* Le nombre de propriétés n'est qu'indicatif : l'objet se termine
+         * par sa marque de fin. */
+        if (amf0_uint(a, 4, &n))
+            return 1;
+        return amf0_object(a, field, depth);
+    case AMF0_OBJECT:
+        return amf0_object(a, field, depth);
+    case AMF0_STRICT_ARRAY:
+        if (amf0_uint(a, 4, &n))
+            return 1;
+        while (n--)
+            if (amf0_value(a, field == AMF0_FIELD_FILEPOSITIONS ? field : AMF0_FIELD_NONE, depth + 1))
+                return 1;
+        return 0;
+    default:
+        return 1;
+    }
+}
+
 type_e stegx_test_file_flv(FILE * file)
 {
     assert(file);
@@ -53,14 +220,267 @@ type_e stegx_test_file_flv(FILE * file)
     return FLV;
 }
 
+flv_tag_s *flv_tag_index(FILE * file, flv_s * flv, uint32_t * nb, long int *end, struct progress *p)
+{
+    assert(file && flv && nb && end);
+    uint32_t header_size, data_size, prev_tag_size, max = 1024;
+    uint8_t tag_type;
+    flv_tag_s *tags = malloc(max * sizeof(*tags));
+    if (!tags)
+        return perror("FLV file: Can't allocate memory for the tag index"), NULL;
+    flv->nb_video_tag = flv->nb_metadata_tag = 0;
+    *nb = 0;
+
+    // lecture de la taille du header, puis saut du premier previous tag size
+    if (fseek(file, 5, SEEK_SET) || fread(&header_size, sizeof(header_size), 1, file) != 1
+        || fseek(file, 4, SEEK_CUR))
+        return perror("FLV file: Can't read header"), free(tags), NULL;
+    flv->file_size = stegx_be32toh(header_size) + 4;
+
+    /* Lecture des tags. Un tag de type inconnu ou incomplet n'est pas
+     * indexé et termine le parcours. */
+    long int adr = ftell(file);
+    for (; fread(&tag_type, sizeof(tag_type), 1, file) == 1; adr = ftell(file)) {
+        if (tag_type != METATAG && tag_type != VIDEO_TAG && tag_type != AUDIO_TAG && tag_type != SCRIPT_DATA_TAG)
+            break;
+        if (p && progress_at(p, adr))
+            return free(tags), NULL;
+        //lecture de la taille des data (24 bits)
+        if (fread(&data_size, sizeof(data_size), 1, file) != 1)
+            break;
+        data_size = stegx_be32toh(data_size) >> 8;
+        //deplacement jusqu'au prochain previous tag size (data size + 6 octets qui comportent d'autres informations non utiles)
+        if (fseek(file, data_size + 6, SEEK_CUR)
+            || fread(&prev_tag_size, sizeof(prev_tag_size), 1, file) != 1)
+            break;
+        prev_tag_size = stegx_be32toh(prev_tag_size);
+        flv->file_size += prev_tag_size + 4;
+        flv->nb_metadata_tag += tag_type == METATAG;
+        flv->nb_video_tag += tag_type == VIDEO_TAG;
+        if (*nb == max) {
+            flv_tag_s *tmp = realloc(tags, (max *= 2) * sizeof(*tags));
+            if (!tmp)
+                return perror("FLV file: Can't allocate memory for the tag index"), free(tags), NULL;
+            tags = tmp;
+        }
+        tags[(*nb)++] = (flv_tag_s) {.offset = adr,.data_size = data_size,.prev_tag_size = prev_tag_size,.type = tag_type };
+    }
+    if (ferror(file))
+        return perror("FLV file: Can't read tag"), free(tags), NULL;
+    *end = adr;
+    return tags;
+}
+
+const flv_tag_s *flv_tags(info_s * infos)
+{
+    host_info_s *hi = &infos->host;
+    if (hi->flv_tag)
+        return hi->flv_tag;
+    flv_s flv;
+    long int end;
+    if (!(hi->flv_tag = flv_tag_index(hi->host, &flv, &hi->flv_nb_tag, &end, NULL)))
+        return NULL;
+    if (flv.nb_video_tag != hi->file_info.flv.nb_video_tag)
+        return fprintf(stderr, "FLV file: Tag index doesn't match the host analysis\n"), NULL;
+    return hi->flv_tag;
+}
+
+int flv_meta_relocate(uint8_t * data, uint32_t len, flv_relocate_f relocate, void *arg)
+{
+    assert(data && relocate);
+    struct amf0 a = {.p = data,.end = data + len,.relocate = relocate,.arg = arg };
+    static const uint8_t name[] = { AMF0_STRING, 0, 10, 'o', 'n', 'M', 'e', 't', 'a', 'D', 'a', 't', 'a' };
+    if (len < sizeof(name) || memcmp(data, name, sizeof(name)))
+        return 0;
+    /* Validation puis mise à jour : les données ne sont modifiées que si
+     * elles sont valides. */
+    a.p += sizeof(name), a.relocate = NULL;
+    if (amf0_value(&a, AMF0_FIELD_NONE, 0))
+        return 1;
+    a.p = data + sizeof(name), a.relocate = relocate;
+    return amf0_value(&a, AMF0_FIELD_NONE, 0);
+}
+
+/**
+ * @brief Écrit le début du tag de script de l'algorithme METADATA.
+ * @details Tag de script (timestamp et stream ID nuls) dont les données sont
+ * le nom "StegX" suivi d'une chaîne AMF0 longue : les données cachées.
+ * @param head Tampon de \r{FLV_METADATA_HEAD} octets.
+ * @param len Taille des données cachées.
+ * @author StegX Team
+ */
+static void flv_metadata_head(uint8_t * head, uint32_t len)
+{
+    static const uint8_t name[] = { AMF0_STRING, 0, 5, 'S', 't', 'e', 'g', 'X', AMF0_LONG_STRING };
+    uint32_t data_size = FLV_METADATA_HEAD - FLV_TAG_HEADER_SIZE + len;
+    memset(head, 0, FLV_TAG_HEADER_SIZE);
+    head[0] = METATAG;
+    head[1] = data_size >> 16, head[2] = data_size >> 8, head[3] = data_size;
+    memcpy(head + FLV_TAG_HEADER_SIZE, name, sizeof(name));
+    len = stegx_htobe32(len);
+    memcpy(head + FLV_TAG_HEADER_SIZE + sizeof(name), &len, sizeof(len));
+}
+
+/**
+ * @brief Lit la taille du header du fichier FLV et se place sur son premier
+ * tag.
+ * @param file Fichier FLV.
+ * @param header_size Taille du header (sans le premier previous tag size).
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+static int flv_first_tag(FILE * file, uint32_t * header_size)
+{
+    if (fseek(file, 5, SEEK_SET) || fread(header_size, sizeof(*header_size), 1, file) != 1)
+        return 1;
+    *header_size = stegx_be32toh(*header_size);
+    return fseek(file, *header_size + 4, SEEK_SET) != 0;
+}
+
+/**
+ * @brief Recopie une zone de l'hôte à la position courante du résultat.
+ * @details La copie est faite par le noyau si possible (sans passer par la
+ * mémoire du programme, en partageant les blocs si le système de fichiers le
+ * permet), sinon par un tampon.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @param from Début de la zone.
+ * @param to Fin de la zone.
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+static int flv_copy(info_s * infos, long int from, long int to)
+{
+    FILE *h = infos->host.host, *r = infos->res;
+    int in = fileno(h), out = fileno(r);
+    long int pos;
+    if (fflush(r))
+        return 1;
+    /* Le résultat doit être positionnable (pas un tube). */
+    if (in != -1 && out != -1 && (pos = ftell(r)) != -1) {
+        while (from < to) {
+            loff_t off_in = from, off_out = pos;
+            size_t n = to - from < FLV_COPY_BLOCK ? (size_t)(to - from) : FLV_COPY_BLOCK;
+            ssize_t c = copy_file_range(in, &off_in, out, &off_out, n, 0);
+            if (c <= 0)
+                break;
+            from += c, pos += c;
+            if (progress_step(&infos->progress, c))
+                return 1;
+        }
+        if (fseek(r, pos, SEEK_SET))
+            return 1;
+    }
+    if (fseek(h, from, SEEK_SET))
+        return 1;
+    uint8_t buf[BUFSIZ];
+    for (size_t n; from < to; from += n) {
+        n = to - from < (long int)sizeof(buf) ? (size_t)(to - from) : sizeof(buf);
+        if (fread(buf, 1, n, h) != n || fwrite(buf, 1, n, r) != n
+            || progress_step(&infos->progress, n))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Nouvelle adresse d'un octet de l'hôte après l'insertion METADATA.
+ * @param offset Adresse de l'octet dans l'hôte.
+ * @param arg Décalage des tags (uint64_t).
+ * @return Adresse de l'octet dans le résultat.
+ * @author StegX Team
+ */
+static uint64_t flv_metadata_relocate(uint64_t offset, void *arg)
+{
+    return offset + *(uint64_t *) arg;
+}
+
 int insert_metadata_flv(info_s * infos)
 {
-    (void)infos;                /* Unused. */
-    return 1;
+    assert(infos);
+    assert(infos->mode == STEGX_MODE_INSERT);
+    assert(infos->algo == STEGX_ALGO_METADATA);
+    assert(infos->host.type == FLV);
+    if (infos->hidden_length > FLV_METADATA_MAX)
+        return perror("FLV file: Can't write data, hidden file to big"), 1;
+    uint32_t header_size, prev_tag_size = stegx_htobe32(FLV_METADATA_HEAD + infos->hidden_length);
+    uint64_t shift = FLV_METADATA_OVERHEAD + (uint64_t) infos->hidden_length;
+    uint8_t head[FLV_METADATA_HEAD];
+    const flv_tag_s *tags = flv_tags(infos);
+    if (!tags)
+        return 1;
+    flv_metadata_head(head, infos->hidden_length);
+
+    // Recopie du header et du premier previous tag size, puis écriture du tag de script
+    if (flv_first_tag(infos->host.host, &header_size))
+        return perror("FLV file: Can't read header"), 1;
+    if (fseek(infos->hidden, 0, SEEK_SET) || flv_copy(infos, 0, header_size + 4)
+        || fwrite(head, sizeof(head), 1, infos->res) != 1)
+        return perror("FLV file: Can't write the script tag"), 1;
+    if (infos->hidden_length > LENGTH_FILE_MAX
+        ? data_xor_write_file(infos->hidden, infos->res, infos->passwd, infos->hidden_length, &infos->progress)
+        : data_scramble_write(infos->hidden, infos->res, infos->passwd, infos->hidden_length,
+                              infos->mode, &infos->arena, &infos->progress))
+        return perror("FLV file: Can't write hidden data"), 1;
+    if (fwrite(&prev_tag_size, sizeof(prev_tag_size), 1, infos->res) != 1)
+        return perror("FLV file: Can't write previous tag size"), 1;
+
+    /* Recopie des tags, décalés du tag ajouté : seules les adresses de
+     * "onMetaData" sont mises à jour. */
+    long int pos = header_size + 4;
+    for (uint32_t i = 0; i < infos->host.flv_nb_tag; i++) {
+        const flv_tag_s *tag = &tags[i];
+        long int adr = tag->offset + FLV_TAG_HEADER_SIZE;
+        if (tag->type != METATAG && tag->type != SCRIPT_DATA_TAG)
+            continue;
+        uint8_t *meta = malloc(tag->data_size ? tag->data_size : 1);
+        if (!meta)
+            return perror("FLV file: Can't allocate memory for script data"), 1;
+        int err = flv_copy(infos, pos, adr) || fread(meta, 1, tag->data_size, infos->host.host) != tag->data_size;
+        if (!err)
+            flv_meta_relocate(meta, tag->data_size, flv_metadata_relocate, &shift);
+        err = err || fwrite(meta, 1, tag->data_size, infos->res) != tag->data_size;
+        free(meta);
+        if (err)
+            return perror("FLV file: Can't copy script data"), 1;
+        pos = adr + tag->data_size;
+    }
+    if (flv_copy(infos, pos, infos->host.file_info.flv.file_size))
+        return perror("FLV file: Can't copy the host file"), 1;
+
+    // Ecriture de la signature
+    if (write_signature(infos) == 1) {
+        stegx_errno = ERR_INSERT;
+        return 1;
+    }
+    return 0;
 }
 
 int extract_metadata_flv(info_s * infos)
 {
-    (void)infos;                /* Unused. */
-    return 1;
+    assert(infos);
+    assert(infos->mode == STEGX_MODE_EXTRACT);
+    assert(infos->algo == STEGX_ALGO_METADATA);
+    assert(infos->host.type == FLV);
+    uint32_t header_size;
+    uint8_t head[FLV_METADATA_HEAD], expected[FLV_METADATA_HEAD];
+
+    // Lecture du premier tag, qui doit être le tag de script de StegX
+    if (flv_first_tag(infos->host.host, &header_size)
+        || fread(head, sizeof(head), 1, infos->host.host) != 1)
+        return perror("FLV file: Can't read the first tag"), 1;
+    flv_metadata_head(expected, infos->hidden_length);
+    if (memcmp(head, expected, sizeof(head)))
+        return perror("FLV file: No StegX script tag"), 1;
+
+    /* Si le fichier cacher est trop gros, on fait un XOR avec la 
+     * suite pseudo aléatoire générée avec le mot de passe, sinon les octets
+     * ont été mélangés. */
+    if (infos->hidden_length > LENGTH_FILE_MAX)
+        return data_xor_write_file(infos->host.host, infos->res, infos->passwd,
+                                   infos->hidden_length, &infos->progress) ? perror("FLV file: Can't write deXORed hidden data"),
+            1 : 0;
+    return data_scramble_write(infos->host.host, infos->res, infos->passwd, infos->hidden_length,
+                               infos->mode, &infos->arena, &infos->progress) ? perror("FLV file: Can't write descrambled hidden data"),
+        1 : 0;
 }
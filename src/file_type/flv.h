@@ -31,6 +31,9 @@
 
 #include "common.h"
 
+/** taille du header d'un tag (type, taille des données, timestamp, stream ID) */
+#define FLV_TAG_HEADER_SIZE 11
+
 /** valeur d'un tag de type video  */
 #define VIDEO_TAG 9
 
@@ -43,6 +46,14 @@
 /** valeur d'un tag de type script data en entier non signé  */
 #define SCRIPT_DATA_TAG 24
 
+/** Octets ajoutés à l'hôte par l'algorithme METADATA en plus des données
+ * cachées : header du tag de script, nom et taille AMF0, previous tag size. */
+#define FLV_METADATA_OVERHEAD 28
+
+/** Taille maximale des données cachées par l'algorithme METADATA (la taille
+ * des données d'un tag est écrite sur 3 octets). */
+#define FLV_METADATA_MAX (0xFFFFFF - (FLV_METADATA_OVERHEAD - FLV_TAG_HEADER_SIZE - 4))
+
 /**
  * @brief Structure du format FLV.
  * @author Claire Baskevitch et Tristan Bessac
@@ -56,6 +67,28 @@ struct flv {
 /** Type du format FLV. */
 typedef struct flv flv_s;
 
+/**
+ * @brief Tag d'un fichier FLV, dans l'index des tags (\r{flv_tag_index}).
+ */
+struct flv_tag {
+    uint32_t offset;            /*!< Adresse du tag (son octet de type). */
+    uint32_t data_size;         /*!< Taille des données du tag. */
+    uint32_t prev_tag_size;     /*!< Taille du tag écrite après ses données. */
+    uint8_t type;               /*!< Type du tag (\r{VIDEO_TAG}, \r{AUDIO_TAG}, ...). */
+};
+
+/** Type d'un tag FLV. */
+typedef struct flv_tag flv_tag_s;
+
+/**
+ * @brief Fonction donnant la nouvelle adresse d'un octet du fichier FLV
+ * après l'insertion.
+ * @param offset Adresse de l'octet dans l'hôte.
+ * @param arg Paramètre de la fonction.
+ * @return Adresse de l'octet dans le résultat.
+ */
+typedef uint64_t(*flv_relocate_f) (uint64_t offset, void *arg);
+
 /**
  * @brief Test si le fichier est un fichier FLV.
  * @param file Fichier à tester.
@@ -65,18 +98,68 @@ typedef struct flv flv_s;
  */
 type_e stegx_test_file_flv(FILE * file);
 
+/**
+ * @brief Parcourt les tags du fichier FLV et les indexe.
+ * @details Le parcours s'arrête à la fin du fichier ou sur un tag de type
+ * inconnu. Les tags sont lus une seule fois : l'index permet ensuite d'aller
+ * directement à chacun d'eux.
+ * @param file Fichier FLV, ouvert en lecture.
+ * @param flv Structure à remplir (nombre de tags vidéo et métadonnées,
+ * taille du fichier).
+ * @param nb Nombre de tags indexés.
+ * @param end Adresse de la fin des tags.
+ * @param p Progression à mettre à jour (peut être NULL).
+ * @return L'index des tags (alloué, même sans tag, à libérer par
+ * l'appelant), ou NULL sur une erreur ou une annulation.
+ * @author StegX Team
+ */
+flv_tag_s *flv_tag_index(FILE * file, flv_s * flv, uint32_t * nb, long int *end, struct progress *p);
+
+/**
+ * @brief Obtient l'index des tags de l'hôte FLV.
+ * @details L'index est celui construit par l'analyse ou repris de l'index
+ * d'analyse. S'il n'existe pas (analyse reprise du cache), il est construit
+ * une fois pour le traitement.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @sideeffect Remplit \r{infos->host.flv_tag} et \r{infos->host.flv_nb_tag}.
+ * @return Les tags de l'hôte, ou NULL sur une erreur.
+ * @author StegX Team
+ */
+const flv_tag_s *flv_tags(info_s * infos);
+
 /** 
  * @brief Va inserer les donnees cachees en utilisant l'algorithme Metadata 
  * dans le format FLV. 
+ * @details Les données sont écrites dans un tag de script placé juste après
+ * le header (chaîne AMF0 longue nommée "StegX"). Le reste de l'hôte est
+ * recopié par blocs, seules les adresses de "onMetaData" étant décalées.
  * @param infos Structure représentant les informations concernant la dissimulation.
  * @return 0 si les données ont bien été inserées ; sinon 1 en cas d'erreur.
  * @author Claire Baskevitch et Tristan Bessac
  */
 int insert_metadata_flv(info_s * infos);
 
+/**
+ * @brief Met à jour les adresses de l'objet "onMetaData" d'un tag de script.
+ * @details Les données du tag sont lues en AMF0 : la taille du fichier
+ * ("filesize") et les adresses des images clés ("keyframes.filepositions")
+ * sont remplacées par leur nouvelle adresse, sans changer la taille des
+ * données. Les autres tags de script ne sont pas modifiés.
+ * @param data Données du tag de script.
+ * @param len Taille des données.
+ * @param relocate Fonction donnant la nouvelle adresse d'un octet.
+ * @param arg Paramètre de "relocate".
+ * @return 0 si les données ont été mises à jour ou ne sont pas "onMetaData",
+ * 1 si elles ne sont pas valides (elles ne sont alors pas modifiées).
+ * @author StegX Team
+ */
+int flv_meta_relocate(uint8_t * data, uint32_t len, flv_relocate_f relocate, void *arg);
+
 /** 
  * @brief Va extraire les donnees cachees en utilisant l'algorithme Metadata
  * dans le formar FLV. 
+ * @details Seul le premier tag est lu : l'hôte n'a pas besoin d'être analysé.
  * @param infos Structure représentant les informations concernant l'extraction.
  * @return 0 si les données ont bien été extraites ; sinon 1 en cas d'erreur.
  * @author Claire Baskevitch et Tristan Bessac
@@ -26,12 +26,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <limits.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "common.h"
 #include "stegx_common.h"
 #include "stegx_errors.h"
 #include "mp3.h"
+#include "../parallel.h"
 
 /** Signature du MPEG 1 Layer III. */
 #define SIG_MPEG1_LAYER3 0xFFFA0000
@@ -44,6 +54,9 @@
 
 /** Masque à appliquer pour reconnaître la signature du MPEG 1/2 Layer III. */
 #define MASK_MPEG_LAYER3 0xFFFE0000
+/** Masque des champs d'un header qui ne changent pas d'une frame à l'autre
+ * (synchronisation, version, couche et fréquence d'échantillonnage). */
+#define MASK_MPEG_FIXED 0xFFFE0C00
 /** Masque à appliquer pour reconnaître la signature de l'ID3. */
 #define MASK_ID3 0xFFFFFF00
 
@@ -52,6 +65,17 @@
 /** Taille d'un header de tag ID3v2. */
 #define TAG_ID3V2_HEADER_SIZE 10
 
+/** Taille de la fenêtre de lecture de l'index et de la resynchronisation. */
+#define MP3_SCAN_SIZE (256 * 1024)
+/** Taille maximale d'une frame MPEG 1/2 Layer III (320 kbit/s à 32 kHz, avec
+ * bourrage), arrondie. */
+#define MP3_FR_SIZE_MAX 1536
+/** Nombre de frames consécutives qui valident une resynchronisation. */
+#define MP3_SYNC_CHAIN 3
+/** Taille minimale d'une partie du fichier parcourue par un thread de
+ * l'index parallèle. */
+#define MP3_PAR_MIN_CHUNK (16L * 1024 * 1024)
+
 /**
  * @brief Test si le header est un header ID3v2.
  * @param hdr Header à tester.
@@ -177,6 +201,13 @@ int mp3_mpeg_hdr_test(const uint32_t hdr)
     return (hdr & MASK_MPEG_LAYER3) == SIG_MPEG1_LAYER3 || (hdr & MASK_MPEG_LAYER3) == SIG_MPEG2_LAYER3;
 }
 
+int mp3_mpeg_fr_size(const uint32_t hdr)
+{
+    if (!mp3_mpeg_hdr_test(hdr) || !mp3_mpeg_hdr_get_version(hdr))
+        return 0;
+    return mp3_mpeg_hdr_get_bitrate(hdr) && mp3_mpeg_hdr_get_samprate(hdr) ? mp3_mpeg_hdr_get_size(hdr) : 0;
+}
+
 int mp3_mpeg_fr_seek(const uint32_t hdr, FILE * f)
 {
     assert(mp3_mpeg_hdr_test(hdr) && "Le header doit être un header MPEG 1/2 Layer III");
@@ -195,6 +226,330 @@ int mp3_mpeg_fr_write(uint32_t hdr, FILE * src, FILE * dst)
     return ferror(src) || ferror(dst) ? -1 : 0;
 }
 
+size_t mp3_mpeg_sync_scan(const uint8_t * buf, size_t len)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    /* 32 positions par tour : octet à 0xFF suivi d'un octet dont les 3 bits
+     * de poids fort sont à 1. */
+    const __m256i ff = _mm256_set1_epi8((char)0xFF), e0 = _mm256_set1_epi8((char)0xE0);
+    for (; i + 33 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(buf + i));
+        __m256i b = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(buf + i + 1)), e0);
+        uint32_t m = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, ff), _mm256_cmpeq_epi8(b, e0)));
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+#elif defined(__SSE2__)
+    /* 16 positions par tour : octet à 0xFF suivi d'un octet dont les 3 bits
+     * de poids fort sont à 1. */
+    const __m128i ff = _mm_set1_epi8((char)0xFF), e0 = _mm_set1_epi8((char)0xE0);
+    for (; i + 17 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(buf + i));
+        __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(buf + i + 1)), e0);
+        int m = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, ff), _mm_cmpeq_epi8(b, e0)));
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+#endif
+    for (; i + 1 < len; i++)
+        if (buf[i] == 0xFF && (buf[i + 1] & 0xE0) == 0xE0)
+            return i;
+    return len;
+}
+
+/**
+ * @brief Fenêtre de lecture séquentielle d'un fichier MP3.
+ */
+struct mp3_scan {
+    FILE *f;                    /*!< Fichier lu (si "fd" vaut -1). */
+    int fd;                     /*!< Descripteur du fichier lu par "pread", ou -1 pour lire "f". */
+    uint8_t *buf;               /*!< Tampon de \r{MP3_SCAN_SIZE} octets. */
+    long int pos;               /*!< Adresse du premier octet du tampon. */
+    size_t len;                 /*!< Nombre d'octets dans le tampon. */
+    int eof;                    /*!< 1 si la fin du fichier est dans le tampon. */
+    int err;                    /*!< 1 sur une erreur de lecture. */
+};
+
+/**
+ * @brief Place une zone du fichier dans la fenêtre de lecture.
+ * @param s Fenêtre de lecture.
+ * @param a Adresse du début de la zone.
+ * @param n Taille de la zone (au plus \r{MP3_SCAN_SIZE}).
+ * @return Nombre d'octets disponibles à partir de "a" (moins de "n" seulement
+ * à la fin du fichier, 0 sur une erreur).
+ * @author StegX Team
+ */
+static size_t mp3_scan_need(struct mp3_scan *s, long int a, size_t n)
+{
+    /* Zone hors de la fenêtre : on s'y déplace. */
+    if (a < s->pos || a > s->pos + (long int)s->len) {
+        if (s->fd == -1 && fseek(s->f, a, SEEK_SET))
+            return s->err = 1, 0;
+        s->pos = a, s->len = 0, s->eof = 0;
+    }
+    /* Zone incomplète : on garde ce qui est lu et on complète la fenêtre. */
+    if (a + n > s->pos + s->len && !s->eof) {
+        s->len -= a - s->pos;
+        memmove(s->buf, s->buf + (a - s->pos), s->len);
+        s->pos = a;
+        ssize_t r = s->fd == -1 ? (ssize_t) fread(s->buf + s->len, 1, MP3_SCAN_SIZE - s->len, s->f)
+            : pread(s->fd, s->buf + s->len, MP3_SCAN_SIZE - s->len, s->pos + s->len);
+        if (r < 0 || (s->fd == -1 && ferror(s->f)))
+            return s->err = 1, 0;
+        s->eof = s->len + r < MP3_SCAN_SIZE;
+        s->len += r;
+    }
+    return s->pos + s->len - a;
+}
+
+/**
+ * @brief Lit un header dans la fenêtre de lecture.
+ * @param s Fenêtre de lecture.
+ * @param a Adresse du header.
+ * @param hdr Header lu.
+ * @return 1 si le header est lu, 0 à la fin du fichier.
+ * @author StegX Team
+ */
+static int mp3_scan_hdr(struct mp3_scan *s, long int a, uint32_t * hdr)
+{
+    if (mp3_scan_need(s, a, sizeof(*hdr)) < sizeof(*hdr))
+        return 0;
+    memcpy(hdr, s->buf + (a - s->pos), sizeof(*hdr));
+    *hdr = stegx_be32toh(*hdr);
+    return 1;
+}
+
+/**
+ * @brief Teste si une chaîne de frames commence à une adresse.
+ * @details Les \r{MP3_SYNC_CHAIN} frames doivent se suivre et garder la même
+ * version, la même couche et la même fréquence d'échantillonnage.
+ * @param s Fenêtre de lecture.
+ * @param a Adresse du premier header.
+ * @return 1 si la chaîne est valide, 0 sinon.
+ * @author StegX Team
+ */
+static int mp3_scan_chain(struct mp3_scan *s, long int a)
+{
+    uint32_t h0, hdr;
+    mp3_scan_need(s, a, MP3_SYNC_CHAIN * MP3_FR_SIZE_MAX + sizeof(hdr));
+    if (!mp3_scan_hdr(s, a, &h0))
+        return 0;
+    for (int c = 0, size; c < MP3_SYNC_CHAIN; c++, a += size)
+        if (!mp3_scan_hdr(s, a, &hdr) || (hdr ^ h0) & MASK_MPEG_FIXED
+            || (size = mp3_mpeg_fr_size(hdr)) <= (int)sizeof(hdr))
+            return 0;
+    return 1;
+}
+
+/**
+ * @brief Resynchronise la lecture sur la prochaine chaîne de frames.
+ * @param s Fenêtre de lecture.
+ * @param a Adresse des premiers octets parasites.
+ * @param limit Adresse où arrêter la recherche.
+ * @return Adresse du premier header de la chaîne, ou -1 s'il n'y en a pas
+ * avant "limit" ou la fin du fichier.
+ * @author StegX Team
+ */
+static long int mp3_scan_resync(struct mp3_scan *s, long int a, long int limit)
+{
+    for (size_t avail, i; a < limit && (avail = mp3_scan_need(s, a, sizeof(uint32_t))) >= sizeof(uint32_t);) {
+        /* Le dernier octet est gardé : son mot de synchronisation peut
+         * continuer dans la fenêtre suivante. */
+        if ((i = mp3_mpeg_sync_scan(s->buf + (a - s->pos), avail)) == avail)
+            a += avail - 1;
+        else if ((a += i) >= limit)
+            break;
+        else if (mp3_scan_chain(s, a))
+            return a;
+        else
+            a++;
+    }
+    return -1;
+}
+
+/**
+ * @brief Parcours des frames d'une partie du fichier.
+ */
+struct mp3_walk {
+    uint32_t *size;             /*!< Distance de chaque frame parcourue à la suivante. */
+    long int nb;                /*!< Nombre de frames parcourues. */
+    size_t max;                 /*!< Nombre de distances allouées. */
+    long int start;             /*!< Adresse de la première frame (-1 si aucune). */
+    long int a;                 /*!< Adresse atteinte : frame suivante, ou fin des frames si "stop". */
+    uint32_t next;              /*!< Les 4 octets à la fin des frames (0 si fin du fichier). */
+    int stop;                   /*!< 1 si la fin des frames est atteinte. */
+};
+
+/**
+ * @brief Ajoute des frames au parcours.
+ * @param w Parcours.
+ * @param size Distances des frames.
+ * @param nb Nombre de frames.
+ * @return 0 si tout s'est bien passé, -1 sur une erreur d'allocation.
+ * @author StegX Team
+ */
+static int mp3_walk_add(struct mp3_walk *w, const uint32_t * size, long int nb)
+{
+    if ((size_t)(w->nb + nb) > w->max) {
+        size_t max = w->max ? w->max : 1024;
+        while (max < (size_t)(w->nb + nb))
+            max *= 2;
+        uint32_t *tmp = realloc(w->size, max * sizeof(*tmp));
+        if (!tmp)
+            return perror("mp3_mpeg_fr_index: Can't allocate memory for the frame index"), -1;
+        w->size = tmp, w->max = max;
+    }
+    memcpy(w->size + w->nb, size, nb * sizeof(*size));
+    w->nb += nb;
+    return 0;
+}
+
+/**
+ * @brief Parcourt les frames jusqu'à une adresse.
+ * @details Une taille nulle (débit libre ou inconnu) n'est pas une frame : on
+ * ne saurait pas où commence la suivante. Les octets parasites entre deux
+ * frames sont comptés dans la distance de la frame qui les précède. Le
+ * parcours s'arrête sur un tag ID3v1, quand aucune chaîne de frames n'est
+ * trouvée avant la fin du fichier, ou à la première frame qui commence à
+ * "limit" ou après.
+ * @param s Fenêtre de lecture.
+ * @param w Parcours à continuer à partir de "w->a".
+ * @param limit Adresse où s'arrêter.
+ * @param p Progression à mettre à jour (peut être NULL).
+ * @return 0 si tout s'est bien passé, -1 sur une erreur ou une annulation.
+ * @author StegX Team
+ */
+static int mp3_walk(struct mp3_scan *s, struct mp3_walk *w, long int limit, struct progress *p)
+{
+    uint32_t hdr, fs;
+    long int q;
+    while (!w->stop && w->a < limit) {
+        if (!mp3_scan_hdr(s, w->a, &hdr)) {
+            /* Moins d'un header avant la fin du fichier : octets gardés. */
+            w->a += mp3_scan_need(s, w->a, sizeof(hdr));
+            w->next = 0, w->stop = 1;
+        } else if ((int)(fs = mp3_mpeg_fr_size(hdr)) > (int)sizeof(hdr)) {
+            if (mp3_walk_add(w, &fs, 1) || (p && progress_at(p, w->a)))
+                return -1;
+            w->a += fs;
+        } else if (mp3_id3v1_hdr_test(hdr) || !w->nb || (q = mp3_scan_resync(s, w->a, LONG_MAX)) == -1
+                   || q - w->a + w->size[w->nb - 1] > UINT32_MAX)
+            w->next = hdr, w->stop = 1;
+        else
+            w->size[w->nb - 1] += q - w->a, w->a = q;
+    }
+    return s->err ? -1 : 0;
+}
+
+/**
+ * @brief Partie du fichier parcourue par un thread de l'index parallèle.
+ */
+struct mp3_chunk {
+    int fd;                     /*!< Descripteur du fichier. */
+    long int begin, end;        /*!< Partie du fichier, [begin, end[. */
+    struct mp3_walk w;          /*!< Parcours depuis la première chaîne de frames de la partie. */
+    int err;                    /*!< 1 sur une erreur. */
+};
+
+/**
+ * @brief Parcourt une partie du fichier (thread de l'index parallèle).
+ * @details Le parcours commence, par spéculation, sur la première chaîne de
+ * frames valide de la partie et continue jusqu'à la première frame de la
+ * partie suivante.
+ * @param arg Partie à parcourir (\r{struct mp3_chunk}).
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *mp3_chunk_walk(void *arg)
+{
+    struct mp3_chunk *c = arg;
+    struct mp3_scan s = {.fd = c->fd,.buf = malloc(MP3_SCAN_SIZE),.pos = c->begin };
+    c->w.start = -1;
+    if (!s.buf)
+        return perror("mp3_mpeg_fr_index: Can't allocate memory for the scan"), c->err = 1, NULL;
+    /* La recherche reste dans la partie : au-delà, c'est la partie suivante. */
+    if ((c->w.a = c->w.start = mp3_scan_resync(&s, c->begin, c->end)) != -1)
+        c->err = mp3_walk(&s, &c->w, c->end, NULL) == -1;
+    else
+        c->err = s.err;
+    free(s.buf);
+    return NULL;
+}
+
+/**
+ * @brief Parcourt les frames en parallèle, en raccordant les parties.
+ * @details Chaque partie est parcourue depuis sa première chaîne de frames.
+ * Les parcours sont ensuite raccordés dans l'ordre : le parcours d'une partie
+ * est gardé si le parcours raccordé aboutit exactement sur sa première frame,
+ * sinon la partie est parcourue de nouveau depuis l'adresse atteinte.
+ * Le résultat est identique au parcours séquentiel.
+ * @param s Fenêtre de lecture séquentielle (raccords).
+ * @param w Parcours à remplir, à partir de la première frame.
+ * @param size Taille du fichier.
+ * @param nb Nombre de parties.
+ * @return 0 si tout s'est bien passé, -1 sur une erreur.
+ * @author StegX Team
+ */
+static int mp3_walk_parallel(struct mp3_scan *s, struct mp3_walk *w, long int size, long int nb)
+{
+    struct mp3_chunk *c = calloc(nb, sizeof(*c));
+    if (!c)
+        return perror("mp3_mpeg_fr_index: Can't allocate memory for the threads"), -1;
+    for (long int i = 0; i < nb; i++)
+        c[i] = (struct mp3_chunk) {.fd = s->fd,.begin = w->a + (size - w->a) * i / nb,
+            .end = i < nb - 1 ? w->a + (size - w->a) * (i + 1) / nb : LONG_MAX
+        };
+    parallel_run(mp3_chunk_walk, c, nb, sizeof(*c), NULL, NULL, 0);
+    int err = 0;
+    for (long int i = 0; i < nb; i++)
+        err |= c[i].err;
+    /* Raccord des parties. */
+    for (long int i = 0; !err && i < nb && !w->stop; i++) {
+        if (w->a == c[i].w.start && !mp3_walk_add(w, c[i].w.size, c[i].w.nb))
+            w->a = c[i].w.a, w->next = c[i].w.next, w->stop = c[i].w.stop;
+        else
+            err = mp3_walk(s, w, c[i].end, NULL);
+    }
+    for (long int i = 0; i < nb; i++)
+        free(c[i].w.size);
+    free(c);
+    return err ? -1 : 0;
+}
+
+uint32_t *mp3_mpeg_fr_index(FILE * f, long int first, long int *nb, long int *end, uint32_t * next,
+                            int threads, struct progress *p)
+{
+    assert(f && nb && end && next);
+    struct mp3_scan s = {.f = f,.fd = -1,.buf = malloc(MP3_SCAN_SIZE),.pos = first };
+    struct mp3_walk w = {.start = first,.a = first };
+    struct stat st;
+    if (!s.buf)
+        return perror("mp3_mpeg_fr_index: Can't allocate memory for the frame index"), NULL;
+    if (fseek(f, first, SEEK_SET))
+        return perror("mp3_mpeg_fr_index: Can't jump to the first frame"), free(s.buf), NULL;
+
+    /* Parcours parallèle si le fichier est lisible par "pread" et assez long. */
+    long int parts = 0;
+    if (threads > 1 && fileno(f) != -1 && !fstat(fileno(f), &st) && S_ISREG(st.st_mode))
+        parts = (st.st_size - first) / MP3_PAR_MIN_CHUNK < threads ? (st.st_size - first) / MP3_PAR_MIN_CHUNK : threads;
+    int err;
+    if (parts > 1)
+        s.fd = fileno(f), err = mp3_walk_parallel(&s, &w, st.st_size, parts);
+    else
+        err = mp3_walk(&s, &w, LONG_MAX, p);
+    free(s.buf);
+    if (s.err)
+        perror("mp3_mpeg_fr_index: Can't read frame header");
+    /* Index alloué même sans frame, pour le distinguer d'une erreur. */
+    if (!err && !w.size && !(w.size = malloc(sizeof(*w.size))))
+        err = 1, perror("mp3_mpeg_fr_index: Can't allocate memory for the frame index");
+    if (err || (p && progress_at(p, w.a)))
+        return free(w.size), NULL;
+    *nb = w.nb, *end = w.a, *next = w.next;
+    return w.size;
+}
+
 long int mp3_mpeg_fr_find_first(FILE * f)
 {
     assert(f);
@@ -206,8 +561,19 @@ long int mp3_mpeg_fr_find_first(FILE * f)
     if (mp3_id3v2_hdr_test(hdr) && mp3_id3v2_tag_seek(f))
         return perror("mp3_mpeg_fr_find_first: Can't skip over ID3v2 tag"), -1;
     /* Si on était sur une frame MPEG 1/2 Layer III ou que l'on est dessus après avoir sauté le tag ID3v2. */
-    return mp3_mpeg_hdr_test(hdr) || ((fread(&hdr, sizeof(hdr), 1, f) == 1) && mp3_mpeg_hdr_test(stegx_be32toh(hdr))) ?
-        ftell(f) - (int)sizeof(hdr) : -1;
+    long int a = mp3_id3v2_hdr_test(hdr) ? ftell(f) : 0;
+    if (a == -1 || fseek(f, a, SEEK_SET) || fread(&hdr, sizeof(hdr), 1, f) != 1)
+        return -1;
+    if (mp3_mpeg_fr_size(stegx_be32toh(hdr)) > (int)sizeof(hdr))
+        return a;
+    /* Sinon (bourrage après le tag, frame invalide), on cherche la première
+     * chaîne de frames. */
+    struct mp3_scan s = {.f = f,.fd = -1,.buf = malloc(MP3_SCAN_SIZE),.pos = a };
+    if (!s.buf)
+        return perror("mp3_mpeg_fr_find_first: Can't allocate memory for the scan"), -1;
+    a = fseek(f, a, SEEK_SET) ? -1 : mp3_scan_resync(&s, a, LONG_MAX);
+    free(s.buf);
+    return a;
 }
 
 int mp3_id3v1_hdr_test(const uint32_t hdr)
@@ -56,6 +56,17 @@ typedef struct mp3 mp3_s;
  */
 int mp3_mpeg_hdr_test(uint32_t hdr);
 
+/**
+ * @brief Obtient la taille d'une frame MP3 à partir d'octets quelconques.
+ * @details Contrairement aux autres fonctions, le header n'a pas besoin d'être
+ * valide : il peut s'agir de 4 octets lus n'importe où dans le fichier.
+ * @param hdr Header à tester.
+ * @return Taille de la frame (header + données), ou 0 si le header n'est pas
+ * un header MPEG 1/2 Layer III valide (version, débit ou fréquence inconnus).
+ * @author StegX Team
+ */
+int mp3_mpeg_fr_size(uint32_t hdr);
+
 /**
  * @brief Saute la frame MP3 actuelle.
  * @param hdr Header de la frame MP3 à sauter.
@@ -88,6 +99,9 @@ int mp3_mpeg_fr_write(uint32_t hdr, FILE * src, FILE * dst);
 
 /**
  * @brief Trouve la première frame MPEG 1/2 Layer III.
+ * @details La frame est cherchée après l'éventuel tag ID3v2. Si elle n'y est
+ * pas, la recherche se resynchronise sur la première chaîne de frames valides
+ * (voir \r{mp3_mpeg_fr_index}).
  * @param f Fichier où chercher.
  * @return L'adresse du header de la première frame si elle est trouvée
  * (ftell(f)), sinon -1 sur une erreur.
@@ -97,6 +111,48 @@ int mp3_mpeg_fr_write(uint32_t hdr, FILE * src, FILE * dst);
  */
 long int mp3_mpeg_fr_find_first(FILE * f);
 
+/**
+ * @brief Cherche le prochain mot de synchronisation MPEG (11 bits à 1).
+ * @details La recherche est vectorisée (AVX2 ou SSE2 selon la compilation).
+ * Une position trouvée n'est qu'un candidat : le header doit encore être
+ * validé.
+ * @param buf Zone où chercher.
+ * @param len Taille de la zone.
+ * @return Position du premier octet du mot trouvé, ou "len" s'il n'y en a pas
+ * (le dernier octet, dont le suivant est hors de la zone, n'est pas testé).
+ * @author StegX Team
+ */
+size_t mp3_mpeg_sync_scan(const uint8_t * buf, size_t len);
+
+/**
+ * @brief Construit l'index des frames MPEG 1/2 Layer III.
+ * @details L'index ne contient que la distance de chaque frame à la suivante
+ * : l'adresse d'une frame est celle de la précédente augmentée de cette
+ * distance. Le fichier est lu par blocs. Après des octets parasites (bourrage,
+ * données inconnues), la lecture se resynchronise sur la prochaine chaîne de
+ * frames valides, les octets sautés étant comptés dans la distance de la
+ * frame qui les précède. La lecture s'arrête sur un tag ID3v1 ou quand aucune
+ * chaîne n'est trouvée avant la fin du fichier.
+ * @param f Fichier MP3.
+ * @param first Adresse du header de la première frame.
+ * @param nb Nombre de frames indexées.
+ * @param end Adresse de fin des frames (fin du fichier s'il reste moins de 4
+ * octets après la dernière frame).
+ * @param next Les 4 octets lus à "end" (pour reconnaître un tag ID3v1), ou 0
+ * si la fin du fichier a été atteinte.
+ * @param threads Nombre de threads. Au-delà de 1, un fichier ordinaire assez
+ * long est découpé en parties parcourues en même temps puis raccordées, pour
+ * le même résultat que le parcours séquentiel.
+ * @param p Progression à mettre à jour (peut être NULL, mise à jour à la fin
+ * seulement pour le parcours parallèle).
+ * @return Tableau des distances, à libérer avec free(), ou NULL sur une erreur
+ * ou une annulation.
+ * @sideeffect Modifie l'emplacement du curseur de lecture dans le fichier f.
+ * @author StegX Team
+ */
+uint32_t *mp3_mpeg_fr_index(FILE * f, long int first, long int *nb, long int *end, uint32_t * next,
+                            int threads, struct progress *p);
+
 /**
  * @brief Test si le header est un header ID3v1.
  * @param hdr Header à tester.
@@ -26,7 +26,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <zlib.h>
 
 #include "common.h"
 #include "stegx_common.h"
@@ -35,10 +38,54 @@
 #include "../protection.h"
 #include "../endian.h"
 #include "../rand.h"
+#include "../crc32.h"
+#include "../parallel.h"
 
 /** Signature PNG */
 #define SIG_PNG 0x0A1A0A0D474E5089
 
+/** Taille des blocs lus et écrits dans les chunks. */
+#define PNG_BLOCK_SIZE (64 * 1024)
+
+/** Taille des lignes filtrées d'une tranche compressée indépendamment. */
+#define PNG_SLICE_SIZE (256 * 1024)
+
+/** Filtres des lignes de l'image. */
+enum png_filter { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVERAGE, PNG_FILTER_PAETH,
+    PNG_NB_FILTER
+};
+
+/**
+ * @brief Lecture en flux des données décompressées des chunks IDAT.
+ */
+struct png_in {
+    FILE *file;                 /*!< Fichier PNG. */
+    z_stream z;                 /*!< Flux de décompression. */
+    long int next;              /*!< Adresse du chunk suivant. */
+    long int end;               /*!< Fin du dernier chunk IDAT. */
+    uint32_t left;              /*!< Données du chunk en cours restant à lire. */
+    struct progress *p;         /*!< Progression à mettre à jour. */
+    uint8_t buf[PNG_BLOCK_SIZE];        /*!< Données compressées lues. */
+};
+
+/**
+ * @brief Tranche de lignes compressée indépendamment des autres.
+ * @details Chaque tranche donne un bloc deflate terminé par un vidage
+ * ("Z_SYNC_FLUSH"), la dernière par la fin du flux : les blocs mis bout à
+ * bout forment un seul flux zlib.
+ */
+struct png_slice {
+    z_stream z;                 /*!< Flux de compression (réutilisé d'une tranche à l'autre). */
+    uint8_t *in;                /*!< Lignes filtrées. */
+    uint8_t *out;               /*!< Données compressées. */
+    uint32_t in_len;            /*!< Taille des lignes filtrées. */
+    uint32_t out_len;           /*!< Taille des données compressées. */
+    uint32_t out_size;          /*!< Taille du tampon des données compressées. */
+    uLong adler;                /*!< Somme Adler-32 des lignes filtrées. */
+    int last;                   /*!< 1 si c'est la dernière tranche de l'image. */
+    int err;                    /*!< 1 si la compression a échoué. */
+};
+
 type_e stegx_test_file_png(FILE * file)
 {
     assert(file);
@@ -54,6 +101,233 @@ type_e stegx_test_file_png(FILE * file)
     return PNG;
 }
 
+int png_chunk_begin(struct png_chunk *c, FILE * file, uint32_t type, uint32_t len)
+{
+    assert(c && file);
+    len = stegx_htobe32(len);
+    c->file = file;
+    c->crc = stegx_crc32(0, &type, sizeof(type));
+    return fwrite(&len, sizeof(len), 1, file) != 1 || fwrite(&type, sizeof(type), 1, file) != 1;
+}
+
+int png_chunk_write(struct png_chunk *c, const void *data, size_t n)
+{
+    assert(c && c->file && (data || !n));
+    c->crc = stegx_crc32(c->crc, data, n);
+    return fwrite(data, 1, n, c->file) != n;
+}
+
+int png_chunk_end(struct png_chunk *c)
+{
+    assert(c && c->file);
+    uint32_t crc = stegx_htobe32(c->crc);
+    return fwrite(&crc, sizeof(crc), 1, c->file) != 1;
+}
+
+int png_chunk_check(FILE * file, uint32_t type, uint32_t len)
+{
+    assert(file);
+    uint8_t buf[PNG_BLOCK_SIZE];
+    uint32_t crc = stegx_crc32(0, &type, sizeof(type)), read_crc;
+    for (size_t n; len; len -= n) {
+        n = len < sizeof(buf) ? len : sizeof(buf);
+        if (fread(buf, 1, n, file) != n)
+            return 1;
+        crc = stegx_crc32(crc, buf, n);
+    }
+    if (fread(&read_crc, sizeof(read_crc), 1, file) != 1)
+        return 1;
+    return stegx_be32toh(read_crc) != crc;
+}
+
+uint32_t png_row_size(const png_s * png)
+{
+    assert(png);
+    /* Nombre d'échantillons par pixel selon le type de couleur. */
+    static const uint8_t channels[7] = { 1, 0, 3, 0, 2, 0, 4 };
+    uint64_t len = png->color_type < sizeof(channels) ? (uint64_t) png->width * channels[png->color_type] : 0;
+    if (png->bit_depth != 8 || png->interlace || !png->idat_begin || !png->height || len >= UINT32_MAX / 4)
+        return 0;
+    return len;
+}
+
+/**
+ * @brief Prédit un octet d'une ligne à partir de ses voisins.
+ * @param type Filtre de la ligne.
+ * @param a Octet du pixel de gauche.
+ * @param b Octet du pixel du dessus.
+ * @param c Octet du pixel en haut à gauche.
+ * @return Prédiction de l'octet.
+ * @author StegX Team
+ */
+static inline uint8_t png_predict(uint8_t type, uint8_t a, uint8_t b, uint8_t c)
+{
+    switch (type) {
+    case PNG_FILTER_SUB:
+        return a;
+    case PNG_FILTER_UP:
+        return b;
+    case PNG_FILTER_AVERAGE:
+        return (a + b) >> 1;
+    case PNG_FILTER_PAETH:{
+            int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+            return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+        }
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Défiltre une ligne sur place.
+ * @param type Filtre de la ligne.
+ * @param cur Ligne à défiltrer.
+ * @param prev Ligne précédente, défiltrée (des zéros pour la première).
+ * @param len Taille d'une ligne.
+ * @param bpp Nombre d'octets par pixel.
+ * @author StegX Team
+ */
+static void png_unfilter(uint8_t type, uint8_t * cur, const uint8_t * prev, uint32_t len, uint32_t bpp)
+{
+    if (type == PNG_FILTER_NONE)
+        return;
+    for (uint32_t i = 0; i < len; i++)
+        cur[i] += png_predict(type, i < bpp ? 0 : cur[i - bpp], prev[i], i < bpp ? 0 : prev[i - bpp]);
+}
+
+/**
+ * @brief Filtre une ligne.
+ * @param type Filtre de la ligne.
+ * @param out Ligne filtrée.
+ * @param cur Ligne à filtrer.
+ * @param prev Ligne précédente (des zéros pour la première).
+ * @param len Taille d'une ligne.
+ * @param bpp Nombre d'octets par pixel.
+ * @author StegX Team
+ */
+static void png_filter(uint8_t type, uint8_t * out, const uint8_t * cur, const uint8_t * prev, uint32_t len,
+                       uint32_t bpp)
+{
+    if (type == PNG_FILTER_NONE) {
+        memcpy(out, cur, len);
+        return;
+    }
+    for (uint32_t i = 0; i < len; i++)
+        out[i] = cur[i] - png_predict(type, i < bpp ? 0 : cur[i - bpp], prev[i], i < bpp ? 0 : prev[i - bpp]);
+}
+
+/**
+ * @brief Lit des données décompressées des chunks IDAT.
+ * @param in Lecture en cours.
+ * @param out Données lues.
+ * @param n Nombre d'octets à lire.
+ * @return 0 si tout s'est bien passé, 1 si les données sont incomplètes ou
+ * invalides, ou si le traitement est annulé.
+ * @author StegX Team
+ */
+static int png_in_read(struct png_in *in, uint8_t * out, uint32_t n)
+{
+    in->z.next_out = out, in->z.avail_out = n;
+    while (in->z.avail_out) {
+        /* Passage au chunk IDAT suivant quand le chunk en cours est lu. */
+        while (!in->z.avail_in && !in->left) {
+            uint32_t hdr[2];
+            if (in->next >= in->end || fseek(in->file, in->next, SEEK_SET)
+                || fread(hdr, sizeof(uint32_t), 2, in->file) != 2 || hdr[1] != SIG_IDAT)
+                return fprintf(stderr, "PNG file: Missing IDAT data\n"), 1;
+            in->left = stegx_be32toh(hdr[0]);
+            in->next += (long int)in->left + 3 * sizeof(uint32_t);
+        }
+        if (!in->z.avail_in) {
+            uint32_t k = in->left < sizeof(in->buf) ? in->left : sizeof(in->buf);
+            if (fread(in->buf, 1, k, in->file) != k)
+                return perror("PNG file: Can't read IDAT data"), 1;
+            in->left -= k;
+            in->z.next_in = in->buf, in->z.avail_in = k;
+            if (progress_at(in->p, in->next - in->left))
+                return 1;
+        }
+        int ret = inflate(&in->z, Z_NO_FLUSH);
+        if ((ret == Z_STREAM_END && in->z.avail_out) || (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR))
+            return fprintf(stderr, "PNG file: Invalid IDAT data\n"), 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Compresse une tranche de lignes (thread de la compression
+ * parallèle).
+ * @param arg Tranche à compresser (\r{struct png_slice}).
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *png_slice_deflate(void *arg)
+{
+    struct png_slice *s = arg;
+    s->adler = adler32(adler32(0, NULL, 0), s->in, s->in_len);
+    s->z.next_in = s->in, s->z.avail_in = s->in_len;
+    s->z.next_out = s->out, s->z.avail_out = s->out_size;
+    int ret = deflate(&s->z, s->last ? Z_FINISH : Z_SYNC_FLUSH);
+    s->err = (s->last ? ret != Z_STREAM_END : ret != Z_OK) || s->z.avail_in;
+    s->out_len = s->out_size - s->z.avail_out;
+    s->err |= deflateReset(&s->z) != Z_OK;
+    return NULL;
+}
+
+/**
+ * @brief Compresse des tranches en parallèle et les écrit dans des chunks
+ * IDAT.
+ * @param sl Tranches, dans l'ordre de l'image.
+ * @param nb Nombre de tranches.
+ * @param res Fichier résultat.
+ * @param first 1 si la première tranche commence l'image.
+ * @param adler Somme Adler-32 des tranches déjà écrites, mise à jour.
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+static int png_slices_write(struct png_slice *sl, int nb, FILE * res, int first, uLong * adler)
+{
+    parallel_run(png_slice_deflate, sl, nb, sizeof(*sl), NULL, NULL, 0);
+    int err = 0;
+
+    /* En-tête zlib avant la première tranche, somme Adler-32 après la
+     * dernière. */
+    static const uint8_t zlib_head[2] = { 0x78, 0x9C };
+    struct png_chunk c;
+    for (int t = 0; t < nb && !err; t++, first = 0) {
+        struct png_slice *s = &sl[t];
+        uint32_t sum;
+        *adler = first ? s->adler : adler32_combine(*adler, s->adler, s->in_len);
+        sum = stegx_htobe32(*adler);
+        err = s->err || png_chunk_begin(&c, res, SIG_IDAT, s->out_len + (first ? sizeof(zlib_head) : 0)
+                                        + (s->last ? sizeof(sum) : 0))
+            || (first && png_chunk_write(&c, zlib_head, sizeof(zlib_head)))
+            || png_chunk_write(&c, s->out, s->out_len)
+            || (s->last && png_chunk_write(&c, &sum, sizeof(sum))) || png_chunk_end(&c);
+    }
+    return err;
+}
+
+/**
+ * @brief Recopie une partie de l'hôte par blocs.
+ * @param in Fichier hôte, placé au début de la partie.
+ * @param out Fichier résultat.
+ * @param n Taille de la partie.
+ * @param p Progression à mettre à jour (peut être NULL).
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+static int png_copy(FILE * in, FILE * out, uint32_t n, struct progress *p)
+{
+    uint8_t buf[PNG_BLOCK_SIZE];
+    for (size_t k; n; n -= k) {
+        k = n < sizeof(buf) ? n : sizeof(buf);
+        if (fread(buf, 1, k, in) != k || fwrite(buf, 1, k, out) != k || (p && progress_step(p, k)))
+            return 1;
+    }
+    return 0;
+}
+
 int insert_metadata_png(info_s * infos)
 {
     assert(infos);
@@ -62,42 +336,126 @@ int insert_metadata_png(info_s * infos)
     assert(infos->host.type == PNG);
     if (fseek(infos->host.host, 0, SEEK_SET) == -1)
         return perror("Can't make insertion METADATA"), 1;
-    if (fseek(infos->hidden, 0, SEEK_SET) == -1)
-        return perror("Can't make insertion METADATA"), 1;
 
-    uint32_t nb_cpy = 0;
-    uint8_t byte_read_png;
     // Recopie du header du fichier PNG
-    while (nb_cpy < infos->host.file_info.png.header_size) {
-        if (fread(&byte_read_png, sizeof(uint8_t), 1, infos->host.host) != 1)
-            return perror("PNG file: Can't read header"), 1;
-        if (fwrite(&byte_read_png, sizeof(uint8_t), 1, infos->res) == 0)
-            return perror("PNG file: Can't write header"), 1;
-        nb_cpy++;
+    if (png_copy(infos->host.host, infos->res, infos->host.file_info.png.header_size, NULL))
+        return perror("PNG file: Can't copy header"), 1;
+    // Recopie du data du fichier PNG
+    if (png_copy(infos->host.host, infos->res, infos->host.file_info.png.data_size - LENGTH_CHUNK_IEND,
+                 &infos->progress))
+        return progress_canceled(&infos->progress) ? 1 : (perror("PNG file: Can't copy data"), 1);
+    return png_metadata_write_hidden(infos);
+}
+
+int png_rows(info_s * infos, png_row_f f, void *arg)
+{
+    assert(infos && f);
+    png_s *png = &infos->host.file_info.png;
+    FILE *h = infos->host.host, *r = infos->res;
+    uint32_t len = png_row_size(png), bpp = len / png->width;
+    int insert = infos->mode == STEGX_MODE_INSERT;
+    assert(len);
+
+    /* Lignes en cours et précédentes, d'origine puis modifiées. */
+    struct png_in *in = arena_alloc(&infos->arena, sizeof(*in));
+    uint8_t *rows = arena_calloc(&infos->arena, 4, len);
+    if (!in || !rows)
+        return perror("PNG file: Can't allocate memory for the rows"), 1;
+    uint8_t *orig[2] = { rows, rows + len }, *mod[2] = { rows + 2 * (size_t)len, rows + 3 * (size_t)len };
+    memset(&in->z, 0, sizeof(in->z));
+    in->file = h, in->next = png->idat_begin, in->end = png->idat_end, in->left = 0, in->p = &infos->progress;
+    if (inflateInit(&in->z) != Z_OK)
+        return fprintf(stderr, "PNG file: Can't initialize decompression\n"), 1;
+
+    /* Tranches compressées ensemble : autant que de threads. Leur taille ne
+     * dépend que de l'image, le résultat est donc le même quel que soit le
+     * nombre de threads. */
+    long int nb = insert && (infos->flags & STEGX_FLAG_PARALLEL) ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    uint32_t rps = PNG_SLICE_SIZE / (len + 1) ? PNG_SLICE_SIZE / (len + 1) : 1;
+    if (rps > png->height)
+        rps = png->height;
+    if (nb > (png->height + rps - 1) / rps)
+        nb = (png->height + rps - 1) / rps;
+    if (nb < 1)
+        nb = 1;
+    struct png_slice *sl = insert ? arena_calloc(&infos->arena, nb, sizeof(*sl)) : NULL;
+    int err = insert && !sl;
+    for (long int t = 0; insert && !err && t < nb; t++) {
+        struct png_slice *s = &sl[t];
+        if (deflateInit2(&s->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            err = 1;
+            break;
+        }
+        /* Un vidage ajoute au plus quelques octets à la borne de deflate. */
+        s->out_size = deflateBound(&s->z, rps * (len + 1)) + 16;
+        s->in = arena_alloc(&infos->arena, (size_t)rps * (len + 1));
+        s->out = arena_alloc(&infos->arena, s->out_size);
+        err = !s->in || !s->out;
     }
+    if (err)
+        perror("PNG file: Can't allocate memory for the compression");
 
-    // Recopie du data du fichier PNG
-    nb_cpy = 0;
-    while (nb_cpy < infos->host.file_info.png.data_size - LENGTH_CHUNK_IEND) {
-        if (fread(&byte_read_png, sizeof(uint8_t), 1, infos->host.host) != 1)
-            return perror("PNG file: Can't read data"), 1;
-        if (fwrite(&byte_read_png, sizeof(uint8_t), 1, infos->res) == 0)
-            return perror("PNG file: Can't write data"), 1;
-        nb_cpy++;
+    /* Recopie des chunks qui précèdent les IDAT. */
+    if (!err && insert && (fseek(h, 0, SEEK_SET) || png_copy(h, r, png->idat_begin, NULL)))
+        err = 1, perror("PNG file: Can't copy the chunks before IDAT");
+
+    /* Lecture des lignes par fenêtres de "nb" tranches. */
+    uLong adler = 0;
+    for (uint32_t y = 0, stop = 0; !err && !stop && y < png->height;) {
+        int n = 0, first = y == 0;
+        for (; !err && !stop && n < (insert ? nb : 1) && y < png->height; n++) {
+            struct png_slice *s = insert ? &sl[n] : NULL;
+            if (s)
+                s->in_len = 0;
+            for (uint32_t y1 = png->height - y < rps ? png->height : y + rps; !err && !stop && y < y1; y++) {
+                uint8_t type, *cur = orig[y & 1];
+                if (png_in_read(in, &type, 1) || png_in_read(in, cur, len) || type >= PNG_NB_FILTER) {
+                    err = 1;
+                    break;
+                }
+                png_unfilter(type, cur, orig[!(y & 1)], len, bpp);
+                /* Extraction : la ligne d'origine suffit. */
+                if (!s) {
+                    int ret = f(cur, len, arg);
+                    err = ret == 1, stop = ret == -1;
+                    continue;
+                }
+                memcpy(mod[y & 1], cur, len);
+                err = f(mod[y & 1], len, arg) == 1;
+                s->in[s->in_len] = type;
+                png_filter(type, s->in + s->in_len + 1, mod[y & 1], mod[!(y & 1)], len, bpp);
+                s->in_len += len + 1;
+            }
+            if (s)
+                s->last = y == png->height;
+        }
+        if (insert && !err && png_slices_write(sl, n, r, first, &adler))
+            err = 1, perror("PNG file: Can't write IDAT");
     }
 
+    /* Recopie des chunks qui suivent les IDAT, jusqu'au chunk IEND. */
+    if (!err && insert && (fseek(h, png->idat_end, SEEK_SET)
+                           || png_copy(h, r, png->header_size + png->data_size - png->idat_end, NULL)))
+        err = 1, perror("PNG file: Can't copy the chunks after IDAT");
+    inflateEnd(&in->z);
+    for (int t = 0; insert && sl && t < nb; t++)
+        if (sl[t].z.state)
+            deflateEnd(&sl[t].z);
+    return err;
+}
+
+int png_metadata_write_hidden(info_s * infos)
+{
+    assert(infos && infos->mode == STEGX_MODE_INSERT);
+
     // Lecture des donnees a cacher et stockage dans data
-    uint8_t *data = malloc(infos->hidden_length * sizeof(uint8_t));
+    uint8_t *data = arena_alloc(&infos->arena, infos->hidden_length * sizeof(uint8_t));
     if (!data)
         return perror("Can't allocate memory Extraction"), 1;
     if (fseek(infos->hidden, 0, SEEK_SET) == -1)
         return perror("Can't make insertion EOF"), 1;
-    uint32_t length;
-    for (length = 0; length < infos->hidden_length; length++) {
-        if (fread(&byte_read_png, sizeof(uint8_t), 1, infos->hidden) != 1)
-            return perror("PNG file: Can't read data"), 1;
-        data[length] = byte_read_png;
-    }
+    if (fread(data, sizeof(uint8_t), infos->hidden_length, infos->hidden) != infos->hidden_length)
+        return perror("PNG file: Can't read data"), 1;
 
     /* Si le fichier depasse la limite de taille imposee
      * on fait un XOR avec les nombres pseudo aleatoires generes à partir 
@@ -106,68 +464,39 @@ int insert_metadata_png(info_s * infos)
     if (infos->hidden_length > LENGTH_FILE_MAX) {
         stegx_srand(create_seed(infos->passwd));
         uint8_t random;
-        for (length = 0; length < infos->hidden_length; length++) {
+        for (uint32_t length = 0; length < infos->hidden_length; length++) {
             random = stegx_rand() % UINT8_MAX;
             data[length] = data[length] ^ random;       //XOR avec le nombre pseudo aleatoire generé
         }
     }
     // Sinon on fait le melange des octets des donnees a cacher
     else {
-        protect_data(data, infos->hidden_length, infos->passwd, infos->mode);
+        if (protect_data(data, infos->hidden_length, infos->passwd, infos->mode, &infos->arena,
+                         &infos->progress))
+            return 1;
     }
 
     // Creation de 2 chunks tEXt pour cacher les donnees dans le fichier PNG
-    uint32_t part_length_hidden = ((infos->hidden_length) / 2) + 4;
-    //+4 pour reconnaitre que ce chunk tEXt a ete cree par STEGX 
-    length = 0;
-    uint32_t part_length_hidden_big_endian = stegx_htobe32(part_length_hidden);
-    uint32_t sig = SIG_tEXt;
+    // (4 octets STEGX au debut pour reconnaitre les chunks tEXt crees par STEGX)
+    uint32_t part = infos->hidden_length / 2, sig = SIG_STEGX_PNG;
+    struct png_chunk c;
     for (int i = 0; i < 2; i++) {
-        // Recopie en big endian de la taille du chunk tEXt
-        if (fwrite(&part_length_hidden_big_endian, sizeof(uint32_t), 1, infos->res) == 0)
-            return perror("PNG file: Can't write length of chunk tEXt"), 1;
-        // Recopie de la signature tEXt
-        if (fwrite(&sig, sizeof(uint32_t), 1, infos->res) == 0)
-            return perror("PNG file: Can't write length of chunk tEXt"), 1;
-        // Recopie des 4 octets STEGX pour reconnaitre le chunk tEXt
-        sig = SIG_STEGX_PNG;
-        if (fwrite(&sig, sizeof(uint32_t), 1, infos->res) == 0)
-            return perror("PNG file: Can't write length of chunk tEXt"), 1;
-        nb_cpy = 0;
-        // Recopie des donnees a cacher
-        while (nb_cpy < (part_length_hidden - 4)) {
-            if (fwrite(&data[length], sizeof(uint8_t), 1, infos->res) == 0)
-                return perror("PNG file: Can't write data hidden"), 1;
-            nb_cpy++;
-            length++;
-        }
-        // Ecriture du CRC du chunk tEXt nouvellement créé
-        sig = 0x00;
-        if (fwrite(&sig, sizeof(uint32_t), 1, infos->res) == 0)
-            return perror("PNG file: Can't write CRC of chunk tEXt"), 1;
-
-        // pour le deuxieme chunk cree on prend les donnees restantes a cacher
-        part_length_hidden = (infos->hidden_length) - ((infos->hidden_length) / 2) + 4;
-        part_length_hidden_big_endian = stegx_htobe32(part_length_hidden);
-        sig = SIG_tEXt;
+        uint32_t part_length = i ? infos->hidden_length - part : part;
+        if (png_chunk_begin(&c, infos->res, SIG_tEXt, part_length + 4)
+            || png_chunk_write(&c, &sig, sizeof(sig))
+            || png_chunk_write(&c, data + (i ? part : 0), part_length) || png_chunk_end(&c))
+            return perror("PNG file: Can't write chunk tEXt"), 1;
     }
 
     // Ecriture du chunk IEND 
-    nb_cpy = 0;
-    while (nb_cpy < LENGTH_CHUNK_IEND) {
-        if (fread(&byte_read_png, sizeof(uint8_t), 1, infos->host.host) != 1)
-            return perror("PNG file: Can't read data"), 1;
-        if (fwrite(&byte_read_png, sizeof(uint8_t), 1, infos->res) == 0)
-            return perror("PNG file: Can't write data"), 1;
-        nb_cpy++;
-    }
+    if (png_copy(infos->host.host, infos->res, LENGTH_CHUNK_IEND, NULL))
+        return perror("PNG file: Can't copy chunk IEND"), 1;
 
     // Ecriture de la signature
     if (write_signature(infos) == 1) {
         stegx_errno = ERR_INSERT;
         return 1;
     }
-    free(data);
     return 0;
 }
 
@@ -191,13 +520,15 @@ int extract_metadata_png(info_s * infos)
     if (fread(&chunk_id, sizeof(uint32_t), 1, infos->host.host) != 1)
         return perror("PNG file: Can't read ID of chunk"), 1;
 
-    uint8_t *data = malloc(infos->hidden_length * sizeof(uint8_t));
+    uint8_t *data = arena_alloc(&infos->arena, infos->hidden_length * sizeof(uint8_t));
     if (!data)
         return perror("Can't allocate memory Extraction"), 1;
     uint32_t length = 0;
     // Lecture de tous les chunks du fichier a analyser     
     uint8_t bool_stegx_text = 0;
     do {
+        if (progress_at(&infos->progress, ftell(infos->host.host)))
+            return 1;
         // si il s'agit d'un chunk tEXt
         if (chunk_id == SIG_tEXt) {
             nb_cpy = 0;         // lecture des 4 premiers octets de data du chunk tEXt
@@ -249,15 +580,13 @@ int extract_metadata_png(info_s * infos)
     }
     // Sinon on fait remet dans l'ordre les octets des donnees cachées
     else {
-        protect_data(data, infos->hidden_length, infos->passwd, infos->mode);
-    }
-
-    for (length = 0; length < infos->hidden_length; length++) {
-        if (fwrite(&data[length], sizeof(uint8_t), 1, infos->res) == 0)
-            return perror("PNG file: Can't write data"), 1;
+        if (protect_data(data, infos->hidden_length, infos->passwd, infos->mode, &infos->arena,
+                         &infos->progress))
+            return 1;
     }
 
-    free(data);
+    if (fwrite(data, sizeof(uint8_t), infos->hidden_length, infos->res) != infos->hidden_length)
+        return perror("PNG file: Can't write data"), 1;
 
     return 0;
 }
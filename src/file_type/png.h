@@ -49,6 +49,8 @@
 #define LENGTH_CRC 4
 /** Longueur jusqu'au premier chunk PNG. */
 #define LENGTH_SIG_PNG 8
+/** Longueur en octets des données du chunk IHDR. */
+#define LENGTH_IHDR 13
 
 /**
  * @brief Structure du format PNG.
@@ -58,11 +60,29 @@
 struct png {
     uint32_t header_size;       /*!< Taille du Header en octets. */
     uint32_t data_size;         /*!< Taille du chunk Data en octets. */
+    uint32_t idat_begin;        /*!< Adresse du premier chunk IDAT (0 s'il n'y en a pas). */
+    uint32_t idat_end;          /*!< Adresse de la fin du dernier chunk IDAT (les IDAT se suivent). */
+    uint32_t width;             /*!< Largeur de l'image en pixels. */
+    uint32_t height;            /*!< Hauteur de l'image en pixels. */
+    uint8_t bit_depth;          /*!< Nombre de bits par échantillon. */
+    uint8_t color_type;         /*!< Type de couleur (0 gris, 2 RGB, 3 palette, 4 gris et alpha, 6 RGBA). */
+    uint8_t interlace;          /*!< Méthode d'entrelacement (0 aucune, 1 Adam7). */
 };
 
 /** Type du format PNG. */
 typedef struct png png_s;
 
+/**
+ * @brief Chunk PNG en cours d'écriture (\r{png_chunk_begin}).
+ * @details Les données sont écrites par blocs, dans l'ordre, et le CRC est
+ * calculé au fur et à mesure : le chunk n'a pas besoin d'être en mémoire.
+ * @author StegX Team
+ */
+struct png_chunk {
+    FILE *file;                 /*!< Fichier où le chunk est écrit. */
+    uint32_t crc;               /*!< CRC du type et des données déjà écrits. */
+};
+
 /**
  * @brief Test si le fichier est un fichier PNG.
  * @param file Fichier à tester.
@@ -72,6 +92,92 @@ typedef struct png png_s;
  */
 type_e stegx_test_file_png(FILE * file);
 
+/**
+ * @brief Fonction appelée sur chaque ligne de l'image (\r{png_rows}).
+ * @param row Échantillons de la ligne, défiltrés (modifiables à l'insertion).
+ * @param len Taille de la ligne en octets.
+ * @param arg Paramètre de la fonction.
+ * @return 0 pour continuer, -1 pour arrêter la lecture (en extraction
+ * seulement), 1 sur une erreur.
+ */
+typedef int (*png_row_f) (uint8_t * row, uint32_t len, void *arg);
+
+/**
+ * @brief Calcule la taille d'une ligne de l'image dont les échantillons
+ * peuvent être modifiés.
+ * @param png Structure du fichier PNG.
+ * @return Taille d'une ligne défiltrée en octets, 0 si l'image n'est pas
+ * modifiable en LSB (palette, entrelacement, 16 bits ou moins de 8 bits par
+ * échantillon).
+ * @author StegX Team
+ */
+uint32_t png_row_size(const png_s * png);
+
+/**
+ * @brief Parcourt les lignes de l'image, et les réécrit à l'insertion.
+ * @details Les chunks IDAT sont décompressés en flux et chaque ligne est
+ * défiltrée puis passée à "f". À l'insertion, les chunks qui précèdent et
+ * suivent les IDAT sont recopiés et les lignes, refiltrées avec leur filtre
+ * d'origine, sont recompressées par tranches indépendantes (un thread par
+ * tranche avec \r{STEGX_FLAG_PARALLEL}) écrites chacune dans un chunk IDAT.
+ * Seule une fenêtre de tranches est en mémoire. Le résultat ne dépend pas du
+ * nombre de threads.
+ * @req L'image doit être modifiable (\r{png_row_size}).
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation ou l'extraction.
+ * @param f Fonction appelée sur chaque ligne.
+ * @param arg Paramètre de "f".
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+int png_rows(info_s * infos, png_row_f f, void *arg);
+
+/**
+ * @brief Commence l'écriture d'un chunk : écrit sa taille et son type.
+ * @param c Chunk à écrire.
+ * @param file Fichier où écrire le chunk.
+ * @param type Type du chunk, tel qu'il est lu dans le fichier (\r{SIG_tEXt}...).
+ * @param len Taille des données du chunk.
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+int png_chunk_begin(struct png_chunk *c, FILE * file, uint32_t type, uint32_t len);
+
+/**
+ * @brief Écrit des données du chunk, à la suite des précédentes.
+ * @param c Chunk en cours d'écriture.
+ * @param data Données.
+ * @param n Taille des données.
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+int png_chunk_write(struct png_chunk *c, const void *data, size_t n);
+
+/**
+ * @brief Termine l'écriture d'un chunk : écrit son CRC.
+ * @req Les données écrites doivent faire la taille donnée à
+ * \r{png_chunk_begin}.
+ * @param c Chunk en cours d'écriture.
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+int png_chunk_end(struct png_chunk *c);
+
+/**
+ * @brief Vérifie le CRC d'un chunk existant.
+ * @details Les données sont lues par blocs et le fichier est placé sur le
+ * chunk suivant.
+ * @req Le curseur du fichier doit être sur les données du chunk (après sa
+ * taille et son type).
+ * @param file Fichier PNG.
+ * @param type Type du chunk, tel qu'il est lu dans le fichier.
+ * @param len Taille des données du chunk.
+ * @return 0 si le CRC est correct, 1 s'il est faux ou en cas d'erreur de
+ * lecture.
+ * @author StegX Team
+ */
+int png_chunk_check(FILE * file, uint32_t type, uint32_t len);
+
 /** 
  * @brief Va inserer les donnees cachees en utilisant l'algorithme Metadata 
  * dans le format PNG. 
@@ -81,6 +187,19 @@ type_e stegx_test_file_png(FILE * file);
  */
 int insert_metadata_png(info_s * infos);
 
+/** 
+ * @brief Écrit les chunks tEXt contenant les données cachées, recopie le
+ * chunk IEND de l'hôte puis écrit la signature.
+ * @details Partie de l'algorithme Metadata pour PNG qui suit la recopie de
+ * l'hôte jusqu'au chunk IEND (exclu).
+ * @req Le curseur de \r{info_s.host.host} doit être sur le chunk IEND et la
+ * copie de l'hôte qui le précède doit déjà avoir été écrite dans \r{info_s.res}.
+ * @param infos Structure représentant les informations concernant la dissimulation.
+ * @return 0 si les données ont bien été écrites ; sinon 1 en cas d'erreur.
+ * @author StegX Team
+ */
+int png_metadata_write_hidden(info_s * infos);
+
 /** 
  * @brief Va extraire les donnees cachees en utilisant l'algorithme Metadata
  * dans le formar PNG. 
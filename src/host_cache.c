@@ -0,0 +1,401 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file host_cache.c
+ * @brief Cache des fichiers hôtes en mémoire partagée.
+ * @details Un hôte absent du cache est réservé (état \r{CACHE_LOADING}) sous
+ * le verrou, puis lu et analysé hors du verrou par le processus qui l'a
+ * demandé. Pendant ce chargement, les autres processus ouvrent l'hôte
+ * normalement plutôt que d'attendre. Retirer un hôte du cache supprime
+ * seulement le nom de son segment : les processus qui l'ont déjà projeté
+ * continuent de l'utiliser jusqu'à leur \r{stegx_clear}.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "stegx.h"
+#include "check_compa.h"
+#include "sugg_algo.h"
+#include "host_cache.h"
+
+/** Signature du segment de contrôle ("SXHC"), écrite une fois initialisé. */
+#define CACHE_MAGIC 0x43485853
+
+/** Nombre d'attentes de 1 ms de l'initialisation du segment de contrôle. */
+#define CACHE_WAIT_INIT 1000
+
+/** Adresse de l'index dans le segment d'un hôte de taille "size" (alignée sur 8 octets). */
+#define CACHE_UNITS_OFF(size) (((size) + 7) & ~(uint64_t) 7)
+
+/** État d'une entrée du cache. */
+enum cache_state {
+    CACHE_FREE = 0,             /*!< Entrée libre. */
+    CACHE_LOADING,              /*!< Hôte en cours de chargement par le processus "loader". */
+    CACHE_READY                 /*!< Hôte chargé et analysé. */
+};
+
+/**
+ * @brief Entrée du cache : identité, analyse et segment d'un hôte.
+ */
+struct cache_entry {
+    uint32_t state;             /*!< État de l'entrée (\r{cache_state}). */
+    pid_t loader;               /*!< Processus chargeant l'hôte (état \r{CACHE_LOADING}). */
+    uint64_t dev;               /*!< Périphérique contenant l'hôte. */
+    uint64_t ino;               /*!< Inode de l'hôte. */
+    uint64_t size;              /*!< Taille de l'hôte (octets). */
+    int64_t mtime_sec;          /*!< Date de modification de l'hôte (secondes). */
+    int64_t mtime_nsec;         /*!< Date de modification de l'hôte (nanosecondes). */
+    uint32_t mode;              /*!< Mode de l'analyse (l'analyse FLV en dépend). */
+    uint64_t last_use;          /*!< Date logique de la dernière utilisation (LRU). */
+    uint32_t type;              /*!< Type de l'hôte. */
+    union file_info_u file_info;        /*!< Analyse de l'hôte. */
+    uint64_t map_size;          /*!< Taille du segment : l'hôte, puis son index à \r{CACHE_UNITS_OFF}. */
+    uint32_t nb_units;          /*!< Nombre d'éléments de l'index (frames MP3 ou tags FLV, 0 si aucun). */
+    char name[HOST_CACHE_NAME_MAX];     /*!< Nom du segment contenant l'hôte. */
+};
+
+/**
+ * @brief Segment de contrôle partagé par tous les processus.
+ */
+struct cache_ctl {
+    uint32_t magic;             /*!< \r{CACHE_MAGIC} une fois le segment initialisé. */
+    pthread_mutex_t lock;       /*!< Verrou partagé entre processus et robuste. */
+    uint64_t budget;            /*!< Budget mémoire des hôtes (octets). */
+    uint64_t used;              /*!< Mémoire utilisée par les hôtes (octets). */
+    uint64_t clock;             /*!< Horloge logique pour le LRU. */
+    uint64_t seq;               /*!< Numéro du prochain segment d'hôte. */
+    struct cache_entry entries[HOST_CACHE_MAX_ENTRIES]; /*!< Hôtes du cache. */
+};
+
+/** Cache ouvert par le processus. */
+static struct {
+    struct cache_ctl *ctl;      /*!< Segment de contrôle projeté (NULL si fermé). */
+    char name[HOST_CACHE_NAME_MAX - 21];        /*!< Nom du segment de contrôle (sans le ".<numéro>" des hôtes). */
+} cache;
+
+/**
+ * @brief Prend le verrou du cache.
+ * @details Si un processus est mort en tenant le verrou, l'état est
+ * récupéré : les entrées sont toujours cohérentes entre deux modifications.
+ * @return 0 si le verrou est pris, 1 sinon.
+ * @author StegX Team
+ */
+static int cache_lock(void)
+{
+    int r = pthread_mutex_lock(&cache.ctl->lock);
+    if (r == EOWNERDEAD)
+        r = pthread_mutex_consistent(&cache.ctl->lock);
+    return r != 0;
+}
+
+/**
+ * @brief Retire une entrée du cache.
+ * @req Le verrou du cache doit être pris.
+ * @param e Entrée à retirer.
+ * @author StegX Team
+ */
+static void cache_evict(struct cache_entry *e)
+{
+    shm_unlink(e->name);
+    cache.ctl->used -= e->map_size;
+    memset(e, 0, sizeof(*e));
+}
+
+/**
+ * @brief Réserve une entrée pour un hôte de taille donnée.
+ * @details Retire les hôtes utilisés le moins récemment tant que le budget ou
+ * le nombre d'entrées est dépassé.
+ * @req Le verrou du cache doit être pris.
+ * @param size Taille de l'hôte à ajouter.
+ * @return Entrée libre réservée, NULL si le budget ne permet pas d'ajouter
+ * l'hôte.
+ * @author StegX Team
+ */
+static struct cache_entry *cache_reserve(uint64_t size)
+{
+    struct cache_ctl *ctl = cache.ctl;
+    if (size > ctl->budget)
+        return NULL;
+    for (;;) {
+        struct cache_entry *lru = NULL, *free_e = NULL;
+        for (int i = 0; i < HOST_CACHE_MAX_ENTRIES; i++) {
+            struct cache_entry *e = &ctl->entries[i];
+            if (e->state == CACHE_FREE && !free_e)
+                free_e = e;
+            else if (e->state == CACHE_READY && (!lru || e->last_use < lru->last_use))
+                lru = e;
+        }
+        if (free_e && ctl->used + size <= ctl->budget)
+            return ctl->used += size, free_e;
+        if (!lru)
+            return NULL;
+        cache_evict(lru);
+    }
+}
+
+/**
+ * @brief Cherche l'entrée d'un hôte dans le cache.
+ * @req Le verrou du cache doit être pris.
+ * @param st Propriétés du fichier hôte.
+ * @param mode Mode d'utilisation de la bibliothèque.
+ * @return Entrée de l'hôte, NULL s'il n'est pas dans le cache.
+ * @author StegX Team
+ */
+static struct cache_entry *cache_find(const struct stat *st, mode_e mode)
+{
+    for (int i = 0; i < HOST_CACHE_MAX_ENTRIES; i++) {
+        struct cache_entry *e = &cache.ctl->entries[i];
+        if (e->state != CACHE_FREE && e->dev == (uint64_t) st->st_dev
+            && e->ino == (uint64_t) st->st_ino && e->size == (uint64_t) st->st_size
+            && e->mtime_sec == st->st_mtim.tv_sec && e->mtime_nsec == st->st_mtim.tv_nsec
+            && e->mode == mode)
+            return e;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Charge un hôte dans son segment puis l'analyse.
+ * @details L'index construit par l'analyse (frames MP3 ou tags FLV) est
+ * recopié dans le même segment, après le contenu de l'hôte : les processus
+ * qui projettent l'hôte n'ont pas à le reconstruire.
+ * @param e Copie de l'entrée réservée pour l'hôte (remplie avec l'analyse,
+ * "map_size" et "nb_units").
+ * @param path Chemin du fichier hôte.
+ * @return Projection du segment en lecture seule, MAP_FAILED en cas d'erreur.
+ * @author StegX Team
+ */
+static void *cache_load(struct cache_entry *e, const char *path)
+{
+    int fd = shm_open(e->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1)
+        return MAP_FAILED;
+    uint8_t *addr = ftruncate(fd, e->size) ? MAP_FAILED :
+        mmap(NULL, e->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        return close(fd), MAP_FAILED;
+
+    /* Copie du contenu de l'hôte dans le segment. */
+    FILE *f = fopen(path, "rb");
+    size_t n = f ? fread(addr, sizeof(*addr), e->size, f) : 0;
+    if (f)
+        fclose(f);
+    if (n != e->size)
+        return close(fd), munmap(addr, e->size), MAP_FAILED;
+
+    /* Analyse de l'hôte depuis la mémoire. */
+    info_s tmp = {.mode = e->mode };
+    if (!(tmp.host.host = fmemopen(addr, e->size, "rb")))
+        return close(fd), munmap(addr, e->size), MAP_FAILED;
+    if (!(tmp.host.type = check_file_format(tmp.host.host)) || fill_host_info(&tmp))
+        return fclose(tmp.host.host), free(tmp.host.mp3_fr_size), free(tmp.host.flv_tag),
+            close(fd), munmap(addr, e->size), MAP_FAILED;
+    fclose(tmp.host.host);
+
+    /* Index ajouté à la fin du segment, projeté de nouveau à sa taille finale. */
+    const void *units = NULL;
+    size_t unit_size = 0;
+    if (tmp.host.type == MP3 && tmp.host.mp3_fr_size)
+        units = tmp.host.mp3_fr_size, unit_size = sizeof(*tmp.host.mp3_fr_size),
+            e->nb_units = (uint32_t) tmp.host.file_info.mp3.fr_nb;
+    else if (tmp.host.type == FLV && tmp.host.flv_tag)
+        units = tmp.host.flv_tag, unit_size = sizeof(*tmp.host.flv_tag),
+            e->nb_units = tmp.host.flv_nb_tag;
+    e->map_size = units ? CACHE_UNITS_OFF(e->size) + (uint64_t) unit_size * e->nb_units : e->size;
+    if (units) {
+        munmap(addr, e->size);
+        addr = ftruncate(fd, e->map_size) ? MAP_FAILED :
+            mmap(NULL, e->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED)
+            memcpy(addr + CACHE_UNITS_OFF(e->size), units, unit_size * e->nb_units);
+    }
+    free(tmp.host.mp3_fr_size), free(tmp.host.flv_tag);
+    close(fd);
+    if (addr == MAP_FAILED || mprotect(addr, e->map_size, PROT_READ))
+        return addr != MAP_FAILED ? munmap(addr, e->map_size) : 0, MAP_FAILED;
+    e->type = tmp.host.type;
+    e->file_info = tmp.host.file_info;
+    return addr;
+}
+
+int stegx_cache_open(const char *name, uint64_t budget)
+{
+    if (!name || cache.ctl || strlen(name) + 1 >= sizeof(cache.name))
+        return stegx_errno = ERR_CACHE, 1;
+    snprintf(cache.name, sizeof(cache.name), "/%s", name);
+
+    /* Le premier processus crée et initialise le segment de contrôle. */
+    int created = 1;
+    int fd = shm_open(cache.name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1 && errno == EEXIST)
+        created = 0, fd = shm_open(cache.name, O_RDWR, 0600);
+    if (fd == -1)
+        return perror("Cache: Can't open control segment"), stegx_errno = ERR_CACHE, 1;
+    if (created && ftruncate(fd, sizeof(struct cache_ctl)))
+        return perror("Cache: Can't size control segment"), close(fd), shm_unlink(cache.name),
+            stegx_errno = ERR_CACHE, 1;
+    /* Les autres attendent que le segment ait sa taille définitive. */
+    struct stat st;
+    for (int i = 0; !created && !fstat(fd, &st) && st.st_size < (off_t) sizeof(struct cache_ctl)
+         && i < CACHE_WAIT_INIT; i++)
+        nanosleep(&(struct timespec) {.tv_nsec = 1000000}, NULL);
+    struct cache_ctl *ctl =
+        mmap(NULL, sizeof(struct cache_ctl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ctl == MAP_FAILED)
+        return perror("Cache: Can't map control segment"), stegx_errno = ERR_CACHE, 1;
+
+    if (created) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&ctl->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+        ctl->budget = budget;
+        __atomic_store_n(&ctl->magic, CACHE_MAGIC, __ATOMIC_RELEASE);
+    }
+    for (int i = 0; __atomic_load_n(&ctl->magic, __ATOMIC_ACQUIRE) != CACHE_MAGIC; i++) {
+        if (i == CACHE_WAIT_INIT)
+            return munmap(ctl, sizeof(*ctl)), stegx_errno = ERR_CACHE, 1;
+        nanosleep(&(struct timespec) {.tv_nsec = 1000000}, NULL);
+    }
+    cache.ctl = ctl;
+
+    /* Un budget non nul remplace celui du cache existant. */
+    if (!created && budget) {
+        if (cache_lock())
+            return stegx_cache_close(0), stegx_errno = ERR_CACHE, 1;
+        ctl->budget = budget;
+        pthread_mutex_unlock(&ctl->lock);
+    }
+    return 0;
+}
+
+void stegx_cache_close(int destroy)
+{
+    if (!cache.ctl)
+        return;
+    if (destroy && !cache_lock()) {
+        for (int i = 0; i < HOST_CACHE_MAX_ENTRIES; i++)
+            if (cache.ctl->entries[i].state != CACHE_FREE)
+                cache_evict(&cache.ctl->entries[i]);
+        pthread_mutex_unlock(&cache.ctl->lock);
+        shm_unlink(cache.name);
+    }
+    cache.ctl = (munmap(cache.ctl, sizeof(struct cache_ctl)), NULL);
+}
+
+int host_cache_attach(info_s * infos, const char *path)
+{
+    assert(infos && path);
+    struct stat st;
+    if (!cache.ctl || stat(path, &st) || !S_ISREG(st.st_mode) || !st.st_size)
+        return 1;
+    if (cache_lock())
+        return 1;
+
+    /* Un chargement abandonné (processus mort) est retiré du cache. */
+    struct cache_entry *e = cache_find(&st, infos->mode), cpy;
+    if (e && e->state == CACHE_LOADING && kill(e->loader, 0) && errno == ESRCH)
+        cache_evict(e), e = NULL;
+    int load = !e;
+    if (load && (e = cache_reserve(st.st_size))) {
+        e->state = CACHE_LOADING;
+        e->loader = getpid();
+        e->dev = st.st_dev, e->ino = st.st_ino, e->size = st.st_size;
+        e->mtime_sec = st.st_mtim.tv_sec, e->mtime_nsec = st.st_mtim.tv_nsec;
+        e->mode = infos->mode;
+        e->map_size = st.st_size;
+        snprintf(e->name, sizeof(e->name), "%s.%llu", cache.name,
+                 (unsigned long long)++cache.ctl->seq);
+    }
+    /* Hôte en cours de chargement par un autre processus ou budget dépassé. */
+    if (!e || (!load && e->state != CACHE_READY))
+        return pthread_mutex_unlock(&cache.ctl->lock), 1;
+    e->last_use = ++cache.ctl->clock;
+    cpy = *e;
+    pthread_mutex_unlock(&cache.ctl->lock);
+
+    /* Chargement de l'hôte ou projection du segment existant. */
+    void *addr = MAP_FAILED;
+    if (load) {
+        addr = cache_load(&cpy, path);
+        if (cache_lock())
+            return addr != MAP_FAILED ? munmap(addr, cpy.map_size) : 0, 1;
+        if (addr == MAP_FAILED)
+            cache_evict(e);
+        else {
+            /* L'index est compté dans le budget une fois sa taille connue. */
+            cache.ctl->used += cpy.map_size - e->map_size;
+            e->type = cpy.type, e->file_info = cpy.file_info, e->state = CACHE_READY;
+            e->map_size = cpy.map_size, e->nb_units = cpy.nb_units;
+        }
+        pthread_mutex_unlock(&cache.ctl->lock);
+    } else {
+        int fd = shm_open(cpy.name, O_RDONLY, 0);
+        if (fd != -1)
+            addr = mmap(NULL, cpy.map_size, PROT_READ, MAP_SHARED, fd, 0), close(fd);
+    }
+    if (addr == MAP_FAILED)
+        return 1;
+
+    /* L'hôte est lu par les algorithmes comme un fichier, depuis la mémoire partagée. */
+    host_cache_map_s *map = malloc(sizeof(*map));
+    FILE *f = map ? fmemopen(addr, cpy.size, "rb") : NULL;
+    if (!f)
+        return free(map), munmap(addr, cpy.map_size), 1;
+    map->addr = addr, map->size = cpy.map_size;
+    infos->host.host = f;
+    infos->host.type = cpy.type;
+    infos->host.file_info = cpy.file_info;
+    infos->host.cache = map;
+    infos->host.analysed = 1;
+    /* Index prêté depuis le segment : il n'est pas libéré avec l'hôte. */
+    if (cpy.nb_units) {
+        void *units = (uint8_t *) addr + CACHE_UNITS_OFF(cpy.size);
+        if (cpy.type == MP3)
+            infos->host.mp3_fr_size = units;
+        else
+            infos->host.flv_tag = units, infos->host.flv_nb_tag = cpy.nb_units;
+        infos->host.borrowed = 1;
+    }
+    return 0;
+}
+
+void host_cache_detach(info_s * infos)
+{
+    if (!infos->host.cache)
+        return;
+    munmap(infos->host.cache->addr, infos->host.cache->size);
+    infos->host.cache = (free(infos->host.cache), NULL);
+}
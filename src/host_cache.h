@@ -0,0 +1,86 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file host_cache.h
+ * @brief Cache des fichiers hôtes en mémoire partagée.
+ * @details Module qui partage entre plusieurs processus le contenu des fichiers
+ * hôtes et le résultat de leur analyse. Un segment de contrôle POSIX
+ * ("/<nom>") contient la table des hôtes en cache et un mutex partagé entre
+ * processus ; chaque hôte est stocké dans son propre segment
+ * ("/<nom>.<numéro>") projeté en lecture seule par les processus qui
+ * l'utilisent. Quand le budget mémoire est dépassé, les hôtes utilisés le
+ * moins récemment sont retirés du cache.
+ */
+
+#ifndef HOST_CACHE_H
+#define HOST_CACHE_H
+
+#include <stddef.h>
+
+#include "common.h"
+
+/** Nombre maximum d'hôtes dans le cache. */
+#define HOST_CACHE_MAX_ENTRIES 256
+
+/** Taille maximale du nom d'un segment de mémoire partagée. */
+#define HOST_CACHE_NAME_MAX 64
+
+/**
+ * @brief Projection d'un hôte du cache dans le processus.
+ */
+struct host_cache_map {
+    void *addr;                 /*!< Adresse de la projection (lecture seule). */
+    size_t size;                /*!< Taille de la projection : l'hôte et son index (octets). */
+};
+
+/** Type de la projection d'un hôte du cache. */
+typedef struct host_cache_map host_cache_map_s;
+
+/**
+ * @brief Ouvre l'hôte depuis le cache partagé.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @param path Chemin du fichier hôte.
+ * @details Si l'hôte n'est pas dans le cache, il est lu, analysé puis ajouté au
+ * cache pour les autres processus. Le fichier hôte est alors un flux en mémoire
+ * sur la projection partagée : les algorithmes le lisent sans le copier depuis
+ * le disque.
+ * @req \r{stegx_cache_open} doit avoir été appelée par le processus.
+ * L'index des frames MP3 ou des tags FLV est stocké dans le même segment et
+ * prêté à la structure (\r{infos->host.borrowed}).
+ * @sideeffect Remplit \r{infos->host.host}, \r{infos->host.type},
+ * \r{infos->host.file_info}, \r{infos->host.cache}, \r{infos->host.analysed}
+ * et, si l'hôte a un index, \r{infos->host.mp3_fr_size} ou
+ * \r{infos->host.flv_tag}.
+ * @return 0 si l'hôte est ouvert depuis le cache, 1 sinon (l'hôte doit alors
+ * être ouvert normalement).
+ * @author StegX Team
+ */
+int host_cache_attach(info_s * infos, const char *path);
+
+/**
+ * @brief Libère la projection de l'hôte du cache.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @req Le flux \r{infos->host.host} doit déjà être fermé.
+ * @author StegX Team
+ */
+void host_cache_detach(info_s * infos);
+
+#endif
@@ -0,0 +1,247 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file host_index.c
+ * @brief Index d'analyse du fichier hôte.
+ * @details Format du fichier "<hôte>.stegxidx" : un en-tête (\r{index_hdr}),
+ * la structure du format de l'hôte (union \r{file_info_u}) puis les unités :
+ * distances des frames MP3 (uint32_t) ou tags FLV (\r{flv_tag_s}).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "host_index.h"
+#include "crc32.h"
+
+/**
+ * @brief En-tête du fichier index.
+ * @details Les champs "dev" à "hash" identifient la version de l'hôte qui a
+ * produit l'index ; si l'un d'eux ne correspond plus, l'index est ignoré.
+ */
+struct index_hdr {
+    uint32_t magic;             /*!< Signature \r{HOST_INDEX_MAGIC}. */
+    uint32_t version;           /*!< Version \r{HOST_INDEX_VERSION}. */
+    uint32_t type;              /*!< Type de l'hôte. */
+    uint32_t mode;              /*!< Mode de l'analyse (l'analyse FLV en dépend). */
+    uint64_t dev;               /*!< Périphérique contenant l'hôte. */
+    uint64_t ino;               /*!< Inode de l'hôte. */
+    uint64_t size;              /*!< Taille de l'hôte (octets). */
+    int64_t mtime_sec;          /*!< Date de modification de l'hôte (secondes). */
+    int64_t mtime_nsec;         /*!< Date de modification de l'hôte (nanosecondes). */
+    uint64_t hash;              /*!< Empreinte FNV-1a du contenu, 0 si non calculée. */
+    uint64_t capacity[STEGX_NB_ALGO];   /*!< Capacité de chaque algorithme. */
+    uint32_t info_size;         /*!< Taille de l'union du format de l'hôte. */
+    uint32_t unit_size;         /*!< Taille d'une unité (octets). */
+    uint32_t nb_units;          /*!< Nombre d'unités qui suivent. */
+};
+
+/**
+ * @brief Donne l'index des unités d'un hôte analysé.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @param size Taille d'une unité.
+ * @param nb Nombre d'unités.
+ * @return Adresse de l'index dans \r{host_info} (NULL si le format n'en a
+ * pas).
+ * @author StegX Team
+ */
+static void **index_units(info_s * infos, uint32_t * size, uint32_t * nb)
+{
+    host_info_s *hi = &infos->host;
+    if (hi->type == MP3) {
+        *size = sizeof(*hi->mp3_fr_size), *nb = (uint32_t) hi->file_info.mp3.fr_nb;
+        return (void **)&hi->mp3_fr_size;
+    }
+    if (hi->type == FLV) {
+        *size = sizeof(*hi->flv_tag), *nb = hi->flv_nb_tag;
+        return (void **)&hi->flv_tag;
+    }
+    *size = *nb = 0;
+    return NULL;
+}
+
+/**
+ * @brief Calcule l'empreinte FNV-1a 64 bits du contenu de l'hôte.
+ * @param f Fichier hôte.
+ * @param hash Empreinte calculée.
+ * @return 0 si l'empreinte a été calculée, 1 sinon.
+ * @author StegX Team
+ */
+static int index_hash(FILE * f, uint64_t * hash)
+{
+    uint8_t buf[BUFSIZ];
+    size_t n;
+    if (fseek(f, 0, SEEK_SET))
+        return 1;
+    *hash = FNV64_OFFSET;
+    while ((n = fread(buf, sizeof(*buf), BUFSIZ, f)))
+        *hash = sig_hash(*hash, buf, n);
+    /* 0 est réservé pour "non calculée". */
+    *hash = *hash ? *hash : 1;
+    return ferror(f);
+}
+
+/**
+ * @brief Remplit l'identité de l'hôte dans un en-tête d'index.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @param hdr En-tête à remplir.
+ * @return 0 si l'identité a été lue, 1 sinon.
+ * @author StegX Team
+ */
+static int index_identity(info_s * infos, struct index_hdr *hdr)
+{
+    struct stat st;
+    if (fstat(fileno(infos->host.host), &st))
+        return 1;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = HOST_INDEX_MAGIC;
+    hdr->version = HOST_INDEX_VERSION;
+    hdr->type = infos->host.type;
+    hdr->mode = infos->mode;
+    hdr->dev = st.st_dev;
+    hdr->ino = st.st_ino;
+    hdr->size = st.st_size;
+    hdr->mtime_sec = st.st_mtim.tv_sec;
+    hdr->mtime_nsec = st.st_mtim.tv_nsec;
+    hdr->info_size = sizeof(union file_info_u);
+    return 0;
+}
+
+/**
+ * @brief Construit le chemin du fichier index de l'hôte.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @param suffix Suffixe ajouté après l'extension (ou chaîne vide).
+ * @return Chemin alloué à libérer par l'appelant, NULL en cas d'erreur.
+ * @author StegX Team
+ */
+static char *index_path(info_s * infos, const char *suffix)
+{
+    size_t len = strlen(infos->host_path) + strlen(HOST_INDEX_EXT) + strlen(suffix) + 1;
+    char *path = malloc(len);
+    if (path)
+        snprintf(path, len, "%s%s%s", infos->host_path, HOST_INDEX_EXT, suffix);
+    return path;
+}
+
+int host_index_new(info_s * infos)
+{
+    assert(infos);
+    host_index_free(infos);
+    return !(infos->host.index = calloc(1, sizeof(host_index_s)));
+}
+
+int host_index_load(info_s * infos)
+{
+    assert(infos && infos->host.host);
+    if (!infos->host_path)
+        return 1;
+    struct index_hdr cur, hdr;
+    if (index_identity(infos, &cur))
+        return 1;
+    char *path = index_path(infos, "");
+    if (!path)
+        return 1;
+    FILE *f = fopen(path, "rb");
+    free(path);
+    if (!f)
+        return 1;
+
+    /* Vérification de l'identité de l'hôte (tout sauf l'empreinte et les capacités). */
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(&hdr, &cur, offsetof(struct index_hdr, hash))
+        || hdr.info_size != cur.info_size)
+        return fclose(f), 1;
+    if (infos->flags & STEGX_FLAG_INDEX_HASH) {
+        if (!hdr.hash || index_hash(infos->host.host, &cur.hash) || hdr.hash != cur.hash)
+            return fclose(f), 1;
+    }
+
+    /* Lecture de l'analyse, puis de l'index des unités (alloué même vide,
+     * pour le distinguer d'un index non construit). */
+    union file_info_u file_info;
+    if (fread(&file_info, sizeof(file_info), 1, f) != 1)
+        return fclose(f), 1;
+    infos->host.file_info = file_info;
+    if (infos->host.type == FLV)
+        infos->host.flv_nb_tag = hdr.nb_units;
+    uint32_t size, nb;
+    void **units = index_units(infos, &size, &nb), *u = NULL;
+    if (hdr.unit_size != size || hdr.nb_units != nb
+        || (units && (!(u = malloc(nb ? (size_t)nb * size : 1)) || fread(u, size, nb, f) != nb))
+        || host_index_new(infos))
+        return fclose(f), free(u), infos->host.flv_nb_tag = 0, 1;
+    fclose(f);
+    if (units)
+        free(*units), *units = u;
+    memcpy(infos->host.index->capacity, hdr.capacity, sizeof(hdr.capacity));
+    return 0;
+}
+
+int host_index_save(info_s * infos)
+{
+    assert(infos && infos->host.host && infos->host.index);
+    if (!infos->host_path)
+        return 1;
+    host_index_s *idx = infos->host.index;
+    struct index_hdr hdr;
+    if (index_identity(infos, &hdr))
+        return 1;
+    if ((infos->flags & STEGX_FLAG_INDEX_HASH) && index_hash(infos->host.host, &hdr.hash))
+        return 1;
+    memcpy(hdr.capacity, idx->capacity, sizeof(hdr.capacity));
+    void **units = index_units(infos, &hdr.unit_size, &hdr.nb_units);
+    if (units && !*units)
+        return 1;
+
+    /* Écriture dans un fichier temporaire propre à cet appel (plusieurs
+     * threads du processus peuvent enregistrer le même index), puis
+     * renommage. */
+    static atomic_uint seq;
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%ld.%u", (long)getpid(), atomic_fetch_add(&seq, 1));
+    char *tmp = index_path(infos, suffix), *path = index_path(infos, "");
+    FILE *f = tmp && path ? fopen(tmp, "wb") : NULL;
+    int err = !f;
+    if (f) {
+        err |= fwrite(&hdr, sizeof(hdr), 1, f) != 1;
+        err |= fwrite(&(infos->host.file_info), sizeof(infos->host.file_info), 1, f) != 1;
+        err |= units && fwrite(*units, hdr.unit_size, hdr.nb_units, f) != hdr.nb_units;
+        err |= fclose(f) != 0;
+        err = err ? (remove(tmp), 1) : rename(tmp, path) != 0;
+    }
+    free(tmp), free(path);
+    return err;
+}
+
+void host_index_free(info_s * infos)
+{
+    if (!infos->host.index)
+        return;
+    infos->host.index = (free(infos->host.index), NULL);
+}
@@ -0,0 +1,104 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file host_index.h
+ * @brief Index d'analyse du fichier hôte.
+ * @details Module qui sauvegarde le résultat de l'analyse du fichier hôte
+ * (\r{fill_host_info}) dans un fichier annexe "<hôte>.stegxidx", afin que les
+ * traitements suivants sur le même hôte n'aient pas à le parcourir de nouveau.
+ * L'index est un cache local à la machine : il est écrit dans la
+ * représentation native des structures et n'est valide que pour l'inode, la
+ * taille et la date de modification de l'hôte qui l'a produit.
+ */
+
+#ifndef HOST_INDEX_H
+#define HOST_INDEX_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+/** Extension du fichier index ajoutée au chemin de l'hôte. */
+#define HOST_INDEX_EXT ".stegxidx"
+
+/** Signature du fichier index ("SXIX"). */
+#define HOST_INDEX_MAGIC 0x58495853
+
+/** Version du format du fichier index. */
+#define HOST_INDEX_VERSION 3
+
+/**
+ * @brief Résultat de l'analyse d'un hôte conservé en mémoire.
+ * @details Les index des unités de l'hôte sont ceux de \r{host_info} : pour
+ * MP3, la distance de chaque frame à la suivante (\r{mp3_fr_size}) ; pour
+ * FLV, les tags (\r{flv_tag}). Ils sont écrits dans le fichier index et
+ * reconstruits à son chargement, pour que l'insertion et l'extraction n'aient
+ * pas à parcourir l'hôte de nouveau.
+ */
+struct host_index {
+    uint64_t capacity[STEGX_NB_ALGO];   /*!< Capacité de chaque algorithme (octets). */
+};
+
+/** Type de l'index d'un hôte. */
+typedef struct host_index host_index_s;
+
+/**
+ * @brief Crée un index vide pour l'analyse à venir de l'hôte.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @sideeffect Remplace \r{infos->host.index} par un index vide.
+ * @return 0 si l'index a été alloué, 1 sinon.
+ * @author StegX Team
+ */
+int host_index_new(info_s * infos);
+
+/**
+ * @brief Charge l'index de l'hôte s'il existe et s'il est toujours valide.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @req \r{infos->host_path} doit être renseigné et le type de l'hôte connu.
+ * @sideeffect Remplit \r{infos->host.file_info}, \r{infos->host.index} et
+ * l'index des frames MP3 ou des tags FLV.
+ * @return 0 si l'index a été chargé, 1 s'il est absent, obsolète ou illisible
+ * (l'hôte doit alors être analysé).
+ * @author StegX Team
+ */
+int host_index_load(info_s * infos);
+
+/**
+ * @brief Sauvegarde l'index de l'hôte venant d'être analysé.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @details Le fichier est écrit sous un nom temporaire puis renommé, pour
+ * qu'un autre processus ne lise jamais un index incomplet.
+ * @return 0 si l'index a été écrit, 1 sinon (l'index est un cache : l'échec
+ * n'empêche pas le traitement).
+ * @author StegX Team
+ */
+int host_index_save(info_s * infos);
+
+/**
+ * @brief Libère l'index de l'hôte.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @author StegX Team
+ */
+void host_index_free(info_s * infos);
+
+#endif
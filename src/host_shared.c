@@ -0,0 +1,121 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file host_shared.c
+ * @brief Hôte ouvert et analysé une fois pour plusieurs traitements.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "stegx.h"
+#include "check_compa.h"
+#include "sugg_algo.h"
+#include "host_shared.h"
+
+/**
+ * @brief Vérifie et analyse un hôte partagé, une seule fois pour tous les
+ * traitements.
+ * @param h Hôte dont l'image est en place (fermé en cas d'erreur).
+ * @return L'hôte, sinon NULL et met à jour \r{stegx_errno}.
+ * @author StegX Team
+ */
+static stegx_host_s *host_analyse(stegx_host_s * h)
+{
+    info_s tmp = {.mode = h->mode };
+    if (!(tmp.host.host = fmemopen(h->addr, h->size, "rb")))
+        return stegx_host_close(h), stegx_errno = ERR_HOST, NULL;
+    if (!(tmp.host.type = check_file_format(tmp.host.host)))
+        return fclose(tmp.host.host), stegx_host_close(h), stegx_errno = ERR_CHECK_COMPAT, NULL;
+    if (fill_host_info(&tmp))
+        return fclose(tmp.host.host), free(tmp.host.mp3_fr_size), free(tmp.host.flv_tag), stegx_host_close(h),
+            stegx_errno = h->mode == STEGX_MODE_INSERT ? ERR_SUGG_ALGOS : ERR_DETECT_ALGOS, NULL;
+    fclose(tmp.host.host);
+    h->type = tmp.host.type;
+    h->file_info = tmp.host.file_info;
+    h->mp3_fr_size = tmp.host.mp3_fr_size;
+    h->flv_tag = tmp.host.flv_tag;
+    h->flv_nb_tag = tmp.host.flv_nb_tag;
+    return h;
+}
+
+stegx_host_s *stegx_host_open(const char *path, mode_e mode)
+{
+    assert(path);
+    stegx_host_s *h = calloc(1, sizeof(*h));
+    if (!h)
+        return perror("Can't allocate memory for shared host"), stegx_errno = ERR_OTHER, NULL;
+    h->mode = mode;
+
+    /* Projection du fichier : les pages sont celles du cache du système. */
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) || !st.st_size)
+        return perror(path), fd != -1 ? close(fd) : 0, free(h), stegx_errno = ERR_HOST, NULL;
+    h->size = st.st_size;
+    h->addr = mmap(NULL, h->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (h->addr == MAP_FAILED)
+        return perror("Can't map host file"), free(h), stegx_errno = ERR_HOST, NULL;
+    return host_analyse(h);
+}
+
+stegx_host_s *host_shared_mem(void *addr, size_t size, mode_e mode)
+{
+    assert(addr && size);
+    stegx_host_s *h = calloc(1, sizeof(*h));
+    if (!h)
+        return perror("Can't allocate memory for shared host"), free(addr), stegx_errno = ERR_OTHER, NULL;
+    *h = (stegx_host_s) {.addr = addr,.size = size,.mode = mode,.mem = 1 };
+    return host_analyse(h);
+}
+
+void stegx_host_close(stegx_host_s * host)
+{
+    if (!host)
+        return;
+    if (host->mem)
+        free(host->addr);
+    else if (host->addr && host->addr != MAP_FAILED)
+        munmap(host->addr, host->size);
+    free(host->mp3_fr_size);
+    free(host->flv_tag);
+    free(host);
+}
+
+int host_shared_attach(info_s * infos, const stegx_host_s * host)
+{
+    assert(infos && host && host->mode == infos->mode);
+    if (!(infos->host.host = fmemopen(host->addr, host->size, "rb")))
+        return perror("Can't open shared host"), 1;
+    infos->host.type = host->type;
+    infos->host.file_info = host->file_info;
+    infos->host.mp3_fr_size = host->mp3_fr_size;
+    infos->host.flv_tag = host->flv_tag;
+    infos->host.flv_nb_tag = host->flv_nb_tag;
+    infos->host.borrowed = 1;
+    infos->host.analysed = 1;
+    return 0;
+}
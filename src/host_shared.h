@@ -0,0 +1,75 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file host_shared.h
+ * @brief Hôte ouvert et analysé une fois pour plusieurs traitements.
+ * @details Le fichier hôte est projeté en lecture seule et analysé à
+ * l'ouverture. Chaque traitement qui l'utilise (éventuellement dans des
+ * threads différents) le lit par un flux en mémoire qui lui est propre et
+ * reprend l'analyse sans parcourir de nouveau le fichier.
+ */
+
+#ifndef HOST_SHARED_H
+#define HOST_SHARED_H
+
+#include <stddef.h>
+
+#include "common.h"
+
+/**
+ * @brief Hôte partagé.
+ */
+struct stegx_host {
+    void *addr;                 /*!< Projection du fichier hôte (lecture seule), ou image en mémoire. */
+    size_t size;                /*!< Taille du fichier hôte (octets). */
+    mode_e mode;                /*!< Mode pour lequel l'hôte a été analysé. */
+    type_e type;                /*!< Type de l'hôte. */
+    union file_info_u file_info;        /*!< Analyse de l'hôte. */
+    uint32_t *mp3_fr_size;      /*!< Index des frames MP3 (NULL si l'hôte n'est pas un MP3), prêté aux traitements. */
+    flv_tag_s *flv_tag;         /*!< Index des tags FLV (NULL si l'hôte n'est pas un FLV), prêté aux traitements. */
+    uint32_t flv_nb_tag;        /*!< Nombre de tags dans l'index des tags FLV. */
+    int mem;                    /*!< 1 si "addr" est une image allouée par malloc (libérée à la fermeture), 0 si c'est une projection. */
+};
+
+/**
+ * @brief Ouvre un hôte partagé à partir d'une image en mémoire.
+ * @param addr Image du fichier hôte, allouée par malloc (libérée par
+ * \r{stegx_host_close}, même en cas d'erreur).
+ * @param size Taille de l'image.
+ * @param mode Mode pour lequel l'hôte est analysé.
+ * @return Hôte à fermer avec \r{stegx_host_close}, sinon NULL et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+stegx_host_s *host_shared_mem(void *addr, size_t size, mode_e mode);
+
+/**
+ * @brief Ouvre l'hôte partagé pour un traitement.
+ * @param infos Structure représentant les informations concernant la
+ * dissimulation.
+ * @param host Hôte partagé.
+ * @req L'hôte doit avoir été analysé pour le même mode que \r{infos->mode} et
+ * rester ouvert jusqu'au \r{stegx_clear} du traitement.
+ * @sideeffect Remplit \r{infos->host}.
+ * @return 0 si l'hôte est ouvert, 1 sinon.
+ * @author StegX Team
+ */
+int host_shared_attach(info_s * infos, const stegx_host_s * host);
+
+#endif
@@ -34,88 +34,122 @@
 #include "common.h"
 #include "stegx_common.h"
 #include "stegx_errors.h"
+#include "host_index.h"
+#include "host_cache.h"
+#include "host_shared.h"
 
 /* Initialisation. */
-algo_e *stegx_propos_algos = NULL;
+_Thread_local algo_e *stegx_propos_algos = NULL;
 
-info_s *stegx_init(stegx_choices_s * choices)
+/**
+ * @brief Ferme les fichiers et libère les ressources d'un traitement, sans
+ * toucher à son allocateur.
+ * @param infos Structure du traitement.
+ * @author StegX Team
+ */
+static void info_release(info_s * infos)
 {
-    /* Lors de l'extraction et de l'insertion : */
-    /* - Le fichier résultat peux être sur stdout. */
-    /* Lors de l'extraction : */
-    /* - Le fichier hôte peux être sur stdin. */
-    /* Lors de l'insertion : */
-    /* - Le fichier à cacher peux être sur stdin. */
-
-    assert(choices);
-    info_s *s = calloc(1, sizeof(info_s));
-    if (!s)
-        return perror("Can't allocate memory for library private information structure"), NULL;
-
-    /* Initialisation de la variable globale de proposition des algorithmes si
-     * elle n'est pas déjà initialisée. Lors du free, il remettre le pointeur à
-     * NULL pour bien spécifié que la zone n'est plus allouée : on pourrait
-     * partager cette variable entre plusieurs structures "info_s" si on imagine
-     * une interface qui appellent plusieurs fois "stegx_init" et "stegx_clear" sur
-     * des structures différentes. */
-    if (!stegx_propos_algos && !(stegx_propos_algos = malloc(STEGX_NB_ALGO * sizeof(algo_e))))
-        return perror("Can't allocate memory for stegx_propos_algos tab"), NULL;
+    if (infos->host.host)
+        infos->host.host = (fclose(infos->host.host), NULL);
+    host_cache_detach(infos);
+    if (infos->hidden)
+        infos->hidden = (fclose(infos->hidden), NULL);
+    if (infos->res)
+        infos->res = (fclose(infos->res), NULL);
+    host_index_free(infos);
+    if (!infos->host.borrowed)
+        free(infos->host.mp3_fr_size), free(infos->host.flv_tag);
+    infos->host.mp3_fr_size = NULL;
+    infos->host.flv_tag = NULL;
+}
 
-    /* Initialisation du mode. */
+/**
+ * @brief Remplit la structure privée à partir des choix de l'utilisateur.
+ * @param s Structure à remplir (mise à zéro, sauf son allocateur).
+ * @param choices Choix de l'utilisateur.
+ * @return 0 si tout s'est bien passé, sinon 1 et met à jour \r{stegx_errno}
+ * si besoin.
+ * @author StegX Team
+ */
+static int info_fill(info_s * s, stegx_choices_s * choices)
+{
+    /* Initialisation du mode et des options. */
     s->mode = choices->mode;
+    s->flags = choices->flags;
+    s->progress.cb = choices->progress;
+    s->progress.data = choices->progress_data;
+    s->progress.deadline = choices->deadline;
+    s->registry = choices->registry;
 
     /* Initialisation du mot de passe. */
     if (choices->passwd) {
         s->method = STEGX_WITH_PASSWD;
         if (!strlen(choices->passwd))
-            return stegx_errno = ERR_PASSWD, NULL;
-        if (!(s->passwd = strdup(choices->passwd)))
-            return perror("Can't allocate memory for password"), NULL;
+            return stegx_errno = ERR_PASSWD, 1;
+        if (!(s->passwd = arena_strdup(&s->arena, choices->passwd)))
+            return perror("Can't allocate memory for password"), 1;
     } else
         s->method = STEGX_WITHOUT_PASSWD;
 
-    /* Vérification du résultat. */
-    if (!strcmp(choices->res_path, "stdout"))
+    /* Vérification du résultat (éventuellement déjà ouvert par l'appelant). */
+    if (choices->res_file)
+        s->res = choices->res_file;
+    else if (!strcmp(choices->res_path, "stdout"))
         s->res = stdout;
 
     /* Initialisations pour l'insertion. */
     if (choices->mode == STEGX_MODE_INSERT) {
         assert(choices->insert_info);
         /* Initialisation du fichier à cacher. */
-        if (!strcmp(choices->insert_info->hidden_path, "stdin"))
+        if (choices->insert_info->hidden_file)
+            s->hidden = choices->insert_info->hidden_file;
+        else if (!strcmp(choices->insert_info->hidden_path, "stdin"))
             s->hidden = stdin;
         else if (!(s->hidden = fopen(choices->insert_info->hidden_path, "rb")))
-            return perror(NULL), stegx_errno = ERR_HIDDEN, NULL;
+            return perror(NULL), stegx_errno = ERR_HIDDEN, 1;
         /* L'algorithme sera choisi avec stegx_choose_algo(). */
 
         /* Initialisation du nom du fichier à cacher. */
-        if (!(s->hidden_name = strdup(basename(choices->insert_info->hidden_path))))
-            return perror("Can't allocate memory for the name of hidden file"), NULL;
-
-        /* Initialisation et vérification du fichier résultat pour l'insertion. */
-        if ((s->res != stdout) && !(s->res = fopen(choices->res_path, "wb")))
-            return stegx_errno = ERR_RES_INSERT, NULL;
+        if (!(s->hidden_name = arena_strdup(&s->arena, basename(choices->insert_info->hidden_path))))
+            return perror("Can't allocate memory for the name of hidden file"), 1;
+
+        /* Initialisation et vérification du fichier résultat pour l'insertion
+         * (son chemin est conservé pour le supprimer en cas d'annulation). */
+        if (!s->res) {
+            if (!(s->res = fopen(choices->res_path, "wb")))
+                return stegx_errno = ERR_RES_INSERT, 1;
+            if (!(s->res_path = arena_strdup(&s->arena, choices->res_path)))
+                return perror("Can't allocate memory for the path of result file"), 1;
+        }
     }
 
     /* Initialisation pour l'extraction. */
     if (choices->mode == STEGX_MODE_EXTRACT) {
         /* Vérification du fichier hôte. */
-        if (!strcmp(choices->host_path, "stdin"))
+        if (!choices->host && !strcmp(choices->host_path, "stdin"))
             s->host.host = stdin;
         /* Vérification du dossier résultat pour l'extraction. */
-        if (s->res != stdout) {
+        if (!s->res) {
             struct stat st;
             if (!stat(choices->res_path, &st)) {
                 if (!S_ISDIR(st.st_mode))
-                    return stegx_errno = ERR_RES_EXTRACT, NULL;
+                    return stegx_errno = ERR_RES_EXTRACT, 1;
             } else
-                return perror("Can't read properties of res path"), NULL;
+                return perror("Can't read properties of res path"), 1;
         }
     }
 
-    /* Initialisation du fichier hôte. */
-    if ((s->host.host != stdin) && !(s->host.host = fopen(choices->host_path, "rb")))
-        return perror(NULL), stegx_errno = ERR_HOST, NULL;
+    /* Initialisation du fichier hôte : hôte partagé fourni par l'appelant, ou
+     * depuis le cache partagé si possible. */
+    if (choices->host && host_shared_attach(s, choices->host))
+        return stegx_errno = ERR_HOST, 1;
+    if (!s->host.host && (s->flags & STEGX_FLAG_CACHE))
+        host_cache_attach(s, choices->host_path);
+    if (!s->host.host && !(s->host.host = fopen(choices->host_path, "rb")))
+        return perror(NULL), stegx_errno = ERR_HOST, 1;
+    /* Conservation du chemin de l'hôte pour retrouver son index. */
+    if ((s->host.host != stdin) && !(s->host_path = arena_strdup(&s->arena, choices->host_path)))
+        return perror("Can't allocate memory for the path of host file"), 1;
 
     /* Si on a une entrée sur stdin, il faut la stocker dans un fichier
      * temporaire car on ne peux pas faire de fseek() sur un flux. */
@@ -123,7 +157,7 @@ info_s *stegx_init(stegx_choices_s * choices)
         FILE * tmp = NULL;
         /* Ouverture en lecture / écriture du fichier temporaire. */
         if (!(tmp = fopen("/tmp/stegx", "w+b")))
-            return perror("Can't create a temporary file in /tmp"), NULL;
+            return perror("Can't create a temporary file in /tmp"), 1;
         /* Copie efficace de stdin vers le fichier temporaire. */
         uint8_t buf[BUFSIZ];
         for (int i = 0; (i = fread(buf, sizeof(*buf), BUFSIZ, stdin)) ;)
@@ -137,20 +171,52 @@ info_s *stegx_init(stegx_choices_s * choices)
     assert(s->algo >= STEGX_ALGO_LSB && s->algo < STEGX_NB_ALGO);
     assert(s->method == STEGX_WITHOUT_PASSWD || s->method == STEGX_WITH_PASSWD);
     assert(s->host.host);
-    return s;
+    return 0;
+}
+
+info_s *stegx_init(stegx_choices_s * choices)
+{
+    /* Lors de l'extraction et de l'insertion : */
+    /* - Le fichier résultat peux être sur stdout. */
+    /* Lors de l'extraction : */
+    /* - Le fichier hôte peux être sur stdin. */
+    /* Lors de l'insertion : */
+    /* - Le fichier à cacher peux être sur stdin. */
+
+    assert(choices);
+    info_s *s = calloc(1, sizeof(info_s));
+    if (!s)
+        return perror("Can't allocate memory for library private information structure"), NULL;
+
+    /* Initialisation de la variable globale de proposition des algorithmes si
+     * elle n'est pas déjà initialisée. Lors du free, il remettre le pointeur à
+     * NULL pour bien spécifié que la zone n'est plus allouée : on pourrait
+     * partager cette variable entre plusieurs structures "info_s" si on imagine
+     * une interface qui appellent plusieurs fois "stegx_init" et "stegx_clear" sur
+     * des structures différentes. */
+    if (!stegx_propos_algos && !(stegx_propos_algos = malloc(STEGX_NB_ALGO * sizeof(algo_e))))
+        return perror("Can't allocate memory for stegx_propos_algos tab"), NULL;
+    return info_fill(s, choices) ? NULL : s;
+}
+
+int stegx_reset(info_s * infos, stegx_choices_s * choices)
+{
+    assert(infos);
+    /* Seul l'allocateur est conservé, avec ses blocs : les chaînes et tampons
+     * du traitement précédent y sont rendus d'un coup. */
+    struct arena arena = infos->arena;
+    info_release(infos);
+    arena_reset(&arena);
+    *infos = (info_s) {.arena = arena };
+    return choices ? info_fill(infos, choices) : 0;
 }
 
 void stegx_clear(info_s * infos)
 {
     /* On remet tout à NULL en libérant la mémoire. */
-    if (infos->host.host)
-        infos->host.host = (fclose(infos->host.host), NULL);
-    if (infos->hidden)
-        infos->hidden = (fclose(infos->hidden), NULL);
-    if (infos->res)
-        infos->res = (fclose(infos->res), NULL);
-    infos->hidden_name = (free(infos->hidden_name), NULL);
-    infos->passwd = (free(infos->passwd), NULL);
+    info_release(infos);
+    infos->hidden_name = infos->passwd = infos->host_path = infos->res_path = NULL;
+    arena_free(&infos->arena);
     infos = (free(infos), NULL);
     stegx_propos_algos = (free(stegx_propos_algos), NULL);
 }
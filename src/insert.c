@@ -32,6 +32,8 @@
 #include "common.h"
 #include "stegx_common.h"
 #include "stegx_errors.h"
+#include "detect_algo.h"
+#include "crc32.h"
 
 #include "algo/lsb.h"
 #include "algo/eof.h"
@@ -44,6 +46,10 @@ int write_signature(info_s * infos)
     assert(infos->host.host && infos->hidden && infos->res && infos->hidden_name
            && infos->mode != STEGX_MODE_EXTRACT);
 
+    /* Adresse de la signature, reprise par son pied (-1 si le résultat n'est
+     * pas positionnable). */
+    infos->sig_pos = ftell(infos->res);
+
     /* Ecriture de l'algorithme utilisé et de la méthode de protection utilisée. */
     if (fwrite(&(infos->method), sizeof(uint8_t), 1, infos->res) != 1)
         return perror("Sig: Can't write method"), 1;
@@ -81,6 +87,35 @@ int write_signature(info_s * infos)
             LENGTH_DEFAULT_PASSWD)
             return perror("Sig: Can't write default password"), 1;
     }
+
+    /* Empreinte de la signature telle qu'elle a été écrite. */
+    uint8_t head[LENGTH_SIG_HEAD] = { infos->method, infos->algo };
+    memcpy(head + 2, &infos->hidden_length, sizeof(uint32_t));
+    head[6] = length_hidden_name;
+    infos->sig_hash = sig_hash(sig_hash(FNV64_OFFSET, head, sizeof(head)), cpy_hidden_name,
+                               length_hidden_name);
+    if (infos->method == STEGX_WITHOUT_PASSWD)
+        infos->sig_hash = sig_hash(infos->sig_hash, infos->passwd, LENGTH_DEFAULT_PASSWD);
+    return 0;
+}
+
+int write_footer(info_s * infos)
+{
+    assert(infos->res && infos->mode != STEGX_MODE_EXTRACT);
+    /* Résultat non positionnable : la signature version 1 suffit à
+     * l'extraction. */
+    if (infos->sig_pos <= 0)
+        return 0;
+    uint8_t footer[LENGTH_SIG_FOOTER] = { 0 };
+    uint32_t magic = SIG_FOOTER_MAGIC;
+    uint64_t pos = infos->sig_pos;
+    memcpy(footer, &magic, sizeof(magic));
+    footer[4] = SIG_VERSION;
+    memcpy(footer + 8, &pos, sizeof(pos));
+    uint64_t hash = sig_hash(infos->sig_hash, footer, 16);
+    memcpy(footer + 16, &hash, sizeof(hash));
+    if (fwrite(footer, sizeof(uint8_t), LENGTH_SIG_FOOTER, infos->res) != LENGTH_SIG_FOOTER)
+        return perror("Sig: Can't write signature footer"), 1;
     return 0;
 }
 
@@ -94,6 +129,10 @@ int stegx_insert(info_s * infos)
     assert(infos->algo >= STEGX_ALGO_LSB && infos->algo < STEGX_NB_ALGO);
     static int (*insert_algo[STEGX_NB_ALGO]) (info_s *) = {
     insert_lsb, insert_eof, insert_metadata, insert_eoc, insert_junk_chunk};
-    /* Insertion en appellant la fonction selon le format. */
-    return (*insert_algo[infos->algo]) (infos) ? (stegx_errno = ERR_INSERT, 1) : 0;
+    /* Insertion en appellant la fonction selon le format. Le total de
+     * l'étape compte l'hôte recopié et les données cachées. */
+    if (progress_begin(&infos->progress, STEGX_STAGE_INSERT, infos->host.host, infos->hidden_length)
+        || (*insert_algo[infos->algo]) (infos) || write_footer(infos))
+        return stegx_errno = progress_fail(&infos->progress, &infos->res, infos->res_path, ERR_INSERT), 1;
+    return progress_end(&infos->progress), 0;
 }
@@ -40,4 +40,18 @@
  */
 int write_signature(info_s * infos);
 
+/**
+ * @brief Écrit le pied de signature (version 2) à la fin du fichier résultat.
+ * @details Le pied contient un identifiant, la version de la signature, son
+ * adresse et une empreinte de la signature et du pied : l'extraction trouve
+ * la signature en lisant les derniers octets du fichier, sans analyser
+ * l'hôte. Il doit être écrit en dernier, après les données cachées, la
+ * signature ayant été écrite par \r{write_signature}.
+ * @param infos Structure représentant les informations concernant la dissimulation.
+ * @return 0 si le pied a bien été écrit (ou si le résultat n'est pas
+ * positionnable, sans pied), 1 sinon.
+ * @author StegX Team
+ */
+int write_footer(info_s * infos);
+
 #endif
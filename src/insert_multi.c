@@ -0,0 +1,431 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file insert_multi.c
+ * @brief Insertion dans plusieurs copies d'un même hôte.
+ * @details Module qui contient la fonction d'insertion multiple : le fichier
+ * hôte est analysé une seule fois puis lu une seule fois par fenêtre, chaque
+ * fenêtre étant écrite dans tous les fichiers résultats.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <libgen.h>
+#include <sys/resource.h>
+
+#include "common.h"
+#include "stegx.h"
+#include "check_compa.h"
+#include "sugg_algo.h"
+#include "insert.h"
+#include "protection.h"
+#include "rand.h"
+#include "host_index.h"
+
+#include "algo/eof.h"
+#include "algo/junk_chunk.h"
+
+/** Taille de la fenêtre de lecture du fichier hôte (octets). */
+#define MULTI_WINDOW_SIZE (1 << 16)
+
+/** Descripteurs laissés libres pour l'hôte et le reste du processus. */
+#define MULTI_FD_RESERVE 16
+
+/**
+ * @brief Destinataire d'une insertion multiple (partie privée).
+ */
+struct multi_dest {
+    info_s *infos;              /*!< Informations de la dissimulation pour ce destinataire. */
+    uint8_t *xored;             /*!< Données cachées déjà XORées (LSB séquentiel uniquement). */
+    int stream;                 /*!< 1 si le destinataire est traité pendant la lecture unique de l'hôte. */
+};
+
+/**
+ * @brief Plan d'une insertion multiple.
+ * @details Décrit la partie de l'hôte commune à tous les fichiers résultats et
+ * les fonctions propres à chaque destinataire.
+ */
+struct multi_plan {
+    long prefix;                /*!< Taille de la partie de l'hôte recopiée au début de chaque résultat. */
+    void (*patch) (struct multi_dest *, uint8_t *, long, size_t);       /*!< Modification d'une fenêtre (NULL si recopie à l'identique). */
+    int (*tail) (info_s *);     /*!< Écriture de la fin du résultat après la partie commune. */
+};
+
+/**
+ * @brief Applique le LSB séquentiel d'un destinataire sur une fenêtre de l'hôte.
+ * @details Reproduit le mode séquentiel de \r{insert_lsb} : les 2 bits de
+ * poids faible des octets de données de l'hôte sont remplacés, dans l'ordre,
+ * par les paires de bits des données cachées XORées.
+ * @param d Destinataire.
+ * @param win Fenêtre de l'hôte à modifier.
+ * @param off Adresse (offset) du début de la fenêtre dans l'hôte.
+ * @param len Taille de la fenêtre.
+ * @author StegX Team
+ */
+static void multi_patch_lsb(struct multi_dest *d, uint8_t * win, long off, size_t len)
+{
+    long begin = d->infos->host.file_info.bmp.header_size;
+    long end = begin + (long)d->infos->hidden_length * 4;
+    long first = off > begin ? off : begin, last = off + (long)len < end ? off + (long)len : end;
+    for (long pos = first; pos < last; pos++) {
+        long k = pos - begin;
+        win[pos - off] = (win[pos - off] & 0xFC) + ((d->xored[k >> 2] >> (6 - 2 * (k & 3))) & 0x03);
+    }
+}
+
+/**
+ * @brief Prépare les données cachées XORées d'un destinataire pour le LSB
+ * séquentiel.
+ * @param d Destinataire.
+ * @return 0 si tout se passe bien, 1 sinon.
+ * @author StegX Team
+ */
+static int multi_xor_lsb(struct multi_dest *d)
+{
+    info_s *infos = d->infos;
+    if (!(d->xored = arena_alloc(&infos->arena, infos->hidden_length)))
+        return perror("Multi: Can't allocate memory for hidden data"), 1;
+    if (fseek(infos->hidden, 0, SEEK_SET)
+        || fread(d->xored, sizeof(uint8_t), infos->hidden_length, infos->hidden) != infos->hidden_length)
+        return perror("Multi: Can't read hidden data"), 1;
+    stegx_srand(create_seed(infos->passwd));
+    for (uint32_t i = 0; i < infos->hidden_length; i++)
+        d->xored[i] ^= stegx_rand() % UINT8_MAX;
+    return 0;
+}
+
+/**
+ * @brief Calcule le plan d'insertion multiple d'un destinataire.
+ * @param infos Informations de la dissimulation pour ce destinataire.
+ * @param p Plan à remplir.
+ * @return 0 si le destinataire peut être traité pendant la lecture unique de
+ * l'hôte, 1 s'il faut utiliser l'insertion classique.
+ * @author StegX Team
+ */
+static int multi_plan_get(info_s * infos, struct multi_plan *p)
+{
+    type_e t = infos->host.type;
+    p->patch = NULL;
+    if (infos->algo == STEGX_ALGO_EOF) {
+        p->tail = eof_write_hidden;
+        /* BMP, PNG et WAVE ont "header_size" et "data_size" au début de leurs structures. */
+        if (t >= BMP_COMPRESSED && t <= PNG)
+            p->prefix = (long)infos->host.file_info.bmp.header_size + infos->host.file_info.bmp.data_size;
+        else if (t == MP3)
+            p->prefix = infos->host.file_info.mp3.eof;
+        else if (t == FLV) {
+            if (fseek(infos->host.host, 0, SEEK_END) || (p->prefix = ftell(infos->host.host)) == -1)
+                return perror("Multi: Can't get the size of the host file"), 1;
+        } else
+            return 1;
+        return 0;
+    } else if (infos->algo == STEGX_ALGO_JUNK_CHUNK) {
+        uint32_t file_size;
+        if (fseek(infos->host.host, 4, SEEK_SET)
+            || fread(&file_size, sizeof(uint32_t), 1, infos->host.host) != 1)
+            return perror("Multi: Can't read RIFF size"), 1;
+        p->prefix = (long)file_size + 4;
+        p->tail = junk_chunk_write_hidden;
+        return 0;
+    } else if (infos->algo == STEGX_ALGO_METADATA && t == PNG) {
+        p->prefix = (long)infos->host.file_info.png.header_size +
+            infos->host.file_info.png.data_size - LENGTH_CHUNK_IEND;
+        p->tail = png_metadata_write_hidden;
+        return 0;
+    } else if (infos->algo == STEGX_ALGO_LSB && (t == BMP_UNCOMPRESSED || t == WAV_PCM)
+               && (infos->hidden_length > LENGTH_FILE_MAX || t == WAV_PCM
+                   || infos->host.file_info.bmp.data_size > LENGTH_FILE_MAX)) {
+        /* Seul le mode séquentiel du LSB modifie l'hôte sans le charger entièrement. */
+        p->prefix = (long)infos->host.file_info.bmp.header_size + infos->host.file_info.bmp.data_size;
+        p->patch = multi_patch_lsb;
+        p->tail = write_signature;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Libère un destinataire sans fermer le fichier hôte partagé.
+ * @param d Destinataire à libérer.
+ * @author StegX Team
+ */
+static void multi_dest_clear(struct multi_dest *d)
+{
+    info_s *infos = d->infos;
+    d->xored = NULL;
+    if (!infos)
+        return;
+    if (infos->hidden)
+        fclose(infos->hidden);
+    if (infos->res)
+        fclose(infos->res);
+    arena_free(&infos->arena);
+    d->infos = (free(infos), NULL);
+}
+
+/**
+ * @brief Ferme l'hôte partagé par les destinataires et libère son analyse.
+ * @details Équivalent de la libération de l'hôte par \r{stegx_clear}.
+ * @param tpl Informations de l'hôte.
+ * @author StegX Team
+ */
+static void multi_host_release(info_s * tpl)
+{
+    tpl->host.host = (fclose(tpl->host.host), NULL);
+    host_index_free(tpl);
+    free(tpl->host.mp3_fr_size), free(tpl->host.flv_tag);
+    tpl->host.mp3_fr_size = NULL;
+    tpl->host.flv_tag = NULL;
+}
+
+/**
+ * @brief Initialise un destinataire à partir de l'analyse de l'hôte.
+ * @details Équivalent de \r{stegx_init}, \r{stegx_suggest_algo} et
+ * \r{stegx_choose_algo} sans relire le fichier hôte.
+ * @param tpl Informations de l'hôte déjà analysé.
+ * @param dest Destinataire choisi par l'utilisateur.
+ * @param algo Algorithme à utiliser.
+ * @return Informations de la dissimulation pour ce destinataire, NULL en cas
+ * d'erreur et met à jour \r{stegx_dest_s.err}.
+ * @author StegX Team
+ */
+static info_s *multi_dest_init(const info_s * tpl, stegx_dest_s * dest, algo_e algo)
+{
+    struct multi_dest d = { 0 };
+    if (!(d.infos = calloc(1, sizeof(info_s))))
+        return perror("Can't allocate memory for library private information structure"),
+            dest->err = ERR_OTHER, NULL;
+    info_s *s = d.infos;
+    s->mode = STEGX_MODE_INSERT;
+    s->host = tpl->host;
+    /* Les index de l'hôte appartiennent à "tpl", libéré après tous les destinataires. */
+    s->host.borrowed = 1;
+    s->method = dest->passwd ? STEGX_WITH_PASSWD : STEGX_WITHOUT_PASSWD;
+
+    /* Le fichier à cacher n'est ouvert que le temps de lire sa taille : les
+     * fichiers d'un destinataire sont rouverts au moment de son insertion. */
+    if (!dest->hidden_path || !(s->hidden = fopen(dest->hidden_path, "rb")))
+        return dest->err = ERR_HIDDEN, multi_dest_clear(&d), NULL;
+    if (!(s->hidden_name = arena_strdup(&s->arena, basename(dest->hidden_path))))
+        return dest->err = ERR_OTHER, multi_dest_clear(&d), NULL;
+    if (dest->passwd && (!strlen(dest->passwd)
+                         || !(s->passwd = arena_strdup(&s->arena, dest->passwd))))
+        return dest->err = ERR_PASSWD, multi_dest_clear(&d), NULL;
+    if (propose_algos(s))
+        return dest->err = stegx_errno, multi_dest_clear(&d), NULL;
+    s->hidden = (fclose(s->hidden), NULL);
+    if (!stegx_propos_algos[algo])
+        return dest->err = ERR_CHOICE_ALGO, multi_dest_clear(&d), NULL;
+    s->algo = algo;
+    if (s->method == STEGX_WITHOUT_PASSWD && create_default_passwd(s))
+        return dest->err = ERR_OTHER, multi_dest_clear(&d), NULL;
+    if (!dest->res_path)
+        return dest->err = ERR_RES_INSERT, multi_dest_clear(&d), NULL;
+    return s;
+}
+
+/**
+ * @brief Ouvre les fichiers d'un destinataire juste avant son insertion.
+ * @details Si la limite de descripteurs du processus est atteinte, aucun
+ * fichier du destinataire ne reste ouvert.
+ * @param d Destinataire.
+ * @param dest Destinataire choisi par l'utilisateur.
+ * @param xor Si non nul, prépare aussi les données cachées XORées (LSB
+ * séquentiel).
+ * @return 0 si tout se passe bien, -1 si la limite de descripteurs est
+ * atteinte, 1 sinon. En cas d'échec, met à jour \r{stegx_dest_s.err}.
+ * @author StegX Team
+ */
+static int multi_dest_open(struct multi_dest *d, stegx_dest_s * dest, int xor)
+{
+    info_s *s = d->infos;
+    if (!(s->hidden = fopen(dest->hidden_path, "rb")))
+        return dest->err = ERR_HIDDEN, errno == EMFILE || errno == ENFILE ? -1 : 1;
+    if (!(s->res = fopen(dest->res_path, "wb"))) {
+        int busy = errno == EMFILE || errno == ENFILE;
+        s->hidden = (fclose(s->hidden), NULL);
+        return dest->err = ERR_RES_INSERT, busy ? -1 : 1;
+    }
+    if (xor && multi_xor_lsb(d))
+        return dest->err = ERR_INSERT, 1;
+    return 0;
+}
+
+/**
+ * @brief Calcule le nombre de destinataires dont les fichiers peuvent être
+ * ouverts en même temps.
+ * @details Chaque destinataire utilise deux descripteurs (fichier à cacher et
+ * fichier résultat), dans la limite \c RLIMIT_NOFILE du processus.
+ * @return Taille maximale d'un lot de destinataires (au moins 1).
+ * @author StegX Team
+ */
+static unsigned int multi_batch_max(void)
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) || rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur / 2 >= UINT_MAX)
+        return UINT_MAX;
+    return rl.rlim_cur > MULTI_FD_RESERVE + 2 ? (rl.rlim_cur - MULTI_FD_RESERVE) / 2 : 1;
+}
+
+/**
+ * @brief Lit une seule fois la partie commune de l'hôte et l'écrit dans les
+ * fichiers résultats des destinataires concernés.
+ * @param host Fichier hôte.
+ * @param p Plan de l'insertion multiple.
+ * @param md Tableau des destinataires.
+ * @param dests Tableau des destinataires choisis par l'utilisateur.
+ * @param nb Nombre de destinataires.
+ * @return 0 si la lecture de l'hôte s'est bien passée, 1 sinon.
+ * @author StegX Team
+ */
+static int multi_stream(FILE * host, const struct multi_plan *p, struct multi_dest *md,
+                        stegx_dest_s * dests, unsigned int nb)
+{
+    uint8_t *win = malloc(MULTI_WINDOW_SIZE), *cpy = p->patch ? malloc(MULTI_WINDOW_SIZE) : NULL;
+    if (!win || (p->patch && !cpy))
+        return free(win), free(cpy), perror("Multi: Can't allocate memory for the window"), 1;
+    if (fseek(host, 0, SEEK_SET))
+        return free(win), free(cpy), perror("Multi: Can't jump to the beginning of the host file"), 1;
+
+    /* Lecture de la fenêtre puis écriture (éventuellement modifiée) dans chaque résultat. */
+    for (long off = 0, n; off < p->prefix; off += n) {
+        n = p->prefix - off < MULTI_WINDOW_SIZE ? p->prefix - off : MULTI_WINDOW_SIZE;
+        if (fread(win, sizeof(uint8_t), n, host) != (size_t)n)
+            return free(win), free(cpy), perror("Multi: Can't read the host file"), 1;
+        for (unsigned int i = 0; i < nb; i++) {
+            if (!md[i].stream || dests[i].err)
+                continue;
+            uint8_t *w = win;
+            if (p->patch)
+                memcpy(cpy, win, n), p->patch(&md[i], cpy, off, n), w = cpy;
+            if (fwrite(w, sizeof(uint8_t), n, md[i].infos->res) != (size_t)n)
+                perror("Multi: Can't write the result file"), dests[i].err = ERR_INSERT;
+        }
+    }
+
+    /* Fin de chaque résultat : l'hôte est replacé après la partie commune. */
+    for (unsigned int i = 0; i < nb; i++) {
+        if (!md[i].stream || dests[i].err)
+            continue;
+        if (fseek(host, p->prefix, SEEK_SET) || p->tail(md[i].infos) || write_footer(md[i].infos))
+            dests[i].err = ERR_INSERT;
+    }
+    return free(win), free(cpy), 0;
+}
+
+int stegx_insert_multi(const char *host_path, algo_e algo, stegx_dest_s * dests, unsigned int nb)
+{
+    assert(algo >= STEGX_ALGO_LSB && algo < STEGX_NB_ALGO);
+    if (!host_path || !dests || !nb)
+        return stegx_errno = ERR_INSERT, 1;
+
+    /* Ouverture, vérification et analyse de l'hôte une seule fois. */
+    info_s tpl = {.mode = STEGX_MODE_INSERT };
+    if (!(tpl.host.host = fopen(host_path, "rb")))
+        return perror(NULL), stegx_errno = ERR_HOST, 1;
+    if (!(tpl.host.type = check_file_format(tpl.host.host)))
+        return fclose(tpl.host.host), stegx_errno = ERR_CHECK_COMPAT, 1;
+    if (fill_host_info(&tpl))
+        return multi_host_release(&tpl), stegx_errno = ERR_SUGG_ALGOS, 1;
+
+    /* Même gestion de la variable globale que "stegx_init" et "stegx_clear". */
+    int own_propos = !stegx_propos_algos;
+    if (own_propos && !(stegx_propos_algos = malloc(STEGX_NB_ALGO * sizeof(algo_e))))
+        return multi_host_release(&tpl), perror("Can't allocate memory for stegx_propos_algos tab"),
+            stegx_errno = ERR_OTHER, 1;
+    struct multi_dest *md = calloc(nb, sizeof(struct multi_dest));
+    if (!md) {
+        perror("Multi: Can't allocate memory for recipients");
+        multi_host_release(&tpl);
+        if (own_propos)
+            stegx_propos_algos = (free(stegx_propos_algos), NULL);
+        return stegx_errno = ERR_OTHER, 1;
+    }
+
+    /* Initialisation de tous les destinataires avant toute insertion : la
+     * suite pseudo aléatoire n'est initialisée qu'une fois pour que les mots
+     * de passe par défaut soient tous différents. */
+    stegx_srand(time(NULL));
+    for (unsigned int i = 0; i < nb; i++) {
+        dests[i].err = ERR_NONE;
+        md[i].infos = multi_dest_init(&tpl, &dests[i], algo);
+    }
+
+    /* Plan commun : tous les destinataires traités pendant la lecture unique
+     * partagent la même partie commune, qui ne dépend que de l'hôte. */
+    struct multi_plan plan, p;
+    int nb_stream = 0;
+    for (unsigned int i = 0; i < nb; i++) {
+        if (dests[i].err || multi_plan_get(md[i].infos, nb_stream ? &p : &plan))
+            continue;
+        md[i].stream = 1, nb_stream++;
+    }
+
+    /* Lecture unique de l'hôte par lot de destinataires : seuls les fichiers
+     * du lot en cours sont ouverts. Un lot est aussi arrêté plus tôt si la
+     * limite de descripteurs est atteinte avant la taille prévue. */
+    unsigned int batch = multi_batch_max();
+    for (unsigned int b = 0, e = 0; nb_stream && b < nb; b = e) {
+        unsigned int n = 0;
+        for (e = b; e < nb && n < batch; e++) {
+            if (!md[e].stream || dests[e].err)
+                continue;
+            int r = multi_dest_open(&md[e], &dests[e], plan.patch != NULL);
+            /* Le destinataire sera ouvert dans le lot suivant. */
+            if (r < 0 && n) {
+                dests[e].err = ERR_NONE;
+                break;
+            }
+            n += !r;
+        }
+        if (n && multi_stream(tpl.host.host, &plan, md + b, dests + b, e - b))
+            for (unsigned int i = b; i < e; i++)
+                dests[i].err = md[i].stream && !dests[i].err ? ERR_INSERT : dests[i].err;
+        for (unsigned int i = b; i < e; i++)
+            if (md[i].stream)
+                multi_dest_clear(&md[i]);
+    }
+
+    /* Insertion classique pour les autres, l'analyse de l'hôte étant
+     * réutilisée. Les fichiers sont fermés dès la fin de chaque insertion. */
+    for (unsigned int i = 0; i < nb; i++) {
+        if (dests[i].err || md[i].stream || multi_dest_open(&md[i], &dests[i], 0))
+            continue;
+        if (stegx_insert(md[i].infos))
+            dests[i].err = stegx_errno;
+        multi_dest_clear(&md[i]);
+    }
+
+    /* Libération et bilan. */
+    int err = 0;
+    for (unsigned int i = 0; i < nb; i++) {
+        multi_dest_clear(&md[i]);
+        err |= dests[i].err != ERR_NONE;
+    }
+    free(md);
+    multi_host_release(&tpl);
+    if (own_propos)
+        stegx_propos_algos = (free(stegx_propos_algos), NULL);
+    return err ? (stegx_errno = ERR_INSERT, 1) : 0;
+}
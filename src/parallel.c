@@ -0,0 +1,137 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file parallel.c
+ * @brief Traitements répartis entre plusieurs threads.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+/**
+ * @brief Partie traitée par un thread.
+ */
+struct parallel_job {
+    void *(*fn)(void *);        /*!< Fonction qui traite la partie. */
+    void *arg;                  /*!< Partie. */
+    struct parallel *par;       /*!< Suivi partagé (NULL si aucun). */
+    pthread_t th;               /*!< Thread de la partie. */
+    int started;                /*!< 1 si le thread a été créé. */
+};
+
+/**
+ * @brief Traite une partie puis signale la fin du thread.
+ * @param arg Partie (\r{struct parallel_job}).
+ * @return NULL.
+ * @author StegX Team
+ */
+static void *parallel_job_run(void *arg)
+{
+    struct parallel_job *j = arg;
+    j->fn(j->arg);
+    if (j->par) {
+        pthread_mutex_lock(&j->par->lock);
+        j->par->left--;
+        pthread_cond_signal(&j->par->cond);
+        pthread_mutex_unlock(&j->par->lock);
+    }
+    return NULL;
+}
+
+void parallel_check(struct parallel *par)
+{
+    uint64_t done = atomic_load_explicit(&par->done, memory_order_relaxed);
+    if (par->p && progress_at(par->p, par->base + done))
+        atomic_store_explicit(&par->stop, 1, memory_order_relaxed);
+}
+
+int parallel_run(void *(*fn)(void *), void *parts, long int nb, size_t size,
+                 struct parallel *par, struct progress *p, uint64_t base)
+{
+    uint8_t *pp = parts;
+    if (par) {
+        par->p = p, par->base = base, par->owner = pthread_self(), par->left = 0;
+        atomic_init(&par->done, 0);
+        atomic_init(&par->stop, 0);
+        pthread_mutex_init(&par->lock, NULL);
+        pthread_cond_init(&par->cond, NULL);
+    }
+    /* Sans tableau des threads, toutes les parties sont traitées ici. */
+    struct parallel_job *j = nb > 1 ? calloc(nb - 1, sizeof(*j)) : NULL;
+    for (long int t = 1; t < nb; t++) {
+        if (j) {
+            j[t - 1] = (struct parallel_job) {.fn = fn,.arg = pp + t * size,.par = par };
+            if ((j[t - 1].started = !pthread_create(&j[t - 1].th, NULL, parallel_job_run, &j[t - 1]))) {
+                if (par) {
+                    pthread_mutex_lock(&par->lock);
+                    par->left++;
+                    pthread_mutex_unlock(&par->lock);
+                }
+                continue;
+            }
+        }
+        fn(pp + t * size);
+    }
+    fn(pp);
+
+    /* Attente des threads en suivant la progression. */
+    if (par) {
+        pthread_mutex_lock(&par->lock);
+        while (par->left > 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += PARALLEL_POLL_MS * 1000000L;
+            ts.tv_sec += ts.tv_nsec / 1000000000L, ts.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&par->cond, &par->lock, &ts);
+            pthread_mutex_unlock(&par->lock);
+            parallel_check(par);
+            pthread_mutex_lock(&par->lock);
+        }
+        pthread_mutex_unlock(&par->lock);
+    }
+    for (long int t = 1; j && t < nb; t++)
+        if (j[t - 1].started)
+            pthread_join(j[t - 1].th, NULL);
+    free(j);
+    if (!par)
+        return 0;
+    parallel_check(par);
+    pthread_mutex_destroy(&par->lock);
+    pthread_cond_destroy(&par->cond);
+    return parallel_stopped(par);
+}
+
+int parallel_copy(struct parallel *par, int in, int out, uint8_t * buf, size_t buf_size,
+                  long int from, long int to, long int shift)
+{
+    for (size_t n; from < to; from += n) {
+        n = (size_t)(to - from) < buf_size ? (size_t)(to - from) : buf_size;
+        if (pread(in, buf, n, from) != (ssize_t) n || pwrite(out, buf, n, from + shift) != (ssize_t) n)
+            return -1;
+        if (parallel_step(par, n))
+            return 1;
+    }
+    return 0;
+}
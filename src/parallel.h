@@ -0,0 +1,136 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file parallel.h
+ * @brief Traitements répartis entre plusieurs threads.
+ * @details Module commun aux insertions et aux analyses parallèles : un
+ * traitement est découpé en parties indépendantes, chacune traitée par un
+ * thread, puis les threads sont attendus. Les parties d'une insertion
+ * comptent leurs octets dans un suivi partagé (\r{struct parallel}) : seul le
+ * thread appelant appelle la fonction de suivi de l'utilisateur et vérifie
+ * l'échéance, et les parties s'arrêtent au bloc suivant si le traitement est
+ * annulé.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "progress.h"
+
+/** Intervalle de vérification de la progression pendant l'attente des
+ * threads (millisecondes). */
+#define PARALLEL_POLL_MS 50
+
+/**
+ * @brief Suivi partagé par les parties d'un traitement parallèle.
+ */
+struct parallel {
+    struct progress *p;         /*!< Progression du thread appelant. */
+    uint64_t base;              /*!< Position de l'étape avant le traitement parallèle. */
+    pthread_t owner;            /*!< Thread appelant. */
+    atomic_uint_fast64_t done;  /*!< Octets traités par l'ensemble des parties. */
+    atomic_int stop;            /*!< 1 si le traitement est annulé. */
+    pthread_mutex_t lock;       /*!< Protège "left". */
+    pthread_cond_t cond;        /*!< Signalé à la fin de chaque thread. */
+    long int left;              /*!< Nombre de threads non terminés. */
+};
+
+/**
+ * @brief Reporte les octets traités sur la progression de l'appelant.
+ * @internal Appelée par \r{parallel_step} dans le thread appelant seulement.
+ * @param par Suivi partagé.
+ * @author StegX Team
+ */
+void parallel_check(struct parallel *par);
+
+/**
+ * @brief Indique si le traitement parallèle est annulé.
+ * @param par Suivi partagé (peut être NULL).
+ * @return 1 si le traitement est annulé, 0 sinon.
+ * @author StegX Team
+ */
+static inline int parallel_stopped(struct parallel *par)
+{
+    return par && atomic_load_explicit(&par->stop, memory_order_relaxed);
+}
+
+/**
+ * @brief Signale des octets traités par une partie, à appeler une fois par
+ * bloc.
+ * @param par Suivi partagé (peut être NULL).
+ * @param n Nombre d'octets traités depuis le dernier appel.
+ * @return 0 si la partie peut continuer, 1 si le traitement est annulé.
+ * @author StegX Team
+ */
+static inline int parallel_step(struct parallel *par, uint64_t n)
+{
+    if (!par)
+        return 0;
+    atomic_fetch_add_explicit(&par->done, n, memory_order_relaxed);
+    if (pthread_equal(pthread_self(), par->owner))
+        parallel_check(par);
+    return parallel_stopped(par);
+}
+
+/**
+ * @brief Traite des parties en parallèle et attend qu'elles soient finies.
+ * @details La première partie est traitée par le thread appelant, les autres
+ * chacune par un thread. Une partie dont le thread n'a pas pu être créé est
+ * traitée par le thread appelant : le résultat ne dépend pas du nombre de
+ * threads obtenus. Pendant l'attente des threads, la progression est
+ * vérifiée toutes les \r{PARALLEL_POLL_MS} millisecondes.
+ * @param fn Fonction qui traite une partie.
+ * @param parts Tableau des parties.
+ * @param nb Nombre de parties.
+ * @param size Taille d'une partie (octets).
+ * @param par Suivi partagé, initialisé ici, que les parties connaissent
+ * déjà (NULL si aucun).
+ * @param p Progression de l'appelant (ignorée si "par" est NULL).
+ * @param base Position de l'étape avant le traitement parallèle.
+ * @return 0 si toutes les parties ont été traitées, 1 si le traitement a été
+ * annulé.
+ * @author StegX Team
+ */
+int parallel_run(void *(*fn)(void *), void *parts, long int nb, size_t size,
+                 struct parallel *par, struct progress *p, uint64_t base);
+
+/**
+ * @brief Recopie une zone d'un fichier dans un autre par "pread" et
+ * "pwrite", sans toucher à leurs curseurs.
+ * @param par Suivi partagé (peut être NULL), mis à jour à chaque bloc.
+ * @param in Descripteur du fichier lu.
+ * @param out Descripteur du fichier écrit.
+ * @param buf Tampon.
+ * @param buf_size Taille du tampon.
+ * @param from Début de la zone.
+ * @param to Fin de la zone.
+ * @param shift Décalage de la zone dans le fichier écrit.
+ * @return 0 si tout s'est bien passé, 1 si le traitement est annulé, -1 sur
+ * une erreur.
+ * @author StegX Team
+ */
+int parallel_copy(struct parallel *par, int in, int out, uint8_t * buf, size_t buf_size,
+                  long int from, long int to, long int shift);
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file probe.c
+ * @brief Sondage rapide d'un fichier : début et fin seulement.
+ * @details Tous les algorithmes écrivent la signature StegX après la fin
+ * "officielle" du fichier hôte (fin de l'image, du chunk "data", du dernier
+ * tag ou de la dernière frame). Le sondage lit un bloc au début et un bloc à
+ * la fin du fichier, reconnaît le format sur le premier et vérifie sur le
+ * second (ou à partir des tailles lues dans le premier) que le fichier se
+ * termine bien là où son format l'indique. Le milieu du fichier n'est jamais
+ * lu : quand la vérification en aurait besoin (dernier tag FLV qui commence
+ * avant le dernier bloc), le fichier est déclaré suspect. Un fichier terminé par un pied de signature (version 2) est reconnu sur
+ * le second bloc seul. Le format est reconnu sur le premier bloc par une table
+ * de signatures, sans repasser par les fonctions "stegx_test_file_*" (qui
+ * relisent chacune le début du fichier).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "stegx.h"
+#include "detect_algo.h"
+#include "crc32.h"
+
+/** Taille des blocs lus au début et à la fin du fichier. */
+#define PROBE_BLOCK 4096
+/** Taille en dessous de laquelle un fichier ne peut pas contenir un hôte et
+ * une signature StegX. */
+#define PROBE_MIN_SIZE 64
+
+/** Taille d'un tag ID3v1 (en fin de fichier MP3). */
+#define PROBE_ID3V1_SIZE 128
+/** Taille de l'en-tête d'un tag FLV. */
+#define PROBE_FLV_TAG_HDR 11
+/** Taille de l'en-tête d'un fichier FLV suivi du premier "previous tag size". */
+#define PROBE_FLV_HDR 13
+
+/** Chunk IEND complet terminant un fichier PNG (taille nulle, ID et CRC). */
+static const uint8_t png_iend[LENGTH_CHUNK_IEND] = {
+    0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82
+};
+
+/**
+ * @brief Lit un entier 32 bits petit-boutiste dans un bloc.
+ * @param b Adresse de l'entier.
+ * @return Entier lu.
+ * @author StegX Team
+ */
+static uint32_t rd_le32(const uint8_t * b)
+{
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24);
+}
+
+/**
+ * @brief Signature d'un format de fichier, reconnue au début du premier bloc.
+ */
+struct probe_format {
+    const char *name;           /*!< Nom du format (\r{stegx_probe_s.format}). */
+    type_e type;                /*!< Type représentant le format (les variantes ne sont pas distinguées). */
+    uint8_t magic[12];          /*!< Octets attendus au début du fichier. */
+    uint8_t len;                /*!< Nombre d'octets de "magic" comparés. */
+    uint16_t skip;              /*!< Octets de "magic" ignorés (bit i pour l'octet i). */
+};
+
+/** Table des formats, dans l'ordre de \r{check_file_format}. */
+static const struct probe_format probe_formats[] = {
+    {"bmp", BMP_UNCOMPRESSED, "BM", 2, 0},
+    {"png", PNG, "\x89PNG\r\n\x1a\n", 8, 0},
+    /* RIFF : la taille du chunk (octets 4 à 7) est ignorée. */
+    {"wav", WAV_PCM, "RIFF\0\0\0\0WAVE", 12, 0x00F0},
+    {"mp3", MP3, "ID3", 3, 0},
+    {"avi", AVI_UNCOMPRESSED, "RIFF\0\0\0\0AVI ", 12, 0x00F0},
+    {"flv", FLV, "FLV", 3, 0},
+};
+
+/** Format MP3 reconnu à sa première frame MPEG (sans tag ID3v2). */
+static const struct probe_format probe_mpeg = { "mp3", MP3, "", 0, 0 };
+
+/**
+ * @brief Lit un entier 64 bits petit-boutiste dans un bloc.
+ * @param b Adresse de l'entier.
+ * @return Entier lu.
+ * @author StegX Team
+ */
+static uint64_t rd_le64(const uint8_t * b)
+{
+    return rd_le32(b) | (uint64_t) rd_le32(b + 4) << 32;
+}
+
+/**
+ * @brief Lit un entier 32 bits gros-boutiste dans un bloc.
+ * @param b Adresse de l'entier.
+ * @return Entier lu.
+ * @author StegX Team
+ */
+static uint32_t rd_be32(const uint8_t * b)
+{
+    return ((uint32_t) b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+/**
+ * @brief Recherche la fin du chunk "data" d'un fichier WAVE dans son premier
+ * bloc.
+ * @param head Premier bloc du fichier.
+ * @param n Taille du bloc.
+ * @return Adresse de la fin du chunk "data", 0 s'il n'est pas dans le bloc.
+ * @author StegX Team
+ */
+static uint64_t probe_wav_end(const uint8_t * head, size_t n)
+{
+    for (uint64_t off = WAV_SUBCHK1_ADDR; off + 8 <= n;
+         off += 8 + (uint64_t) rd_le32(head + off + 4)) {
+        if (rd_le32(head + off) == WAV_DATA_SIGN)
+            return off + 8 + rd_le32(head + off + 4);
+    }
+    return 0;
+}
+
+/**
+ * @brief Vérifie que la fin d'un fichier FLV est son dernier tag.
+ * @param size Taille du fichier.
+ * @param tail Dernier bloc du fichier.
+ * @param n Taille du bloc.
+ * @return 1 si le fichier se termine par un tag complet, 0 sinon (y compris
+ * quand l'en-tête du dernier tag n'est pas dans le bloc).
+ * @author StegX Team
+ */
+static int probe_flv_clean(uint64_t size, const uint8_t * tail, size_t n)
+{
+    /* Le dernier "previous tag size" donne l'adresse du dernier tag. */
+    uint32_t prev = rd_be32(tail + n - 4);
+    if (!prev)
+        return size == PROBE_FLV_HDR;
+    if (prev < PROBE_FLV_TAG_HDR || (uint64_t) prev + 4 + PROBE_FLV_HDR > size)
+        return 0;
+    uint64_t tag = size - 4 - prev;
+    /* En-tête hors du bloc : le milieu du fichier n'est pas lu. */
+    if (tag < size - n)
+        return 0;
+    const uint8_t *hdr = tail + (tag - (size - n));
+    if (hdr[0] != AUDIO_TAG && hdr[0] != VIDEO_TAG && hdr[0] != METATAG)
+        return 0;
+    return (rd_be32(hdr) & 0x00FFFFFF) + PROBE_FLV_TAG_HDR == prev;
+}
+
+/**
+ * @brief Vérifie que la fin d'un fichier MP3 est un tag ID3v1 ou la fin d'une
+ * frame MPEG.
+ * @param tail Dernier bloc du fichier.
+ * @param n Taille du bloc.
+ * @return 1 si le fichier se termine par un tag ID3v1 ou une frame complète,
+ * 0 sinon.
+ * @author StegX Team
+ */
+static int probe_mp3_clean(const uint8_t * tail, size_t n)
+{
+    if (n >= PROBE_ID3V1_SIZE && mp3_id3v1_hdr_test(rd_be32(tail + n - PROBE_ID3V1_SIZE)))
+        return 1;
+    /* Une frame dont la taille mène exactement à la fin du fichier. */
+    for (size_t i = 0; i + 4 <= n; i++) {
+        int fr = tail[i] == 0xFF ? mp3_mpeg_fr_size(rd_be32(tail + i)) : 0;
+        if (fr && i + fr == n)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Lit la signature si elle se trouve entièrement dans le dernier bloc.
+ * @param res Résultat du sondage, "sig_offset" renseigné.
+ * @param size Taille du fichier.
+ * @param tail Dernier bloc du fichier.
+ * @param n Taille du bloc.
+ * @param footer 1 si le fichier a un pied de signature (dont l'empreinte est
+ * alors vérifiée), 0 sinon.
+ * @return 1 si la signature a été lue, 0 si elle n'est pas dans le bloc ou
+ * n'est pas valide.
+ * @author StegX Team
+ */
+static int probe_sig(stegx_probe_s * res, uint64_t size, const uint8_t * tail, size_t n, int footer)
+{
+    uint64_t end = size - (footer ? LENGTH_SIG_FOOTER : 0);
+    if (res->sig_offset < size - n || res->sig_offset >= end)
+        return 0;
+    const uint8_t *sig = tail + (res->sig_offset - (size - n));
+    size_t len = sig_size(sig, end - res->sig_offset);
+    if (!len || (footer && sig_hash(sig_hash(FNV64_OFFSET, sig, len), tail + n - LENGTH_SIG_FOOTER, 16)
+                 != rd_le64(tail + n - 8)))
+        return 0;
+    res->algo = sig[1], res->method = sig[0];
+    res->hidden_length = rd_le32(sig + 2);
+    return res->confirmed = 1;
+}
+
+/**
+ * @brief Reconnaît le format d'un fichier sur son premier bloc.
+ * @param head Premier bloc du fichier.
+ * @param n Taille du bloc.
+ * @return Format reconnu, NULL si aucun.
+ * @author StegX Team
+ */
+static const struct probe_format *probe_sniff(const uint8_t * head, size_t n)
+{
+    for (size_t i = 0; i < sizeof(probe_formats) / sizeof(*probe_formats); i++) {
+        const struct probe_format *f = &probe_formats[i];
+        size_t k = 0;
+        while (k < f->len && k < n && ((f->skip >> k) & 1 || head[k] == f->magic[k]))
+            k++;
+        if (k == f->len)
+            return f;
+    }
+    /* MP3 sans tag ID3v2 : une frame MPEG dès le début. */
+    return mp3_mpeg_hdr_test(rd_be32(head)) ? &probe_mpeg : NULL;
+}
+
+int stegx_probe(const char *path, stegx_probe_s * res)
+{
+    stegx_probe_s r = {.algo = STEGX_NB_ALGO };
+    res = res ? res : &r;
+    *res = r;
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st))
+        return fd != -1 ? close(fd) : 0, stegx_errno = ERR_HOST, -1;
+    if (!S_ISREG(st.st_mode) || st.st_size < PROBE_MIN_SIZE)
+        return close(fd), 0;
+    /* Deux petites lectures : la lecture anticipée du système serait perdue. */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    uint64_t size = st.st_size;
+    uint8_t head[PROBE_BLOCK], tail[PROBE_BLOCK];
+    size_t n = size < PROBE_BLOCK ? size : PROBE_BLOCK;
+    if (pread(fd, head, n, 0) != (ssize_t) n || pread(fd, tail, n, size - n) != (ssize_t) n)
+        return close(fd), stegx_errno = ERR_HOST, -1;
+    const struct probe_format *f = probe_sniff(head, n);
+    type_e type = f ? f->type : UNKNOWN;
+    res->format = f ? f->name : NULL;
+
+    /* Pied de signature : il donne l'adresse de la signature. */
+    int footer = sig_footer_test(tail + n - LENGTH_SIG_FOOTER);
+    if (footer) {
+        res->suspect = 1;
+        uint64_t pos = rd_le64(tail + n - 16);
+        res->sig_offset = pos && pos < size - LENGTH_SIG_FOOTER ? pos : 0;
+    }
+    /* Sinon, fin "officielle" du fichier selon son format (0 si inconnue). */
+    else if (type == BMP_UNCOMPRESSED)
+        res->sig_offset = rd_le32(head + BMP_DEF_LENGTH);
+    else if (type == WAV_PCM)
+        res->sig_offset = probe_wav_end(head, n);
+    else if (type == AVI_UNCOMPRESSED)
+        res->sig_offset = (uint64_t) rd_le32(head + 4) + 8;
+    else if (type == PNG) {
+        res->suspect = memcmp(tail + n - LENGTH_CHUNK_IEND, png_iend, LENGTH_CHUNK_IEND) != 0;
+        /* Le dernier chunk IEND du bloc termine l'image. */
+        for (size_t i = n - LENGTH_CHUNK_IEND; res->suspect && i-- > 0;)
+            if (!memcmp(tail + i, png_iend, LENGTH_CHUNK_IEND)) {
+                res->sig_offset = size - n + i + LENGTH_CHUNK_IEND;
+                break;
+            }
+    } else if (type == FLV)
+        res->suspect = !probe_flv_clean(size, tail, n);
+    else if (type == MP3)
+        res->suspect = !probe_mp3_clean(tail, n);
+    close(fd);
+    if (!footer && res->sig_offset && type != PNG)
+        res->suspect = size > res->sig_offset;
+    if (!res->suspect || !res->sig_offset)
+        return res->sig_offset = 0, res->suspect;
+
+    /* La signature est lue si elle est dans le dernier bloc. Avant ce bloc,
+     * les données la suivent : seuls EOF et JUNK_CHUNK écrivent après elle. */
+    if (!probe_sig(res, size, tail, n, footer) && res->sig_offset < size - n)
+        res->algo = type == AVI_UNCOMPRESSED ? STEGX_ALGO_JUNK_CHUNK : STEGX_ALGO_EOF;
+    return 1;
+}
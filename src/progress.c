@@ -0,0 +1,113 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file progress.c
+ * @brief Suivi de progression et annulation d'un traitement.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "stegx_common.h"
+#include "stegx_errors.h"
+#include "progress.h"
+
+/**
+ * @brief Indique si le suivi a quelque chose à vérifier.
+ * @param p Suivi de progression.
+ * @return 1 si une fonction de suivi ou une échéance est choisie, 0 sinon.
+ * @author StegX Team
+ */
+static int progress_active(const struct progress *p)
+{
+    return p->cb || p->deadline.tv_sec || p->deadline.tv_nsec;
+}
+
+/**
+ * @brief Calcule la taille d'un fichier sans déplacer son curseur.
+ * @param f Fichier.
+ * @return Taille du fichier (0 si elle est inconnue).
+ * @author StegX Team
+ */
+static uint64_t progress_file_size(FILE * f)
+{
+    struct stat st;
+    if (!f)
+        return 0;
+    if (fileno(f) != -1 && !fstat(fileno(f), &st) && S_ISREG(st.st_mode))
+        return st.st_size;
+    /* Flux en mémoire (hôte partagé) : pas de descripteur. */
+    long pos = ftell(f), size = -1;
+    if (pos != -1 && !fseek(f, 0, SEEK_END))
+        size = ftell(f), fseek(f, pos, SEEK_SET);
+    return size == -1 ? 0 : size;
+}
+
+int progress_begin(struct progress *p, stage_e stage, FILE * f, uint64_t extra)
+{
+    p->stage = stage;
+    p->done = 0;
+    p->total = extra + (progress_active(p) ? progress_file_size(f) : 0);
+    p->next = 0;
+    return progress_check(p);
+}
+
+int progress_check(struct progress *p)
+{
+    if (p->err)
+        return stegx_errno = p->err, 1;
+    if (!progress_active(p))
+        return p->next = UINT64_MAX, 0;
+    p->next = p->done + STEGX_PROGRESS_BLOCK;
+
+    /* L'échéance est vérifiée avant d'appeler la fonction de suivi. */
+    struct timespec now;
+    if ((p->deadline.tv_sec || p->deadline.tv_nsec) && !clock_gettime(CLOCK_MONOTONIC, &now)
+        && (now.tv_sec > p->deadline.tv_sec
+            || (now.tv_sec == p->deadline.tv_sec && now.tv_nsec >= p->deadline.tv_nsec)))
+        p->err = ERR_DEADLINE;
+    else if (p->cb && p->cb(p->data, p->stage, p->done < p->total ? p->done : p->total, p->total))
+        p->err = ERR_CANCELED;
+    /* Une fois annulé, chaque appel suivant renvoie immédiatement 1. */
+    if (p->err)
+        return p->next = 0, stegx_errno = p->err, 1;
+    return 0;
+}
+
+void progress_end(struct progress *p)
+{
+    if (!p->err && p->cb)
+        p->cb(p->data, p->stage, p->total, p->total);
+}
+
+enum err_code progress_fail(struct progress *p, FILE ** res, const char *res_path,
+                            enum err_code err)
+{
+    if (!p->err)
+        return err;
+    if (res && *res && res_path) {
+        *res = (fclose(*res), NULL);
+        unlink(res_path);
+    }
+    return p->err;
+}
@@ -0,0 +1,136 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ * 
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file progress.h
+ * @brief Suivi de progression et annulation d'un traitement.
+ * @details Module qui compte les octets traités par les boucles de l'analyse,
+ * de l'insertion et de l'extraction. Tous les \r{STEGX_PROGRESS_BLOCK} octets,
+ * la fonction de suivi de l'utilisateur est appelée et l'échéance est vérifiée :
+ * si le traitement est annulé, les boucles s'arrêtent et les fonctions de la
+ * bibliothèque renvoient \r{ERR_CANCELED} ou \r{ERR_DEADLINE}. Sans fonction de
+ * suivi ni échéance, le coût se limite à une addition par itération.
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "stegx_common.h"
+#include "stegx_errors.h"
+
+/**
+ * @brief Suivi de progression d'un traitement.
+ */
+struct progress {
+    stegx_progress_f cb;        /*!< Fonction de suivi de l'utilisateur (NULL si aucune). */
+    void *data;                 /*!< Argument de la fonction de suivi. */
+    struct timespec deadline;   /*!< Échéance sur CLOCK_MONOTONIC (nulle si aucune). */
+    stage_e stage;              /*!< Étape en cours. */
+    uint64_t total;             /*!< Nombre d'octets à traiter dans l'étape (estimation). */
+    uint64_t done;              /*!< Nombre d'octets traités dans l'étape. */
+    uint64_t next;              /*!< Valeur de "done" à partir de laquelle on vérifie à nouveau. */
+    enum err_code err;          /*!< \r{ERR_CANCELED} ou \r{ERR_DEADLINE} si le traitement est annulé. */
+};
+
+/**
+ * @brief Commence une étape du traitement.
+ * @param p Suivi de progression.
+ * @param stage Étape commencée.
+ * @param f Fichier dont la taille est comptée dans le total (fichier hôte).
+ * @param extra Nombre d'octets ajoutés au total (fichier à cacher).
+ * @return 0 si le traitement peut continuer, 1 s'il est annulé et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int progress_begin(struct progress *p, stage_e stage, FILE * f, uint64_t extra);
+
+/**
+ * @brief Appelle la fonction de suivi et vérifie l'échéance.
+ * @internal Appelée par \r{progress_at} une fois par bloc seulement.
+ * @param p Suivi de progression.
+ * @return 0 si le traitement peut continuer, 1 s'il est annulé et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int progress_check(struct progress *p);
+
+/**
+ * @brief Termine l'étape en cours en signalant qu'elle est complète.
+ * @param p Suivi de progression.
+ * @author StegX Team
+ */
+void progress_end(struct progress *p);
+
+/**
+ * @brief Renvoie le code d'erreur d'un traitement qui a échoué.
+ * @details Si le traitement a été annulé, le fichier résultat créé par la
+ * bibliothèque est fermé et supprimé : un traitement annulé ne laisse pas de
+ * résultat incomplet. Un fichier résultat fourni par l'appelant n'est pas
+ * touché.
+ * @param p Suivi de progression.
+ * @param res Fichier résultat (mis à NULL s'il est supprimé).
+ * @param res_path Chemin du fichier résultat s'il a été créé par la
+ * bibliothèque, NULL sinon.
+ * @param err Code d'erreur si le traitement n'a pas été annulé.
+ * @return Code d'erreur à placer dans \r{stegx_errno}.
+ * @author StegX Team
+ */
+enum err_code progress_fail(struct progress *p, FILE ** res, const char *res_path,
+                            enum err_code err);
+
+/**
+ * @brief Indique si le traitement a été annulé.
+ * @param p Suivi de progression.
+ * @return 1 si le traitement est annulé, 0 sinon.
+ * @author StegX Team
+ */
+static inline int progress_canceled(const struct progress *p)
+{
+    return p->err != ERR_NONE;
+}
+
+/**
+ * @brief Signale la position atteinte dans l'étape en cours.
+ * @param p Suivi de progression.
+ * @param pos Nombre d'octets traités depuis le début de l'étape.
+ * @return 0 si le traitement peut continuer, 1 s'il est annulé.
+ * @author StegX Team
+ */
+static inline int progress_at(struct progress *p, uint64_t pos)
+{
+    return (p->done = pos) >= p->next ? progress_check(p) : 0;
+}
+
+/**
+ * @brief Signale des octets traités dans l'étape en cours.
+ * @param p Suivi de progression.
+ * @param n Nombre d'octets traités depuis le dernier appel.
+ * @return 0 si le traitement peut continuer, 1 s'il est annulé.
+ * @author StegX Team
+ */
+static inline int progress_step(struct progress *p, uint64_t n)
+{
+    return progress_at(p, p->done + n);
+}
+
+#endif
@@ -37,17 +37,18 @@
 #include "protection.h"
 #include "rand.h"
 
-int protect_data(uint8_t * tab, uint32_t hidden_length, const char *passwd, mode_e mode)
+int protect_data(uint8_t * tab, uint32_t hidden_length, const char *passwd, mode_e mode,
+                 struct arena *a, struct progress *p)
 {
 
     // copie temporaire de tab car le resultat sera dans tab
-    uint8_t *cpy = malloc(hidden_length * sizeof(uint8_t));
+    uint8_t *cpy = arena_alloc(a, hidden_length * sizeof(uint8_t));
     if (!cpy)
         return perror("Can't allocate memory protection data"), 1;
 
     uint32_t i;
     // Tableau pour savoir si cette case a deja ete inseree dans result
-    uint8_t *done = malloc(hidden_length * sizeof(uint8_t));
+    uint8_t *done = arena_alloc(a, hidden_length * sizeof(uint8_t));
     if (!done)
         return perror("Can't allocate memory protection data"), 1;
     // on initialise cpy comme tab
@@ -71,6 +72,8 @@ int protect_data(uint8_t * tab, uint32_t hidden_length, const char *passwd, mode
 
     // pour chaque element a cacher
     for (i = 0; i < hidden_length; i++) {
+        if (progress_step(p, 1))
+            return 1;
         l = m = 0;
         // on choisit au hasard le n-ieme élément a cacher
         rang = stegx_rand() % (hidden_length_recalcul - 1);   //-1 (au dernier tour rang vaudra 1)
@@ -119,19 +122,18 @@ int protect_data(uint8_t * tab, uint32_t hidden_length, const char *passwd, mode
         hidden_length_recalcul--;
     }
 
-    free(done);
-    free(cpy);
-
     return 0;
 
 }
 
-int data_xor_write_file(FILE * src, FILE * res, const char *passwd)
+int data_xor_write_file(FILE * src, FILE * res, const char *passwd, const uint32_t len,
+                        struct progress *p)
 {
     stegx_srand(create_seed(passwd));
-    for (uint8_t b; fread(&b, sizeof(b), 1, src) == 1;)
+    uint32_t i = 0;
+    for (uint8_t b; i < len && !progress_step(p, 1) && fread(&b, sizeof(b), 1, src) == 1; i++)
         fwrite((b ^= stegx_rand() % UINT8_MAX, &b), sizeof(b), 1, res);
-    return ferror(src);
+    return i < len;
 }
 
 void data_xor_write_tab(uint8_t * src, const char *passwd, const uint32_t len)
@@ -142,21 +144,24 @@ void data_xor_write_tab(uint8_t * src, const char *passwd, const uint32_t len)
 }
 
 int data_scramble_write(FILE * src, FILE * res, const char *pass,
-                        const uint32_t len, const mode_e m)
+                        const uint32_t len, const mode_e m, struct arena *a, struct progress *p)
 {
-    uint8_t *data = malloc(len * sizeof(uint8_t));
+    uint8_t *data = arena_alloc(a, len * sizeof(uint8_t));
     if (!data)
         return perror("EOF: Can't allocate memory for copy hidden file"), 1;
     // Copie les données de fichier source dans data.
     if (fread(data, sizeof(*data), len, src) != len)
         return perror("EOF: Can't make a copy of hidden file"), 1;
     // Mélange ou remet en ordre les octets dans data, et les XOR ou les déXOR.
+    int err;
     if (m)
-        protect_data(data, len, pass, m), data_xor_write_tab(data, pass, len);
+        err = protect_data(data, len, pass, m, a, p), data_xor_write_tab(data, pass, len);
     else
-        data_xor_write_tab(data, pass, len), protect_data(data, len, pass, m);
+        data_xor_write_tab(data, pass, len), err = protect_data(data, len, pass, m, a, p);
+    if (err)
+        return 1;
     // Écriture des données dans le fichier resultat.
     if (fwrite(data, sizeof(*data), len, res) != len)
         return perror("EOF: Can't write hidden data"), 1;
-    return free(data), 0;
+    return 0;
 }
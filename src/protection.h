@@ -30,6 +30,8 @@
 #include <stdint.h>
 #include "stegx_common.h"
 #include "stegx_errors.h"
+#include "arena.h"
+#include "progress.h"
 
 /** Valeur du tableau done pour savoir si un élément n'a pas été vu. */
 #define NOT_DONE 0
@@ -55,10 +57,14 @@
  * pseudo aleatoire nécessaire au mélange des octets de tab. 
  * @param mode Mode qui peut être \req{STEGX_STEGX_MODE_INSERT} ou 
  * \req{STEGX_MODE_EXTRACT}. 
- * @return 0 si le melange des donnees s'est bien passé ; 1 sinon. 
+ * @param a Allocateur du traitement (tableaux temporaires).
+ * @param p Suivi de progression du traitement (un octet par élément rangé).
+ * @return 0 si le melange des donnees s'est bien passé ; 1 sinon (ou si le
+ * traitement est annulé). 
  * @author Clément Caumes
  */
-int protect_data(uint8_t * tab, uint32_t hidden_length, const char *passwd, mode_e mode);
+int protect_data(uint8_t * tab, uint32_t hidden_length, const char *passwd, mode_e mode,
+                 struct arena *a, struct progress *p);
 
 /**
  * @brief Écrit des données XORées avec un mot de passe.
@@ -67,11 +73,16 @@ int protect_data(uint8_t * tab, uint32_t hidden_length, const char *passwd, mode
  * @param src Fichier où lire la donnée.
  * @param res Fichier où écrire la donnée.
  * @param passwd Mot de passe utilisé pour générer la seed.
- * @return 0 si tout est ok, 1 s'il y a eu une erreur lors de la lecture du
- * fichier source.
+ * @param len Nombre d'octets à lire dans le fichier source (ce qui suit n'est
+ * pas lu, par exemple les données de l'hôte ou le pied de signature).
+ * @param p Suivi de progression du traitement.
+ * @return 0 si tout est ok, 1 si le fichier source contient moins de "len"
+ * octets, s'il y a eu une erreur lors de sa lecture ou si le traitement est
+ * annulé.
  * @author Pierre Ayoub
  */
-int data_xor_write_file(FILE * src, FILE * res, const char *passwd);
+int data_xor_write_file(FILE * src, FILE * res, const char *passwd, const uint32_t len,
+                        struct progress *p);
 
 /**
  * @brief Écrit des données XORées avec un mot de passe.
@@ -90,10 +101,13 @@ void data_xor_write_tab(uint8_t * src, const char *passwd, const uint32_t len);
  * @param pass Mot de passe utilisé pour générer la seed.
  * @param len Longueur des données à cacher / cacher.
  * @param m Mode d'utilisation (insertion ou extraction).
- * @return 0 si tout est ok, 1 s'il y a eu une erreur.
+ * @param a Allocateur du traitement (copie des données).
+ * @param p Suivi de progression du traitement.
+ * @return 0 si tout est ok, 1 s'il y a eu une erreur ou si le traitement est
+ * annulé.
  * @author Pierre Ayoub
  */
 int data_scramble_write(FILE * src, FILE * res, const char *pass,
-                        const uint32_t len, const mode_e m);
+                        const uint32_t len, const mode_e m, struct arena *a, struct progress *p);
 
 #endif
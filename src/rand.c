@@ -29,9 +29,23 @@
 #include "rand.h"
 
 /**
- * Variable globale représentant la seed pour la suite pseudo aléatoire.
+ * Variable globale représentant la seed pour la suite pseudo aléatoire (une
+ * par thread).
  */
-unsigned int stegx_seed=0;
+_Thread_local unsigned int stegx_seed=0;
+
+/** Taille de l'état de "rand" de la glibc (générateur TYPE_3). */
+#define LIBC_RAND_STATE_SIZE 128
+
+/** Degré de la récurrence de "rand" de la glibc (générateur TYPE_3). */
+#define LIBC_RAND_DEG 31
+/** Écart de la récurrence de "rand" de la glibc (générateur TYPE_3). */
+#define LIBC_RAND_SEP 3
+
+/** État de la suite compatible avec "rand" de la glibc (un par thread). */
+static _Thread_local char libc_rand_state[LIBC_RAND_STATE_SIZE];
+/** Données de la suite compatible avec "rand" de la glibc (un par thread). */
+static _Thread_local struct random_data libc_rand_data;
 
 unsigned int create_seed(const char *passwd)
 {
@@ -54,3 +68,67 @@ int stegx_rand(){
 	stegx_seed=(1103515245*stegx_seed+12345)%UINT_MAX;
 	return stegx_seed%INT_MAX;
 }
+
+void stegx_srand_libc(unsigned int seed)
+{
+    /* "initstate_r" avec un état de 128 octets donne la même suite que
+     * "srand" de la glibc, qui utilise un état global. */
+    libc_rand_data.state = NULL;
+    initstate_r(seed, libc_rand_state, sizeof(libc_rand_state), &libc_rand_data);
+}
+
+int stegx_rand_libc(void)
+{
+    int32_t r = 0;
+    random_r(&libc_rand_data, &r);
+    return r;
+}
+
+/**
+ * @brief Multiplie deux polynômes modulo x^31 - x^28 - 1 (coefficients
+ * modulo 2^32).
+ * @param res Produit (peut être l'un des facteurs).
+ * @param a Premier facteur.
+ * @param b Second facteur.
+ * @author StegX Team
+ */
+static void libc_rand_mul(uint32_t res[LIBC_RAND_DEG], const uint32_t a[LIBC_RAND_DEG],
+                          const uint32_t b[LIBC_RAND_DEG])
+{
+    uint32_t p[2 * LIBC_RAND_DEG - 1] = { 0 };
+    for (int i = 0; i < LIBC_RAND_DEG; i++)
+        for (int j = 0; j < LIBC_RAND_DEG; j++)
+            p[i + j] += a[i] * b[j];
+    /* x^d = x^(d - 31) * (x^28 + 1). */
+    for (int d = 2 * LIBC_RAND_DEG - 2; d >= LIBC_RAND_DEG; d--)
+        p[d - LIBC_RAND_SEP] += p[d], p[d - LIBC_RAND_DEG] += p[d];
+    for (int i = 0; i < LIBC_RAND_DEG; i++)
+        res[i] = p[i];
+}
+
+void stegx_rand_libc_skip(uint64_t n)
+{
+    /* Dans l'ordre chronologique, les 31 derniers entiers de la suite
+     * commencent à "fptr" (le plus ancien, remplacé au prochain tirage). */
+    int32_t *st = libc_rand_data.state;
+    int f = libc_rand_data.fptr - st;
+    uint32_t s[LIBC_RAND_DEG], x[LIBC_RAND_DEG] = { 0, 1 }, p[LIBC_RAND_DEG] = { 1 };
+    for (int k = 0; k < LIBC_RAND_DEG; k++)
+        s[k] = st[(f + k) % LIBC_RAND_DEG];
+
+    /* p = x^n. */
+    for (; n; n >>= 1, libc_rand_mul(x, x, x))
+        if (n & 1)
+            libc_rand_mul(p, p, x);
+    /* Nouvel état : r[n + k] = somme des p_k[j] * r[j], avec p_k = x^k * p. */
+    for (int k = 0; k < LIBC_RAND_DEG; k++) {
+        uint32_t r = 0;
+        for (int j = 0; j < LIBC_RAND_DEG; j++)
+            r += p[j] * s[j];
+        st[(f + k) % LIBC_RAND_DEG] = r;
+        uint32_t top = p[LIBC_RAND_DEG - 1];
+        for (int j = LIBC_RAND_DEG - 1; j > 0; j--)
+            p[j] = p[j - 1];
+        p[0] = top, p[LIBC_RAND_DEG - LIBC_RAND_SEP] += top;
+    }
+}
@@ -50,5 +50,36 @@ void stegx_srand(unsigned int seed);
  */
 int stegx_rand();
 
+/** 
+ * @brief Initialise la suite pseudo aléatoire compatible avec "srand" de la
+ * glibc. 
+ * @details La suite est propre à chaque thread. Elle remplace "srand"/"rand"
+ * pour les formats dont les fichiers existants ont été produits avec la suite
+ * de la glibc (LSB sur MP3).
+ * @param seed nombre qui représentera la seed.
+ * @author StegX Team
+ */
+void stegx_srand_libc(unsigned int seed);
+
+/** 
+ * @brief Renvoie un entier de la suite compatible avec "rand" de la glibc. 
+ * @return renvoie l'entier de la suite pseudo aléatoire.
+ * @author StegX Team
+ */
+int stegx_rand_libc(void);
+
+/** 
+ * @brief Avance la suite compatible avec "rand" de la glibc sans calculer
+ * les entiers sautés.
+ * @details La suite de la glibc vérifie r[i] = r[i - 3] + r[i - 31] (modulo
+ * 2^32) : l'état après n entiers s'obtient à partir de l'état courant par
+ * x^n modulo x^31 - x^28 - 1, en O(log n). Chaque thread peut ainsi démarrer
+ * directement à la position de sa partie des données.
+ * @param n Nombre d'entiers à sauter.
+ * @req La suite doit avoir été initialisée par \r{stegx_srand_libc}.
+ * @author StegX Team
+ */
+void stegx_rand_libc_skip(uint64_t n);
+
 #endif
 
@@ -0,0 +1,308 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file registry.c
+ * @brief Registre des empreintes : jeton caché vers identité de l'utilisateur.
+ * @details Format du fichier : un en-tête (\r{registry_hdr}), les entrées
+ * (\r{registry_entry}) triées par empreinte FNV-1a du jeton puis par jeton,
+ * puis un bloc de chaînes contenant les jetons et les identifiants (tous
+ * suivis d'un '\0', chaque identifiant n'y figurant qu'une fois). Le fichier est
+ * projeté en mémoire et interrogé par recherche dichotomique sur les
+ * empreintes, sans copie. Comme l'index des hôtes, il est écrit dans la
+ * représentation native des entiers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "stegx.h"
+#include "crc32.h"
+
+/** Signature du registre ("SXRG"). */
+#define REGISTRY_MAGIC 0x47525853
+
+/** Version du format du registre. */
+#define REGISTRY_VERSION 1
+
+/**
+ * @brief En-tête du registre.
+ */
+struct registry_hdr {
+    uint32_t magic;             /*!< Signature \r{REGISTRY_MAGIC}. */
+    uint32_t version;           /*!< Version \r{REGISTRY_VERSION}. */
+    uint64_t nb;                /*!< Nombre d'entrées. */
+    uint64_t strings_size;      /*!< Taille du bloc de chaînes (octets). */
+};
+
+/**
+ * @brief Entrée du registre.
+ * @details Les champs "token", "user" et "host" sont des adresses dans le bloc
+ * de chaînes.
+ */
+struct registry_entry {
+    uint64_t hash;              /*!< Empreinte FNV-1a 64 bits du jeton. */
+    int64_t issued;             /*!< Date de délivrance du jeton. */
+    uint32_t token;             /*!< Adresse du jeton. */
+    uint32_t token_len;         /*!< Taille du jeton. */
+    uint32_t user;              /*!< Adresse de l'identifiant de l'utilisateur. */
+    uint32_t host;              /*!< Adresse de l'identifiant de l'hôte. */
+};
+
+/**
+ * @brief Registre projeté en mémoire.
+ */
+struct stegx_registry {
+    void *addr;                 /*!< Projection du fichier (lecture seule). */
+    size_t size;                /*!< Taille du fichier (octets). */
+    const struct registry_entry *entries;       /*!< Entrées triées. */
+    uint64_t nb;                /*!< Nombre d'entrées. */
+    const char *strings;        /*!< Bloc de chaînes. */
+};
+
+/**
+ * @brief Entrée en construction, liée à son jeton.
+ */
+struct build_entry {
+    struct registry_entry e;    /*!< Entrée à écrire. */
+    const stegx_token_s *t;     /*!< Jeton de l'appelant. */
+};
+
+/**
+ * @brief Table des chaînes en construction (adressage ouvert), pour n'écrire
+ * qu'une fois chaque identifiant.
+ */
+struct build_strings {
+    char *buf;                  /*!< Bloc de chaînes. */
+    size_t len;                 /*!< Taille utilisée du bloc. */
+    size_t cap;                 /*!< Taille allouée du bloc. */
+    uint32_t *slots;            /*!< Adresse + 1 de chaque chaîne (0 si libre). */
+    size_t nb_slots;            /*!< Nombre de cases (puissance de 2). */
+};
+
+/**
+ * @brief Ajoute des octets au bloc de chaînes.
+ * @param s Table des chaînes.
+ * @param d Octets à ajouter.
+ * @param n Nombre d'octets.
+ * @param off Adresse des octets ajoutés dans le bloc.
+ * @return 0 si les octets ont été ajoutés, 1 sinon.
+ * @author StegX Team
+ */
+static int strings_append(struct build_strings *s, const void *d, size_t n, uint32_t * off)
+{
+    if (s->len + n > UINT32_MAX)
+        return 1;
+    if (s->len + n > s->cap) {
+        size_t cap = s->cap ? s->cap : 1 << 16;
+        while (cap < s->len + n)
+            cap *= 2;
+        char *buf = realloc(s->buf, cap);
+        if (!buf)
+            return perror("Registry: Can't allocate memory for strings"), 1;
+        s->buf = buf, s->cap = cap;
+    }
+    memcpy(s->buf + s->len, d, n);
+    *off = s->len;
+    s->len += n;
+    return 0;
+}
+
+/**
+ * @brief Ajoute un identifiant au bloc de chaînes s'il n'y est pas déjà.
+ * @param s Table des chaînes.
+ * @param str Identifiant.
+ * @param off Adresse de l'identifiant dans le bloc.
+ * @return 0 si l'identifiant est dans le bloc, 1 sinon.
+ * @author StegX Team
+ */
+static int strings_intern(struct build_strings *s, const char *str, uint32_t * off)
+{
+    size_t n = strlen(str) + 1, mask = s->nb_slots - 1;
+    for (size_t i = sig_hash(FNV64_OFFSET, str, n) & mask;; i = (i + 1) & mask) {
+        if (!s->slots[i]) {
+            if (strings_append(s, str, n, off))
+                return 1;
+            s->slots[i] = *off + 1;
+            return 0;
+        }
+        if (!strcmp(s->buf + s->slots[i] - 1, str))
+            return *off = s->slots[i] - 1, 0;
+    }
+}
+
+/**
+ * @brief Compare deux entrées en construction (empreinte puis jeton).
+ * @author StegX Team
+ */
+static int build_cmp(const void *a, const void *b)
+{
+    const struct build_entry *x = a, *y = b;
+    if (x->e.hash != y->e.hash)
+        return x->e.hash < y->e.hash ? -1 : 1;
+    if (x->t->len != y->t->len)
+        return x->t->len < y->t->len ? -1 : 1;
+    return memcmp(x->t->token, y->t->token, x->t->len);
+}
+
+int stegx_registry_build(const char *path, const stegx_token_s * tokens, size_t nb)
+{
+    assert(path && (tokens || !nb));
+    struct build_entry *b = malloc((nb + 1) * sizeof(*b));
+    struct build_strings s = {.nb_slots = 1024 };
+    while (s.nb_slots < 4 * nb)
+        s.nb_slots *= 2;
+    s.slots = calloc(s.nb_slots, sizeof(*s.slots));
+    int err = !b || !s.slots;
+    if (err)
+        perror("Registry: Can't allocate memory");
+
+    /* Entrées triées par empreinte : deux jetons identiques sont voisins. */
+    for (size_t i = 0; !err && i < nb; i++) {
+        const stegx_token_s *t = &tokens[i];
+        if (!t->len || t->len > STEGX_TOKEN_MAX || !t->id.user || !t->id.host) {
+            fprintf(stderr, "Registry: invalid token %zu\n", i);
+            err = 1;
+            break;
+        }
+        b[i] = (struct build_entry) {.t = t,.e = {.hash = sig_hash(FNV64_OFFSET, t->token, t->len),
+                                                   .issued = t->id.issued,.token_len = t->len}
+        };
+    }
+    if (!err)
+        qsort(b, nb, sizeof(*b), build_cmp);
+    for (size_t i = 1; !err && i < nb; i++)
+        if (!build_cmp(&b[i - 1], &b[i])) {
+            fprintf(stderr, "Registry: duplicate token %.*s\n", (int)b[i].t->len,
+                    (const char *)b[i].t->token);
+            err = 1;
+        }
+    uint32_t nul;
+    for (size_t i = 0; !err && i < nb; i++)
+        err = strings_append(&s, b[i].t->token, b[i].t->len, &b[i].e.token)
+            || strings_append(&s, "", 1, &nul)
+            || strings_intern(&s, b[i].t->id.user, &b[i].e.user)
+            || strings_intern(&s, b[i].t->id.host, &b[i].e.host);
+
+    /* Écriture dans un fichier temporaire propre à cet appel, puis renommage. */
+    static atomic_uint seq;
+    size_t len = strlen(path) + 32;
+    char *tmp = err ? NULL : malloc(len);
+    FILE *f = NULL;
+    if (tmp) {
+        snprintf(tmp, len, "%s.%ld.%u", path, (long)getpid(), atomic_fetch_add(&seq, 1));
+        f = fopen(tmp, "wb");
+    }
+    err = err || !f;
+    if (f) {
+        struct registry_hdr hdr = {.magic = REGISTRY_MAGIC,.version = REGISTRY_VERSION,
+            .nb = nb,.strings_size = s.len
+        };
+        err |= fwrite(&hdr, sizeof(hdr), 1, f) != 1;
+        for (size_t i = 0; i < nb; i++)
+            err |= fwrite(&b[i].e, sizeof(b[i].e), 1, f) != 1;
+        err |= fwrite(s.buf, 1, s.len, f) != s.len;
+        err |= fclose(f) != 0;
+        err = err ? (remove(tmp), 1) : rename(tmp, path) != 0;
+    }
+    free(tmp), free(b), free(s.buf), free(s.slots);
+    return err ? stegx_errno = ERR_REGISTRY, 1 : 0;
+}
+
+stegx_registry_s *stegx_registry_open(const char *path)
+{
+    assert(path);
+    stegx_registry_s *r = calloc(1, sizeof(*r));
+    if (!r)
+        return perror("Can't allocate memory for registry"), stegx_errno = ERR_OTHER, NULL;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) || (size_t)st.st_size < sizeof(struct registry_hdr))
+        return perror(path), fd != -1 ? close(fd) : 0, free(r), stegx_errno = ERR_REGISTRY, NULL;
+    r->size = st.st_size;
+    r->addr = mmap(NULL, r->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (r->addr == MAP_FAILED)
+        return perror("Can't map registry"), free(r), stegx_errno = ERR_REGISTRY, NULL;
+
+    /* Vérification de l'en-tête, puis de chaque entrée une fois pour toutes :
+     * les recherches n'ont plus rien à vérifier. */
+    const struct registry_hdr *hdr = r->addr;
+    int err = hdr->magic != REGISTRY_MAGIC || hdr->version != REGISTRY_VERSION
+        || hdr->nb > (r->size - sizeof(*hdr)) / sizeof(struct registry_entry)
+        || sizeof(*hdr) + hdr->nb * sizeof(struct registry_entry) + hdr->strings_size != r->size
+        || (hdr->strings_size && ((const char *)r->addr)[r->size - 1]);
+    if (!err) {
+        r->nb = hdr->nb;
+        r->entries = (const struct registry_entry *)(hdr + 1);
+        r->strings = (const char *)(r->entries + r->nb);
+    }
+    for (uint64_t i = 0; !err && i < r->nb; i++) {
+        const struct registry_entry *e = &r->entries[i];
+        err = (uint64_t) e->token + e->token_len > hdr->strings_size
+            || e->user >= hdr->strings_size || e->host >= hdr->strings_size
+            || (i && e->hash < e[-1].hash);
+    }
+    if (err)
+        return fprintf(stderr, "%s: invalid registry\n", path), stegx_registry_close(r),
+            stegx_errno = ERR_REGISTRY, NULL;
+    madvise(r->addr, r->size, MADV_RANDOM);
+    return r;
+}
+
+int stegx_registry_lookup(const stegx_registry_s * r, const void *token, size_t len,
+                          stegx_identity_s * id)
+{
+    assert(r && (token || !len) && id);
+    uint64_t h = sig_hash(FNV64_OFFSET, token, len);
+    /* Première entrée d'empreinte >= h. */
+    uint64_t lo = 0, hi = r->nb;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (r->entries[mid].hash < h)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (const struct registry_entry *e = &r->entries[lo]; lo < r->nb && e->hash == h; e++, lo++)
+        if (e->token_len == len && !memcmp(r->strings + e->token, token, len)) {
+            *id = (stegx_identity_s) {.user = r->strings + e->user,.host = r->strings + e->host,
+                .issued = e->issued
+            };
+            return 0;
+        }
+    return 1;
+}
+
+void stegx_registry_close(stegx_registry_s * r)
+{
+    if (!r)
+        return;
+    if (r->addr && r->addr != MAP_FAILED)
+        munmap(r->addr, r->size);
+    free(r);
+}
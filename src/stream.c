@@ -0,0 +1,319 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file stream.c
+ * @brief Insertion et extraction EOC sur un flux FLV.
+ * @details L'algorithme EOC répartit les données entre tous les tags vidéo,
+ * dont il doit connaître le nombre : il ne peut pas traiter un flux en direct
+ * (enregistrement RTMP, envoi par morceaux). Ici, chaque tag vidéo reçoit un
+ * nombre fixe d'octets d'une trame répétée sans fin :
+ *
+ *     "SXST"  taille (4 octets)  données  somme de contrôle (4 octets)
+ *
+ * La trame est XORée avec la suite pseudo-aléatoire du mot de passe, sauf sa
+ * sentinelle qui permet de la retrouver à partir de n'importe quel tag. Les
+ * octets d'un tag sont écrits à la fin de ses données, suivis de leur nombre
+ * et de \r{STREAM_MARK}. Les tags sont traités au fil de leur arrivée : seul
+ * le header du tag en cours est gardé en mémoire, ses données sont recopiées
+ * par blocs. Les adresses de "onMetaData" ne sont pas mises à jour, les tags
+ * suivants n'étant pas encore connus.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "common.h"
+#include "stegx.h"
+#include "rand.h"
+
+/** Sentinelle du début d'une trame ("SXST"). */
+#define STREAM_MAGIC 0x53585354
+
+/** Octet qui termine les données ajoutées à un tag vidéo. */
+#define STREAM_MARK 28
+/** Taille du header et de la somme de contrôle d'une trame (octets). */
+#define STREAM_FRAME_OVERHEAD (3 * sizeof(uint32_t))
+/** Taille maximale des données d'une trame lue. */
+#define STREAM_MAX_LEN (16 * 1024 * 1024)
+/** Taille des blocs recopiés d'un coup. */
+#define STREAM_BLOCK_SIZE (64 * 1024)
+/** Taille du header d'un fichier FLV. */
+#define STREAM_FLV_HDR 9
+
+/**
+ * @brief Somme de contrôle FNV-1a des données d'une trame.
+ * @param data Données.
+ * @param len Taille des données.
+ * @return Somme de contrôle.
+ * @author StegX Team
+ */
+static uint32_t stream_sum(const uint8_t * data, uint32_t len)
+{
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < len; i++)
+        h = (h ^ data[i]) * 16777619u;
+    return h;
+}
+
+/**
+ * @brief Écrit un entier en big endian.
+ * @param p Destination.
+ * @param v Entier.
+ * @param n Nombre d'octets.
+ * @author StegX Team
+ */
+static void stream_put_be(uint8_t * p, uint32_t v, int n)
+{
+    while (n--)
+        p[n] = v, v >>= 8;
+}
+
+/**
+ * @brief Lit un entier big endian.
+ * @param p Source.
+ * @param n Nombre d'octets.
+ * @return Entier lu.
+ * @author StegX Team
+ */
+static uint32_t stream_get_be(const uint8_t * p, int n)
+{
+    uint32_t v = 0;
+    while (n--)
+        v = v << 8 | *p++;
+    return v;
+}
+
+/**
+ * @brief Recopie des octets d'un flux à l'autre.
+ * @details Si le flux lu se termine avant, les octets lus sont recopiés.
+ * @param in Flux lu.
+ * @param out Flux écrit (NULL pour sauter les octets).
+ * @param buf Tampon de \r{STREAM_BLOCK_SIZE} octets.
+ * @param n Nombre d'octets.
+ * @return 0 si tout s'est bien passé, sinon 1.
+ * @author StegX Team
+ */
+static int stream_copy(FILE * in, FILE * out, uint8_t * buf, uint32_t n)
+{
+    for (size_t len, rd; n; n -= len) {
+        len = n < STREAM_BLOCK_SIZE ? n : STREAM_BLOCK_SIZE;
+        if ((rd = fread(buf, 1, len, in)) != len) {
+            if (out)
+                fwrite(buf, 1, rd, out);
+            return 1;
+        }
+        if (out && fwrite(buf, 1, len, out) != len)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Recopie le header du flux FLV.
+ * @param in Flux lu.
+ * @param out Flux écrit (NULL pour seulement lire).
+ * @param buf Tampon de \r{STREAM_BLOCK_SIZE} octets.
+ * @return 0 si le flux est un FLV, sinon 1.
+ * @author StegX Team
+ */
+static int stream_header(FILE * in, FILE * out, uint8_t * buf)
+{
+    /* Header puis "previous tag size" du premier tag. */
+    if (fread(buf, 1, STREAM_FLV_HDR, in) != STREAM_FLV_HDR || memcmp(buf, "FLV", 3))
+        return 1;
+    uint32_t size = stream_get_be(buf + 5, 4);
+    if (size < STREAM_FLV_HDR || size - STREAM_FLV_HDR + 4 > STREAM_BLOCK_SIZE
+        || fread(buf + STREAM_FLV_HDR, 1, size - STREAM_FLV_HDR + 4, in) != size - STREAM_FLV_HDR + 4)
+        return 1;
+    return out && fwrite(buf, 1, size + 4, out) != size + 4;
+}
+
+int stegx_stream_insert(FILE * in, FILE * out, const void *data, uint32_t len, const char *passwd,
+                        unsigned int per_tag)
+{
+    assert(in && out && data);
+    assert(per_tag && per_tag <= UINT8_MAX);
+    if (!len || len > STREAM_MAX_LEN)
+        return stegx_errno = ERR_LENGTH_HIDDEN, 1;
+    uint8_t *buf = malloc(STREAM_BLOCK_SIZE), *frame = malloc(len + STREAM_FRAME_OVERHEAD);
+    if (!buf || !frame)
+        return perror("Can't allocate memory for the stream"), free(buf), free(frame),
+            stegx_errno = ERR_OTHER, 1;
+
+    /* Trame XORée à partir de sa taille. */
+    uint32_t frame_len = len + STREAM_FRAME_OVERHEAD, f = 0;
+    stream_put_be(frame, STREAM_MAGIC, 4);
+    stream_put_be(frame + 4, len, 4);
+    memcpy(frame + 8, data, len);
+    stream_put_be(frame + frame_len - 4, stream_sum(data, len), 4);
+    if (passwd) {
+        stegx_srand(create_seed(passwd));
+        for (uint32_t i = 4; i < frame_len; i++)
+            frame[i] ^= stegx_rand() % UINT8_MAX;
+    }
+
+    int err = stream_header(in, out, buf) ? ERR_HOST : ERR_NONE;
+    /* Tags au fil de leur arrivée. La fin du flux peut couper un tag (fin
+     * d'un enregistrement) : ce qui en a été lu est recopié. */
+    for (uint8_t hdr[FLV_TAG_HEADER_SIZE], tail[UINT8_MAX + 2], pts[4]; !err;) {
+        size_t n = fread(hdr, 1, sizeof(hdr), in);
+        if (n < sizeof(hdr)) {
+            err = fwrite(hdr, 1, n, out) != n || ferror(in) ? ERR_INSERT : ERR_NONE;
+            break;
+        }
+        uint32_t data_size = stream_get_be(hdr + 1, 3), add = 0;
+        if (hdr[0] == VIDEO_TAG && data_size + per_tag + 2 <= 0xFFFFFF)
+            add = per_tag + 2;
+        stream_put_be(hdr + 1, data_size + add, 3);
+        if (fwrite(hdr, 1, sizeof(hdr), out) != sizeof(hdr))
+            err = ERR_INSERT;
+        else if (stream_copy(in, out, buf, data_size))
+            err = ferror(in) || ferror(out) ? ERR_INSERT : ERR_NONE;
+        else {
+            /* Octets suivants de la trame, leur nombre et la marque. */
+            for (uint32_t i = 0; add && i < per_tag; i++, f = (f + 1) % frame_len)
+                tail[i] = frame[f];
+            tail[per_tag] = per_tag, tail[per_tag + 1] = STREAM_MARK;
+            if ((add && fwrite(tail, 1, add, out) != add))
+                err = ERR_INSERT;
+            else if ((n = fread(pts, 1, sizeof(pts), in)) < sizeof(pts))
+                err = fwrite(pts, 1, n, out) != n || ferror(in) ? ERR_INSERT : ERR_NONE;
+            else {
+                stream_put_be(pts, stream_get_be(pts, 4) + add, 4);
+                /* Flux en direct : chaque tag est transmis dès qu'il est écrit. */
+                if (fwrite(pts, 1, sizeof(pts), out) != sizeof(pts) || fflush(out))
+                    err = ERR_INSERT;
+                continue;
+            }
+        }
+        break;
+    }
+    if (fflush(out) && !err)
+        err = ERR_INSERT;
+    if (err == ERR_INSERT)
+        perror("Can't insert into the FLV stream");
+    free(buf), free(frame);
+    return err ? (stegx_errno = err), 1 : 0;
+}
+
+/** États de la lecture d'une trame. */
+enum stream_state { STREAM_SEARCH, STREAM_LEN, STREAM_DATA, STREAM_SUM };
+
+/**
+ * @brief Lecture des trames dans les octets ajoutés aux tags vidéo.
+ */
+struct stream_frame {
+    enum stream_state state;    /*!< Champ en cours de lecture. */
+    const char *passwd;         /*!< Mot de passe (NULL si la trame n'est pas XORée). */
+    uint32_t word;              /*!< Derniers octets lus (sentinelle, taille ou somme de contrôle). */
+    uint32_t pos, len;          /*!< Octets lus du champ en cours et taille des données. */
+    uint8_t *data;              /*!< Données de la trame. */
+};
+
+/**
+ * @brief Lit l'octet suivant d'une trame.
+ * @details Une trame invalide (taille ou somme de contrôle) est abandonnée et
+ * la sentinelle recherchée de nouveau : la trame suivante la répète.
+ * @param fr Lecture en cours.
+ * @param b Octet lu.
+ * @return 1 si une trame valide est complète, -1 sur une erreur
+ * d'allocation, sinon 0.
+ * @author StegX Team
+ */
+static int stream_feed(struct stream_frame *fr, uint8_t b)
+{
+    if (fr->state == STREAM_SEARCH) {
+        if ((fr->word = fr->word << 8 | b) == STREAM_MAGIC) {
+            fr->state = STREAM_LEN, fr->pos = fr->word = 0;
+            if (fr->passwd)
+                stegx_srand(create_seed(fr->passwd));
+        }
+        return 0;
+    }
+    if (fr->passwd)
+        b ^= stegx_rand() % UINT8_MAX;
+    if (fr->state == STREAM_DATA) {
+        fr->data[fr->pos++] = b;
+        if (fr->pos == fr->len)
+            fr->state = STREAM_SUM, fr->pos = fr->word = 0;
+        return 0;
+    }
+    fr->word = fr->word << 8 | b;
+    if (++fr->pos < sizeof(uint32_t))
+        return 0;
+    if (fr->state == STREAM_LEN && fr->word && fr->word <= STREAM_MAX_LEN) {
+        uint8_t *tmp = realloc(fr->data, fr->word);
+        if (!tmp)
+            return perror("Can't allocate memory for the stream"), -1;
+        fr->data = tmp, fr->len = fr->word, fr->state = STREAM_DATA, fr->pos = 0;
+        return 0;
+    }
+    if (fr->state == STREAM_SUM && fr->word == stream_sum(fr->data, fr->len))
+        return 1;
+    fr->state = STREAM_SEARCH, fr->word = 0;
+    return 0;
+}
+
+int stegx_stream_extract(FILE * in, const char *passwd, FILE * res)
+{
+    assert(in && res);
+    struct stream_frame fr = {.passwd = passwd };
+    uint8_t *buf = malloc(STREAM_BLOCK_SIZE), tail[UINT8_MAX + 2], hdr[FLV_TAG_HEADER_SIZE];
+    if (!buf)
+        return perror("Can't allocate memory for the stream"), stegx_errno = ERR_OTHER, 1;
+    int err = stream_header(in, NULL, buf) ? ERR_HOST : ERR_NONE, found = 0;
+    /* Tags au fil de leur arrivée, jusqu'à la première trame valide. */
+    while (!err && !found && fread(hdr, 1, sizeof(hdr), in) == sizeof(hdr)) {
+        uint32_t data_size = stream_get_be(hdr + 1, 3), t = 0;
+        if (hdr[0] != VIDEO_TAG) {
+            if (stream_copy(in, NULL, buf, data_size + sizeof(uint32_t)))
+                break;
+            continue;
+        }
+        /* Données du tag par blocs, en gardant leurs derniers octets. */
+        for (uint32_t len, n = data_size; n; n -= len) {
+            len = n < STREAM_BLOCK_SIZE ? n : STREAM_BLOCK_SIZE;
+            if (fread(buf, 1, len, in) != len)
+                break;
+            uint32_t m = len < sizeof(tail) ? len : sizeof(tail), keep = t + m > sizeof(tail) ? sizeof(tail) - m : t;
+            memmove(tail, tail + t - keep, keep);
+            memcpy(tail + keep, buf + len - m, m);
+            t = keep + m;
+        }
+        if (fread(buf, 1, sizeof(uint32_t), in) != sizeof(uint32_t))
+            break;
+        /* Octets ajoutés : leur nombre et la marque terminent les données. */
+        if (t < 3 || tail[t - 1] != STREAM_MARK || !tail[t - 2] || tail[t - 2] + 2u > t)
+            continue;
+        for (uint32_t i = t - 2 - tail[t - 2]; !err && !found && i < t - 2; i++)
+            if ((found = stream_feed(&fr, tail[i])) == -1)
+                err = ERR_OTHER;
+    }
+    if (!err && ferror(in))
+        err = ERR_READ, perror("Can't read the FLV stream");
+    else if (!err && !found)
+        err = ERR_EXTRACT;
+    else if (!err && (fwrite(fr.data, 1, fr.len, res) != fr.len || fflush(res)))
+        err = ERR_EXTRACT, perror("Can't write the hidden data");
+    free(fr.data), free(buf);
+    return err ? (stegx_errno = err), 1 : 0;
+}
@@ -28,20 +28,24 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "endian.h"
 #include "common.h"
 #include "stegx_common.h"
 #include "stegx_errors.h"
 #include "rand.h"
+#include "sugg_algo.h"
+#include "host_index.h"
 
 /** 
- * @brief Teste si l'on peut utiliser l'algorithme LSB pour la dissimulation. 
+ * @brief Calcule la capacité de l'algorithme LSB pour la dissimulation. 
  * @param infos Structure représentant les informations concernant la dissimulation.
- * @return 0 Si l'algorithme est proposé, 1 sinon.
- * @author Clément Caumes (BMP) et Pierre Ayoub (WAV)
+ * @return Nombre maximum d'octets pouvant être cachés, 0 si l'algorithme n'est
+ * pas proposé.
+ * @author Clément Caumes (BMP), Pierre Ayoub (WAV) et StegX Team (PNG)
  */
-static int can_use_lsb(info_s * infos)
+static uint64_t capacity_lsb(info_s * infos)
 {
     assert(infos);
     /* Si le fichier hôte est un fichier BMP non compressé. Si le nombre de bits
@@ -55,10 +59,7 @@ static int can_use_lsb(info_s * infos)
             8;
         // calcul du nombre de bits modifiables pour l'algorithme LSB
         nb_bits_pic /= 4;
-
-        // si la taille du fichier a cacher est ok -> LSB possible
-        if ((infos->hidden_length * 8) <= nb_bits_pic)
-            return 0;
+        return nb_bits_pic / 8;
     }
 
     /* Si le fichier hôte est un fichier WAVE-PCM. */
@@ -70,88 +71,117 @@ static int can_use_lsb(info_s * infos)
         uint64_t nb_bits_modif =
             ((infos->host.file_info.wav.data_size) / (infos->host.file_info.wav.chunk_size / 8)) *
             2;
-
-        /* Si le nombre de bit du fichier à cacher est inférieur ou égal au
-         * nombre de bit modifiables => LSB utilisable. */
-        if ((infos->hidden_length * 8) <= nb_bits_modif)
-            return 0;
+        return nb_bits_modif / 8;
     }
     /* Si le fichier hote est un fichier MP3. */
-    else if (infos->host.type == MP3 &&
-            (infos->host.file_info.mp3.fr_nb * MP3_HDR_NB_BITS_MODIF >= infos->hidden_length * 8))
-        return 0;
+    else if (infos->host.type == MP3)
+        return infos->host.file_info.mp3.fr_nb * MP3_HDR_NB_BITS_MODIF / 8;
+    /* Si le fichier hôte est un fichier PNG dont les échantillons font un
+     * octet : 2 bits de poids faible par échantillon des pixels décompressés. */
+    else if (infos->host.type == PNG)
+        return (uint64_t) png_row_size(&infos->host.file_info.png) * infos->host.file_info.png.height / 4;
     /* Sinon, on ne peux pas utiliser LSB. */
-    return 1;
+    return 0;
 }
 
 /** 
- * @brief Teste si l'on peut utiliser l'algorithme EOF pour la dissimulation. 
+ * @brief Calcule la capacité de l'algorithme EOF pour la dissimulation. 
  * @param infos Structure représentant les informations concernant la dissimulation.
- * @return 0 si l'algorithme est proposé, 1 sinon.
+ * @return Nombre maximum d'octets pouvant être cachés, 0 si l'algorithme n'est
+ * pas proposé.
  * @author Clément Caumes
  */
-static int can_use_eof(info_s * infos)
+static uint64_t capacity_eof(info_s * infos)
 {
     assert(infos);
     // Pour tous les formats proposés par StegX sauf AVI, on propose EOF.
-    return infos->host.type == AVI_COMPRESSED || infos->host.type == AVI_UNCOMPRESSED ? 1 : !IS_FILE_TYPE(infos->host.type);
+    int is_file_type = IS_FILE_TYPE(infos->host.type);
+    if (!is_file_type || infos->host.type == AVI_COMPRESSED || infos->host.type == AVI_UNCOMPRESSED)
+        return 0;
+    return CAPACITY_UNLIMITED;
 }
 
 /** 
- * @brief Teste si l'on peut utiliser l'algorithme Metadata pour la dissimulation. 
+ * @brief Calcule la capacité de l'algorithme Metadata pour la dissimulation. 
  * @param infos Structure représentant les informations concernant la dissimulation.
- * @return 0 si l'algorithme est proposé, 1 sinon.
+ * @return Nombre maximum d'octets pouvant être cachés, 0 si l'algorithme n'est
+ * pas proposé.
  * @author Clément Caumes
  */
-static int can_use_metadata(info_s * infos)
+static uint64_t capacity_metadata(info_s * infos)
 {
     assert(infos);
-    /* On propose Metadata pour BMP & PNG seulement. */
+    /* On propose Metadata pour BMP, PNG & FLV seulement. */
     /* L'algorithme METADATA sur le format BMP consiste à insérer entre le 
      * header et le debut de l'image les données cachées. L'offset de l'image 
      * brute est écrit sur 4 octets et il ne faut pas dépasser cette taille 
      */
     if ((infos->host.type == BMP_COMPRESSED) || (infos->host.type == BMP_UNCOMPRESSED)) {
-        uint64_t length = infos->hidden_length + infos->host.file_info.bmp.header_size
+        uint64_t length = (uint64_t) infos->host.file_info.bmp.header_size
             + infos->host.file_info.bmp.header_size;
         // Si cela depasse 4 octets on ne propose pas METADATA
-        if (length > BMP_METADATA_MAX)
-            return 1;
-        else
-            return 0;
+        return length > BMP_METADATA_MAX ? 0 : BMP_METADATA_MAX - length;
     } else if (infos->host.type == PNG)
-        return 0;
+        return CAPACITY_UNLIMITED;
+    /* Sur FLV, les données sont dans un tag de script dont la taille est
+     * écrite sur 3 octets. */
+    else if (infos->host.type == FLV)
+        return FLV_METADATA_MAX;
     else
-        return 1;
+        return 0;
 }
 
 /** 
- * @brief Teste si l'on peut utiliser l'algorithme EOC pour la dissimulation. 
+ * @brief Calcule la capacité de l'algorithme EOC pour la dissimulation. 
  * @param infos Structure représentant les informations concernant la dissimulation.
- * @return 0 si l'algorithme est proposé, 1 sinon.
+ * @return Nombre maximum d'octets pouvant être cachés, 0 si l'algorithme n'est
+ * pas proposé.
  * @author Clément Caumes
  */
-static int can_use_eoc(info_s * infos)
+static uint64_t capacity_eoc(info_s * infos)
 {
     assert(infos);
     // Pour le format FLV, on propose EOC. Pour tous le reste, on ne propose pas EOC.
-    return infos->host.type == FLV ? 0 : 1;
+    return infos->host.type == FLV ? CAPACITY_UNLIMITED : 0;
 }
 
 /** 
- * @brief Teste si l'on peut utiliser l'algorithme Junk Chunk pour la dissimulation. 
+ * @brief Calcule la capacité de l'algorithme Junk Chunk pour la dissimulation. 
  * @param infos Structure représentant les informations concernant la dissimulation.
- * @return 0 si l'algorithme est proposé, 1 sinon.
+ * @return Nombre maximum d'octets pouvant être cachés, 0 si l'algorithme n'est
+ * pas proposé.
  * @author Clément Caumes
  */
-static int can_use_junk_chunk(info_s * infos)
+static uint64_t capacity_junk_chunk(info_s * infos)
 {
     assert(infos);
     // Pour le format AVI, on propose Junk Chunk. Pour tous le reste, on ne propose pas Junk Chunk.
-    return (infos->host.type == AVI_COMPRESSED) || (infos->host.type == AVI_UNCOMPRESSED) ? 0 : 1;
+    return (infos->host.type == AVI_COMPRESSED) || (infos->host.type == AVI_UNCOMPRESSED) ?
+        CAPACITY_UNLIMITED : 0;
 }
 
-int fill_host_info(info_s * infos)
+uint64_t host_capacity(info_s * infos, algo_e algo)
+{
+    assert(algo >= STEGX_ALGO_LSB && algo < STEGX_NB_ALGO);
+    /* Capacité connue grâce à l'index de l'hôte. */
+    if (infos->host.index && infos->host.index->capacity[algo])
+        return infos->host.index->capacity[algo];
+    /* Les fonctions de ce tableau doivent être déclarés dans l'ordre de
+     * l'énumération. */
+    static uint64_t(*capacity_algo[STEGX_NB_ALGO]) (info_s *) = {
+    capacity_lsb, capacity_eof, capacity_metadata, capacity_eoc, capacity_junk_chunk};
+    return (*capacity_algo[algo]) (infos);
+}
+
+/** 
+ * @brief Analyse le fichier hôte en le parcourant.
+ * @param infos Structure représentant les informations concernant la dissimulation.
+ * @sideeffect Remplit la structure \r{infos->host.file_info} et l'index des
+ * frames MP3 ou des tags FLV.
+ * @return 0 si l'analyse s'est bien passée, 1 sinon.
+ * @author StegX Team
+ */
+static int parse_host_info(info_s * infos)
 {
     /* Vérifications + on set positionne au début du fichier. */
     assert(infos && infos->host.host);
@@ -210,6 +240,17 @@ int fill_host_info(info_s * infos)
         ihdr_length = stegx_be32toh(ihdr_length);
         infos->host.file_info.png.header_size = PNG_DEF_IHDR + ihdr_length;
 
+        // lecture des dimensions et du format des pixels (pour le LSB)
+        uint8_t ihdr[LENGTH_IHDR];
+        png_s *png = &(infos->host.file_info.png);
+        if (ihdr_length < LENGTH_IHDR || fseek(infos->host.host, 4, SEEK_CUR)
+            || fread(ihdr, sizeof(ihdr), 1, infos->host.host) != 1)
+            return perror("PNG file: Can't read chunk IHDR"), 1;
+        png->width = (uint32_t) ihdr[0] << 24 | ihdr[1] << 16 | ihdr[2] << 8 | ihdr[3];
+        png->height = (uint32_t) ihdr[4] << 24 | ihdr[5] << 16 | ihdr[6] << 8 | ihdr[7];
+        png->bit_depth = ihdr[8], png->color_type = ihdr[9], png->interlace = ihdr[12];
+        png->idat_begin = png->idat_end = 0;
+
         uint32_t chunk_size, chunk_id;
 
         // Jump sur le premier chunk et lecture de son ID et de sa taille
@@ -222,7 +263,19 @@ int fill_host_info(info_s * infos)
             return perror("PNG file: Can't read ID of chunk"), 1;
         // on cherche le chunk IEND pour connaitre la taille du fichier
         while (chunk_id != SIG_IEND) {
-            if (fseek(infos->host.host, chunk_size + LENGTH_CRC, SEEK_CUR))
+            long int adr = ftell(infos->host.host);
+            if (progress_at(&infos->progress, adr))
+                return 1;
+            // les chunks IDAT se suivent : on retient le début du premier et la fin du dernier
+            if (chunk_id == SIG_IDAT) {
+                png->idat_begin = png->idat_begin ? png->idat_begin : adr - 8;
+                png->idat_end = adr + chunk_size + LENGTH_CRC;
+            }
+            /* Les données sont lues pour vérifier le CRC si demandé, sinon sautées. */
+            if (infos->flags & STEGX_FLAG_CHECK_CRC) {
+                if (png_chunk_check(infos->host.host, chunk_id, chunk_size))
+                    return perror("PNG file: Invalid CRC of chunk"), 1;
+            } else if (fseek(infos->host.host, chunk_size + LENGTH_CRC, SEEK_CUR))
                 return perror("PNG file: Can not move in the file"), 1;
             if (fread(&chunk_size, sizeof(uint32_t), 1, infos->host.host) != 1)
                 return perror("PNG file: Can't read size of chunk"), 1;
@@ -272,50 +325,16 @@ int fill_host_info(info_s * infos)
     // remplit la structure FLV de infos.host.file_info
     // https://www.adobe.com/content/dam/acom/en/devnet/flv/video_file_format_spec_v10.pdf
     else if (infos->host.type == FLV) {
-        uint8_t check_tags;
-        uint32_t header_size;
-        uint8_t tag_type;
-        uint32_t data_size;
-        uint32_t prev_tag_size;
-
-        infos->host.file_info.flv.nb_video_tag = 0;
-        infos->host.file_info.flv.nb_metadata_tag = 0;
-        infos->host.file_info.flv.file_size = 0;
-        fseek(infos->host.host, 4, SEEK_SET);
-
-        //lecture du header
-        fread(&check_tags, sizeof(check_tags), 1, infos->host.host);
-        fread(&header_size, sizeof(header_size), 1, infos->host.host);
-
-        header_size = stegx_be32toh(header_size);
-        infos->host.file_info.flv.file_size += header_size;
-        fseek(infos->host.host, 4, SEEK_CUR);
-        infos->host.file_info.flv.file_size += 4;
-
-        //lecture des tags
-        while (fread(&tag_type, sizeof(tag_type), 1, infos->host.host) == 1) {
-
-            if (tag_type == METATAG) {
-                infos->host.file_info.flv.nb_metadata_tag += 1;
-            } else if (tag_type == VIDEO_TAG) {
-                infos->host.file_info.flv.nb_video_tag += 1;
-            } else if (!(tag_type == AUDIO_TAG || tag_type == SCRIPT_DATA_TAG)) {
-                break;
-            }
-            fread(&data_size, sizeof(data_size), 1, infos->host.host);
-            //lecture de la taille des data
-            data_size = stegx_be32toh(data_size);
-            //passage en 24 bits      
-            data_size >>= 8;
-            //deplacement jusqu'au prochain previous tag size (data size + 6 octets qui comportent d'autres informations non utiles) 
-            fseek(infos->host.host, data_size + 6, SEEK_CUR);
-            //lecture du previous tag size 
-            fread(&prev_tag_size, sizeof(prev_tag_size), 1, infos->host.host);
-            prev_tag_size = stegx_be32toh(prev_tag_size);
-            infos->host.file_info.flv.file_size += prev_tag_size + 4;
-        }
+        long int end;
+        uint8_t byte;
+        /* Index des tags (pour l'extraction EOC, qui va directement aux tags
+         * vidéo au lieu de parcourir de nouveau le fichier). */
+        free(infos->host.flv_tag);
+        if (!(infos->host.flv_tag = flv_tag_index(infos->host.host, &infos->host.file_info.flv,
+                                                  &infos->host.flv_nb_tag, &end, &infos->progress)))
+            return 1;
         if (infos->mode == STEGX_MODE_INSERT
-            && fread(&check_tags, sizeof(uint8_t), 1, infos->host.host))
+            && !fseek(infos->host.host, end, SEEK_SET) && fread(&byte, sizeof(byte), 1, infos->host.host))
             return
                 perror
                 ("Fichier flv ayant des données en fin de fichier. Fichier incompatible pour l'insertion."),
@@ -326,30 +345,26 @@ int fill_host_info(info_s * infos)
     /* Fichier MP3. */
     else if (infos->host.type == MP3) {
         uint32_t hdr = 0;
+        long int end = 0;
         long int * n = &(infos->host.file_info.mp3.fr_nb);
         long int * f = &(infos->host.file_info.mp3.fr_frst_adr);
         FILE * h = infos->host.host;
         /* Déplacement et stockage de l'adresse du header de la première frame du MP3 (pour le "LSB"). */
-        if ((*f = mp3_mpeg_fr_find_first(h)) == -1 || fseek(h, *f, SEEK_SET))
+        if ((*f = mp3_mpeg_fr_find_first(h)) == -1)
             return perror("MP3 fill_host_info: Can't find first MPEG 1/2 Layer III frame"), 1;
-        /* Dénombrement du nombre de frame (pour "can_use_lsb"). */
-        for (*n = 0 ; (fread(&hdr, sizeof(hdr), 1, h) == 1) && mp3_mpeg_hdr_test(hdr = stegx_be32toh(hdr)); (*n)++) {
-            if (mp3_mpeg_fr_seek(hdr, h))
-                return perror("MP3 fill_host_info: Can't skip current MP3 MPEG frame"), 1;
-        }
-        if (ferror(h))
-            return perror("MP3 fill_host_info: Can't read frame header"), 1;
+        /* Index des frames (pour "can_use_lsb" et pour l'insertion et
+         * l'extraction en LSB, qui n'ont plus à parcourir le fichier). */
+        int threads = infos->flags & STEGX_FLAG_PARALLEL ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+        free(infos->host.mp3_fr_size);
+        if (!(infos->host.mp3_fr_size = mp3_mpeg_fr_index(h, *f, n, &end, &hdr, threads, &infos->progress)))
+            return 1;
 
-        /* Curseur sur un tag ID3v1 => saut au-dessus du tag et fin du fichier définitive. */
-        if (mp3_id3v1_hdr_test(hdr) && mp3_id3v1_tag_seek(h))
+        /* Tag ID3v1 après les frames => saut au-dessus du tag et fin du fichier définitive. */
+        if (mp3_id3v1_hdr_test(hdr) && (fseek(h, end + sizeof(hdr), SEEK_SET) || mp3_id3v1_tag_seek(h)))
             return perror("MP3 fill_host_info: Can't skip over ID3v1 tag at the end of file"), 1;
         /* Stockage de la fin du fichier (pour EOF). */
-        if ((infos->host.file_info.mp3.eof = ftell(h)) == -1)
+        if ((infos->host.file_info.mp3.eof = mp3_id3v1_hdr_test(hdr) ? ftell(h) : end) == -1)
             return perror("MP3 fill_host_info: Can't get end-of-file address"), 1;
-        /* Curseur n'était pas sur un tag ID3v1 et la fin du fichier n'as pas
-         * été lu => on à lu 4 octets de données en trop (exemple, la signature). */
-        if (!mp3_id3v1_hdr_test(hdr) && !feof(h))
-            infos->host.file_info.mp3.eof -= sizeof(hdr);
         return 0;
     }
 
@@ -361,13 +376,33 @@ int fill_host_info(info_s * infos)
         return 1;
 }
 
-int stegx_suggest_algo(info_s * infos)
+int fill_host_info(info_s * infos)
 {
-    /* Test si on est en mode insertion, si oui, remplit la structure
-       infos->host.file_info. */
-    if (infos->mode == STEGX_MODE_EXTRACT || fill_host_info(infos))
-        return stegx_errno = ERR_SUGG_ALGOS, 1;
+    assert(infos && infos->host.host);
+    /* Analyse déjà faite (hôte du cache ou hôte partagé, ou index toujours
+     * valide) : rien à parcourir. */
+    if (infos->host.analysed)
+        return 0;
+    if ((infos->flags & STEGX_FLAG_INDEX) && !host_index_load(infos))
+        return 0;
+    if ((infos->flags & STEGX_FLAG_INDEX) && host_index_new(infos))
+        return 1;
+    if (progress_begin(&infos->progress, STEGX_STAGE_ANALYSE, infos->host.host, 0)
+        || parse_host_info(infos))
+        return host_index_free(infos), 1;
+    progress_end(&infos->progress);
+    if (infos->host.index) {
+        for (algo_e i = 0; i < STEGX_NB_ALGO; i++)
+            infos->host.index->capacity[i] = host_capacity(infos, i);
+        /* L'index n'est qu'un cache : une erreur d'écriture n'est pas bloquante. */
+        host_index_save(infos);
+    }
+    return 0;
+}
 
+int propose_algos(info_s * infos)
+{
+    assert(infos && infos->hidden);
     // Lecture de la taille du fichier à cacher.
     if (fseek(infos->hidden, 0, SEEK_END))
         return stegx_errno = ERR_SUGG_ALGOS, perror("Can't move to the end of hidden file"), 1;
@@ -383,12 +418,29 @@ int stegx_suggest_algo(info_s * infos)
     /* Remplissage du tableau stegx_propos_algos pour savoir 
        quels algos sont proposés par l'application en fonction des entrées de
        l'utilisateur. */
-    /* Les fonctions de ce tableau doivent être déclarés dans l'ordre de
-     * l'énumération. */
-    int (*can_use_algo[STEGX_NB_ALGO]) (info_s *) = {
-    can_use_lsb, can_use_eof, can_use_metadata, can_use_eoc, can_use_junk_chunk};
     for (algo_e i = 0; i < STEGX_NB_ALGO; i++)
-        stegx_propos_algos[i] = !(*can_use_algo[i]) (infos);
+        stegx_propos_algos[i] = infos->hidden_length <= host_capacity(infos, i);
+    return 0;
+}
+
+int stegx_suggest_algo(info_s * infos)
+{
+    /* Test si on est en mode insertion, si oui, remplit la structure
+       infos->host.file_info. */
+    if (infos->mode == STEGX_MODE_EXTRACT || fill_host_info(infos))
+        return stegx_errno =
+            progress_fail(&infos->progress, &infos->res, infos->res_path, ERR_SUGG_ALGOS), 1;
+    return propose_algos(infos);
+}
+
+int create_default_passwd(info_s * infos)
+{
+    assert(infos && infos->method == STEGX_WITHOUT_PASSWD);
+    if (!(infos->passwd = arena_calloc(&infos->arena, LENGTH_DEFAULT_PASSWD + 1, sizeof(char))))
+        return perror("Can't allocate memory for password string"), 1;
+    // Génération de symboles ASCII >= 32 et <= 126.
+    for (int i = 0; i < LENGTH_DEFAULT_PASSWD; i++)
+        infos->passwd[i] = 32 + (stegx_rand() % 95);
     return 0;
 }
 
@@ -399,12 +451,8 @@ int stegx_choose_algo(info_s * infos, algo_e algo_choosen)
     /* Si l'utilisateur n'a pas choisi de mot de passe, on en crée un par défaut aléatoirement. */
     if (infos->method == STEGX_WITHOUT_PASSWD) {
         stegx_srand(time(NULL));
-        free(infos->passwd);
-        if (!(infos->passwd = calloc((LENGTH_DEFAULT_PASSWD + 1), sizeof(char))))
-            return perror("Can't allocate memory for password string"), 1;
-        // Génération de symboles ASCII >= 32 et <= 126.
-        for (int i = 0; i < LENGTH_DEFAULT_PASSWD; i++)
-            infos->passwd[i] = 32 + (stegx_rand() % 95);
+        if (create_default_passwd(infos))
+            return 1;
     }
 
     assert(algo_choosen >= STEGX_ALGO_LSB && algo_choosen < STEGX_NB_ALGO);
@@ -27,13 +27,23 @@
 #ifndef SUGG_ALGOS_H
 #define SUGG_ALGOS_H
 
+#include <stdint.h>
+
 #include "stegx_common.h"
 
+/** Capacité d'un algorithme qui n'est limitée que par la taille maximum du
+ * fichier à cacher. */
+#define CAPACITY_UNLIMITED ((uint64_t)UINT32_MAX - 1)
+
 /** 
  * @brief Remplit les informations du fichier hôte. 
  * @details Remplit les informations du fichier hôte en fonction du type de
  * fichier. Effectue la lecture des données pour remplir la structure. 
- * @sideeffect Initialise et rempli le champ \r{info_s.host.file_info}.
+ * Si l'option \r{STEGX_FLAG_INDEX} est choisie, l'analyse est lue depuis
+ * l'index de l'hôte quand il est valide, sinon elle est faite puis sauvegardée
+ * dans l'index (voir host_index.h).
+ * @sideeffect Initialise et rempli le champ \r{info_s.host.file_info}, ainsi
+ * que \r{info_s.host.index} si l'index est utilisé.
  * @req \r{info_s.host.host} doit être un fichier ouvert en lecture et
  * compatible avec l'application.
  * @error \r{ERR_SUGG_ALGOS} si la fonction est utilisé en mode extraction.
@@ -45,4 +55,42 @@
  */
 int fill_host_info(info_s * infos);
 
+/** 
+ * @brief Propose les algorithmes utilisables sur un hôte déjà analysé.
+ * @details Lit la taille du fichier à cacher puis teste chaque algorithme en
+ * fonction de \r{info_s.host.file_info}, qui doit déjà être rempli.
+ * @sideeffect Remplit le champ \r{info_s.hidden_length} ainsi que la variable
+ * globale \r{stegx_propos_algos}.
+ * @error \r{ERR_HIDDEN_FILE_EMPTY} si le fichier à cacher est vide.
+ * @error \r{ERR_LENGTH_HIDDEN} si le fichier à cacher est supérieur à la taille
+ * maximum (2^32).
+ * @param infos Structure représentant les informations concernant la dissimulation.
+ * @return 0 si tout se passe bien, sinon 1 en cas d'erreur et met à jour
+ * \r{stegx_errno}.
+ * @author StegX Team
+ */
+int propose_algos(info_s * infos);
+
+/** 
+ * @brief Calcule la capacité d'un algorithme sur un hôte déjà analysé.
+ * @param infos Structure représentant les informations concernant la dissimulation.
+ * @param algo Algorithme à tester.
+ * @return Nombre maximum d'octets pouvant être cachés avec cet algorithme, 0
+ * si l'algorithme n'est pas utilisable sur cet hôte, \r{CAPACITY_UNLIMITED} si
+ * seule la taille maximum du fichier à cacher limite l'algorithme.
+ * @author StegX Team
+ */
+uint64_t host_capacity(info_s * infos, algo_e algo);
+
+/** 
+ * @brief Crée un mot de passe par défaut aléatoire.
+ * @details Utilise la suite pseudo-aléatoire courante, qui doit avoir été
+ * initialisée par l'appelant avec \r{stegx_srand}.
+ * @sideeffect Remplace le champ \r{info_s.passwd}.
+ * @param infos Structure représentant les informations concernant la dissimulation.
+ * @return 0 si tout se passe bien, sinon 1 en cas d'erreur d'allocation.
+ * @author StegX Team
+ */
+int create_default_passwd(info_s * infos);
+
 #endif
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the StegX project.
+ * Copyright (C) 2018  StegX Team
+ *
+ * StegX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file trial.c
+ * @brief Recherche du mot de passe d'un fichier hôte parmi des candidats.
+ * @details L'hôte est projeté et analysé une seule fois, et sa signature est
+ * lue une seule fois sans déXORer le nom du fichier caché. Tester un candidat
+ * revient alors à déXORer ce nom (quelques octets) : c'est le seul champ de la
+ * signature qui dépend du mot de passe, la taille des données y étant écrite
+ * en clair. Les données, elles, ne dépendent que de la seed tirée du mot de
+ * passe (\r{stegx_trial_key}) : des candidats de même clé donnent les mêmes
+ * données et n'ont besoin que d'une seule extraction.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include "common.h"
+#include "stegx.h"
+#include "detect_algo.h"
+#include "host_shared.h"
+#include "rand.h"
+
+/**
+ * @brief Recherche du mot de passe d'un fichier hôte.
+ */
+struct stegx_trial {
+    stegx_host_s *host;         /*!< Hôte projeté et analysé. */
+    uint32_t hidden_length;     /*!< Taille des données cachées. */
+    uint8_t name_len;           /*!< Longueur du nom du fichier caché. */
+    char name[LENGTH_HIDDEN_NAME_MAX];  /*!< Nom du fichier caché, XORé avec le mot de passe. */
+};
+
+stegx_trial_s *stegx_trial_open(const char *host_path)
+{
+    assert(host_path);
+    stegx_trial_s *t = calloc(1, sizeof(*t));
+    if (!t)
+        return perror("Can't allocate memory for password trial"), stegx_errno = ERR_OTHER, NULL;
+    if (!(t->host = stegx_host_open(host_path, STEGX_MODE_EXTRACT)))
+        return free(t), NULL;
+
+    /* Lecture de la signature sans mot de passe : le nom reste XORé. */
+    info_s tmp = {.mode = STEGX_MODE_EXTRACT };
+    if (host_shared_attach(&tmp, t->host))
+        return stegx_trial_close(t), stegx_errno = ERR_HOST, NULL;
+    enum err_code err = sig_read(&tmp, 0, &t->name_len) ? ERR_DETECT_ALGOS
+        : tmp.method != STEGX_WITH_PASSWD ? ERR_NO_PASSWD : ERR_NONE;
+    if (!err) {
+        memcpy(t->name, tmp.hidden_name, t->name_len);
+        t->hidden_length = tmp.hidden_length;
+    }
+    fclose(tmp.host.host);
+    arena_free(&tmp.arena);
+    if (err)
+        return stegx_trial_close(t), stegx_errno = err, NULL;
+    return t;
+}
+
+int stegx_trial_name(const stegx_trial_s * t, const char *passwd, char *name)
+{
+    assert(t && passwd && name);
+    if (!*passwd)
+        return 0;
+    memcpy(name, t->name, t->name_len);
+    sig_name_xor(name, t->name_len, passwd);
+    name[t->name_len] = '\0';
+    /* Le nom vient de "basename" lors de l'insertion : ni caractère de
+     * contrôle (dont '\0'), ni '/'. */
+    for (int i = 0; i < t->name_len; i++)
+        if ((unsigned char)name[i] < 0x20 || name[i] == 0x7F || name[i] == '/')
+            return 0;
+    return t->name_len > 0;
+}
+
+unsigned int stegx_trial_key(const char *passwd)
+{
+    assert(passwd && *passwd);
+    return create_seed(passwd);
+}
+
+uint32_t stegx_trial_length(const stegx_trial_s * t)
+{
+    assert(t);
+    return t->hidden_length;
+}
+
+int stegx_trial_extract(const stegx_trial_s * t, const char *passwd, FILE * res)
+{
+    assert(t && passwd && res);
+    stegx_choices_s choices = {.host_path = "",.res_path = "",.passwd = (char *)passwd,
+        .mode = STEGX_MODE_EXTRACT,.host = t->host,.res_file = res
+    };
+    info_s *infos = stegx_init(&choices);
+    if (!infos)
+        return fclose(res), 1;
+    int err = stegx_detect_algo(infos) || stegx_extract(infos, "");
+    stegx_clear(infos);
+    return err;
+}
+
+void stegx_trial_close(stegx_trial_s * t)
+{
+    if (!t)
+        return;
+    stegx_host_close(t->host);
+    free(t);
+}